@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <stddef.h>
 #include <inttypes.h>
 #include "main.h"
@@ -35,11 +36,19 @@
  * a file.
  *
  * The input must be h.264 byte-stream data. Depending on the encoder,
- * it may or may not support/expect access unit delimiters. */
+ * it may or may not support/expect access unit delimiters.
+ *
+ * By default, the h.264 data is split into access units here, since that
+ * works with all decoders. If the BYTE_STREAM_INPUT_ENV_VAR environment
+ * variable is set to 1, and the decoder supports byte stream input, then
+ * the data is instead pushed in fixed size chunks as-is, and the decoder
+ * finds the access units by itself. */
 
 
 #define FRAME_CONTEXT_START          0x1000
 #define FRAMEBUFFER_CONTEXT_START    0x2000
+#define BYTE_STREAM_CHUNK_SIZE       (64*1024)
+#define BYTE_STREAM_INPUT_ENV_VAR    "IMXVPUAPI2_DECODE_EXAMPLE_BYTE_STREAM_INPUT"
 
 
 struct _Context
@@ -54,6 +63,13 @@ struct _Context
 	/* Helper structure to parse h.264 byte-stream data. */
 	h264_context h264_ctx;
 
+	/* Nonzero if byte stream input was requested and the decoder supports
+	 * it. The h.264 data is then pushed in fixed size chunks as-is, and the
+	 * decoder finds the access units by itself. Otherwise, h264_ctx is used
+	 * for splitting the h.264 data into access units. */
+	int byte_stream_input;
+	uint8_t byte_stream_chunk[BYTE_STREAM_CHUNK_SIZE];
+
 	/* DMA buffer allocator for the decoder's framebuffer pool and
 	 * for output frames. */
 	ImxDmaBufferAllocator *allocator;
@@ -234,13 +250,31 @@ static Retval push_encoded_input_frame(Context *ctx)
 	ImxVpuApiEncodedFrame encoded_frame;
 	ImxVpuApiDecReturnCodes vpudec_ret;
 
-	ok = h264_ctx_read_access_unit(&(ctx->h264_ctx));
+	if (ctx->byte_stream_input)
+	{
+		size_t num_read = fread(ctx->byte_stream_chunk, 1, BYTE_STREAM_CHUNK_SIZE, ctx->h264_input_file);
+		if (num_read == 0)
+		{
+			if (ferror(ctx->h264_input_file))
+				fprintf(stderr, "Reading failed: %s\n", strerror(errno));
+			return RETVAL_EOS;
+		}
+
+		encoded_frame.data = ctx->byte_stream_chunk;
+		encoded_frame.data_size = num_read;
+		ok = 1;
+	}
+	else
+	{
+		ok = h264_ctx_read_access_unit(&(ctx->h264_ctx));
 
-	if (ctx->h264_ctx.au_end_offset <= ctx->h264_ctx.au_start_offset)
-		return RETVAL_EOS;
+		if (ctx->h264_ctx.au_end_offset <= ctx->h264_ctx.au_start_offset)
+			return RETVAL_EOS;
+
+		encoded_frame.data = ctx->h264_ctx.in_buffer + ctx->h264_ctx.au_start_offset;
+		encoded_frame.data_size = ctx->h264_ctx.au_end_offset - ctx->h264_ctx.au_start_offset;
+	}
 
-	encoded_frame.data = ctx->h264_ctx.in_buffer + ctx->h264_ctx.au_start_offset;
-	encoded_frame.data_size = ctx->h264_ctx.au_end_offset - ctx->h264_ctx.au_start_offset;
 	encoded_frame.context = (void*)((uintptr_t)(ctx->frame_context_counter));
 
 	ctx->frame_context_counter++;
@@ -492,6 +526,7 @@ Context* init(FILE *input_file, FILE *output_file)
 	fprintf(stderr, "semi planar frames supported: %d\n", !!(dec_flags & IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SEMI_PLANAR_FRAMES_SUPPORTED));
 	fprintf(stderr, "fully planar frames supported: %d\n", !!(dec_flags & IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_FULLY_PLANAR_FRAMES_SUPPORTED));
 	fprintf(stderr, "decoded frames are from buffer pool: %d\n", !!(dec_flags & IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL));
+	fprintf(stderr, "byte stream input supported: %d\n", !!(dec_flags & IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_BYTE_STREAM_INPUT_SUPPORTED));
 	fprintf(stderr, "min required stream buffer size: %zu\n", ctx->dec_global_info->min_required_stream_buffer_size);
 	fprintf(stderr, "required stream buffer physaddr alignment: %zu\n", ctx->dec_global_info->required_stream_buffer_physaddr_alignment);
 	fprintf(stderr, "required stream buffer size alignment: %zu\n", ctx->dec_global_info->required_stream_buffer_size_alignment);
@@ -504,7 +539,7 @@ Context* init(FILE *input_file, FILE *output_file)
 
 	/* Set up the DMA buffer allocator. We use this to allocate framebuffers
 	 * and the stream buffer for the decoder. */
-	ctx->allocator = imx_dma_buffer_allocator_new(&err);
+	ctx->allocator = example_dma_buffer_allocator_new(&err);
 	if (ctx->allocator == NULL)
 	{
 		fprintf(stderr, "could not create DMA buffer allocator: %s (%d)\n", strerror(err), err);
@@ -523,6 +558,24 @@ Context* init(FILE *input_file, FILE *output_file)
 		| IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_USE_SEMI_PLANAR_COLOR_FORMAT
 		;
 
+	/* If requested, and if the decoder can find the access units by itself,
+	 * let it do so. This spares us from scanning the h.264 data for access
+	 * units here. It is opt-in, since the decoder can then not associate
+	 * every decoded frame with the context of an access unit. */
+	{
+		char const *byte_stream_input_env = getenv(BYTE_STREAM_INPUT_ENV_VAR);
+		if ((byte_stream_input_env != NULL) && (strcmp(byte_stream_input_env, "1") == 0))
+		{
+			if (dec_flags & IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_BYTE_STREAM_INPUT_SUPPORTED)
+				ctx->byte_stream_input = 1;
+			else
+				fprintf(stderr, "byte stream input requested, but the decoder does not support it; splitting input into access units\n");
+		}
+	}
+	if (ctx->byte_stream_input)
+		open_params.flags |= IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT;
+	fprintf(stderr, "using byte stream input: %d\n", ctx->byte_stream_input);
+
 	/* Allocate the stream buffer that is used throughout the decoding process. */
 	ctx->stream_buffer = imx_dma_buffer_allocate(
 		ctx->allocator,
@@ -0,0 +1,621 @@
+/* benchmark for the imxvpuapi CPU detiler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include "imxvpuapi2/imxvpuapi2.h"
+
+
+
+/* This benchmarks imx_vpu_api_detile_frame(). It does not need a VPU.
+ * First, small frames of every tiled format are detiled and compared
+ * against fixed golden tables. Then, a large tiled frame is filled with
+ * a synthetic pattern, detiled, and compared against a straightforward
+ * per-byte conversion to make sure the output is correct before
+ * measuring throughput. */
+
+
+typedef struct
+{
+	char const *name;
+	ImxVpuApiColorFormat color_format;
+	size_t tile_width;
+	size_t luma_tile_height, chroma_tile_height;
+	size_t tile_row_size;
+	int field_tiled;
+	int is_10bit;
+}
+TiledFormat;
+
+
+static TiledFormat const tiled_formats[] =
+{
+	{ "4x4-8bit", IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_8BIT, 4, 4, 4, 4, 0, 0 },
+	{ "4x4-10bit", IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_10BIT, 4, 4, 4, 5, 0, 1 },
+	{ "8x4-8bit", IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_8BIT, 8, 4, 4, 8, 0, 0 },
+	{ "8x4-10bit", IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_10BIT, 8, 4, 4, 10, 0, 1 },
+	{ "coda-frame", IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FRAME_TILED_8BIT, 16, 16, 8, 16, 0, 0 },
+	{ "coda-field", IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FIELD_TILED_8BIT, 16, 16, 8, 16, 1, 0 }
+};
+
+
+/* Golden reference tables. Each entry is the offset (relative to the
+ * start of the tiled plane) of the bytes that end up in one linear tile
+ * row. Every linear row consists of (stride / tile_row_size) such tile
+ * rows, so there is one table row per linear row. These are written out
+ * by hand instead of computed, so they catch errors that a reference
+ * implementation sharing the same misconception would not. The CODA960
+ * tables are an exception to that: they were written from the same
+ * assumed macroblock layout that the detiler implements, not from
+ * framebuffers captured on real hardware. They only guard against
+ * regressions in the detiler, not against a wrong layout. */
+
+static size_t const golden_4x4_8bit_luma_runs[] =
+{
+	0, 16, 32, 48,
+	4, 20, 36, 52,
+	8, 24, 40, 56,
+	12, 28, 44, 60,
+	64, 80, 96, 112,
+	68, 84, 100, 116,
+	72, 88, 104, 120,
+	76, 92, 108, 124
+};
+
+static size_t const golden_4x4_8bit_chroma_runs[] =
+{
+	0, 16, 32, 48,
+	4, 20, 36, 52,
+	8, 24, 40, 56,
+	12, 28, 44, 60
+};
+
+static size_t const golden_8x4_8bit_luma_runs[] =
+{
+	0, 32,
+	8, 40,
+	16, 48,
+	24, 56,
+	64, 96,
+	72, 104,
+	80, 112,
+	88, 120
+};
+
+static size_t const golden_8x4_8bit_chroma_runs[] =
+{
+	0, 32,
+	8, 40,
+	16, 48,
+	24, 56
+};
+
+static size_t const golden_4x4_10bit_luma_runs[] =
+{
+	0, 20,
+	5, 25,
+	10, 30,
+	15, 35,
+	40, 60,
+	45, 65,
+	50, 70,
+	55, 75
+};
+
+static size_t const golden_4x4_10bit_chroma_runs[] =
+{
+	0, 20,
+	5, 25,
+	10, 30,
+	15, 35
+};
+
+static size_t const golden_8x4_10bit_luma_runs[] =
+{
+	0, 40,
+	10, 50,
+	20, 60,
+	30, 70,
+	80, 120,
+	90, 130,
+	100, 140,
+	110, 150
+};
+
+static size_t const golden_8x4_10bit_chroma_runs[] =
+{
+	0, 40,
+	10, 50,
+	20, 60,
+	30, 70
+};
+
+static size_t const golden_coda_frame_luma_runs[] =
+{
+	0, 256,
+	16, 272,
+	32, 288,
+	48, 304,
+	64, 320,
+	80, 336,
+	96, 352,
+	112, 368,
+	128, 384,
+	144, 400,
+	160, 416,
+	176, 432,
+	192, 448,
+	208, 464,
+	224, 480,
+	240, 496
+};
+
+static size_t const golden_coda_frame_chroma_runs[] =
+{
+	0, 128,
+	16, 144,
+	32, 160,
+	48, 176,
+	64, 192,
+	80, 208,
+	96, 224,
+	112, 240
+};
+
+static size_t const golden_coda_field_luma_runs[] =
+{
+	0, 256,
+	512, 768,
+	16, 272,
+	528, 784,
+	32, 288,
+	544, 800,
+	48, 304,
+	560, 816,
+	64, 320,
+	576, 832,
+	80, 336,
+	592, 848,
+	96, 352,
+	608, 864,
+	112, 368,
+	624, 880,
+	128, 384,
+	640, 896,
+	144, 400,
+	656, 912,
+	160, 416,
+	672, 928,
+	176, 432,
+	688, 944,
+	192, 448,
+	704, 960,
+	208, 464,
+	720, 976,
+	224, 480,
+	736, 992,
+	240, 496,
+	752, 1008
+};
+
+static size_t const golden_coda_field_chroma_runs[] =
+{
+	0, 128,
+	256, 384,
+	16, 144,
+	272, 400,
+	32, 160,
+	288, 416,
+	48, 176,
+	304, 432,
+	64, 192,
+	320, 448,
+	80, 208,
+	336, 464,
+	96, 224,
+	352, 480,
+	112, 240,
+	368, 496
+};
+
+
+typedef struct
+{
+	char const *format_name;
+	size_t width, height;
+	size_t const *luma_runs;
+	size_t const *chroma_runs;
+}
+GoldenCase;
+
+
+/* The frame sizes are chosen so that they need no alignment, and
+ * that each plane has at least two tile columns. The 8-bit 4x4 case
+ * has four tile columns, which is what the NEON code processes at once. */
+static GoldenCase const golden_cases[] =
+{
+	{ "4x4-8bit", 16, 8, golden_4x4_8bit_luma_runs, golden_4x4_8bit_chroma_runs },
+	{ "8x4-8bit", 16, 8, golden_8x4_8bit_luma_runs, golden_8x4_8bit_chroma_runs },
+	{ "4x4-10bit", 8, 8, golden_4x4_10bit_luma_runs, golden_4x4_10bit_chroma_runs },
+	{ "8x4-10bit", 16, 8, golden_8x4_10bit_luma_runs, golden_8x4_10bit_chroma_runs },
+	{ "coda-frame", 32, 16, golden_coda_frame_luma_runs, golden_coda_frame_chroma_runs },
+	{ "coda-field", 32, 32, golden_coda_field_luma_runs, golden_coda_field_chroma_runs }
+};
+
+
+static void logging_fn(ImxVpuApiLogLevel level, char const *file, int const line, char const *fn, const char *format, ...)
+{
+	va_list args;
+
+	if (level > IMX_VPU_API_LOG_LEVEL_WARNING)
+		return;
+
+	fprintf(stderr, "%s:%d (%s)   %s: ", file, line, fn, (level == IMX_VPU_API_LOG_LEVEL_ERROR) ? "ERROR" : "WARNING");
+
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+
+	fprintf(stderr, "\n");
+}
+
+
+static void usage(char *progname)
+{
+	static char options[] =
+		"\t-f tiled format (4x4-8bit, 4x4-10bit, 8x4-8bit, 8x4-10bit, coda-frame, coda-field) [default: 4x4-8bit]\n"
+		"\t-p detile into fully planar frames instead of semi-planar ones (8-bit formats only)\n"
+		"\t-w frame width [default: 1920]\n"
+		"\t-h frame height [default: 1080]\n"
+		"\t-n number of iterations [default: 200]\n"
+		;
+
+	fprintf(stderr, "usage:\t%s [option]\n\noption:\n%s\n", progname, options);
+}
+
+
+static double get_time_in_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Computes the plane sizes of both frames. The tiled stride is the
+ * number of bytes in one row of tiles, divided by the tile height. */
+static void compute_metrics(TiledFormat const *format, int fully_planar, size_t width, size_t height, ImxVpuApiFramebufferMetrics *tiled_metrics, ImxVpuApiFramebufferMetrics *linear_metrics, size_t *frame_size)
+{
+	size_t aligned_width = (width + format->tile_width - 1) / format->tile_width * format->tile_width;
+	/* Align the height so that the chroma plane, and with field
+	 * tiled formats each field, consists of whole tile rows. */
+	size_t height_alignment = format->chroma_tile_height * 2 * (format->field_tiled ? 2 : 1);
+	size_t aligned_height = (height + height_alignment - 1) / height_alignment * height_alignment;
+	size_t stride = aligned_width / format->tile_width * format->tile_row_size;
+
+	memset(tiled_metrics, 0, sizeof(ImxVpuApiFramebufferMetrics));
+	tiled_metrics->actual_frame_width = width;
+	tiled_metrics->actual_frame_height = height;
+	tiled_metrics->aligned_frame_width = aligned_width;
+	tiled_metrics->aligned_frame_height = aligned_height;
+	tiled_metrics->y_stride = stride;
+	tiled_metrics->uv_stride = stride;
+	tiled_metrics->y_size = stride * aligned_height;
+	tiled_metrics->uv_size = stride * aligned_height / 2;
+	tiled_metrics->y_offset = 0;
+	tiled_metrics->u_offset = tiled_metrics->y_size;
+	tiled_metrics->v_offset = tiled_metrics->y_size;
+
+	/* Both frames occupy the same number of bytes per plane row,
+	 * so the linear frame can use the same metrics, except for
+	 * the chroma planes of fully planar frames. */
+	*linear_metrics = *tiled_metrics;
+	if (fully_planar)
+	{
+		linear_metrics->uv_stride = stride / 2;
+		linear_metrics->uv_size = tiled_metrics->uv_size / 2;
+		linear_metrics->v_offset = linear_metrics->u_offset + linear_metrics->uv_size;
+	}
+
+	*frame_size = tiled_metrics->y_size + tiled_metrics->uv_size;
+}
+
+
+/* Straightforward per-byte detiling, used as the reference
+ * the output of imx_vpu_api_detile_frame() is compared with. */
+static void reference_detile_plane(TiledFormat const *format, size_t tile_height, uint8_t const *src, uint8_t *dest, size_t stride, size_t num_rows)
+{
+	size_t x, y;
+	size_t tile_size = format->tile_row_size * tile_height;
+	size_t num_fields = format->field_tiled ? 2 : 1;
+
+	for (y = 0; y < num_rows; ++y)
+	{
+		/* With field tiled formats, the top field (the even rows) is
+		 * tiled in the first half of the plane, the bottom field (the
+		 * odd rows) in the second half. */
+		size_t field = y % num_fields;
+		size_t field_y = y / num_fields;
+		uint8_t const *field_src = src + field * stride * (num_rows / 2);
+
+		for (x = 0; x < stride; ++x)
+		{
+			size_t tile_column = x / format->tile_row_size;
+			size_t src_offset = (field_y / tile_height) * tile_height * stride
+			                  + tile_column * tile_size
+			                  + (field_y % tile_height) * format->tile_row_size
+			                  + (x % format->tile_row_size);
+			dest[y * stride + x] = field_src[src_offset];
+		}
+	}
+}
+
+
+static int check_golden_plane(TiledFormat const *format, uint8_t const *tiled_plane, uint8_t const *linear_plane, size_t stride, size_t num_rows, size_t const *runs)
+{
+	size_t y, run;
+	size_t num_runs_per_row = stride / format->tile_row_size;
+
+	for (y = 0; y < num_rows; ++y)
+	{
+		for (run = 0; run < num_runs_per_row; ++run)
+		{
+			uint8_t const *expected = tiled_plane + runs[y * num_runs_per_row + run];
+			uint8_t const *actual = linear_plane + y * stride + run * format->tile_row_size;
+
+			if (memcmp(actual, expected, format->tile_row_size) != 0)
+			{
+				fprintf(stderr, "mismatch in row %zu, tile row %zu\n", y, run);
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+static TiledFormat const * find_tiled_format(char const *name)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(tiled_formats) / sizeof(TiledFormat); ++i)
+	{
+		if (strcmp(name, tiled_formats[i].name) == 0)
+			return &tiled_formats[i];
+	}
+
+	return NULL;
+}
+
+
+/* Detiles the golden frames into semi-planar frames and compares
+ * them against the golden tables. The tiled frame is deliberately
+ * placed at an odd address to catch unaligned loads. */
+static int run_golden_tests(void)
+{
+	size_t i, j;
+	int ret = 1;
+
+	for (i = 0; (i < sizeof(golden_cases) / sizeof(GoldenCase)) && ret; ++i)
+	{
+		GoldenCase const *golden_case = &golden_cases[i];
+		TiledFormat const *format = find_tiled_format(golden_case->format_name);
+		ImxVpuApiFramebufferMetrics tiled_metrics, linear_metrics;
+		ImxVpuApiColorFormat linear_color_format;
+		size_t frame_size;
+		uint8_t *tiled_buffer, *tiled_pixels, *linear_pixels;
+
+		if (format == NULL)
+		{
+			fprintf(stderr, "golden test %s: unknown format\n", golden_case->format_name);
+			return 0;
+		}
+
+		compute_metrics(format, 0, golden_case->width, golden_case->height, &tiled_metrics, &linear_metrics, &frame_size);
+		linear_color_format = format->is_10bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_10BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT;
+
+		tiled_buffer = malloc(frame_size + 1);
+		linear_pixels = malloc(frame_size);
+		if ((tiled_buffer == NULL) || (linear_pixels == NULL))
+		{
+			fprintf(stderr, "Could not allocate frames\n");
+			free(tiled_buffer);
+			free(linear_pixels);
+			return 0;
+		}
+
+		tiled_pixels = tiled_buffer + 1;
+		for (j = 0; j < frame_size; ++j)
+			tiled_pixels[j] = (uint8_t)(j % 251);
+		memset(linear_pixels, 0, frame_size);
+
+		if (!imx_vpu_api_detile_frame(format->color_format, tiled_pixels, &tiled_metrics, linear_color_format, linear_pixels, &linear_metrics, 0, 0, 0, 0))
+		{
+			fprintf(stderr, "golden test %s: detiling failed\n", format->name);
+			ret = 0;
+		}
+		else if (!check_golden_plane(format, tiled_pixels + tiled_metrics.y_offset, linear_pixels + linear_metrics.y_offset, tiled_metrics.y_stride, tiled_metrics.aligned_frame_height, golden_case->luma_runs)
+		      || !check_golden_plane(format, tiled_pixels + tiled_metrics.u_offset, linear_pixels + linear_metrics.u_offset, tiled_metrics.uv_stride, tiled_metrics.aligned_frame_height / 2, golden_case->chroma_runs))
+		{
+			fprintf(stderr, "golden test %s: detiled frame does not match the golden table\n", format->name);
+			ret = 0;
+		}
+		else
+			fprintf(stderr, "golden test %s: OK\n", format->name);
+
+		free(tiled_buffer);
+		free(linear_pixels);
+	}
+
+	return ret;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	size_t i;
+	int fully_planar = 0;
+	TiledFormat const *format = &tiled_formats[0];
+	ImxVpuApiColorFormat linear_color_format;
+	size_t width = 1920, height = 1080;
+	long num_iterations = 200;
+	ImxVpuApiFramebufferMetrics tiled_metrics, linear_metrics;
+	size_t frame_size;
+	uint8_t *tiled_pixels = NULL, *linear_pixels = NULL, *reference_pixels = NULL, *planar_reference_pixels = NULL;
+	double start_time, total_time;
+	int ret = 1;
+
+	imx_vpu_api_set_logging_threshold(IMX_VPU_API_LOG_LEVEL_WARNING);
+	imx_vpu_api_set_logging_function(logging_fn);
+
+	while ((opt = getopt(argc, argv, "f:pw:h:n:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'f':
+			{
+				format = find_tiled_format(optarg);
+				if (format == NULL)
+				{
+					fprintf(stderr, "Unknown tiled format \"%s\"\n\n", optarg);
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			}
+			case 'p':
+				fully_planar = 1;
+				break;
+			case 'w':
+				width = strtoul(optarg, NULL, 10);
+				break;
+			case 'h':
+				height = strtoul(optarg, NULL, 10);
+				break;
+			case 'n':
+				num_iterations = strtol(optarg, NULL, 10);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if ((width == 0) || (height == 0) || (num_iterations <= 0))
+	{
+		fprintf(stderr, "Invalid frame size or number of iterations\n\n");
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (fully_planar && format->is_10bit)
+	{
+		fprintf(stderr, "10-bit formats can only be detiled into semi-planar frames\n\n");
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (format->is_10bit)
+		linear_color_format = IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_10BIT;
+	else if (fully_planar)
+		linear_color_format = IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT;
+	else
+		linear_color_format = IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT;
+
+	if (!run_golden_tests())
+		return 1;
+
+	compute_metrics(format, fully_planar, width, height, &tiled_metrics, &linear_metrics, &frame_size);
+
+	tiled_pixels = malloc(frame_size);
+	linear_pixels = malloc(frame_size);
+	reference_pixels = malloc(frame_size);
+	planar_reference_pixels = malloc(frame_size);
+	if ((tiled_pixels == NULL) || (linear_pixels == NULL) || (reference_pixels == NULL) || (planar_reference_pixels == NULL))
+	{
+		fprintf(stderr, "Could not allocate frames\n");
+		goto cleanup;
+	}
+
+	for (i = 0; i < frame_size; ++i)
+		tiled_pixels[i] = (uint8_t)((i * 7) ^ (i >> 8));
+
+	reference_detile_plane(format, format->luma_tile_height, tiled_pixels + tiled_metrics.y_offset, reference_pixels + tiled_metrics.y_offset, tiled_metrics.y_stride, tiled_metrics.aligned_frame_height);
+	reference_detile_plane(format, format->chroma_tile_height, tiled_pixels + tiled_metrics.u_offset, reference_pixels + tiled_metrics.u_offset, tiled_metrics.uv_stride, tiled_metrics.aligned_frame_height / 2);
+
+	/* For fully planar frames, split the semi-planar reference chroma plane. */
+	if (fully_planar)
+	{
+		memcpy(planar_reference_pixels, reference_pixels, tiled_metrics.y_size);
+		for (i = 0; i < linear_metrics.uv_size; ++i)
+		{
+			planar_reference_pixels[linear_metrics.u_offset + i] = reference_pixels[tiled_metrics.u_offset + i * 2 + 0];
+			planar_reference_pixels[linear_metrics.v_offset + i] = reference_pixels[tiled_metrics.u_offset + i * 2 + 1];
+		}
+	}
+	else
+		memcpy(planar_reference_pixels, reference_pixels, frame_size);
+
+	/* Detile the whole aligned frame once and verify it. */
+	memset(linear_pixels, 0, frame_size);
+	if (!imx_vpu_api_detile_frame(format->color_format, tiled_pixels, &tiled_metrics, linear_color_format, linear_pixels, &linear_metrics, 0, 0, tiled_metrics.aligned_frame_width, tiled_metrics.aligned_frame_height))
+	{
+		fprintf(stderr, "Detiling failed\n");
+		goto cleanup;
+	}
+
+	if (memcmp(linear_pixels, planar_reference_pixels, frame_size) != 0)
+	{
+		fprintf(stderr, "Detiled frame does not match the reference\n");
+		goto cleanup;
+	}
+
+	start_time = get_time_in_seconds();
+	for (i = 0; i < (size_t)num_iterations; ++i)
+		imx_vpu_api_detile_frame(format->color_format, tiled_pixels, &tiled_metrics, linear_color_format, linear_pixels, &linear_metrics, 0, 0, 0, 0);
+	total_time = get_time_in_seconds() - start_time;
+
+	fprintf(
+		stderr,
+		"format %s  %s  size %zux%zu  iterations %ld:  %.3f ms per frame  %.1f frames/s  %.1f MB/s\n",
+		format->name, fully_planar ? "fully planar" : "semi-planar", width, height, num_iterations,
+		total_time * 1000.0 / num_iterations,
+		num_iterations / total_time,
+		(double)frame_size * num_iterations / total_time / (1024.0 * 1024.0)
+	);
+
+	ret = 0;
+
+cleanup:
+	free(tiled_pixels);
+	free(linear_pixels);
+	free(reference_pixels);
+	free(planar_reference_pixels);
+
+	return ret;
+}
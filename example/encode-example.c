@@ -396,7 +396,7 @@ Context* init(FILE *input_file, FILE *output_file)
 
 	/* Set up the DMA buffer allocator. We use this to allocate framebuffers
 	 * and the stream buffer for the encoder. */
-	ctx->allocator = imx_dma_buffer_allocator_new(&err);
+	ctx->allocator = example_dma_buffer_allocator_new(&err);
 	if (ctx->allocator == NULL)
 	{
 		fprintf(stderr, "could not create DMA buffer allocator: %s (%d)\n", strerror(err), err);
@@ -21,8 +21,18 @@
 #define MAIN_H_____________
 
 #include <stdio.h>
+#include <config.h>
 #include "imxvpuapi2/imxvpuapi2.h"
 
+/* The sim platform has no physically contiguous memory,
+ * so the examples have to use its own allocator. */
+#ifdef IMXVPUAPI2_SIM_PLATFORM
+#include "imxvpuapi2/imxvpuapi2_sim.h"
+#define example_dma_buffer_allocator_new imx_vpu_api_sim_dma_buffer_allocator_new
+#else
+#define example_dma_buffer_allocator_new imx_dma_buffer_allocator_new
+#endif
+
 
 typedef enum
 {
@@ -0,0 +1,576 @@
+/* benchmark for the imxvpuapi decoder on the sim platform
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include "imxvpuapi2/imxvpuapi2.h"
+#include "imxvpuapi2/imxvpuapi2_sim.h"
+
+
+
+/* This benchmarks the decoder's own per-frame overhead on the sim platform.
+ * It does not need a VPU; it encodes synthetic frames with the sim encoder,
+ * then decodes them, checks that each decoded frame is identical to the
+ * frame that was encoded (the sim codec is lossless), and measures the
+ * throughput and the latency between pushing a frame and getting it back.
+ *
+ * It exits with a nonzero value if decoding fails, if a decoded frame does
+ * not match, or if the average time per frame exceeds the (optional) limit.
+ * The "./waf sim-benchmark" command runs it, so it can be used in CI. */
+
+
+typedef struct
+{
+	ImxDmaBufferAllocator *allocator;
+
+	ImxVpuApiDecoder *decoder;
+	ImxDmaBuffer *stream_buffer;
+	ImxVpuApiDecStreamInfo stream_info;
+
+	ImxDmaBuffer **fb_pool_dmabuffers;
+	size_t num_fb_pool_framebuffers;
+
+	size_t width, height;
+	size_t num_frames;
+
+	/* Per-frame push timestamps, indexed by the frame's PTS. */
+	double *push_times;
+
+	size_t num_decoded_frames;
+	double min_latency, max_latency, total_latency;
+}
+Context;
+
+
+static void logging_fn(ImxVpuApiLogLevel level, char const *file, int const line, char const *fn, const char *format, ...)
+{
+	va_list args;
+
+	if (level > IMX_VPU_API_LOG_LEVEL_WARNING)
+		return;
+
+	fprintf(stderr, "%s:%d (%s)   %s: ", file, line, fn, (level == IMX_VPU_API_LOG_LEVEL_ERROR) ? "ERROR" : "WARNING");
+
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+
+	fprintf(stderr, "\n");
+}
+
+
+static void usage(char *progname)
+{
+	static char options[] =
+		"\t-w frame width [default: 640]\n"
+		"\t-h frame height [default: 480]\n"
+		"\t-n number of frames [default: 300]\n"
+		"\t-t maximum average decoding time per frame, in nanoseconds; fail if exceeded [default: no limit]\n"
+		;
+
+	fprintf(stderr, "usage:\t%s [option]\n\noption:\n%s\n", progname, options);
+}
+
+
+static double get_time_in_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* The synthetic pattern differs from frame to frame, so that
+ * mixed up or stale frames are caught by the comparison. */
+static uint8_t get_pattern_value(size_t frame_index, size_t x, size_t y, size_t plane)
+{
+	return (uint8_t)(x * 3 + y * 5 + frame_index * 7 + plane * 64);
+}
+
+
+static void fill_raw_frame(uint8_t *pixels, ImxVpuApiFramebufferMetrics const *fb_metrics, size_t frame_index)
+{
+	size_t x, y;
+
+	for (y = 0; y < fb_metrics->actual_frame_height; ++y)
+	{
+		for (x = 0; x < fb_metrics->actual_frame_width; ++x)
+			pixels[fb_metrics->y_offset + y * fb_metrics->y_stride + x] = get_pattern_value(frame_index, x, y, 0);
+	}
+
+	for (y = 0; y < (fb_metrics->actual_frame_height + 1) / 2; ++y)
+	{
+		for (x = 0; x < (fb_metrics->actual_frame_width + 1) / 2; ++x)
+		{
+			pixels[fb_metrics->u_offset + y * fb_metrics->uv_stride + x * 2 + 0] = get_pattern_value(frame_index, x, y, 1);
+			pixels[fb_metrics->u_offset + y * fb_metrics->uv_stride + x * 2 + 1] = get_pattern_value(frame_index, x, y, 2);
+		}
+	}
+}
+
+
+static int check_decoded_frame(uint8_t const *pixels, ImxVpuApiFramebufferMetrics const *fb_metrics, size_t width, size_t height, size_t frame_index)
+{
+	size_t x, y;
+
+	for (y = 0; y < height; ++y)
+	{
+		for (x = 0; x < width; ++x)
+		{
+			if (pixels[fb_metrics->y_offset + y * fb_metrics->y_stride + x] != get_pattern_value(frame_index, x, y, 0))
+			{
+				fprintf(stderr, "Frame %zu: Y pixel at %zu,%zu does not match\n", frame_index, x, y);
+				return 0;
+			}
+		}
+	}
+
+	for (y = 0; y < (height + 1) / 2; ++y)
+	{
+		for (x = 0; x < (width + 1) / 2; ++x)
+		{
+			if ((pixels[fb_metrics->u_offset + y * fb_metrics->uv_stride + x * 2 + 0] != get_pattern_value(frame_index, x, y, 1))
+			 || (pixels[fb_metrics->u_offset + y * fb_metrics->uv_stride + x * 2 + 1] != get_pattern_value(frame_index, x, y, 2)))
+			{
+				fprintf(stderr, "Frame %zu: UV pixel at %zu,%zu does not match\n", frame_index, x, y);
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+/* Encodes the synthetic frames with the sim encoder. This is done
+ * before decoding starts, so that it does not affect the timings. */
+static int encode_frames(Context *ctx, size_t num_frames, ImxVpuApiEncodedFrame *encoded_frames)
+{
+	int err;
+	int ret = 0;
+	size_t i;
+	ImxVpuApiEncoder *encoder = NULL;
+	ImxVpuApiEncOpenParams open_params;
+	ImxVpuApiEncStreamInfo const *stream_info;
+	ImxVpuApiEncReturnCodes enc_ret;
+	ImxVpuApiEncOutputCodes output_code;
+	ImxDmaBuffer *stream_buffer = NULL, *raw_dma_buffer = NULL;
+	ImxVpuApiEncGlobalInfo const *enc_global_info = imx_vpu_api_enc_get_global_info();
+	ImxVpuApiRawFrame raw_frame;
+	uint8_t *raw_pixels;
+	size_t encoded_frame_size;
+
+	stream_buffer = imx_dma_buffer_allocate(ctx->allocator, enc_global_info->min_required_stream_buffer_size, enc_global_info->required_stream_buffer_physaddr_alignment, &err);
+	if (stream_buffer == NULL)
+	{
+		fprintf(stderr, "Could not allocate encoder stream buffer: %s (%d)\n", strerror(err), err);
+		goto cleanup;
+	}
+
+	imx_vpu_api_enc_set_default_open_params(IMX_VPU_API_COMPRESSION_FORMAT_H264, IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT, ctx->width, ctx->height, &open_params);
+	if ((enc_ret = imx_vpu_api_enc_open(&encoder, &open_params, stream_buffer)) != IMX_VPU_API_ENC_RETURN_CODE_OK)
+	{
+		fprintf(stderr, "Could not open encoder: %s\n", imx_vpu_api_enc_return_code_string(enc_ret));
+		encoder = NULL;
+		goto cleanup;
+	}
+
+	stream_info = imx_vpu_api_enc_get_stream_info(encoder);
+
+	raw_dma_buffer = imx_dma_buffer_allocate(ctx->allocator, stream_info->min_framebuffer_size, stream_info->framebuffer_alignment, &err);
+	if (raw_dma_buffer == NULL)
+	{
+		fprintf(stderr, "Could not allocate raw frame: %s (%d)\n", strerror(err), err);
+		goto cleanup;
+	}
+
+	for (i = 0; i < num_frames; ++i)
+	{
+		raw_pixels = imx_dma_buffer_map(raw_dma_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_WRITE, &err);
+		fill_raw_frame(raw_pixels, &(stream_info->frame_encoding_framebuffer_metrics), i);
+		imx_dma_buffer_unmap(raw_dma_buffer);
+
+		memset(&raw_frame, 0, sizeof(raw_frame));
+		raw_frame.fb_dma_buffer = raw_dma_buffer;
+		raw_frame.pts = raw_frame.dts = i;
+
+		imx_vpu_api_enc_push_raw_frame(encoder, &raw_frame);
+
+		if ((enc_ret = imx_vpu_api_enc_encode(encoder, &encoded_frame_size, &output_code)) != IMX_VPU_API_ENC_RETURN_CODE_OK)
+		{
+			fprintf(stderr, "Encoding frame %zu failed: %s\n", i, imx_vpu_api_enc_return_code_string(enc_ret));
+			goto cleanup;
+		}
+		if (output_code != IMX_VPU_API_ENC_OUTPUT_CODE_ENCODED_FRAME_AVAILABLE)
+		{
+			fprintf(stderr, "Encoder did not produce frame %zu\n", i);
+			goto cleanup;
+		}
+
+		encoded_frames[i].data = malloc(encoded_frame_size);
+		if (encoded_frames[i].data == NULL)
+		{
+			fprintf(stderr, "Could not allocate encoded frame %zu\n", i);
+			goto cleanup;
+		}
+
+		imx_vpu_api_enc_get_encoded_frame(encoder, &(encoded_frames[i]));
+	}
+
+	ret = 1;
+
+cleanup:
+	if (encoder != NULL)
+		imx_vpu_api_enc_close(encoder);
+	if (raw_dma_buffer != NULL)
+		imx_dma_buffer_deallocate(raw_dma_buffer);
+	if (stream_buffer != NULL)
+		imx_dma_buffer_deallocate(stream_buffer);
+
+	return ret;
+}
+
+
+static void deallocate_framebuffers(Context *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->num_fb_pool_framebuffers; ++i)
+		imx_dma_buffer_deallocate(ctx->fb_pool_dmabuffers[i]);
+	free(ctx->fb_pool_dmabuffers);
+
+	ctx->fb_pool_dmabuffers = NULL;
+	ctx->num_fb_pool_framebuffers = 0;
+}
+
+
+static int add_framebuffers(Context *ctx, size_t num_framebuffers)
+{
+	int err;
+	size_t i;
+	size_t old_num = ctx->num_fb_pool_framebuffers;
+	ImxDmaBuffer **new_array;
+	ImxVpuApiDecReturnCodes dec_ret;
+
+	if (num_framebuffers == 0)
+		return 1;
+
+	new_array = realloc(ctx->fb_pool_dmabuffers, (old_num + num_framebuffers) * sizeof(ImxDmaBuffer *));
+	if (new_array == NULL)
+		return 0;
+	ctx->fb_pool_dmabuffers = new_array;
+
+	for (i = old_num; i < (old_num + num_framebuffers); ++i)
+	{
+		ctx->fb_pool_dmabuffers[i] = imx_dma_buffer_allocate(ctx->allocator, ctx->stream_info.min_fb_pool_framebuffer_size, ctx->stream_info.fb_pool_framebuffer_alignment, &err);
+		if (ctx->fb_pool_dmabuffers[i] == NULL)
+		{
+			fprintf(stderr, "Could not allocate framebuffer: %s (%d)\n", strerror(err), err);
+			return 0;
+		}
+		ctx->num_fb_pool_framebuffers++;
+	}
+
+	if ((dec_ret = imx_vpu_api_dec_add_framebuffers_to_pool(ctx->decoder, ctx->fb_pool_dmabuffers + old_num, NULL, num_framebuffers)) != IMX_VPU_API_DEC_RETURN_CODE_OK)
+	{
+		fprintf(stderr, "Could not add framebuffers to the pool: %s\n", imx_vpu_api_dec_return_code_string(dec_ret));
+		return 0;
+	}
+
+	return 1;
+}
+
+
+/* Runs the decoder until it needs more input, or until it reports EOS.
+ * Returns 1 if it needs more input, 2 on EOS, and 0 in case of an error. */
+static int decode_frames(Context *ctx)
+{
+	ImxVpuApiDecReturnCodes dec_ret;
+	ImxVpuApiDecOutputCodes output_code;
+
+	for (;;)
+	{
+		if ((dec_ret = imx_vpu_api_dec_decode(ctx->decoder, &output_code)) != IMX_VPU_API_DEC_RETURN_CODE_OK)
+		{
+			fprintf(stderr, "Decoding failed: %s\n", imx_vpu_api_dec_return_code_string(dec_ret));
+			return 0;
+		}
+
+		switch (output_code)
+		{
+			case IMX_VPU_API_DEC_OUTPUT_CODE_NO_OUTPUT_YET_AVAILABLE:
+				break;
+
+			case IMX_VPU_API_DEC_OUTPUT_CODE_EOS:
+				return 2;
+
+			case IMX_VPU_API_DEC_OUTPUT_CODE_MORE_INPUT_DATA_NEEDED:
+				return 1;
+
+			case IMX_VPU_API_DEC_OUTPUT_CODE_NEW_STREAM_INFO_AVAILABLE:
+				deallocate_framebuffers(ctx);
+				ctx->stream_info = *imx_vpu_api_dec_get_stream_info(ctx->decoder);
+				if (!add_framebuffers(ctx, ctx->stream_info.min_num_required_framebuffers))
+					return 0;
+				break;
+
+			case IMX_VPU_API_DEC_OUTPUT_CODE_NEED_ADDITIONAL_FRAMEBUFFER:
+				if (!add_framebuffers(ctx, 1))
+					return 0;
+				break;
+
+			case IMX_VPU_API_DEC_OUTPUT_CODE_DECODED_FRAME_AVAILABLE:
+			{
+				int err;
+				int frame_ok;
+				uint8_t *pixels;
+				double latency;
+				ImxVpuApiRawFrame decoded_frame;
+
+				if ((dec_ret = imx_vpu_api_dec_get_decoded_frame(ctx->decoder, &decoded_frame)) != IMX_VPU_API_DEC_RETURN_CODE_OK)
+				{
+					fprintf(stderr, "Could not get decoded frame: %s\n", imx_vpu_api_dec_return_code_string(dec_ret));
+					return 0;
+				}
+
+				if (decoded_frame.pts >= ctx->num_frames)
+				{
+					fprintf(stderr, "Decoded frame has invalid PTS %" PRIu64 "\n", decoded_frame.pts);
+					imx_vpu_api_dec_return_framebuffer_to_decoder(ctx->decoder, decoded_frame.fb_dma_buffer);
+					return 0;
+				}
+
+				/* Measure the latency before checking the pixels,
+				 * since that check is not part of decoding. */
+				latency = get_time_in_seconds() - ctx->push_times[decoded_frame.pts];
+				if ((ctx->num_decoded_frames == 0) || (latency < ctx->min_latency))
+					ctx->min_latency = latency;
+				if ((ctx->num_decoded_frames == 0) || (latency > ctx->max_latency))
+					ctx->max_latency = latency;
+				ctx->total_latency += latency;
+
+				pixels = imx_dma_buffer_map(decoded_frame.fb_dma_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_READ, &err);
+				frame_ok = check_decoded_frame(pixels, &(ctx->stream_info.decoded_frame_framebuffer_metrics), ctx->width, ctx->height, decoded_frame.pts);
+				imx_dma_buffer_unmap(decoded_frame.fb_dma_buffer);
+
+				imx_vpu_api_dec_return_framebuffer_to_decoder(ctx->decoder, decoded_frame.fb_dma_buffer);
+
+				if (!frame_ok)
+					return 0;
+
+				ctx->num_decoded_frames++;
+
+				break;
+			}
+
+			case IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED:
+			{
+				ImxVpuApiDecSkippedFrameReasons reason;
+				uint64_t pts;
+				imx_vpu_api_dec_get_skipped_frame_info(ctx->decoder, &reason, NULL, &pts, NULL);
+				fprintf(stderr, "Frame %" PRIu64 " was skipped: %s\n", pts, imx_vpu_api_dec_skipped_frame_reason_string(reason));
+				return 0;
+			}
+
+			default:
+				fprintf(stderr, "Unexpected output code %s\n", imx_vpu_api_dec_output_code_string(output_code));
+				return 0;
+		}
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	int err;
+	size_t i;
+	long num_frames = 300;
+	long max_ns_per_frame = 0;
+	Context ctx;
+	ImxVpuApiEncodedFrame *encoded_frames = NULL;
+	ImxVpuApiDecGlobalInfo const *dec_global_info;
+	ImxVpuApiDecOpenParams open_params;
+	ImxVpuApiDecReturnCodes dec_ret;
+	double start_time, total_time, ns_per_frame;
+	int ret = 1;
+
+	imx_vpu_api_set_logging_threshold(IMX_VPU_API_LOG_LEVEL_WARNING);
+	imx_vpu_api_set_logging_function(logging_fn);
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.width = 640;
+	ctx.height = 480;
+
+	while ((opt = getopt(argc, argv, "w:h:n:t:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'w':
+				ctx.width = strtoul(optarg, NULL, 10);
+				break;
+			case 'h':
+				ctx.height = strtoul(optarg, NULL, 10);
+				break;
+			case 'n':
+				num_frames = strtol(optarg, NULL, 10);
+				break;
+			case 't':
+				max_ns_per_frame = strtol(optarg, NULL, 10);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if ((ctx.width == 0) || (ctx.height == 0) || (num_frames <= 0) || (max_ns_per_frame < 0))
+	{
+		fprintf(stderr, "Invalid frame size, number of frames, or time limit\n\n");
+		usage(argv[0]);
+		return 1;
+	}
+
+	ctx.num_frames = num_frames;
+
+	ctx.allocator = imx_vpu_api_sim_dma_buffer_allocator_new(&err);
+	if (ctx.allocator == NULL)
+	{
+		fprintf(stderr, "Could not create DMA buffer allocator: %s (%d)\n", strerror(err), err);
+		return 1;
+	}
+
+	encoded_frames = calloc(num_frames, sizeof(ImxVpuApiEncodedFrame));
+	ctx.push_times = calloc(num_frames, sizeof(double));
+	if ((encoded_frames == NULL) || (ctx.push_times == NULL))
+	{
+		fprintf(stderr, "Could not allocate frame arrays\n");
+		goto cleanup;
+	}
+
+	if (!encode_frames(&ctx, num_frames, encoded_frames))
+		goto cleanup;
+
+	dec_global_info = imx_vpu_api_dec_get_global_info();
+
+	ctx.stream_buffer = imx_dma_buffer_allocate(ctx.allocator, dec_global_info->min_required_stream_buffer_size, dec_global_info->required_stream_buffer_physaddr_alignment, &err);
+	if (ctx.stream_buffer == NULL)
+	{
+		fprintf(stderr, "Could not allocate decoder stream buffer: %s (%d)\n", strerror(err), err);
+		goto cleanup;
+	}
+
+	memset(&open_params, 0, sizeof(open_params));
+	open_params.compression_format = IMX_VPU_API_COMPRESSION_FORMAT_H264;
+	open_params.flags = IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_USE_SEMI_PLANAR_COLOR_FORMAT;
+	open_params.frame_width = ctx.width;
+	open_params.frame_height = ctx.height;
+
+	if ((dec_ret = imx_vpu_api_dec_open(&(ctx.decoder), &open_params, ctx.stream_buffer)) != IMX_VPU_API_DEC_RETURN_CODE_OK)
+	{
+		fprintf(stderr, "Could not open decoder: %s\n", imx_vpu_api_dec_return_code_string(dec_ret));
+		ctx.decoder = NULL;
+		goto cleanup;
+	}
+
+	start_time = get_time_in_seconds();
+
+	for (i = 0; i < (size_t)num_frames; ++i)
+	{
+		ctx.push_times[i] = get_time_in_seconds();
+
+		if ((dec_ret = imx_vpu_api_dec_push_encoded_frame(ctx.decoder, &(encoded_frames[i]))) != IMX_VPU_API_DEC_RETURN_CODE_OK)
+		{
+			fprintf(stderr, "Could not push frame %zu: %s\n", i, imx_vpu_api_dec_return_code_string(dec_ret));
+			goto cleanup;
+		}
+
+		switch (decode_frames(&ctx))
+		{
+			case 1:
+				break;
+			case 2:
+				fprintf(stderr, "Decoder reported EOS before the end of the input\n");
+				goto cleanup;
+			default:
+				goto cleanup;
+		}
+	}
+
+	imx_vpu_api_dec_enable_drain_mode(ctx.decoder);
+	if (decode_frames(&ctx) != 2)
+	{
+		fprintf(stderr, "Draining the decoder failed\n");
+		goto cleanup;
+	}
+
+	total_time = get_time_in_seconds() - start_time;
+
+	if (ctx.num_decoded_frames != (size_t)num_frames)
+	{
+		fprintf(stderr, "Decoded %zu frames, expected %ld\n", ctx.num_decoded_frames, num_frames);
+		goto cleanup;
+	}
+
+	ns_per_frame = total_time * 1e9 / num_frames;
+
+	fprintf(
+		stderr,
+		"size %zux%zu  frames %ld:  %.0f ns per frame  %.1f frames/s  latency min/avg/max %.0f/%.0f/%.0f ns\n",
+		ctx.width, ctx.height, num_frames,
+		ns_per_frame,
+		num_frames / total_time,
+		ctx.min_latency * 1e9, ctx.total_latency * 1e9 / num_frames, ctx.max_latency * 1e9
+	);
+
+	if ((max_ns_per_frame > 0) && (ns_per_frame > max_ns_per_frame))
+	{
+		fprintf(stderr, "Average time per frame exceeds the limit of %ld ns\n", max_ns_per_frame);
+		goto cleanup;
+	}
+
+	ret = 0;
+
+cleanup:
+	if (ctx.decoder != NULL)
+		imx_vpu_api_dec_close(ctx.decoder);
+	deallocate_framebuffers(&ctx);
+	if (ctx.stream_buffer != NULL)
+		imx_dma_buffer_deallocate(ctx.stream_buffer);
+
+	if (encoded_frames != NULL)
+	{
+		for (i = 0; i < (size_t)num_frames; ++i)
+			free(encoded_frames[i].data);
+		free(encoded_frames);
+	}
+	free(ctx.push_times);
+
+	imx_dma_buffer_allocator_destroy(ctx.allocator);
+
+	return ret;
+}
@@ -144,6 +144,9 @@ char const *imx_vpu_api_color_format_string(ImxVpuApiColorFormat color_format)
 		case IMX_VPU_API_COLOR_FORMAT_RGBA8888: return "RGBA 8:8:8:8 (32 bits per pixel)";
 		case IMX_VPU_API_COLOR_FORMAT_BGRA8888: return "BGRA 8:8:8:8 (32 bits per pixel)";
 
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FRAME_TILED_8BIT: return "Chips&Media CODA960 semi planar frame tiled YUV 4:2:0 8-bit";
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FIELD_TILED_8BIT: return "Chips&Media CODA960 semi planar field tiled YUV 4:2:0 8-bit";
+
 		default: return "<unknown>";
 	}
 }
@@ -176,6 +179,10 @@ int imx_vpu_api_is_color_format_semi_planar(ImxVpuApiColorFormat color_format)
 		case IMX_VPU_API_AMPHION_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x128TILED_10BIT:
 			return 1;
 
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FRAME_TILED_8BIT:
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FIELD_TILED_8BIT:
+			return 1;
+
 		default:
 			break;
 	}
@@ -244,6 +251,8 @@ int imx_vpu_api_is_color_format_tiled(ImxVpuApiColorFormat color_format)
 		case IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_10BIT:
 		case IMX_VPU_API_AMPHION_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x128TILED_8BIT:
 		case IMX_VPU_API_AMPHION_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x128TILED_10BIT:
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FRAME_TILED_8BIT:
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FIELD_TILED_8BIT:
 			return 1;
 
 		default:
@@ -367,6 +376,7 @@ char const * imx_vpu_api_dec_return_code_string(ImxVpuApiDecReturnCodes code)
 		case IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL:                    return "invalid call";
 		case IMX_VPU_API_DEC_RETURN_CODE_TIMEOUT:                         return "timeout";
 		case IMX_VPU_API_DEC_RETURN_CODE_ERROR:                           return "error";
+		case IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET:                  return "hardware reset";
 		default: return "<unknown>";
 	}
 }
@@ -395,6 +405,9 @@ char const * imx_vpu_api_dec_skipped_frame_reason_string(ImxVpuApiDecSkippedFram
 	{
 		case IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_CORRUPTED_FRAME: return "corrupted frame";
 		case IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_INTERNAL_FRAME:  return "internal frame";
+		case IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_SKIP_MODE:       return "excluded by skip mode";
+		case IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_DISCARDED:       return "discarded";
+		case IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_RESYNC:          return "discarded during resync";
 		default: return "<unknown>";
 	}
 }
@@ -423,6 +436,7 @@ char const * imx_vpu_api_enc_return_code_string(ImxVpuApiEncReturnCodes code)
 		case IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL:                          return "invalid call";
 		case IMX_VPU_API_ENC_RETURN_CODE_TIMEOUT:                               return "timeout";
 		case IMX_VPU_API_ENC_RETURN_CODE_ERROR:                                 return "error";
+		case IMX_VPU_API_ENC_RETURN_CODE_HARDWARE_RESET:                        return "hardware reset";
 		default: return "<unknown>";
 	}
 }
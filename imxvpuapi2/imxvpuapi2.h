@@ -71,6 +71,10 @@ void imx_vpu_api_set_logging_function(ImxVpuApiLoggingFunc logging_fn);
 /* FourCC identifying the hardware as a Hantro codec. */
 #define IMX_VPU_API_HARDWARE_TYPE_HANTRO  IMX_VPU_API_MAKE_FOURCC_UINT32('H','T','R','O')
 #define IMX_VPU_API_HARDWARE_TYPE_CODA960 IMX_VPU_API_MAKE_FOURCC_UINT32('C','9','6','0')
+/* FourCC identifying the software simulation encoder (no actual hardware).
+ * The sim platform's decoder is the Hantro decoder backend running on top
+ * of a simulated codec, so it identifies itself as a Hantro decoder. */
+#define IMX_VPU_API_HARDWARE_TYPE_SIM     IMX_VPU_API_MAKE_FOURCC_UINT32('S','I','M','U')
 
 
 /* Possible frame types. */
@@ -333,7 +337,25 @@ typedef enum
 	/* RGBA 8:8:8:8, 32 bits per pixel. */
 	IMX_VPU_API_COLOR_FORMAT_RGBA8888,
 	/* BGRA 8:8:8:8, 32 bits per pixel. */
-	IMX_VPU_API_COLOR_FORMAT_BGRA8888
+	IMX_VPU_API_COLOR_FORMAT_BGRA8888,
+
+	/* Chips&Media CODA960 semi-planar frame tiled YUV 4:2:0, 8-bit.
+	 * The luma plane is made of 16x16 pixel macroblocks, the chroma
+	 * plane of macroblocks with 8 rows of 16 bytes (8 interleaved U/V
+	 * pairs each). Macroblocks are stored in row-major order, and so
+	 * are the pixels inside them. This is the layout of the CODA960
+	 * framebuffer pool on the i.MX6; decoders do not output it.
+	 * NOTE: This layout has not been checked against framebuffers that
+	 * were written by the actual hardware. If the real layout differs,
+	 * imx_vpu_api_detile_frame() produces scrambled output for this
+	 * format and the field tiled one. */
+	IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FRAME_TILED_8BIT,
+	/* Chips&Media CODA960 semi-planar field tiled YUV 4:2:0, 8-bit.
+	 * Same macroblock layout as the frame tiled format, except that
+	 * the two fields are tiled separately. The first half of each
+	 * plane contains the top field (the even rows), the second half
+	 * contains the bottom field (the odd rows). */
+	IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FIELD_TILED_8BIT
 }
 ImxVpuApiColorFormat;
 
@@ -413,6 +435,59 @@ typedef struct
 ImxVpuApiFramebufferMetrics;
 
 
+/* Converts a frame in one of the tiled Hantro or CODA960 color formats into
+ * a linear (that is, not tiled) frame. 8-bit tiled frames can be converted to
+ * IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT and to
+ * IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT frames, 10-bit ones only to
+ * IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_10BIT frames. This is useful
+ * if the decoder was opened with the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_USE_TILED_OUTPUT
+ * flag, and only some of the decoded frames (or only parts of them) need to
+ * be accessed by the CPU in a linear layout.
+ *
+ * Tiles are stored one after the other, in row-major order. The pixels inside
+ * each tile are stored in row-major order as well. In tiled frames, y_stride
+ * and uv_stride are the sizes of one row of tiles in bytes, divided by the
+ * tile height. (This is the same as the stride of a linear frame with the
+ * same width.) The chroma plane of tiled frames is always semi-planar, so
+ * v_offset is unused in tiled_fb_metrics.
+ *
+ * Only the pixels inside the given region are converted. The region is
+ * expanded to tile boundaries. Pixels outside of it are left untouched in
+ * the linear frame. If region_width or region_height is 0, the entire frame
+ * is converted. The aligned width and height in linear_fb_metrics must be at
+ * least as large as the ones in tiled_fb_metrics.
+ *
+ * The conversion is done by the CPU. If the library was built with NEON
+ * support, 8-bit tiles are converted with NEON instructions.
+ *
+ * @param tiled_color_format Color format of the tiled frame. Must be one of the
+ *        IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_*TILED_* or
+ *        IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_*_TILED_8BIT formats.
+ * @param tiled_pixels Pointer to the start of the tiled frame. Must not be NULL.
+ * @param tiled_fb_metrics Metrics of the tiled frame. Must not be NULL.
+ * @param linear_color_format Color format of the linear frame. Must be
+ *        IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT or
+ *        IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT with 8-bit tiled
+ *        formats, and IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_10BIT
+ *        with 10-bit ones.
+ * @param linear_pixels Pointer to the start of the linear frame. Must not be NULL.
+ * @param linear_fb_metrics Metrics of the linear frame. Must not be NULL.
+ * @param region_x X coordinate of the region to convert, in pixels.
+ * @param region_y Y coordinate of the region to convert, in pixels.
+ * @param region_width Width of the region to convert, in pixels.
+ * @param region_height Height of the region to convert, in pixels.
+ * @return 1 if the frame was converted, 0 if the color formats are not supported
+ *         or the region or the metrics are invalid.
+ */
+int imx_vpu_api_detile_frame(
+	ImxVpuApiColorFormat tiled_color_format,
+	uint8_t const *tiled_pixels, ImxVpuApiFramebufferMetrics const *tiled_fb_metrics,
+	ImxVpuApiColorFormat linear_color_format,
+	uint8_t *linear_pixels, ImxVpuApiFramebufferMetrics const *linear_fb_metrics,
+	size_t region_x, size_t region_y, size_t region_width, size_t region_height
+);
+
+
 /* Structure with details about encoded frames. When decoding, these are
  * the input structures. When encoding, these are the output structures. */
 typedef struct
@@ -464,6 +539,10 @@ typedef struct
 }
 ImxVpuApiEncodedFrame;
 
+/* PTS/DTS value used by the library for frames that have no timestamps
+ * associated with them. See IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT. */
+#define IMX_VPU_API_NO_TIMESTAMP UINT64_MAX
+
 
 /* Structure with details about raw, uncompressed frames. When decoding, these
  * are the output structures. When encoding, these are the input structures. */
@@ -866,9 +945,11 @@ ImxVpuApiVP9SupportDetails;
  *      from the ImxVpuApiDecStreamInfo structure.
  *      Then go back to step 4.
  *    - If the output code is IMX_VPU_API_DEC_OUTPUT_CODE_NEED_ADDITIONAL_FRAMEBUFFER,
- *      allocate an extra framebuffer and add it to the VPU decoder's pool,
- *      just like in step 5 above (except add just 1 buffer here, not the amount
- *      added in that step). Then go back to step 4.
+ *      allocate extra framebuffers and add them to the VPU decoder's pool,
+ *      just like in step 5 above (except add as many buffers as
+ *      imx_vpu_api_dec_get_num_framebuffers_to_be_added() returns here, not
+ *      the amount added in that step; adding just 1 buffer is also valid).
+ *      Then go back to step 4.
  *    - If the output code is IMX_VPU_API_DEC_OUTPUT_CODE_DECODED_FRAME_AVAILABLE,
  *      retrieve the decoded frame with imx_vpu_api_dec_get_decoded_frame(), and
  *      then go back to step 4.
@@ -886,6 +967,12 @@ ImxVpuApiVP9SupportDetails;
  *      (if present), open a new decoder with imx_vpu_api_dec_open(), and go back
  *      to step 2, feedin the same data into the encoder that was previously fed
  *      and which produced this output code.
+ *      (If IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS is set and
+ *      supported, go back to step 4 instead. The decoder then announces the
+ *      new stream info later. Deallocate only those framebuffers for which
+ *      imx_vpu_api_dec_is_framebuffer_in_pool() returns 0 at that point,
+ *      and add as many as imx_vpu_api_dec_get_num_framebuffers_to_be_added()
+ *      returns.)
  * 5. Drain the decoder as explained below.
  * 6. Exit the loop.
  *
@@ -974,7 +1061,12 @@ typedef enum
 	/* General return code for when an error occurs. This is used as a catch-all
 	 * for when the other error return codes do not match the error.
 	 * Consult the log output if this is returned. */
-	IMX_VPU_API_DEC_RETURN_CODE_ERROR
+	IMX_VPU_API_DEC_RETURN_CODE_ERROR,
+	/* The hardware did not finish decoding in time or reported a bus error,
+	 * and the decoder instance was reset to recover from that. Unlike with
+	 * the other error codes, the decoder does not have to be closed. See
+	 * imx_vpu_api_dec_decode() for details. */
+	IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET
 }
 ImxVpuApiDecReturnCodes;
 
@@ -1027,9 +1119,12 @@ typedef enum
 	 * Decoding cannot continue until the framebuffers were added to the pool
 	 * (unless the required amount of framebuffers for the pool is 0). */
 	IMX_VPU_API_DEC_OUTPUT_CODE_NEW_STREAM_INFO_AVAILABLE,
-	/* The decoder needs one additional framebuffer in its pool for decoding.
-	 * The user is supposed to allocate one extra framebuffer and add it by
-	 * calling imx_vpu_api_dec_add_framebuffers_to_pool(). Decoding cannot
+	/* The decoder needs additional framebuffers in its pool for decoding.
+	 * The user is supposed to allocate extra framebuffers and add them by
+	 * calling imx_vpu_api_dec_add_framebuffers_to_pool(). How many are needed
+	 * is returned by imx_vpu_api_dec_get_num_framebuffers_to_be_added().
+	 * Adding all of them in one call avoids further round trips through this
+	 * output code, but adding just one is valid as well. Decoding cannot
 	 * continue until a framebuffer was added. This output code only occurs
 	 * after IMX_VPU_API_DEC_OUTPUT_CODE_NEW_STREAM_INFO_AVAILABLE was
 	 * returned some time earlier. */
@@ -1085,7 +1180,16 @@ typedef enum
 	IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_CORRUPTED_FRAME = 0,
 	/* Frame was skipped because it is internal and only to be decoded,
 	 * not shown. One example is a VP8/VP9 alt-ref frame. */
-	IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_INTERNAL_FRAME
+	IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_INTERNAL_FRAME,
+	/* Frame was not decoded because the current skip mode excludes it.
+	 * See imx_vpu_api_dec_set_skip_mode() for details. */
+	IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_SKIP_MODE,
+	/* Frame was decoded, but not output, because it was pushed while frame
+	 * discarding was enabled. See imx_vpu_api_dec_set_frame_discarding(). */
+	IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_DISCARDED,
+	/* Frame was not decoded because the decoder is resynchronizing after
+	 * a decoding error. See IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_RESYNC_ON_ERRORS. */
+	IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_RESYNC
 }
 ImxVpuApiDecSkippedFrameReasons;
 
@@ -1094,6 +1198,22 @@ ImxVpuApiDecSkippedFrameReasons;
 char const * imx_vpu_api_dec_skipped_frame_reason_string(ImxVpuApiDecSkippedFrameReasons reason);
 
 
+/* Modes for selecting which frames shall be decoded.
+ * Also see imx_vpu_api_dec_set_skip_mode(). */
+typedef enum
+{
+	/* Decode all frames. This is the default. */
+	IMX_VPU_API_DEC_SKIP_MODE_NONE = 0,
+	/* Skip frames that no other frame refers to. These can be dropped
+	 * without affecting the decoding of the remaining frames. */
+	IMX_VPU_API_DEC_SKIP_MODE_NON_REFERENCE_FRAMES,
+	/* Only decode intra frames (I / IDR frames, and keyframes), and skip
+	 * all others. Useful for fast-forward and thumbnail generation. */
+	IMX_VPU_API_DEC_SKIP_MODE_NON_INTRA_FRAMES
+}
+ImxVpuApiDecSkipMode;
+
+
 /* Flags for use in ImxVpuApiDecOpenParams. */
 typedef enum
 {
@@ -1142,9 +1262,195 @@ typedef enum
 	 * if the suggested format is unusable for the decoder, these flags are
 	 * processed as usual. */
 	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_USE_SUGGESTED_COLOR_FORMAT = (1 << 6),
+	/* If this is set, then imx_vpu_api_dec_push_encoded_frame() accepts
+	 * arbitrary chunks of a byte stream instead of complete frames. The
+	 * decoder then finds the frame boundaries by itself. Pushed chunks can
+	 * contain the end of one frame and the beginning of the next, or just a
+	 * part of one frame. The context, PTS, and DTS of a chunk are associated
+	 * with the first frame that begins in that chunk. Any further frames that
+	 * begin in the same chunk get a NULL context and IMX_VPU_API_NO_TIMESTAMP
+	 * as PTS and DTS. If no frame begins in a chunk, its context, PTS, and
+	 * DTS are discarded. This is the same association that MPEG transport
+	 * streams use between PES packets and access units. If more chunks than
+	 * max_num_queued_encoded_frames are waiting for a frame to be completed,
+	 * the decoder may merge some of the later ones into their predecessors,
+	 * in which case their context, PTS, and DTS are discarded as well.
+	 * Only decoders with the IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_BYTE_STREAM_INPUT_SUPPORTED
+	 * global info flag set support this, and only for formats whose frames
+	 * are delimited by start codes (h.264 and h.265). Opening a decoder with
+	 * this flag set fails if the flag is not supported for the format. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT = (1 << 7),
+	/* If this is set, then h.264/h.265 frames are pushed in the form used by
+	 * MP4 and Matroska, that is, as NAL units that are prefixed by their
+	 * size instead of by a start code. The extra_header_data in the open
+	 * params must then contain the avcC (h.264) or hvcC (h.265) NAL
+	 * configuration record. The decoder inserts the parameter sets from
+	 * that record, and replaces the size prefixes with start codes while
+	 * copying the frames into the stream buffer. This spares users from
+	 * having to convert the data to Annex-B byte-stream format by themselves.
+	 * Only decoders with the IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_LENGTH_PREFIXED_NAL_INPUT_SUPPORTED
+	 * global info flag set support this. Opening a decoder with this flag set
+	 * fails if the flag is not supported. This flag cannot be combined with
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LENGTH_PREFIXED_NAL_INPUT = (1 << 8),
+	/* Minimize the delay between pushing an encoded frame and getting the
+	 * corresponding decoded frame. Frames are output in decoding order, and
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_FRAME_REORDERING is ignored.
+	 * The decoder does not hold back decoded frames. Instead, for streams
+	 * without frame reordering, each imx_vpu_api_dec_decode() call that
+	 * decodes a frame also reports it as available. This is intended for
+	 * video conferencing and remote desktop applications, whose streams do
+	 * not use B-frames. imx_vpu_api_dec_get_decoded_frame_latency() can be
+	 * used for checking the latency that is actually achieved. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LOW_LATENCY = (1 << 9),
+	/* Keep framebuffers in the decoder's pool when the video parameters of
+	 * the stream change. Normally, all framebuffers are removed from the pool
+	 * in that case, and a completely new pool has to be allocated. If this
+	 * flag is set, framebuffers that are still large enough and suitably
+	 * aligned for the new stream stay in the pool, and only the missing ones
+	 * need to be added. Framebuffers that hold decoded frames which have not
+	 * yet been returned with imx_vpu_api_dec_return_framebuffer_to_decoder()
+	 * are never kept. Also, the decoder does not have to be reopened after
+	 * IMX_VPU_API_DEC_OUTPUT_CODE_VIDEO_PARAMETERS_CHANGED; instead, decoding
+	 * continues, and IMX_VPU_API_DEC_OUTPUT_CODE_NEW_STREAM_INFO_AVAILABLE is
+	 * returned once the new video parameters are known. This is useful for
+	 * adaptive streaming, where the resolution changes whenever the player
+	 * switches to another rendition.
+	 * See imx_vpu_api_dec_get_num_framebuffers_to_be_added() and
+	 * imx_vpu_api_dec_is_framebuffer_in_pool() for how to find out what
+	 * framebuffers to add and what framebuffers can be deallocated.
+	 * This flag is ignored unless the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_FRAMEBUFFER_REUSE_SUPPORTED flag
+	 * is set in the ImxVpuApiDecGlobalInfo. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS = (1 << 10),
+	/* Recover from corrupted input automatically. Normally, if decoding a
+	 * frame fails because of errors in the bitstream, imx_vpu_api_dec_decode()
+	 * returns IMX_VPU_API_DEC_RETURN_CODE_ERROR, and the decoder has to be
+	 * closed and reopened. If this flag is set, the frame is instead reported
+	 * as skipped, with IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_CORRUPTED_FRAME
+	 * as the reason. The decoder then discards any encoded data that was
+	 * queued after that frame and any frames that are pushed afterwards,
+	 * until a frame arrives that decoding can start at (an h.264 IDR frame,
+	 * an h.265 IRAP frame, a VP8/VP9 keyframe etc). Decoding resumes with
+	 * that frame. The discarded frames are reported as skipped, with
+	 * IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_RESYNC as the reason. This is
+	 * useful for lossy transmissions like RTP streams, since the stream
+	 * buffer and framebuffers do not have to be reallocated after errors.
+	 * Frames with formats whose random access points cannot be detected
+	 * are never discarded; only the frame that failed is skipped then.
+	 * This flag cannot be combined with IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT.
+	 * This flag is ignored unless the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ERROR_RESYNC_SUPPORTED flag
+	 * is set in the ImxVpuApiDecGlobalInfo. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_RESYNC_ON_ERRORS = (1 << 11),
+	/* Pass decoded frames through the decoder's post-processor before they
+	 * are output. The post-processor can crop, scale, rotate, and
+	 * color-convert frames as part of the decoding, which makes it
+	 * unnecessary to do that in separate passes afterwards. See ImxVpuApiDecPostProcessingParams
+	 * for details. The stream info then describes the post-processed frames
+	 * instead of the decoded ones.
+	 * This flag is ignored unless the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_POST_PROCESSING_SUPPORTED flag
+	 * is set in the ImxVpuApiDecGlobalInfo. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING = (1 << 12),
+	/* Copy decoded frames into the output frame DMA buffers in the
+	 * background. Only relevant for decoders that do not have the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL
+	 * flag set. Normally, imx_vpu_api_dec_get_decoded_frame() blocks until
+	 * the decoded frame was copied (and, if necessary, detiled) into the
+	 * output frame DMA buffer. If this flag is set, that function only
+	 * starts the copy and returns right away. The copy then runs while
+	 * the next frames are decoded. Only a few copies can be pending at the
+	 * same time; if the limit is reached, imx_vpu_api_dec_get_decoded_frame()
+	 * waits for the oldest one to finish. Until a copy is finished, the
+	 * output frame DMA buffer must not be accessed, and must not be set as
+	 * output frame DMA buffer again. Use imx_vpu_api_dec_is_output_frame_ready()
+	 * and imx_vpu_api_dec_wait_for_output_frame() to find out when it is
+	 * finished. Flushing and closing the decoder wait for pending copies.
+	 * This flag is ignored unless the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ASYNC_OUTPUT_FRAME_COPY_SUPPORTED flag
+	 * is set in the ImxVpuApiDecGlobalInfo. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ASYNC_OUTPUT_FRAME_COPY = (1 << 13),
+	/* Deinterlace interlaced frames while they are copied into the output
+	 * frame DMA buffers. Only relevant for decoders that do not have the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL
+	 * flag set. Which frames are deinterlaced is determined by the
+	 * interlacing mode of each decoded frame; progressive frames are
+	 * copied as usual. Deinterlaced frames are output with the interlacing
+	 * mode set to IMX_VPU_API_INTERLACING_MODE_NO_INTERLACING. This saves
+	 * a separate deinterlacing pass over each output frame. The
+	 * deinterlacing_mode field in ImxVpuApiDecOpenParams selects the
+	 * deinterlacing algorithm.
+	 * This flag is ignored unless the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DEINTERLACING_SUPPORTED flag
+	 * is set in the ImxVpuApiDecGlobalInfo. */
+	IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE = (1 << 14),
 }
 ImxVpuApiDecOpenParamsFlags;
 
+/* Deinterlacing algorithms that can be used if the
+ * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE flag is set. */
+typedef enum
+{
+	/* Motion adaptive deinterlacing. Fields of the previous frame are
+	 * used for reconstructing static parts of the picture, which gives
+	 * the best quality. The previous frame has to be kept around until
+	 * the current one is deinterlaced, so this requires one additional
+	 * framebuffer. This is the default. */
+	IMX_VPU_API_DEC_DEINTERLACING_MODE_MOTION_ADAPTIVE = 0,
+	/* Simple "bob" deinterlacing. The missing rows are interpolated
+	 * from the rows of the first field of the same frame. */
+	IMX_VPU_API_DEC_DEINTERLACING_MODE_BOB
+}
+ImxVpuApiDecDeinterlacingMode;
+
+/* Orientation changes the post-processor can apply to decoded frames.
+ * Rotations are clockwise. */
+typedef enum
+{
+	IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_NORMAL = 0,
+	IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_90,
+	IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_180,
+	IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_270,
+	/* Mirror frames along the vertical axis (left and right are swapped). */
+	IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_FLIP_HORIZONTAL,
+	/* Mirror frames along the horizontal axis (top and bottom are swapped). */
+	IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_FLIP_VERTICAL
+}
+ImxVpuApiDecPostProcessingOrientation;
+
+/* Parameters for the decoder's post-processor. Only used if the
+ * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING flag is set. */
+typedef struct
+{
+	/* Rectangle within the decoded frames that gets post-processed.
+	 * Everything outside of this rectangle is discarded. If crop_width
+	 * or crop_height is 0, the entire frame is used. Some post-processors
+	 * can only crop at macroblock boundaries. These expand the rectangle
+	 * to the nearest boundaries. */
+	uint32_t crop_left, crop_top, crop_width, crop_height;
+
+	/* Width and height of the post-processed frames. If either of these
+	 * is 0, frames are not scaled. Some post-processors can only scale
+	 * down by fixed ratios (1/2, 1/4, 1/8). These use the ratio that comes
+	 * closest to this size. The actual size of the post-processed frames
+	 * is available in the stream info. If the orientation rotates frames
+	 * by 90 or 270 degrees, this is the size after rotation. */
+	uint32_t output_width, output_height;
+
+	/* Rotation or mirroring to apply to frames. Not all post-processors
+	 * support this. imx_vpu_api_dec_open() returns
+	 * IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS if they don't. */
+	ImxVpuApiDecPostProcessingOrientation orientation;
+
+	/* Color format of the post-processed frames. Which formats are
+	 * supported depends on the post-processor and on the compression
+	 * format. imx_vpu_api_dec_open() returns IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS
+	 * if this format cannot be produced. */
+	ImxVpuApiColorFormat output_color_format;
+}
+ImxVpuApiDecPostProcessingParams;
+
 /* Parameters for opening a decoder. */
 typedef struct
 {
@@ -1179,8 +1485,37 @@ typedef struct
 	 * is set. Even then, the decoder is allowed to ignored this value. */
 	ImxVpuApiColorFormat suggested_color_format;
 
+	/* Maximum number of encoded frames that can be pushed into the decoder
+	 * with imx_vpu_api_dec_push_encoded_frame() before imx_vpu_api_dec_decode()
+	 * has to be called. This allows for queuing several frames in the stream
+	 * buffer, which imx_vpu_api_dec_decode() then works through without
+	 * requiring a push between each decoding step. Only decoders with the
+	 * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_INPUT_QUEUE_SUPPORTED global info flag
+	 * set support this. Others ignore this value. The value 0 is treated
+	 * as 1, which means that only one frame can be pushed at a time. */
+	uint32_t max_num_queued_encoded_frames;
+
+	/* How long to wait for the hardware to finish decoding a frame, in
+	 * milliseconds. If the hardware does not finish within this time, the
+	 * decoder is reset, and imx_vpu_api_dec_decode() returns
+	 * IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET. If this is set to 0, a
+	 * backend specific default is used. Decoders whose drivers use a fixed
+	 * internal timeout ignore this value. */
+	uint32_t completion_timeout;
+
+	/* Post-processor parameters. Only valid if the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING flag
+	 * is set. */
+	ImxVpuApiDecPostProcessingParams post_processing;
+
+	/* Deinterlacing algorithm. Only valid if the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE flag is set.
+	 * imx_vpu_api_dec_open() returns IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS
+	 * if this is not one of the ImxVpuApiDecDeinterlacingMode values. */
+	ImxVpuApiDecDeinterlacingMode deinterlacing_mode;
+
 	/* Reserved bytes for ABI compatibility. */
-	uint8_t reserved[IMX_VPU_API_RESERVED_SIZE - sizeof(ImxVpuApiColorFormat)];
+	uint8_t reserved[IMX_VPU_API_RESERVED_SIZE - sizeof(ImxVpuApiColorFormat) - sizeof(uint32_t) - sizeof(uint32_t) - sizeof(ImxVpuApiDecPostProcessingParams) - sizeof(ImxVpuApiDecDeinterlacingMode)];
 }
 ImxVpuApiDecOpenParams;
 
@@ -1265,7 +1600,8 @@ typedef enum
 	 * V values, which are interleaved. Otherwise, there are two separate
 	 * planes for U and V. */
 	IMX_VPU_API_DEC_STREAM_INFO_FLAG_SEMI_PLANAR_FRAMES = (1 << 0),
-	/* If set, the decoded frames are interlaced. */
+	/* If set, the decoded frames are interlaced. This is not set if the
+	 * decoder deinterlaces the frames (see IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE). */
 	IMX_VPU_API_DEC_STREAM_INFO_FLAG_INTERLACED = (1 << 1),
 	/* If set, the decoded frames contain HDR 10-bit data. */
 	IMX_VPU_API_DEC_STREAM_INFO_FLAG_10BIT = (1 << 2),
@@ -1394,7 +1730,41 @@ typedef enum
 	 * the buffer is not needed, since there is nothing to return. In fact,
 	 * imx_vpu_api_dec_return_framebuffer_to_decoder() is a no-op if this flag
 	 * is not set. */
-	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL = (1 << 3)
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL = (1 << 3),
+	/* If set, then imx_vpu_api_dec_push_encoded_dma_buffer() can pass the
+	 * encoded data in the DMA buffer directly to the VPU, without copying it
+	 * into the stream buffer first. If this is not set, that function is still
+	 * usable, but internally copies the data just like
+	 * imx_vpu_api_dec_push_encoded_frame() does. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ZERO_COPY_INPUT_SUPPORTED = (1 << 4),
+	/* If set, then the decoder can queue multiple encoded frames in its
+	 * stream buffer. See the max_num_queued_encoded_frames field in
+	 * ImxVpuApiDecOpenParams for details. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_INPUT_QUEUE_SUPPORTED = (1 << 5),
+	/* If set, then the decoder supports the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT open params flag. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_BYTE_STREAM_INPUT_SUPPORTED = (1 << 6),
+	/* If set, then the decoder supports the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LENGTH_PREFIXED_NAL_INPUT open params flag. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_LENGTH_PREFIXED_NAL_INPUT_SUPPORTED = (1 << 7),
+	/* If set, then imx_vpu_api_dec_set_skip_mode() can be used for
+	 * skipping frames before they are decoded. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SKIP_MODES_SUPPORTED = (1 << 8),
+	/* If set, then the decoder supports the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS open params flag. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_FRAMEBUFFER_REUSE_SUPPORTED = (1 << 9),
+	/* If set, then the decoder supports the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_RESYNC_ON_ERRORS open params flag. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ERROR_RESYNC_SUPPORTED = (1 << 10),
+	/* If set, then the decoder supports the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING open params flag. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_POST_PROCESSING_SUPPORTED = (1 << 11),
+	/* If set, then the decoder supports the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ASYNC_OUTPUT_FRAME_COPY open params flag. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ASYNC_OUTPUT_FRAME_COPY_SUPPORTED = (1 << 12),
+	/* If set, then the decoder supports the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE open params flag. */
+	IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DEINTERLACING_SUPPORTED = (1 << 13)
 }
 ImxVpuApiDecGlobalInfoFlags;
 
@@ -1482,8 +1852,9 @@ ImxVpuApiCompressionFormatSupportDetails const * imx_vpu_api_dec_get_compression
  * IMX_VPU_API_DEC_RETURN_CODE_DMA_MEMORY_ACCESS_ERROR: Could not access memory
  * from the stream buffer.
  *
- * IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS: Extra header data is invalid, or
- * stream buffer size is insufficient.
+ * IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS: Extra header data is invalid,
+ * stream buffer size is insufficient, or other values in open_params (like
+ * the post-processing parameters or the deinterlacing mode) are invalid.
  *
  * IMX_VPU_API_DEC_RETURN_CODE_UNSUPPORTED_COMPRESSION_FORMAT: The compression
  * format specified in open_params is not supported by this decoder. Check the
@@ -1538,8 +1909,10 @@ ImxVpuApiDecStreamInfo const * imx_vpu_api_dec_get_stream_info(ImxVpuApiDecoder
  * framebuffers to the decoder as indicated by the min_num_required_framebuffers
  * field of the ImxVpuApiDecStreamInfo structure.
  *
- * In case of output code #2, the user must pass exactly one framebuffer
- * to this function.
+ * In case of output code #2, the user must pass at least one framebuffer
+ * to this function. Ideally, as many framebuffers as indicated by
+ * imx_vpu_api_dec_get_num_framebuffers_to_be_added() are passed, since
+ * the decoder otherwise asks for more with the same output code again.
  *
  * User-defined context pointers are useful for when each framebuffer needs to
  * be associated with some additional context. One example would be an OpenGL
@@ -1588,6 +1961,44 @@ ImxVpuApiDecStreamInfo const * imx_vpu_api_dec_get_stream_info(ImxVpuApiDecoder
  */
 ImxVpuApiDecReturnCodes imx_vpu_api_dec_add_framebuffers_to_pool(ImxVpuApiDecoder *decoder, ImxDmaBuffer **fb_dma_buffers, void **fb_contexts, size_t num_framebuffers);
 
+/* Returns the number of framebuffers that currently need to be added to the pool.
+ *
+ * This is the minimum num_framebuffers value that imx_vpu_api_dec_add_framebuffers_to_pool()
+ * accepts after imx_vpu_api_dec_decode() returned one of the output codes listed
+ * in the imx_vpu_api_dec_add_framebuffers_to_pool() documentation. Unless
+ * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS is set, this equals
+ * min_num_required_framebuffers after new stream info was announced. If that
+ * flag is set, framebuffers that were kept in the pool are subtracted from
+ * that number. The return value can then be 0, in which case no framebuffers
+ * need to be added, and imx_vpu_api_dec_add_framebuffers_to_pool() must not
+ * be called.
+ *
+ * After IMX_VPU_API_DEC_OUTPUT_CODE_NEED_ADDITIONAL_FRAMEBUFFER, this returns
+ * the number of additional framebuffers the decoder needs. This is at least 1.
+ * Unlike after new stream info, it is okay to add fewer framebuffers then.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @return Number of framebuffers that need to be added.
+ */
+size_t imx_vpu_api_dec_get_num_framebuffers_to_be_added(ImxVpuApiDecoder *decoder);
+
+/* Checks whether or not a framebuffer is part of the decoder's pool.
+ *
+ * This is mainly useful after IMX_VPU_API_DEC_OUTPUT_CODE_NEW_STREAM_INFO_AVAILABLE
+ * was returned by imx_vpu_api_dec_decode() with IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS
+ * set. Framebuffers that were previously added, but are no longer part of the
+ * pool, are not used by the decoder anymore and can be deallocated.
+ * Framebuffers that hold a decoded frame which was not yet returned with
+ * imx_vpu_api_dec_return_framebuffer_to_decoder() remain part of the pool
+ * until they are returned, even if the decoder does not use them for the
+ * new stream anymore. Check again after returning them.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param fb_dma_buffer DMA buffer of the framebuffer to check. Must not be NULL.
+ * @return Nonzero if the framebuffer is in the pool, zero otherwise.
+ */
+int imx_vpu_api_dec_is_framebuffer_in_pool(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer);
+
 /* Enables the drain mode.
  *
  * Draining consists of two parts: First, any queued encoded input frame
@@ -1639,21 +2050,113 @@ int imx_vpu_api_dec_is_drain_mode_enabled(ImxVpuApiDecoder *decoder);
  * since, as mentioned above, any previously pushed/queued encoded frames
  * also get discarded by the flush operation.
  *
+ * Stream headers are kept across flushes. This includes the extra header
+ * data from the open params, and also headers that were contained in
+ * previously pushed frames (h.264/h.265 parameter sets, MPEG-2, MPEG-4,
+ * and VC-1 sequence headers). It is therefore not necessary to resend
+ * these headers after a flush (for example, when seeking) before pushing
+ * the next keyframe. No state is kept for formats without separate stream
+ * headers, such as VP8 and VP9. This does not apply to byte stream input
+ * mode, since headers cannot be reliably found in arbitrary chunks of data.
+ *
  * @param decoder Decoder instance. Must not be NULL.
  */
 void imx_vpu_api_dec_flush(ImxVpuApiDecoder *decoder);
 
+/* Returns how often the decoder instance was reset to recover from
+ * hardware errors, that is, how often imx_vpu_api_dec_decode() returned
+ * IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET since the decoder was opened.
+ *
+ * This is useful for monitoring the health of the hardware. For example,
+ * if resets keep occurring, an application can decide to give up and
+ * report a fatal error.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ */
+unsigned int imx_vpu_api_dec_get_num_hardware_resets(ImxVpuApiDecoder *decoder);
+
+/* Selects which frames shall be decoded.
+ *
+ * Frames that are excluded by the skip mode are not decoded. Instead,
+ * imx_vpu_api_dec_decode() reports them with the output code
+ * IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED and the skipped frame reason
+ * IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_SKIP_MODE, just like other skipped
+ * frames. The skip mode can be changed at any time; it affects frames that
+ * are pushed after this call. To get correctly decoded frames after switching
+ * back to IMX_VPU_API_DEC_SKIP_MODE_NONE, it is recommended to flush the
+ * decoder and resume at an intra frame.
+ *
+ * How frames are classified depends on the decoder. Some decoders determine
+ * the frame type by parsing the pushed data's picture/slice headers with the
+ * CPU, and decode frames whose type cannot be determined. In particular, with
+ * h.265, only IRAP pictures are treated as intra frames, and only sub-layer
+ * non-reference pictures of the highest sub-layer are treated as non-reference
+ * frames (the highest sub-layer is taken from the SPS). Stream headers in
+ * skipped frames still reach the decoder. Skipped frames are reported after
+ * the frames that were pushed before them. Such decoders do not
+ * support skip modes if IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT is
+ * set, since then, pushed data does not correspond to individual frames.
+ *
+ * This only works if the IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SKIP_MODES_SUPPORTED
+ * flag is set in the ImxVpuApiDecGlobalInfo.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param skip_mode New skip mode.
+ * @return Return code indicating the outcome. Valid values:
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_OK: Success.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS: The decoder does not support
+ * this skip mode, either at all, or with the current open params, or the
+ * skip mode is not a valid ImxVpuApiDecSkipMode value.
+ */
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_set_skip_mode(ImxVpuApiDecoder *decoder, ImxVpuApiDecSkipMode skip_mode);
+
+/* Enables or disables frame discarding.
+ *
+ * Frames that are pushed while discarding is enabled are decoded as usual,
+ * so they can serve as references for subsequent frames. However, once such
+ * a frame is ready for output, its framebuffer is immediately returned to the
+ * decoder, and no pixels are copied or detiled. imx_vpu_api_dec_decode() then
+ * reports it with the output code IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED
+ * and the skipped frame reason IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_DISCARDED
+ * instead of IMX_VPU_API_DEC_OUTPUT_CODE_DECODED_FRAME_AVAILABLE.
+ *
+ * The setting is recorded for each pushed frame individually. This is
+ * useful for accurate seeking: enable discarding, push the frames from the
+ * preceding intra frame up to (but not including) the target frame, then
+ * disable discarding and push the target frame. Frames that are pushed
+ * afterwards are output normally, even if discarded frames are still
+ * in flight inside the decoder.
+ *
+ * Discarding is disabled by default.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param discard_frames Nonzero if frames pushed from now on shall be
+ *        discarded, 0 if they shall be output normally.
+ */
+void imx_vpu_api_dec_set_frame_discarding(ImxVpuApiDecoder *decoder, int discard_frames);
+
 /* Pushes encoded frame data into the decoder's stream buffer.
  *
  * Only complete frames can be pushed in. That is, no partial data is allowed.
  * If partial data is pushed in, then the decoder is in an undefined state.
  * If the incoming data consists of partial frames, then it is up to the user
  * to make sure that these parts are assembled into complete frames before
- * calling this function.
+ * calling this function. The exception is the byte stream input mode (see
+ * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT), in which arbitrary
+ * chunks of data can be pushed in.
  *
  * This function needs to be called at the beginning, before the first
  * imx_vpu_api_dec_decode() call, and when imx_vpu_api_dec_decode() returns
  * the output code IMX_VPU_API_DEC_OUTPUT_CODE_MORE_INPUT_DATA_NEEDED .
+ * If the decoder supports input queuing (see the
+ * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_INPUT_QUEUE_SUPPORTED global info flag)
+ * and max_num_queued_encoded_frames in ImxVpuApiDecOpenParams is greater
+ * than 1, then this can also be called as long as less than that many
+ * pushed frames are still waiting to be decoded. imx_vpu_api_dec_decode()
+ * then decodes these queued frames one after the other, and only returns
+ * IMX_VPU_API_DEC_OUTPUT_CODE_MORE_INPUT_DATA_NEEDED once they are used up.
  *
  * This function is not to be called when the drain mode is enabled.
  *
@@ -1665,10 +2168,80 @@ void imx_vpu_api_dec_flush(ImxVpuApiDecoder *decoder);
  * IMX_VPU_API_DEC_RETURN_CODE_ERROR: Unspecified error. Consult log output.
  *
  * IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL: Tried to call this before
+ * the previously pushed encoded frame was decoded (or, with input queuing,
+ * while the queue is full or the stream buffer has no room for the frame),
+ * or tried to call this in drain mode.
+ */
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame);
+
+/* Function pointer type for the release callback that is passed to
+ * imx_vpu_api_dec_push_encoded_dma_buffer(). It is invoked once the decoder
+ * no longer accesses the DMA buffer. From then on, the user can reuse or
+ * deallocate the buffer.
+ *
+ * Note that this may be called from within imx_vpu_api_dec_decode(),
+ * imx_vpu_api_dec_flush(), imx_vpu_api_dec_close(), and also from within
+ * imx_vpu_api_dec_push_encoded_dma_buffer() itself. Do not call any other
+ * decoder functions from within this callback. */
+typedef void (*ImxVpuApiDecEncodedDmaBufferReleaseCallback)(ImxVpuApiDecoder *decoder, ImxDmaBuffer *dma_buffer, void *user_data);
+
+/* Pushes encoded frame data that is stored in a DMA buffer into the decoder.
+ *
+ * This is a variant of imx_vpu_api_dec_push_encoded_frame() for when the
+ * encoded data already resides in physically contiguous memory. If the
+ * IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ZERO_COPY_INPUT_SUPPORTED flag is set in
+ * the global info, the decoder reads the encoded data directly from that DMA
+ * buffer instead of copying it into the stream buffer. The user must then not
+ * modify or deallocate the DMA buffer until release_callback is invoked.
+ *
+ * Even if that flag is set, the decoder may fall back to copying the data.
+ * This happens if headers have to be inserted in front of the data (for
+ * example, with WMV3 and DIVX3 content, or with the first frame if extra
+ * header data was specified in the open params), if the stream buffer still
+ * contains leftover data from earlier frames, or if the physical address of
+ * the encoded data does not meet the stream buffer physical address alignment
+ * requirement. Also, if the decoder does not consume all of the data in the
+ * DMA buffer and needs more input data, the rest is copied into the stream
+ * buffer. In all of these cases, release_callback is invoked as soon as the
+ * data was copied.
+ *
+ * The encoded_frame argument is used just like in
+ * imx_vpu_api_dec_push_encoded_frame(), except that its data field is
+ * ignored. Instead, the encoded data is expected to be located in
+ * encoded_dma_buffer, starting at the given offset. The size of the encoded
+ * data is given by the data_size field of encoded_frame.
+ *
+ * The same restrictions as with imx_vpu_api_dec_push_encoded_frame() apply
+ * regarding complete frames and when this function can be called.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param encoded_frame Encoded frame metadata. Must not be NULL.
+ * @param encoded_dma_buffer DMA buffer that contains the encoded data.
+ *        Must not be NULL.
+ * @param offset Offset in bytes inside encoded_dma_buffer where the
+ *        encoded data starts.
+ * @param release_callback Callback to invoke once the decoder no longer
+ *        accesses encoded_dma_buffer. Can be NULL. It is not invoked if
+ *        this function returns an error.
+ * @param release_callback_user_data User defined pointer to pass to
+ *        release_callback.
+ * @return Return code indicating the outcome. Valid values:
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_OK: Success.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_ERROR: Unspecified error. Consult log output.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS: The encoded data does not
+ * fit inside encoded_dma_buffer.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL: Tried to call this before
  * the previously pushed encoded frame was decoded, or tried to call this
  * in drain mode.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_DMA_MEMORY_ACCESS_ERROR: Mapping the DMA buffer
+ * failed.
  */
-ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame);
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_dma_buffer(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame, ImxDmaBuffer *encoded_dma_buffer, size_t offset, ImxVpuApiDecEncodedDmaBufferReleaseCallback release_callback, void *release_callback_user_data);
 
 /* Sets the DMA buffer for decoded frames.
  *
@@ -1766,9 +2339,118 @@ void imx_vpu_api_dec_set_output_frame_dma_buffer(ImxVpuApiDecoder *decoder, ImxD
  * IMX_VPU_API_DEC_RETURN_CODE_TIMEOUT: VPU timeout occurred during decoding
  * because the hardware is already busy with some other operation and is not
  * available for decoding.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET: The hardware did not finish
+ * decoding within the completion_timeout from the open params, or it
+ * reported a bus error. The decoder instance was then reset. This error is
+ * recoverable: the framebuffers stay in the pool, and the decoder does not
+ * have to be closed. The reset has the same effect as imx_vpu_api_dec_flush(),
+ * so any undecoded and queued frames are discarded. To resume, push encoded
+ * frames, beginning with the next keyframe (or other random access point).
+ * If the timeout occurred before the new stream info was available, also
+ * push any header data again.
+ * imx_vpu_api_dec_get_num_hardware_resets() returns how often this happened.
+ * On the i.MX6, the reset affects the entire VPU, so the library first
+ * waits for other decoder and encoder instances in the same process to
+ * finish their current frame. Instances in other processes are not
+ * protected this way, and may get a timeout or corrupted frame.
  */
 ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code);
 
+/* Returns a file descriptor that becomes readable once a decoding step that
+ * was started with imx_vpu_api_dec_start_decode() is finished.
+ *
+ * The file descriptor can be added to a poll()/select()/epoll based event
+ * loop. This makes it possible to drive many decoders from one thread. The
+ * file descriptor is owned by the decoder and stays valid until the decoder
+ * is closed. Do not read from it or close it; imx_vpu_api_dec_finish_decode()
+ * takes care of resetting it.
+ *
+ * The VPU hardware cannot signal finished frames through a file descriptor
+ * on its own. Internally, the blocking decoding calls are therefore run in
+ * worker threads that are shared by all decoders and encoders in the process.
+ * These are started the first time this function or imx_vpu_api_dec_start_decode()
+ * (or their encoder counterparts) are called, and stopped once all decoders
+ * and encoders that used them are closed.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @return The file descriptor, or -1 if it could not be set up.
+ */
+int imx_vpu_api_dec_get_event_fd(ImxVpuApiDecoder *decoder);
+
+/* Starts a decoding step without waiting for it to finish.
+ *
+ * This is the non-blocking counterpart of imx_vpu_api_dec_decode(). It
+ * returns immediately after the decoding step was started. Once the file
+ * descriptor from imx_vpu_api_dec_get_event_fd() becomes readable, the
+ * decoding step is finished, and imx_vpu_api_dec_finish_decode() must be
+ * called to get its results. Between these two calls, no other function
+ * must be called for this decoder, with the exception of
+ * imx_vpu_api_dec_get_event_fd() and imx_vpu_api_dec_close(). (Closing the
+ * decoder waits for the decoding step to finish first.)
+ *
+ * Both ways of decoding can be mixed, that is, it is fine to call
+ * imx_vpu_api_dec_decode() once a decoding step that was started with
+ * this function was finished with imx_vpu_api_dec_finish_decode().
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @return Return code indicating the outcome. Valid values:
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_OK: Success. The decoding step was started.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL: A decoding step is already in
+ * progress, that is, imx_vpu_api_dec_finish_decode() was not called yet.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_ERROR: The file descriptor or the worker
+ * threads could not be set up. Consult log output.
+ */
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_start_decode(ImxVpuApiDecoder *decoder);
+
+/* Finishes a decoding step that was started with imx_vpu_api_dec_start_decode().
+ *
+ * If the decoding step is still in progress, this blocks until it is finished.
+ * Usually, this is called once the file descriptor from
+ * imx_vpu_api_dec_get_event_fd() becomes readable, in which case it does not
+ * block. Afterwards, the file descriptor is no longer readable.
+ *
+ * The output code and the return code are those that imx_vpu_api_dec_decode()
+ * would have produced, and must be handled the same way.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param output_code Pointer to an ImxVpuApiDecOutputCodes enum that will be
+ *        set to the output code of the decoding step. Must not be NULL.
+ * @return Return code indicating the outcome. In addition to the values listed
+ *         in the imx_vpu_api_dec_decode() documentation, this can return
+ *         IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL if no decoding step is
+ *         in progress.
+ */
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_finish_decode(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code);
+
+/* Sets how decoding steps started with imx_vpu_api_dec_start_decode() are
+ * scheduled relative to those of other decoders and encoders.
+ *
+ * The shared worker threads (see imx_vpu_api_dec_get_event_fd()) pick the
+ * waiting step with the highest priority first. Steps that keep getting
+ * passed over gradually gain priority though, so lower priority steps are
+ * delayed, but never starved. Steps with equal priority share the worker
+ * threads according to their weights. For
+ * example, a decoder with weight 800 gets eight times as much VPU time as
+ * one with weight 100 if both always have steps waiting. This ensures that
+ * a high resolution main stream is not slowed down by many low resolution
+ * preview streams. On the i.MX6, only one worker thread is used, since
+ * the VPU can only process one frame at a time anyway.
+ *
+ * Decoding with imx_vpu_api_dec_decode() is not affected by this.
+ *
+ * By default, the priority is 0 and the weight is 100.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param priority Scheduling priority. Higher values mean higher priority.
+ * @param weight Relative share of VPU time among steps with the same
+ *        priority. 0 selects the default weight.
+ */
+void imx_vpu_api_dec_set_scheduling_params(ImxVpuApiDecoder *decoder, int priority, unsigned int weight);
+
 /* Get details about a decoded frame.
  *
  * This must not be called until imx_vpu_api_dec_decode() returns the output
@@ -1787,7 +2469,10 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
  * imx_vpu_api_dec_set_output_frame_dma_buffer() before decoding with
  * imx_vpu_api_dec_decode(). imx_vpu_api_dec_get_decoded_frame() then sets
  * fb_dma_buffer to the DMA buffer passed to this function, and the fb_context
- * is set to the fb_context passed to that function.
+ * is set to the fb_context passed to that function. If in addition the
+ * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ASYNC_OUTPUT_FRAME_COPY flag is set,
+ * the frame is not yet fully copied into that DMA buffer when this function
+ * returns. See imx_vpu_api_dec_wait_for_output_frame() for details.
  *
  * @param decoder Decoder instance. Must not be NULL.
  * @param decoded_frame Pointer to ImxVpuApiRawFrame structure to fill details
@@ -1801,6 +2486,52 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
  */
 ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiRawFrame *decoded_frame);
 
+/* Returns the latency of the frame that was last retrieved with
+ * imx_vpu_api_dec_get_decoded_frame().
+ *
+ * The latency is the time that passed between pushing the frame's encoded
+ * data with imx_vpu_api_dec_push_encoded_frame() (or with
+ * imx_vpu_api_dec_push_encoded_dma_buffer()) and the end of the
+ * imx_vpu_api_dec_get_decoded_frame() call that retrieved the decoded frame.
+ * This includes any postprocessing like detiling that is done while the
+ * decoded frame is retrieved. It is measured with a monotonic clock.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @return Latency in nanoseconds, or 0 if no frame was retrieved yet.
+ */
+uint64_t imx_vpu_api_dec_get_decoded_frame_latency(ImxVpuApiDecoder *decoder);
+
+/* Checks if the decoded frame was fully copied into an output frame DMA buffer.
+ *
+ * This is only needed if the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ASYNC_OUTPUT_FRAME_COPY
+ * flag is set. Then, imx_vpu_api_dec_get_decoded_frame() returns before the
+ * frame is copied into the output frame DMA buffer. This function does not
+ * block. It returns 1 if no copy into the given DMA buffer is pending
+ * anymore. This includes DMA buffers that were never used as an output
+ * frame DMA buffer. If the flag is not set, this always returns 1.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param fb_dma_buffer Output frame DMA buffer to check.
+ * @return 1 if the output frame DMA buffer holds the complete frame, 0 otherwise.
+ */
+int imx_vpu_api_dec_is_output_frame_ready(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer);
+
+/* Waits until the decoded frame was fully copied into an output frame DMA buffer.
+ *
+ * This is the blocking counterpart of imx_vpu_api_dec_is_output_frame_ready().
+ * It returns right away if no copy into the given DMA buffer is pending.
+ *
+ * @param decoder Decoder instance. Must not be NULL.
+ * @param fb_dma_buffer Output frame DMA buffer to wait for.
+ * @return Return code indicating the outcome. Valid values:
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_OK: Success.
+ *
+ * IMX_VPU_API_DEC_RETURN_CODE_ERROR: The frame could not be copied.
+ * The contents of the output frame DMA buffer are undefined.
+ */
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_wait_for_output_frame(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer);
+
 /* Returns a framebuffer to the decoder's pool.
  *
  * This function only needs to be called if in ImxVpuApiDecGlobalInfo, the flag
@@ -2000,7 +2731,12 @@ typedef enum
 	IMX_VPU_API_ENC_RETURN_CODE_TIMEOUT,
 	/* General return code for when an error occurs. This is used as a catch-all
 	 * for when the other error return codes do not match the error. */
-	IMX_VPU_API_ENC_RETURN_CODE_ERROR
+	IMX_VPU_API_ENC_RETURN_CODE_ERROR,
+	/* The hardware did not finish encoding in time, and the encoder instance
+	 * was reset to recover from that. Unlike with the other error codes, the
+	 * encoder does not have to be closed. See imx_vpu_api_enc_encode() for
+	 * details. */
+	IMX_VPU_API_ENC_RETURN_CODE_HARDWARE_RESET
 }
 ImxVpuApiEncReturnCodes;
 
@@ -2254,8 +2990,16 @@ typedef struct
 	/* Bitwise OR combination of flags from ImxVpuApiEncOpenParamsFlags. */
 	uint32_t flags;
 
+	/* How long to wait for the hardware to finish encoding a frame, in
+	 * milliseconds. If the hardware does not finish within this time, the
+	 * encoder is reset, and imx_vpu_api_enc_encode() returns
+	 * IMX_VPU_API_ENC_RETURN_CODE_HARDWARE_RESET.
+	 * If this is set to 0, a backend specific default is used. Encoders
+	 * whose drivers use a fixed internal timeout ignore this value. */
+	uint32_t completion_timeout;
+
 	/* Reserved bytes for ABI compatibility. */
-	uint8_t reserved[IMX_VPU_API_RESERVED_SIZE - sizeof(unsigned int) - sizeof(int) - sizeof(uint32_t)];
+	uint8_t reserved[IMX_VPU_API_RESERVED_SIZE - sizeof(unsigned int) - sizeof(int) - sizeof(uint32_t) - sizeof(uint32_t)];
 }
 ImxVpuApiEncOpenParams;
 
@@ -2664,9 +3408,92 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_push_raw_frame(ImxVpuApiEncoder *encoder
  * IMX_VPU_API_ENC_RETURN_CODE_TIMEOUT: VPU timeout occurred during encoding
  * because the hardware is already busy with some other operation and is not
  * available for encoding.
+ *
+ * IMX_VPU_API_ENC_RETURN_CODE_HARDWARE_RESET: The hardware did not finish
+ * encoding within the completion_timeout from the open params. The encoder
+ * instance was then reset. This error is recoverable: the framebuffers stay
+ * in the pool, and the encoder does not have to be closed. The frame that
+ * was being encoded is lost. The next frame is encoded as an IDR frame, and
+ * headers are prepended to it, just like with the very first frame.
+ * On the i.MX6, the reset affects the entire VPU, so the library first
+ * waits for other decoder and encoder instances in the same process to
+ * finish their current frame. Instances in other processes are not
+ * protected this way, and may get a timeout or corrupted frame.
  */
 ImxVpuApiEncReturnCodes imx_vpu_api_enc_encode(ImxVpuApiEncoder *encoder, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code);
 
+/* Returns a file descriptor that becomes readable once an encoding step that
+ * was started with imx_vpu_api_enc_start_encode() is finished.
+ *
+ * This works just like imx_vpu_api_dec_get_event_fd(), and shares the same
+ * worker threads. Do not read from the file descriptor or close it.
+ *
+ * @param encoder Encoder instance. Must not be NULL.
+ * @return The file descriptor, or -1 if it could not be set up.
+ */
+int imx_vpu_api_enc_get_event_fd(ImxVpuApiEncoder *encoder);
+
+/* Starts an encoding step without waiting for it to finish.
+ *
+ * This is the non-blocking counterpart of imx_vpu_api_enc_encode(). It
+ * returns immediately after the encoding step was started. Once the file
+ * descriptor from imx_vpu_api_enc_get_event_fd() becomes readable, the
+ * encoding step is finished, and imx_vpu_api_enc_finish_encode() must be
+ * called to get its results. Between these two calls, no other function
+ * must be called for this encoder, with the exception of
+ * imx_vpu_api_enc_get_event_fd() and imx_vpu_api_enc_close(). (Closing the
+ * encoder waits for the encoding step to finish first.) The DMA buffer of
+ * the raw frame that was pushed last must not be modified until then.
+ *
+ * This makes it possible to prepare the next raw frame on the CPU while
+ * the hardware is encoding the current one.
+ *
+ * @param encoder Encoder instance. Must not be NULL.
+ * @return Return code indicating the outcome. Valid values:
+ *
+ * IMX_VPU_API_ENC_RETURN_CODE_OK: Success. The encoding step was started.
+ *
+ * IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL: An encoding step is already in
+ * progress, that is, imx_vpu_api_enc_finish_encode() was not called yet.
+ *
+ * IMX_VPU_API_ENC_RETURN_CODE_ERROR: The file descriptor or the worker
+ * threads could not be set up. Consult log output.
+ */
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_start_encode(ImxVpuApiEncoder *encoder);
+
+/* Finishes an encoding step that was started with imx_vpu_api_enc_start_encode().
+ *
+ * If the encoding step is still in progress, this blocks until it is finished.
+ * Afterwards, the file descriptor from imx_vpu_api_enc_get_event_fd() is no
+ * longer readable.
+ *
+ * The encoded frame size, the output code, and the return code are those
+ * that imx_vpu_api_enc_encode() would have produced, and must be handled
+ * the same way.
+ *
+ * @param encoder Encoder instance. Must not be NULL.
+ * @param encoded_frame_size Pointer to a size_t value that will be set to the
+ *        size of the encoded frame, in bytes. Must not be NULL.
+ * @param output_code Pointer to an ImxVpuApiEncOutputCodes enum that will be
+ *        set to the output code of the encoding step. Must not be NULL.
+ * @return Return code indicating the outcome. In addition to the values listed
+ *         in the imx_vpu_api_enc_encode() documentation, this can return
+ *         IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL if no encoding step is
+ *         in progress.
+ */
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_finish_encode(ImxVpuApiEncoder *encoder, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code);
+
+/* Sets how encoding steps started with imx_vpu_api_enc_start_encode() are
+ * scheduled. This works just like imx_vpu_api_dec_set_scheduling_params(),
+ * and decoders and encoders are scheduled together.
+ *
+ * @param encoder Encoder instance. Must not be NULL.
+ * @param priority Scheduling priority. Higher values mean higher priority.
+ * @param weight Relative share of VPU time among steps with the same
+ *        priority. 0 selects the default weight.
+ */
+void imx_vpu_api_enc_set_scheduling_params(ImxVpuApiEncoder *encoder, int priority, unsigned int weight);
+
 /* Get details about an encoded frame.
  *
  * This must not be called until imx_vpu_api_enc_encode() returns the output
@@ -0,0 +1,526 @@
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <config.h>
+#include "imxvpuapi2.h"
+#include "imxvpuapi2_priv.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMXVPUAPI2_DETILE_WITH_NEON 1
+#endif
+
+
+typedef struct
+{
+	/* Tile width, in components. Since the chroma planes are
+	 * semi-planar, a chroma tile is tile_width/2 U-V pairs wide. */
+	size_t tile_width;
+	/* Tile heights in the luma and chroma planes. These differ
+	 * with macroblock tiled formats, where a chroma macroblock
+	 * covers the same pixels as a luma macroblock. */
+	size_t luma_tile_height, chroma_tile_height;
+	/* How many bytes one row of components inside a tile occupies.
+	 * With 10-bit formats, components are fully packed, so this is
+	 * tile_width * 10 / 8. Tile widths are multiples of 4, so these
+	 * rows always contain whole 40-bit packing groups. */
+	size_t tile_row_size;
+	/* If TRUE, the top and bottom fields are tiled separately, and
+	 * stored in the first and second half of each plane. */
+	BOOL field_tiled;
+	BOOL is_10bit;
+}
+TileLayout;
+
+
+/* Range of tiles to convert within one plane, or within one field of a plane. */
+typedef struct
+{
+	size_t first_tile_column, num_tile_columns;
+	size_t first_tile_row, num_tile_rows;
+	size_t tile_height;
+}
+TileRange;
+
+
+typedef void (*DetileTileRowFunc)(uint8_t *dest, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout);
+typedef void (*DetileChromaTileRowFunc)(uint8_t *dest_u, uint8_t *dest_v, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout);
+
+
+static BOOL get_tile_layout(ImxVpuApiColorFormat color_format, TileLayout *layout)
+{
+	memset(layout, 0, sizeof(TileLayout));
+
+	switch (color_format)
+	{
+		case IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_8BIT:
+			layout->tile_width = 4;
+			layout->luma_tile_height = layout->chroma_tile_height = 4;
+			layout->tile_row_size = 4;
+			return TRUE;
+
+		case IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_10BIT:
+			layout->tile_width = 4;
+			layout->luma_tile_height = layout->chroma_tile_height = 4;
+			layout->tile_row_size = 5;
+			layout->is_10bit = TRUE;
+			return TRUE;
+
+		case IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_8BIT:
+			layout->tile_width = 8;
+			layout->luma_tile_height = layout->chroma_tile_height = 4;
+			layout->tile_row_size = 8;
+			return TRUE;
+
+		case IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_10BIT:
+			layout->tile_width = 8;
+			layout->luma_tile_height = layout->chroma_tile_height = 4;
+			layout->tile_row_size = 10;
+			layout->is_10bit = TRUE;
+			return TRUE;
+
+		/* The CODA960 layout has not been verified against framebuffers
+		 * written by the hardware (see the format's documentation). */
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FRAME_TILED_8BIT:
+		case IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FIELD_TILED_8BIT:
+			layout->tile_width = 16;
+			layout->luma_tile_height = 16;
+			layout->chroma_tile_height = 8;
+			layout->tile_row_size = 16;
+			layout->field_tiled = (color_format == IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FIELD_TILED_8BIT);
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+
+/* Copies the component rows of num_tiles consecutive tiles into one linear
+ * row. This is inlined with constant tile sizes below, which allows the
+ * compiler to turn the memcpy() calls into plain loads and stores. */
+static inline void copy_tile_rows(uint8_t *dest, uint8_t const *src, size_t num_tiles, size_t tile_row_size, size_t tile_size)
+{
+	size_t i;
+
+	for (i = 0; i < num_tiles; ++i)
+	{
+		memcpy(dest, src, tile_row_size);
+		dest += tile_row_size;
+		src += tile_size;
+	}
+}
+
+
+/* Scalar reference implementation. Detiles one row of tiles. src points to
+ * the first tile to convert, dest to the linear row where its first row of
+ * components ends up. */
+static void detile_tile_row_scalar(uint8_t *dest, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout)
+{
+	size_t row;
+	size_t tile_size = layout->tile_row_size * tile_height;
+
+	for (row = 0; row < tile_height; ++row)
+	{
+		uint8_t *dest_row = dest + row * dest_stride;
+		uint8_t const *src_row = src + row * layout->tile_row_size;
+
+		switch (tile_size)
+		{
+			case 4 * 4: copy_tile_rows(dest_row, src_row, num_tiles, 4, 4 * 4); break;
+			case 5 * 4: copy_tile_rows(dest_row, src_row, num_tiles, 5, 5 * 4); break;
+			case 8 * 4: copy_tile_rows(dest_row, src_row, num_tiles, 8, 8 * 4); break;
+			case 10 * 4: copy_tile_rows(dest_row, src_row, num_tiles, 10, 10 * 4); break;
+			case 16 * 8: copy_tile_rows(dest_row, src_row, num_tiles, 16, 16 * 8); break;
+			case 16 * 16: copy_tile_rows(dest_row, src_row, num_tiles, 16, 16 * 16); break;
+			default: copy_tile_rows(dest_row, src_row, num_tiles, layout->tile_row_size, tile_size);
+		}
+	}
+}
+
+
+/* Scalar reference implementation for detiling one row of 8-bit
+ * chroma tiles into separate U and V planes. */
+static void detile_chroma_tile_row_scalar(uint8_t *dest_u, uint8_t *dest_v, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout)
+{
+	size_t row, i, j;
+	size_t num_pairs = layout->tile_row_size / 2;
+	size_t tile_size = layout->tile_row_size * tile_height;
+
+	for (row = 0; row < tile_height; ++row)
+	{
+		uint8_t *dest_u_row = dest_u + row * dest_stride;
+		uint8_t *dest_v_row = dest_v + row * dest_stride;
+		uint8_t const *src_row = src + row * layout->tile_row_size;
+
+		for (i = 0; i < num_tiles; ++i)
+		{
+			for (j = 0; j < num_pairs; ++j)
+			{
+				dest_u_row[j] = src_row[j * 2 + 0];
+				dest_v_row[j] = src_row[j * 2 + 1];
+			}
+
+			dest_u_row += num_pairs;
+			dest_v_row += num_pairs;
+			src_row += tile_size;
+		}
+	}
+}
+
+
+#ifdef IMXVPUAPI2_DETILE_WITH_NEON
+
+/* NEON implementation for 8-bit 4x4 tiles. Four consecutive tiles make up
+ * 64 bytes; each tile is loaded into one register, with its four rows in
+ * the four 32-bit lanes. Transposing these lanes across the four registers
+ * yields the linear rows of the four tiles. The tiles are loaded with byte
+ * loads, since the source rows are not necessarily 32-bit aligned.
+ * Leftover tiles are copied by the scalar code. */
+static void detile_tile_row_neon_4x4_8bit(uint8_t *dest, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout)
+{
+	size_t i;
+	size_t num_tile_quads = num_tiles / 4;
+
+	assert(tile_height == 4);
+
+	for (i = 0; i < num_tile_quads; ++i)
+	{
+		uint8_t const *tiles = src + i * 64;
+		uint32x4_t tile0 = vreinterpretq_u32_u8(vld1q_u8(tiles + 0));
+		uint32x4_t tile1 = vreinterpretq_u32_u8(vld1q_u8(tiles + 16));
+		uint32x4_t tile2 = vreinterpretq_u32_u8(vld1q_u8(tiles + 32));
+		uint32x4_t tile3 = vreinterpretq_u32_u8(vld1q_u8(tiles + 48));
+		/* tiles01.val[0] = rows 0 and 2 of tiles 0 and 1, interleaved;
+		 * tiles01.val[1] = rows 1 and 3. Same with tiles23. */
+		uint32x4x2_t tiles01 = vtrnq_u32(tile0, tile1);
+		uint32x4x2_t tiles23 = vtrnq_u32(tile2, tile3);
+
+		vst1q_u8(dest + 0 * dest_stride + i * 16, vreinterpretq_u8_u32(vcombine_u32(vget_low_u32(tiles01.val[0]), vget_low_u32(tiles23.val[0]))));
+		vst1q_u8(dest + 1 * dest_stride + i * 16, vreinterpretq_u8_u32(vcombine_u32(vget_low_u32(tiles01.val[1]), vget_low_u32(tiles23.val[1]))));
+		vst1q_u8(dest + 2 * dest_stride + i * 16, vreinterpretq_u8_u32(vcombine_u32(vget_high_u32(tiles01.val[0]), vget_high_u32(tiles23.val[0]))));
+		vst1q_u8(dest + 3 * dest_stride + i * 16, vreinterpretq_u8_u32(vcombine_u32(vget_high_u32(tiles01.val[1]), vget_high_u32(tiles23.val[1]))));
+	}
+
+	if ((num_tiles % 4) != 0)
+		detile_tile_row_scalar(dest + num_tile_quads * 16, dest_stride, src + num_tile_quads * 64, num_tiles % 4, tile_height, layout);
+}
+
+
+/* NEON implementation for 8-bit 8x4 tiles. Two consecutive tiles make up
+ * 64 bytes. Each 128-bit register then holds two rows of one tile; the
+ * linear rows are assembled from the matching halves of both tiles. */
+static void detile_tile_row_neon_8x4_8bit(uint8_t *dest, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout)
+{
+	size_t i;
+	size_t num_tile_pairs = num_tiles / 2;
+
+	assert(tile_height == 4);
+
+	for (i = 0; i < num_tile_pairs; ++i)
+	{
+		uint8_t const *tiles = src + i * 64;
+		uint8x16_t tile0_rows01 = vld1q_u8(tiles + 0);
+		uint8x16_t tile0_rows23 = vld1q_u8(tiles + 16);
+		uint8x16_t tile1_rows01 = vld1q_u8(tiles + 32);
+		uint8x16_t tile1_rows23 = vld1q_u8(tiles + 48);
+
+		vst1q_u8(dest + 0 * dest_stride + i * 16, vcombine_u8(vget_low_u8(tile0_rows01), vget_low_u8(tile1_rows01)));
+		vst1q_u8(dest + 1 * dest_stride + i * 16, vcombine_u8(vget_high_u8(tile0_rows01), vget_high_u8(tile1_rows01)));
+		vst1q_u8(dest + 2 * dest_stride + i * 16, vcombine_u8(vget_low_u8(tile0_rows23), vget_low_u8(tile1_rows23)));
+		vst1q_u8(dest + 3 * dest_stride + i * 16, vcombine_u8(vget_high_u8(tile0_rows23), vget_high_u8(tile1_rows23)));
+	}
+
+	if ((num_tiles % 2) != 0)
+		detile_tile_row_scalar(dest + num_tile_pairs * 16, dest_stride, src + num_tile_pairs * 64, 1, tile_height, layout);
+}
+
+
+/* NEON implementation for CODA960 macroblocks. Each macroblock row is
+ * exactly one 128-bit register wide, so macroblocks are copied one row
+ * at a time. Each macroblock is read sequentially, which keeps the reads
+ * inside the same DRAM page as much as possible. */
+static void detile_tile_row_neon_mb_8bit(uint8_t *dest, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout)
+{
+	size_t i, row;
+
+	assert(layout->tile_row_size == 16);
+
+	for (i = 0; i < num_tiles; ++i)
+	{
+		uint8_t const *tile = src + i * 16 * tile_height;
+		uint8_t *dest_column = dest + i * 16;
+
+		for (row = 0; row < tile_height; ++row)
+			vst1q_u8(dest_column + row * dest_stride, vld1q_u8(tile + row * 16));
+	}
+}
+
+
+/* NEON implementation for detiling CODA960 chroma macroblocks into
+ * separate U and V planes. A 2-way deinterleaving load splits one
+ * macroblock row into its 8 U and 8 V values. */
+static void detile_chroma_tile_row_neon_mb_8bit(uint8_t *dest_u, uint8_t *dest_v, size_t dest_stride, uint8_t const *src, size_t num_tiles, size_t tile_height, TileLayout const *layout)
+{
+	size_t i, row;
+
+	assert(layout->tile_row_size == 16);
+
+	for (i = 0; i < num_tiles; ++i)
+	{
+		uint8_t const *tile = src + i * 16 * tile_height;
+
+		for (row = 0; row < tile_height; ++row)
+		{
+			uint8x8x2_t uv = vld2_u8(tile + row * 16);
+			vst1_u8(dest_u + row * dest_stride + i * 8, uv.val[0]);
+			vst1_u8(dest_v + row * dest_stride + i * 8, uv.val[1]);
+		}
+	}
+}
+
+#endif
+
+
+static DetileTileRowFunc get_detile_tile_row_func(TileLayout const *layout)
+{
+#ifdef IMXVPUAPI2_DETILE_WITH_NEON
+	/* The 10-bit rows (5 and 10 bytes) do not map onto
+	 * NEON lanes, so these always use the scalar code. */
+	switch (layout->tile_row_size)
+	{
+		case 4: return detile_tile_row_neon_4x4_8bit;
+		case 8: return detile_tile_row_neon_8x4_8bit;
+		case 16: return detile_tile_row_neon_mb_8bit;
+		default: break;
+	}
+#else
+	(void)layout;
+#endif
+
+	return detile_tile_row_scalar;
+}
+
+
+static DetileChromaTileRowFunc get_detile_chroma_tile_row_func(TileLayout const *layout)
+{
+#ifdef IMXVPUAPI2_DETILE_WITH_NEON
+	if (layout->tile_row_size == 16)
+		return detile_chroma_tile_row_neon_mb_8bit;
+#else
+	(void)layout;
+#endif
+
+	return detile_chroma_tile_row_scalar;
+}
+
+
+/* Computes the tile rows that cover the frame rows [first_row, end_row) in a
+ * plane with num_rows rows. With field tiled frames, row_divisor is 2, since
+ * every second frame row then belongs to the same tiled field. Otherwise,
+ * it is 1. */
+static void compute_tile_rows(TileRange *range, size_t first_row, size_t end_row, size_t num_rows, size_t row_divisor, size_t tile_height)
+{
+	size_t num_plane_tile_rows = (num_rows / row_divisor) / tile_height;
+	size_t first_tile_row = (first_row / row_divisor) / tile_height;
+	size_t end_tile_row = ((end_row + row_divisor - 1) / row_divisor + tile_height - 1) / tile_height;
+
+	if (end_tile_row > num_plane_tile_rows)
+		end_tile_row = num_plane_tile_rows;
+
+	range->tile_height = tile_height;
+	range->first_tile_row = first_tile_row;
+	range->num_tile_rows = (first_tile_row < end_tile_row) ? (end_tile_row - first_tile_row) : 0;
+}
+
+
+/* Detiles the tiles in the given range of one plane. */
+static void detile_plane(
+	uint8_t *dest, size_t dest_stride,
+	uint8_t const *src, size_t src_stride,
+	TileLayout const *layout, TileRange const *range
+)
+{
+	size_t tile_row;
+	size_t tile_size = layout->tile_row_size * range->tile_height;
+	DetileTileRowFunc detile_tile_row = get_detile_tile_row_func(layout);
+
+	for (tile_row = range->first_tile_row; tile_row < (range->first_tile_row + range->num_tile_rows); ++tile_row)
+	{
+		/* A row of tiles occupies stride * tile_height bytes in the
+		 * tiled frame. With field tiled frames, dest_stride covers
+		 * two linear rows, since the fields are interleaved there. */
+		uint8_t const *src_tiles = src + tile_row * range->tile_height * src_stride + range->first_tile_column * tile_size;
+		uint8_t *dest_rows = dest + tile_row * range->tile_height * dest_stride + range->first_tile_column * layout->tile_row_size;
+
+		detile_tile_row(dest_rows, dest_stride, src_tiles, range->num_tile_columns, range->tile_height, layout);
+	}
+}
+
+
+/* Detiles the tiles in the given range of a semi-planar
+ * chroma plane into separate U and V planes. */
+static void detile_chroma_plane_to_fully_planar(
+	uint8_t *dest_u, uint8_t *dest_v, size_t dest_stride,
+	uint8_t const *src, size_t src_stride,
+	TileLayout const *layout, TileRange const *range
+)
+{
+	size_t tile_row;
+	size_t tile_size = layout->tile_row_size * range->tile_height;
+	DetileChromaTileRowFunc detile_chroma_tile_row = get_detile_chroma_tile_row_func(layout);
+
+	for (tile_row = range->first_tile_row; tile_row < (range->first_tile_row + range->num_tile_rows); ++tile_row)
+	{
+		uint8_t const *src_tiles = src + tile_row * range->tile_height * src_stride + range->first_tile_column * tile_size;
+		size_t dest_offset = tile_row * range->tile_height * dest_stride + range->first_tile_column * layout->tile_row_size / 2;
+
+		detile_chroma_tile_row(dest_u + dest_offset, dest_v + dest_offset, dest_stride, src_tiles, range->num_tile_columns, range->tile_height, layout);
+	}
+}
+
+
+int imx_vpu_api_detile_frame(
+	ImxVpuApiColorFormat tiled_color_format,
+	uint8_t const *tiled_pixels, ImxVpuApiFramebufferMetrics const *tiled_fb_metrics,
+	ImxVpuApiColorFormat linear_color_format,
+	uint8_t *linear_pixels, ImxVpuApiFramebufferMetrics const *linear_fb_metrics,
+	size_t region_x, size_t region_y, size_t region_width, size_t region_height
+)
+{
+	TileLayout layout;
+	BOOL valid_linear_color_format;
+	BOOL fully_planar;
+	size_t field, num_fields;
+	size_t first_tile_column, end_tile_column, num_plane_tile_columns;
+	size_t luma_plane_height, chroma_plane_height;
+	TileRange luma_range, chroma_range;
+
+	assert(tiled_pixels != NULL);
+	assert(tiled_fb_metrics != NULL);
+	assert(linear_pixels != NULL);
+	assert(linear_fb_metrics != NULL);
+
+	if (!get_tile_layout(tiled_color_format, &layout))
+	{
+		IMX_VPU_API_ERROR("cannot detile frames with color format %s", imx_vpu_api_color_format_string(tiled_color_format));
+		return 0;
+	}
+
+	/* 10-bit chroma values straddle byte boundaries,
+	 * so these can only be detiled into semi-planar frames. */
+	if (layout.is_10bit)
+		valid_linear_color_format = (linear_color_format == IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_10BIT);
+	else
+		valid_linear_color_format = (linear_color_format == IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT) || (linear_color_format == IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT);
+
+	if (!valid_linear_color_format)
+	{
+		IMX_VPU_API_ERROR(
+			"cannot detile frames with color format %s into frames with color format %s",
+			imx_vpu_api_color_format_string(tiled_color_format),
+			imx_vpu_api_color_format_string(linear_color_format)
+		);
+		return 0;
+	}
+
+	fully_planar = (linear_color_format == IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT);
+
+	if ((linear_fb_metrics->aligned_frame_width < tiled_fb_metrics->aligned_frame_width) || (linear_fb_metrics->aligned_frame_height < tiled_fb_metrics->aligned_frame_height))
+	{
+		IMX_VPU_API_ERROR(
+			"linear frame size %zux%zu is smaller than tiled frame size %zux%zu",
+			linear_fb_metrics->aligned_frame_width, linear_fb_metrics->aligned_frame_height,
+			tiled_fb_metrics->aligned_frame_width, tiled_fb_metrics->aligned_frame_height
+		);
+		return 0;
+	}
+
+	if ((region_width == 0) || (region_height == 0))
+	{
+		region_x = 0;
+		region_y = 0;
+		region_width = tiled_fb_metrics->actual_frame_width;
+		region_height = tiled_fb_metrics->actual_frame_height;
+	}
+
+	/* Only whole tiles can be converted, so expand the region to tile
+	 * boundaries, and clip it against the tiles that actually exist.
+	 * The chroma plane has half the height of the luma plane. Since U and V
+	 * are interleaved, it has the same width in components, so the tile
+	 * columns are the same in both planes. */
+	num_plane_tile_columns = tiled_fb_metrics->aligned_frame_width / layout.tile_width;
+	first_tile_column = region_x / layout.tile_width;
+	end_tile_column = (region_x + region_width + layout.tile_width - 1) / layout.tile_width;
+	if (end_tile_column > num_plane_tile_columns)
+		end_tile_column = num_plane_tile_columns;
+
+	/* With field tiled frames, each plane consists of two tiled
+	 * planes with half the height, one for each field. */
+	num_fields = layout.field_tiled ? 2 : 1;
+	luma_plane_height = tiled_fb_metrics->aligned_frame_height;
+	chroma_plane_height = tiled_fb_metrics->aligned_frame_height / 2;
+
+	compute_tile_rows(&luma_range, region_y, region_y + region_height, luma_plane_height, num_fields, layout.luma_tile_height);
+	compute_tile_rows(&chroma_range, region_y / 2, (region_y + region_height + 1) / 2, chroma_plane_height, num_fields, layout.chroma_tile_height);
+
+	if ((first_tile_column >= end_tile_column) || (luma_range.num_tile_rows == 0))
+	{
+		IMX_VPU_API_ERROR(
+			"region %zu/%zu/%zux%zu lies outside of the %zux%zu frame",
+			region_x, region_y, region_width, region_height,
+			tiled_fb_metrics->aligned_frame_width, tiled_fb_metrics->aligned_frame_height
+		);
+		return 0;
+	}
+
+	luma_range.first_tile_column = chroma_range.first_tile_column = first_tile_column;
+	luma_range.num_tile_columns = chroma_range.num_tile_columns = end_tile_column - first_tile_column;
+
+	IMX_VPU_API_LOG(
+		"detiling %s frame into %s frame:  tile columns %zu-%zu  luma tile rows %zu-%zu  chroma tile rows %zu-%zu  num fields %zu",
+		imx_vpu_api_color_format_string(tiled_color_format),
+		imx_vpu_api_color_format_string(linear_color_format),
+		first_tile_column, end_tile_column,
+		luma_range.first_tile_row, luma_range.first_tile_row + luma_range.num_tile_rows,
+		chroma_range.first_tile_row, chroma_range.first_tile_row + chroma_range.num_tile_rows,
+		num_fields
+	);
+
+	for (field = 0; field < num_fields; ++field)
+	{
+		/* The bottom field starts in the middle of each tiled plane,
+		 * and its rows are the odd rows of the linear frame. */
+		uint8_t const *tiled_luma = tiled_pixels + tiled_fb_metrics->y_offset + field * tiled_fb_metrics->y_stride * (luma_plane_height / 2);
+		uint8_t const *tiled_chroma = tiled_pixels + tiled_fb_metrics->u_offset + field * tiled_fb_metrics->uv_stride * (chroma_plane_height / 2);
+
+		detile_plane(
+			linear_pixels + linear_fb_metrics->y_offset + field * linear_fb_metrics->y_stride,
+			linear_fb_metrics->y_stride * num_fields,
+			tiled_luma, tiled_fb_metrics->y_stride,
+			&layout, &luma_range
+		);
+
+		if (fully_planar)
+		{
+			detile_chroma_plane_to_fully_planar(
+				linear_pixels + linear_fb_metrics->u_offset + field * linear_fb_metrics->uv_stride,
+				linear_pixels + linear_fb_metrics->v_offset + field * linear_fb_metrics->uv_stride,
+				linear_fb_metrics->uv_stride * num_fields,
+				tiled_chroma, tiled_fb_metrics->uv_stride,
+				&layout, &chroma_range
+			);
+		}
+		else
+		{
+			detile_plane(
+				linear_pixels + linear_fb_metrics->u_offset + field * linear_fb_metrics->uv_stride,
+				linear_fb_metrics->uv_stride * num_fields,
+				tiled_chroma, tiled_fb_metrics->uv_stride,
+				&layout, &chroma_range
+			);
+		}
+	}
+
+	return 1;
+}
@@ -46,6 +46,7 @@
 
 #define VPU_WAIT_TIMEOUT                            (500) /* milliseconds to wait for frame completion */
 #define VPU_MAX_TIMEOUT_COUNTS                      (4)   /* how many timeouts are allowed in series */
+#define VPU_DEFAULT_COMPLETION_TIMEOUT              (VPU_WAIT_TIMEOUT * VPU_MAX_TIMEOUT_COUNTS)
 
 #define JPEG_ENC_HEADER_DATA_MAX_SIZE  2048
 
@@ -57,6 +58,17 @@
  * problem, we increase the minimum framebuffer count by this constant. */
 #define NUM_EXTRA_FRAMEBUFFERS_REQUIRED             (4)
 
+/* How many frames can be detiled by the IPU in the background if the
+ * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ASYNC_OUTPUT_FRAME_COPY flag is set.
+ * Each of these holds on to one framebuffer until it is detiled, so
+ * this many framebuffers are added to the minimum framebuffer count. */
+#define MAX_NUM_PENDING_DETILING_TASKS              (3)
+
+/* How many output frames whose detiling failed are remembered until the
+ * failure is reported by imx_vpu_api_dec_wait_for_output_frame(). If more
+ * failures accumulate without being reported, the oldest one is dropped. */
+#define MAX_NUM_FAILED_DETILING_OUTPUT_FRAMES       (16)
+
 
 /* Component tables, used by imx-vpu to fill in JPEG SOF headers as described
  * by the JPEG specification section B.2.2 and to pick the correct quantization
@@ -275,6 +287,95 @@ static void imx_coda_vpu_unload(void)
 }
 
 
+/* Waits until the VPU finishes the current frame, or until completion_timeout
+ * milliseconds have passed. vpu_WaitForInt() blocks until the VPU interrupt
+ * arrives, but sometimes, it takes more than one call to cover the entire
+ * decoding/encoding interval, so the timeout is split into
+ * VPU_MAX_TIMEOUT_COUNTS waits. Only if all of them time out is this
+ * considered a timeout. Returns FALSE if a timeout occurred. */
+static BOOL wait_for_frame_completion(unsigned int completion_timeout)
+{
+	int cnt;
+	unsigned int wait_time = completion_timeout / VPU_MAX_TIMEOUT_COUNTS;
+
+	if (wait_time == 0)
+		wait_time = 1;
+
+	for (cnt = 0; cnt < VPU_MAX_TIMEOUT_COUNTS; ++cnt)
+	{
+		if (vpu_WaitForInt(wait_time) == RETCODE_SUCCESS)
+			return TRUE;
+
+		IMX_VPU_API_INFO("timeout after waiting %u ms for frame completion (%d of %d)", wait_time, cnt + 1, VPU_MAX_TIMEOUT_COUNTS);
+	}
+
+	return FALSE;
+}
+
+
+/* vpu_SWReset() resets the entire CODA core, and not just the instance
+ * whose handle is passed to it. Any frame that another instance is
+ * decoding or encoding at that moment would be lost. To prevent that,
+ * instances announce VPU operations that are in flight (that is, from
+ * vpu_DecStartOneFrame() / vpu_EncStartOneFrame() until the matching
+ * vpu_DecGetOutputInfo() / vpu_EncGetOutputInfo() call, and for the
+ * duration of vpu_DecGetInitialInfo()), and a reset waits until no
+ * operation is in flight. New operations are held back until the reset
+ * is done. This only coordinates instances within this process; other
+ * processes that use the VPU at the same time are still affected. */
+
+static pthread_mutex_t vpu_reset_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t vpu_reset_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int vpu_num_operations_in_flight = 0;
+static BOOL vpu_reset_in_progress = FALSE;
+
+
+static void begin_vpu_operation(void)
+{
+	pthread_mutex_lock(&vpu_reset_mutex);
+	while (vpu_reset_in_progress)
+		pthread_cond_wait(&vpu_reset_cond, &vpu_reset_mutex);
+	vpu_num_operations_in_flight++;
+	pthread_mutex_unlock(&vpu_reset_mutex);
+}
+
+
+static void end_vpu_operation(void)
+{
+	pthread_mutex_lock(&vpu_reset_mutex);
+	assert(vpu_num_operations_in_flight > 0);
+	vpu_num_operations_in_flight--;
+	if (vpu_num_operations_in_flight == 0)
+		pthread_cond_broadcast(&vpu_reset_cond);
+	pthread_mutex_unlock(&vpu_reset_mutex);
+}
+
+
+/* The caller must not have an operation in flight
+ * (see begin_vpu_operation()), otherwise this deadlocks. */
+static RetCode reset_vpu(DecHandle handle)
+{
+	RetCode ret;
+
+	pthread_mutex_lock(&vpu_reset_mutex);
+	while (vpu_reset_in_progress)
+		pthread_cond_wait(&vpu_reset_cond, &vpu_reset_mutex);
+	vpu_reset_in_progress = TRUE;
+	while (vpu_num_operations_in_flight > 0)
+		pthread_cond_wait(&vpu_reset_cond, &vpu_reset_mutex);
+	pthread_mutex_unlock(&vpu_reset_mutex);
+
+	ret = vpu_SWReset(handle, 0);
+
+	pthread_mutex_lock(&vpu_reset_mutex);
+	vpu_reset_in_progress = FALSE;
+	pthread_cond_broadcast(&vpu_reset_cond);
+	pthread_mutex_unlock(&vpu_reset_mutex);
+
+	return ret;
+}
+
+
 
 
 /* Functions for converting CODA VPU specific values into imxvpuapi enums. */
@@ -609,18 +710,79 @@ typedef struct
 	 * be confused with frame_context. This value corresponds to the
 	 * fb_contexts argument of imx_vpu_api_dec_add_framebuffers_to_pool(). */
 	void *fb_context;
+	/* Virtual address of fb_dma_buffer if the CPU detiled it before, or NULL.
+	 * The framebuffer then stays mapped until it is removed from the pool,
+	 * so it does not have to be mapped and unmapped for every frame. */
+	uint8_t const *fb_virtual_address;
+
+	/* If TRUE, the frame was pushed while frame discarding was enabled.
+	 * Once it is displayable, its framebuffer is returned to the VPU right
+	 * away, and it is reported as skipped instead of being detiled. */
+	BOOL discard;
+
+	/* Monotonic time at which the frame's encoded data was pushed.
+	 * Used for measuring the frame's latency. */
+	uint64_t push_time;
 }
 DecFrameEntry;
 
 
+/* Frame that the IPU detiles in the background. See the
+ * pending_detiling_tasks field in ImxVpuApiDecoder. */
+typedef struct
+{
+	/* Index of the framebuffer to mark as displayed in the VPU once
+	 * the task is finished, or -1 if there is none. This usually is
+	 * the framebuffer the frame is read from. With motion adaptive
+	 * deinterlacing, it is the framebuffer of the previous frame
+	 * instead (see deinterlacing_reference_fb_index). */
+	int fb_index;
+	/* Output frame DMA buffer the frame is written to. */
+	ImxDmaBuffer *output_frame_dma_buffer;
+}
+PendingDetilingTask;
+
+
 struct _ImxVpuApiDecoder
 {
 	/* Handle of the CODA VPU decoder instance. */
 	DecHandle handle;
 
-	/* Unix file descriptor of the IPU VDOA. */
+	/* Unix file descriptor of the IPU VDOA, or -1 if the IPU could not
+	 * be opened. In that case, the CPU detiles the decoded frames. It also
+	 * does that if the IPU fails to detile a frame, for example because
+	 * it is busy, as long as no IPU-only processing is enabled (see
+	 * imx_vpu_api_dec_can_detile_with_cpu()). */
 	int ipu_vdoa_fd;
 
+	/* Only used if the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ASYNC_OUTPUT_FRAME_COPY
+	 * flag is set (and the compression format is not JPEG). Otherwise,
+	 * detiling_queue is NULL. pending_detiling_tasks is a ring buffer with
+	 * the frames that are in detiling_queue, in the same order. Their
+	 * framebuffers are not marked as displayed in the VPU until the
+	 * detiling is finished, since the VPU would otherwise be allowed
+	 * to decode into them while the IPU is still reading from them.
+	 * failed_detiling_output_frame_dma_buffers contains the output frame
+	 * DMA buffers of the tasks that failed, oldest first, so the failures
+	 * can still be reported by imx_vpu_api_dec_wait_for_output_frame()
+	 * after the tasks were retired. */
+	ImxVpuApiImx6CodaIpuDetilingQueue *detiling_queue;
+	PendingDetilingTask pending_detiling_tasks[MAX_NUM_PENDING_DETILING_TASKS];
+	size_t first_pending_detiling_task_index, num_pending_detiling_tasks;
+	ImxDmaBuffer *failed_detiling_output_frame_dma_buffers[MAX_NUM_FAILED_DETILING_OUTPUT_FRAMES];
+	size_t num_failed_detiling_output_frames;
+
+	/* deinterlacing_enabled is TRUE if the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE flag is set
+	 * (and the compression format is not JPEG). With motion
+	 * adaptive deinterlacing, the IPU also reads from the framebuffer
+	 * of the previous frame, so that framebuffer is not marked as
+	 * displayed in the VPU until the next frame was detiled.
+	 * deinterlacing_reference_fb_index is the index of that
+	 * framebuffer, or -1 if there is none. */
+	BOOL deinterlacing_enabled;
+	int deinterlacing_reference_fb_index;
+
 	/* Stream buffer (called "bitstream buffer" in the VPU documentation).
 	 * Holds encoded data that shall be decoded. This includes additional
 	 * header metadata that may have to be manually produced and inserted
@@ -646,8 +808,25 @@ struct _ImxVpuApiDecoder
 	 * of the "co-located motion vector" data. */
 	size_t mvcol_offset;
 
-	size_t total_padded_input_width, total_padded_input_height;
-	size_t total_padded_output_width, total_padded_output_height;
+	/* Metrics of the framebuffers in the pool that the VPU decodes into.
+	 * Unless post-processing is enabled, these are the same as the
+	 * decoded_frame_framebuffer_metrics in the stream info. */
+	ImxVpuApiFramebufferMetrics fb_pool_framebuffer_metrics;
+	/* Tiled layout of the framebuffers in the pool, matching the mapType
+	 * in the VPU open parameters. Used for detiling with the CPU. Field
+	 * tiling (mapType 2) is never used, so this is always frame tiled. */
+	ImxVpuApiColorFormat fb_pool_tiled_color_format;
+
+	/* Parameters for the IPU task that detiles decoded frames into the
+	 * output frame DMA buffer. The deinterlacing fields are filled in
+	 * for each frame in imx_vpu_api_dec_get_decoded_frame(). */
+	ImxVpuApiImx6CodaIpuDetilingParams detiling_params;
+
+	/* TRUE if the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING
+	 * flag is set (and the compression format is not JPEG). The IPU then
+	 * also crops, scales, rotates, and color-converts frames while
+	 * detiling them. */
+	BOOL post_processing_enabled;
 
 	/* num_framebuffers: How many framebuffers there are. This is also the
 	 * size of the frame_entries and internal_framebuffers arrays.
@@ -696,6 +875,23 @@ struct _ImxVpuApiDecoder
 	 * details later when we know what item to pick. */
 	ImxVpuApiEncodedFrame staged_encoded_frame;
 	BOOL staged_encoded_frame_set;
+	/* Copy of discard_frames from the time the staged frame was pushed. */
+	BOOL staged_encoded_frame_discard;
+	/* Monotonic time at which the staged frame was pushed. */
+	uint64_t staged_encoded_frame_push_time;
+
+	/* Latency of the frame that was last retrieved by
+	 * imx_vpu_api_dec_get_decoded_frame(), in nanoseconds. */
+	uint64_t decoded_frame_latency;
+
+	/* How long to wait for frame completion, in milliseconds. Set to
+	 * VPU_DEFAULT_COMPLETION_TIMEOUT if the open_params value is 0. */
+	unsigned int completion_timeout;
+	/* How often the decoder was reset after a timeout. */
+	unsigned int num_hardware_resets;
+
+	/* Set by imx_vpu_api_dec_set_frame_discarding(). */
+	BOOL discard_frames;
 
 	/* If TRUE, then at some point after opening a new decoder instance,
 	 * some encoded data got pushed into the encoder by calling the
@@ -741,11 +937,18 @@ struct _ImxVpuApiDecoder
 	 * frame_entries array always is only one item long). */
 	int available_decoded_frame_idx;
 
+	/* Current skip mode, mapped to the VPU's skipframeMode
+	 * in imx_vpu_api_dec_decode(). */
+	ImxVpuApiDecSkipMode skip_mode;
+
 	/* Information about skipped/dropped frames. */
 	ImxVpuApiDecSkippedFrameReasons skipped_frame_reason;
 	void *skipped_frame_context;
 	uint64_t skipped_frame_pts;
 	uint64_t skipped_frame_dts;
+
+	/* State for imx_vpu_api_dec_start_decode() / imx_vpu_api_dec_finish_decode(). */
+	ImxVpuApiDecAsyncState async_state;
 };
 
 
@@ -756,8 +959,18 @@ static void imx_vpu_api_dec_free_internal_arrays(ImxVpuApiDecoder *decoder);
 
 static RetCode imx_vpu_api_dec_get_initial_info(ImxVpuApiDecoder *decoder);
 
+static void imx_vpu_api_dec_reset_after_timeout(ImxVpuApiDecoder *decoder);
+
+static BOOL imx_vpu_api_dec_is_detiling_pending(ImxVpuApiDecoder *decoder, ImxDmaBuffer *output_frame_dma_buffer);
+static void imx_vpu_api_dec_retire_detiling_tasks(ImxVpuApiDecoder *decoder, ImxDmaBuffer *output_frame_dma_buffer, BOOL wait);
+static void imx_vpu_api_dec_release_deinterlacing_reference(ImxVpuApiDecoder *decoder);
+
+static BOOL imx_vpu_api_dec_can_detile_with_cpu(ImxVpuApiDecoder *decoder);
+static BOOL imx_vpu_api_dec_detile_frame_with_cpu(ImxVpuApiDecoder *decoder, DecFrameEntry *frame_entry, ImxDmaBuffer *dest_fb_dma_buffer);
+
 static BOOL imx_vpu_api_dec_fill_stream_info_from_initial_info(ImxVpuApiDecoder *decoder, DecInitialInfo const *initial_info);
 static BOOL imx_vpu_api_dec_fill_stream_info(ImxVpuApiDecoder *decoder, size_t actual_frame_width, size_t actual_frame_height, ImxVpuApiColorFormat color_format, unsigned int frame_rate_numerator, unsigned int frame_rate_denominator, size_t min_num_required_framebuffers, BOOL interlaced);
+static BOOL imx_vpu_api_dec_apply_post_processing_to_stream_info(ImxVpuApiDecoder *decoder);
 
 
 
@@ -899,8 +1112,8 @@ static BOOL imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uin
 			{
 				imx_vpu_api_insert_vp8_ivf_sequence_header(
 					&(header[0]),
-					decoder->stream_info.decoded_frame_framebuffer_metrics.actual_frame_width,
-					decoder->stream_info.decoded_frame_framebuffer_metrics.actual_frame_height
+					decoder->fb_pool_framebuffer_metrics.actual_frame_width,
+					decoder->fb_pool_framebuffer_metrics.actual_frame_height
 				);
 				imx_vpu_api_insert_vp8_ivf_frame_header(&(header[VP8_SEQUENCE_HEADER_SIZE]), main_data_size, 0);
 				header_size = VP8_SEQUENCE_HEADER_SIZE + VP8_FRAME_HEADER_SIZE;
@@ -1025,6 +1238,8 @@ static BOOL imx_vpu_api_dec_push_input_data(ImxVpuApiDecoder *decoder, void cons
 
 static void imx_vpu_api_dec_free_internal_arrays(ImxVpuApiDecoder *decoder)
 {
+	size_t i;
+
 	if (decoder->internal_framebuffers != NULL)
 	{
 		free(decoder->internal_framebuffers);
@@ -1033,9 +1248,242 @@ static void imx_vpu_api_dec_free_internal_arrays(ImxVpuApiDecoder *decoder)
 
 	if (decoder->frame_entries != NULL)
 	{
+		for (i = 0; i < decoder->num_framebuffers; ++i)
+		{
+			if (decoder->frame_entries[i].fb_virtual_address != NULL)
+				imx_dma_buffer_unmap(decoder->frame_entries[i].fb_dma_buffer);
+		}
+
 		free(decoder->frame_entries);
 		decoder->frame_entries = NULL;
 	}
+
+	decoder->deinterlacing_reference_fb_index = -1;
+}
+
+
+static void imx_vpu_api_dec_reset_after_timeout(ImxVpuApiDecoder *decoder)
+{
+	RetCode dec_ret;
+
+	assert(decoder != NULL);
+
+	IMX_VPU_API_ERROR("resetting decoder after VPU timeout");
+
+	/* vpu_SWReset() resets the VPU without closing the instance, so the
+	 * registered framebuffers and the sequence information stay valid.
+	 * Whatever the VPU was working on is lost though, so afterwards,
+	 * discard everything that is in flight, just like a flush does.
+	 * (See reset_vpu() for how other instances are protected.) */
+	dec_ret = reset_vpu(decoder->handle);
+	if (dec_ret != RETCODE_SUCCESS)
+		IMX_VPU_API_ERROR("vpu_SWReset() error: %s", retcode_to_string(dec_ret));
+
+	imx_vpu_api_dec_flush(decoder);
+
+	/* The flush does nothing with WMV3 data or before framebuffers
+	 * were added, so make sure the staged frame is dropped. */
+	decoder->staged_encoded_frame_set = FALSE;
+
+	decoder->num_hardware_resets++;
+	IMX_VPU_API_DEBUG("decoder reset; %u reset(s) so far", decoder->num_hardware_resets);
+}
+
+
+static BOOL imx_vpu_api_dec_is_detiling_pending(ImxVpuApiDecoder *decoder, ImxDmaBuffer *output_frame_dma_buffer)
+{
+	size_t i;
+
+	for (i = 0; i < decoder->num_pending_detiling_tasks; ++i)
+	{
+		size_t index = (decoder->first_pending_detiling_task_index + i) % MAX_NUM_PENDING_DETILING_TASKS;
+		if (decoder->pending_detiling_tasks[index].output_frame_dma_buffer == output_frame_dma_buffer)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+/* Removes output_frame_dma_buffer from the list of output frames whose
+ * detiling failed. Returns TRUE if it was in that list. */
+static BOOL imx_vpu_api_dec_remove_failed_detiling_output_frame(ImxVpuApiDecoder *decoder, ImxDmaBuffer *output_frame_dma_buffer)
+{
+	size_t i;
+
+	for (i = 0; i < decoder->num_failed_detiling_output_frames; ++i)
+	{
+		if (decoder->failed_detiling_output_frame_dma_buffers[i] == output_frame_dma_buffer)
+		{
+			memmove(
+				&(decoder->failed_detiling_output_frame_dma_buffers[i]),
+				&(decoder->failed_detiling_output_frame_dma_buffers[i + 1]),
+				(decoder->num_failed_detiling_output_frames - i - 1) * sizeof(ImxDmaBuffer *)
+			);
+			decoder->num_failed_detiling_output_frames--;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+
+static void imx_vpu_api_dec_add_failed_detiling_output_frame(ImxVpuApiDecoder *decoder, ImxDmaBuffer *output_frame_dma_buffer)
+{
+	/* Avoid duplicates in case the same output frame failed again. */
+	imx_vpu_api_dec_remove_failed_detiling_output_frame(decoder, output_frame_dma_buffer);
+
+	if (decoder->num_failed_detiling_output_frames == MAX_NUM_FAILED_DETILING_OUTPUT_FRAMES)
+	{
+		IMX_VPU_API_WARNING("too many unreported detiling failures; dropping the oldest one");
+		imx_vpu_api_dec_remove_failed_detiling_output_frame(decoder, decoder->failed_detiling_output_frame_dma_buffers[0]);
+	}
+
+	decoder->failed_detiling_output_frame_dma_buffers[decoder->num_failed_detiling_output_frames++] = output_frame_dma_buffer;
+}
+
+
+/* Removes finished tasks from the detiling queue and marks their framebuffers
+ * as displayed in the VPU. If wait is TRUE, this waits until the task that
+ * writes into output_frame_dma_buffer is finished, or until all tasks are
+ * finished if output_frame_dma_buffer is NULL. */
+static void imx_vpu_api_dec_retire_detiling_tasks(ImxVpuApiDecoder *decoder, ImxDmaBuffer *output_frame_dma_buffer, BOOL wait)
+{
+	if (decoder->detiling_queue == NULL)
+		return;
+
+	/* Tasks are finished in order, so there is no need to wait
+	 * if the requested output frame is not among the pending ones. */
+	if (wait && (output_frame_dma_buffer != NULL) && !imx_vpu_api_dec_is_detiling_pending(decoder, output_frame_dma_buffer))
+		wait = FALSE;
+
+	while (decoder->num_pending_detiling_tasks > 0)
+	{
+		RetCode dec_ret;
+		BOOL success;
+		PendingDetilingTask *task = &(decoder->pending_detiling_tasks[decoder->first_pending_detiling_task_index]);
+
+		if (!imx_vpu_api_imx6_coda_ipu_detiling_queue_pop(decoder->detiling_queue, wait, &success))
+			break;
+
+		/* The framebuffer is not marked as displayed yet, so
+		 * the CPU can still detile the frame if the IPU failed. */
+		if (!success && imx_vpu_api_dec_can_detile_with_cpu(decoder) && (task->fb_index >= 0))
+		{
+			IMX_VPU_API_WARNING("IPU could not detile and copy decoded frame pixels; detiling with the CPU instead");
+			success = imx_vpu_api_dec_detile_frame_with_cpu(decoder, &(decoder->frame_entries[task->fb_index]), task->output_frame_dma_buffer);
+		}
+
+		if (!success)
+		{
+			IMX_VPU_API_ERROR("could not detile and copy decoded frame pixels");
+			imx_vpu_api_dec_add_failed_detiling_output_frame(decoder, task->output_frame_dma_buffer);
+		}
+
+		if (task->fb_index >= 0)
+		{
+			dec_ret = vpu_DecClrDispFlag(decoder->handle, task->fb_index);
+			if (dec_ret != RETCODE_SUCCESS)
+				IMX_VPU_API_ERROR("vpu_DecClrDispFlag() error: %s", retcode_to_string(dec_ret));
+
+			decoder->num_used_framebuffers--;
+		}
+
+		decoder->first_pending_detiling_task_index = (decoder->first_pending_detiling_task_index + 1) % MAX_NUM_PENDING_DETILING_TASKS;
+		decoder->num_pending_detiling_tasks--;
+
+		if ((output_frame_dma_buffer != NULL) && (task->output_frame_dma_buffer == output_frame_dma_buffer))
+			wait = FALSE;
+	}
+}
+
+
+/* Marks the framebuffer that is kept around for motion adaptive
+ * deinterlacing as displayed in the VPU. Pending detiling tasks
+ * may read from it, so these must be retired before calling this. */
+static void imx_vpu_api_dec_release_deinterlacing_reference(ImxVpuApiDecoder *decoder)
+{
+	RetCode dec_ret;
+
+	if (decoder->deinterlacing_reference_fb_index < 0)
+		return;
+
+	dec_ret = vpu_DecClrDispFlag(decoder->handle, decoder->deinterlacing_reference_fb_index);
+	if (dec_ret != RETCODE_SUCCESS)
+		IMX_VPU_API_ERROR("vpu_DecClrDispFlag() error: %s", retcode_to_string(dec_ret));
+
+	decoder->num_used_framebuffers--;
+	decoder->deinterlacing_reference_fb_index = -1;
+}
+
+
+/* Returns TRUE if the CPU can detile frames in place of the IPU. Only plain
+ * detiling is done by the CPU; deinterlacing and post-processing need the IPU. */
+static BOOL imx_vpu_api_dec_can_detile_with_cpu(ImxVpuApiDecoder *decoder)
+{
+	return !(decoder->deinterlacing_enabled) && !(decoder->post_processing_enabled);
+}
+
+
+/* Detiles the frame in the framebuffer of frame_entry into dest_fb_dma_buffer.
+ * The framebuffer is mapped the first time this is done, and stays mapped
+ * (see the fb_virtual_address field in DecFrameEntry). Only the output frame,
+ * which belongs to the user, is mapped and unmapped every time. */
+static BOOL imx_vpu_api_dec_detile_frame_with_cpu(ImxVpuApiDecoder *decoder, DecFrameEntry *frame_entry, ImxDmaBuffer *dest_fb_dma_buffer)
+{
+	int err;
+	BOOL ret;
+	uint8_t *dest_pixels;
+	ImxVpuApiFramebufferMetrics tiled_fb_metrics;
+
+	assert(imx_vpu_api_dec_can_detile_with_cpu(decoder));
+
+	/* The VPU always decodes into semi-planar tiled framebuffers, with
+	 * the interleaved chroma plane at the same address that is
+	 * passed to the VPU when registering the framebuffers. Since
+	 * post-processing is disabled, the output frame uses the
+	 * same metrics as the framebuffers in the pool otherwise. */
+	tiled_fb_metrics = decoder->fb_pool_framebuffer_metrics;
+	tiled_fb_metrics.uv_stride = tiled_fb_metrics.y_stride;
+	tiled_fb_metrics.y_offset = decoder->y_offset;
+	tiled_fb_metrics.u_offset = decoder->u_offset;
+
+	/* Mapping with IMX_DMA_BUFFER_MAPPING_FLAG_MANUAL_SYNC since the
+	 * framebuffer stays mapped while the VPU keeps decoding into it.
+	 * The sync session below makes the VPU's writes visible. */
+	if (frame_entry->fb_virtual_address == NULL)
+	{
+		frame_entry->fb_virtual_address = imx_dma_buffer_map(frame_entry->fb_dma_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_READ | IMX_DMA_BUFFER_MAPPING_FLAG_MANUAL_SYNC, &err);
+		if (frame_entry->fb_virtual_address == NULL)
+		{
+			IMX_VPU_API_ERROR("mapping framebuffer to virtual address space failed: %s (%d)", strerror(err), err);
+			return FALSE;
+		}
+	}
+
+	dest_pixels = imx_dma_buffer_map(dest_fb_dma_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_WRITE, &err);
+	if (dest_pixels == NULL)
+	{
+		IMX_VPU_API_ERROR("mapping output frame to virtual address space failed: %s (%d)", strerror(err), err);
+		return FALSE;
+	}
+
+	imx_dma_buffer_start_sync_session(frame_entry->fb_dma_buffer);
+
+	ret = imx_vpu_api_detile_frame(
+		decoder->fb_pool_tiled_color_format,
+		frame_entry->fb_virtual_address, &tiled_fb_metrics,
+		decoder->stream_info.color_format,
+		dest_pixels, &(decoder->fb_pool_framebuffer_metrics),
+		0, 0, 0, 0
+	);
+
+	imx_dma_buffer_stop_sync_session(frame_entry->fb_dma_buffer);
+
+	imx_dma_buffer_unmap(dest_fb_dma_buffer);
+
+	return ret;
 }
 
 
@@ -1056,7 +1504,9 @@ static RetCode imx_vpu_api_dec_get_initial_info(ImxVpuApiDecoder *decoder)
 	}
 
 	/* The actual retrieval */
+	begin_vpu_operation();
 	dec_ret = vpu_DecGetInitialInfo(decoder->handle, &(decoder->initial_info));
+	end_vpu_operation();
 
 	/* As recommended in section 4.3.2.2, clear the force
 	 * escape flag immediately after retrieval is finished */
@@ -1120,6 +1570,16 @@ static BOOL imx_vpu_api_dec_fill_stream_info_from_initial_info(ImxVpuApiDecoder
 	 * them if we are decoding JPEG data. */
 	min_num_required_framebuffers = initial_info->minFrameBufferCount + ((decoder->open_params.compression_format == IMX_VPU_API_COMPRESSION_FORMAT_JPEG) ? 0 : NUM_EXTRA_FRAMEBUFFERS_REQUIRED);
 
+	/* Framebuffers of frames that are still being detiled
+	 * cannot be used by the VPU, so add more to make up for them. */
+	if (decoder->detiling_queue != NULL)
+		min_num_required_framebuffers += MAX_NUM_PENDING_DETILING_TASKS;
+
+	/* The same is true for the framebuffer of the previous frame
+	 * when motion adaptive deinterlacing is used. */
+	if (decoder->deinterlacing_enabled && (decoder->open_params.deinterlacing_mode == IMX_VPU_API_DEC_DEINTERLACING_MODE_MOTION_ADAPTIVE))
+		min_num_required_framebuffers += 1;
+
 	ret = imx_vpu_api_dec_fill_stream_info(
 		decoder,
 		frame_width, frame_height,
@@ -1146,6 +1606,9 @@ static BOOL imx_vpu_api_dec_fill_stream_info_from_initial_info(ImxVpuApiDecoder
 		}
 	}
 
+	if (decoder->post_processing_enabled && !imx_vpu_api_dec_apply_post_processing_to_stream_info(decoder))
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -1159,7 +1622,8 @@ static BOOL imx_vpu_api_dec_fill_stream_info(ImxVpuApiDecoder *decoder, size_t a
 
 	BOOL semi_planar = decoder_uses_semi_planar_color_format(&(decoder->open_params));
 	ImxVpuApiDecStreamInfo *stream_info = &(decoder->stream_info);
-	ImxVpuApiFramebufferMetrics *fb_metrics = &(stream_info->decoded_frame_framebuffer_metrics);
+	ImxVpuApiFramebufferMetrics *fb_metrics = &(decoder->fb_pool_framebuffer_metrics);
+	ImxVpuApiImx6CodaIpuDetilingParams *detiling_params = &(decoder->detiling_params);
 
 	assert(decoder->initial_info_available);
 
@@ -1233,10 +1697,18 @@ static BOOL imx_vpu_api_dec_fill_stream_info(ImxVpuApiDecoder *decoder, size_t a
 	decoder->mvcol_offset = semi_planar ? fb_metrics->u_offset : fb_metrics->v_offset;
 	decoder->mvcol_offset = IMX_VPU_API_ALIGN_VAL_TO(decoder->mvcol_offset + fb_metrics->uv_size, 8);
 
-	decoder->total_padded_input_width = fb_metrics->y_stride / bytes_per_y_pixel;
-	decoder->total_padded_input_height = (color_format == IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT) ? fb_metrics->aligned_frame_height : ((fb_metrics->u_offset - fb_metrics->y_offset) / fb_metrics->y_stride);
-	decoder->total_padded_output_width = fb_metrics->y_stride / bytes_per_y_pixel;
-	decoder->total_padded_output_height = (color_format == IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT) ? fb_metrics->aligned_frame_height : ((decoder->u_offset - decoder->y_offset) / fb_metrics->y_stride);
+	/* By default, the IPU detiles entire frames, including the padding,
+	 * and does not scale, rotate, or color-convert them. */
+	memset(detiling_params, 0, sizeof(ImxVpuApiImx6CodaIpuDetilingParams));
+	detiling_params->total_padded_input_width = fb_metrics->y_stride / bytes_per_y_pixel;
+	detiling_params->total_padded_input_height = (color_format == IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT) ? fb_metrics->aligned_frame_height : ((fb_metrics->u_offset - fb_metrics->y_offset) / fb_metrics->y_stride);
+	detiling_params->total_padded_output_width = fb_metrics->y_stride / bytes_per_y_pixel;
+	detiling_params->total_padded_output_height = (color_format == IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT) ? fb_metrics->aligned_frame_height : ((decoder->u_offset - decoder->y_offset) / fb_metrics->y_stride);
+	detiling_params->input_crop_width = detiling_params->total_padded_input_width;
+	detiling_params->input_crop_height = detiling_params->total_padded_input_height;
+	detiling_params->output_frame_width = detiling_params->total_padded_output_width;
+	detiling_params->output_frame_height = detiling_params->total_padded_output_height;
+	detiling_params->orientation = IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_NORMAL;
 
 	/* Compute the minimum size for FB pool framebuffers and for
 	 * output framebuffes. The two important difference between the
@@ -1262,7 +1734,7 @@ static BOOL imx_vpu_api_dec_fill_stream_info(ImxVpuApiDecoder *decoder, size_t a
 	stream_info->flags = 0;
 	if (semi_planar)
 		stream_info->flags = IMX_VPU_API_DEC_STREAM_INFO_FLAG_SEMI_PLANAR_FRAMES;
-	if (interlaced)
+	if (interlaced && !(decoder->deinterlacing_enabled))
 		stream_info->flags |= IMX_VPU_API_DEC_STREAM_INFO_FLAG_INTERLACED;
 
 	/* Get the YUV color format. For any format other than JPEG,
@@ -1297,6 +1769,9 @@ static BOOL imx_vpu_api_dec_fill_stream_info(ImxVpuApiDecoder *decoder, size_t a
 			assert(FALSE);
 	}
 
+	detiling_params->output_color_format = stream_info->color_format;
+	stream_info->decoded_frame_framebuffer_metrics = *fb_metrics;
+
 	/* Make sure that at least one framebuffer is allocated and registered. */
 	if (stream_info->min_num_required_framebuffers < 1)
 		stream_info->min_num_required_framebuffers = 1;
@@ -1305,6 +1780,184 @@ static BOOL imx_vpu_api_dec_fill_stream_info(ImxVpuApiDecoder *decoder, size_t a
 }
 
 
+/* Color formats the IPU can produce when post-processing is enabled, along
+ * with the number of bytes per pixel in the first plane of such frames.
+ * This is the only place where the supported output formats are listed. */
+static struct
+{
+	ImxVpuApiColorFormat color_format;
+	size_t bytes_per_pixel;
+}
+const post_processing_output_formats[] =
+{
+	{ IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT, 1 },
+	{ IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT, 1 },
+	{ IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_UYVY_8BIT, 2 },
+	{ IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_YUYV_8BIT, 2 },
+	{ IMX_VPU_API_COLOR_FORMAT_RGB565, 2 },
+	{ IMX_VPU_API_COLOR_FORMAT_RGBA8888, 4 },
+	{ IMX_VPU_API_COLOR_FORMAT_BGRA8888, 4 }
+};
+
+
+/* Returns the number of bytes per pixel in the first plane of frames with
+ * the given color format, or 0 if the IPU cannot produce this format when
+ * post-processing is enabled. */
+static size_t get_post_processing_bytes_per_pixel(ImxVpuApiColorFormat color_format)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(post_processing_output_formats) / sizeof(post_processing_output_formats[0]); ++i)
+	{
+		if (post_processing_output_formats[i].color_format == color_format)
+			return post_processing_output_formats[i].bytes_per_pixel;
+	}
+
+	return 0;
+}
+
+
+/* Adjusts the stream info and the detiling parameters so that the
+ * IPU crops, scales, rotates, and color-converts the decoded frames
+ * as specified by the post-processing open params. The stream info
+ * then describes the post-processed frames. */
+static BOOL imx_vpu_api_dec_apply_post_processing_to_stream_info(ImxVpuApiDecoder *decoder)
+{
+	ImxVpuApiDecPostProcessingParams const *params = &(decoder->open_params.post_processing);
+	ImxVpuApiDecStreamInfo *stream_info = &(decoder->stream_info);
+	ImxVpuApiFramebufferMetrics const *fb_pool_metrics = &(decoder->fb_pool_framebuffer_metrics);
+	ImxVpuApiFramebufferMetrics *fb_metrics = &(stream_info->decoded_frame_framebuffer_metrics);
+	ImxVpuApiImx6CodaIpuDetilingParams *detiling_params = &(decoder->detiling_params);
+	ImxVpuApiColorFormat color_format = params->output_color_format;
+	BOOL rotated_by_90_degrees;
+	size_t bytes_per_pixel;
+	size_t crop_left, crop_top, crop_right, crop_bottom;
+	size_t output_width, output_height;
+
+	bytes_per_pixel = get_post_processing_bytes_per_pixel(color_format);
+	assert(bytes_per_pixel != 0);
+
+	rotated_by_90_degrees = (params->orientation == IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_90) || (params->orientation == IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_270);
+
+	/* Use the stream's crop rectangle unless the
+	 * post-processing params specify a different one. */
+	if ((params->crop_width != 0) && (params->crop_height != 0))
+	{
+		crop_left = params->crop_left;
+		crop_top = params->crop_top;
+		crop_right = crop_left + params->crop_width;
+		crop_bottom = crop_top + params->crop_height;
+	}
+	else
+	{
+		crop_left = stream_info->crop_left;
+		crop_top = stream_info->crop_top;
+		crop_right = crop_left + stream_info->crop_width;
+		crop_bottom = crop_top + stream_info->crop_height;
+	}
+
+	if (crop_right > fb_pool_metrics->actual_frame_width)
+		crop_right = fb_pool_metrics->actual_frame_width;
+	if (crop_bottom > fb_pool_metrics->actual_frame_height)
+		crop_bottom = fb_pool_metrics->actual_frame_height;
+	if ((crop_left >= crop_right) || (crop_top >= crop_bottom))
+	{
+		IMX_VPU_API_ERROR("post-processing crop rectangle lies outside of the %zux%zu frame", fb_pool_metrics->actual_frame_width, fb_pool_metrics->actual_frame_height);
+		return FALSE;
+	}
+
+	/* The VDOA can only read whole macroblocks. The framebuffers
+	 * are padded to multiples of 32 rows and 128 columns, so
+	 * expanding the rectangle stays within the framebuffer. */
+	crop_left = (crop_left / 16) * 16;
+	crop_top = (crop_top / 16) * 16;
+	crop_right = IMX_VPU_API_ALIGN_VAL_TO(crop_right, 16);
+	crop_bottom = IMX_VPU_API_ALIGN_VAL_TO(crop_bottom, 16);
+
+	detiling_params->input_crop_left = crop_left;
+	detiling_params->input_crop_top = crop_top;
+	detiling_params->input_crop_width = crop_right - crop_left;
+	detiling_params->input_crop_height = crop_bottom - crop_top;
+
+	if ((params->output_width != 0) && (params->output_height != 0))
+	{
+		output_width = params->output_width;
+		output_height = params->output_height;
+	}
+	else
+	{
+		output_width = rotated_by_90_degrees ? detiling_params->input_crop_height : detiling_params->input_crop_width;
+		output_height = rotated_by_90_degrees ? detiling_params->input_crop_width : detiling_params->input_crop_height;
+	}
+
+	/* The IPU's rotation unit works with 8x8 pixel blocks, and the
+	 * IC's output sizes must be multiples of 8 as well. */
+	output_width = (output_width < 8) ? 8 : ((output_width / 8) * 8);
+	output_height = (output_height < 8) ? 8 : ((output_height / 8) * 8);
+
+	fb_metrics->actual_frame_width = output_width;
+	fb_metrics->actual_frame_height = output_height;
+	fb_metrics->aligned_frame_width = IMX_VPU_API_ALIGN_VAL_TO(output_width, 16);
+	fb_metrics->aligned_frame_height = IMX_VPU_API_ALIGN_VAL_TO(output_height, 16);
+	fb_metrics->y_stride = fb_metrics->aligned_frame_width * bytes_per_pixel;
+	fb_metrics->y_size = fb_metrics->y_stride * fb_metrics->aligned_frame_height;
+
+	switch (color_format)
+	{
+		case IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT:
+			fb_metrics->uv_stride = fb_metrics->y_stride / 2;
+			fb_metrics->uv_size = fb_metrics->y_size / 4;
+			break;
+
+		case IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT:
+			fb_metrics->uv_stride = fb_metrics->y_stride;
+			fb_metrics->uv_size = fb_metrics->y_size / 2;
+			break;
+
+		default:
+			/* Packed YUV and RGB formats only have one plane. */
+			fb_metrics->uv_stride = 0;
+			fb_metrics->uv_size = 0;
+	}
+
+	fb_metrics->y_offset = 0;
+	fb_metrics->u_offset = fb_metrics->y_size;
+	fb_metrics->v_offset = fb_metrics->u_offset + fb_metrics->uv_size;
+
+	stream_info->min_output_framebuffer_size = ((color_format == IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT) ? fb_metrics->v_offset : fb_metrics->u_offset) + fb_metrics->uv_size;
+	stream_info->color_format = color_format;
+
+	stream_info->flags &= ~IMX_VPU_API_DEC_STREAM_INFO_FLAG_SEMI_PLANAR_FRAMES;
+	if (color_format == IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT)
+		stream_info->flags |= IMX_VPU_API_DEC_STREAM_INFO_FLAG_SEMI_PLANAR_FRAMES;
+
+	/* The frames are already cropped. */
+	stream_info->has_crop_rectangle = FALSE;
+	stream_info->crop_left = 0;
+	stream_info->crop_top = 0;
+	stream_info->crop_width = output_width;
+	stream_info->crop_height = output_height;
+
+	detiling_params->total_padded_output_width = fb_metrics->aligned_frame_width;
+	detiling_params->total_padded_output_height = fb_metrics->aligned_frame_height;
+	detiling_params->output_frame_width = output_width;
+	detiling_params->output_frame_height = output_height;
+	detiling_params->output_color_format = color_format;
+	detiling_params->orientation = params->orientation;
+
+	IMX_VPU_API_DEBUG(
+		"post-processing:  input crop rectangle: left %zu top %zu width %zu height %zu  output width/height: %zu/%zu  output color format: %s  orientation: %d",
+		detiling_params->input_crop_left, detiling_params->input_crop_top,
+		detiling_params->input_crop_width, detiling_params->input_crop_height,
+		output_width, output_height,
+		imx_vpu_api_color_format_string(color_format),
+		(int)(params->orientation)
+	);
+
+	return TRUE;
+}
+
+
 static ImxVpuApiCompressionFormat const dec_supported_compression_formats[] =
 {
 	IMX_VPU_API_COMPRESSION_FORMAT_MPEG2,
@@ -1318,7 +1971,7 @@ static ImxVpuApiCompressionFormat const dec_supported_compression_formats[] =
 };
 
 static ImxVpuApiDecGlobalInfo const dec_global_info = {
-	.flags = IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_HAS_DECODER | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SEMI_PLANAR_FRAMES_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_FULLY_PLANAR_FRAMES_SUPPORTED,
+	.flags = IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_HAS_DECODER | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SEMI_PLANAR_FRAMES_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_FULLY_PLANAR_FRAMES_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SKIP_MODES_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ASYNC_OUTPUT_FRAME_COPY_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DEINTERLACING_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_POST_PROCESSING_SUPPORTED,
 	.hardware_type = IMX_VPU_API_HARDWARE_TYPE_CODA960,
 	.min_required_stream_buffer_size = VPU_DEC_MIN_REQUIRED_BITSTREAM_BUFFER_SIZE,
 	.required_stream_buffer_physaddr_alignment = BITSTREAM_BUFFER_PHYSADDR_ALIGNMENT,
@@ -1449,6 +2102,53 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 	}
 
 
+	/* Byte stream input is not supported, since this decoder can
+	 * only work with complete frames. */
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT)
+	{
+		IMX_VPU_API_ERROR("byte stream input is not supported");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LENGTH_PREFIXED_NAL_INPUT)
+	{
+		IMX_VPU_API_ERROR("length-prefixed NAL input is not supported");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+
+	/* Post-processing is done by the IPU while detiling frames.
+	 * JPEG frames are not detiled, so they are not post-processed. */
+	if ((open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING) && (open_params->compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG))
+	{
+		if (get_post_processing_bytes_per_pixel(open_params->post_processing.output_color_format) == 0)
+		{
+			IMX_VPU_API_ERROR("post-processing cannot produce color format %s", imx_vpu_api_color_format_string(open_params->post_processing.output_color_format));
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+		}
+
+		if (open_params->post_processing.orientation > IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_FLIP_VERTICAL)
+		{
+			IMX_VPU_API_ERROR("invalid post-processing orientation %d", (int)(open_params->post_processing.orientation));
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+		}
+	}
+
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE)
+	{
+		switch (open_params->deinterlacing_mode)
+		{
+			case IMX_VPU_API_DEC_DEINTERLACING_MODE_MOTION_ADAPTIVE:
+			case IMX_VPU_API_DEC_DEINTERLACING_MODE_BOB:
+				break;
+
+			default:
+				IMX_VPU_API_ERROR("invalid deinterlacing mode %d", (int)(open_params->deinterlacing_mode));
+				return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+		}
+	}
+
+
 	/* Verify extra header data */
 	switch (open_params->compression_format)
 	{
@@ -1502,11 +2202,35 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 
 	/* Open the IPU VDOA FD. We'll need this in 
 	 * imx_vpu_api_dec_get_decoded_frame() to detile
-	 * and copy the decoded frames. */
-	if (((*decoder)->ipu_vdoa_fd = imx_vpu_api_imx6_coda_open_ipu_voda_fd()) < 0)
+	 * and copy the decoded frames. If the IPU is not
+	 * available, the CPU detiles frames instead, unless
+	 * deinterlacing or post-processing is requested,
+	 * since only the IPU can do these. */
+	(*decoder)->ipu_vdoa_fd = imx_vpu_api_imx6_coda_open_ipu_voda_fd();
+	if (((*decoder)->ipu_vdoa_fd < 0) && (open_params->compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG))
 	{
-		ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
-		goto cleanup;
+		if (open_params->flags & (IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE | IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING))
+		{
+			IMX_VPU_API_ERROR("deinterlacing and post-processing require the IPU");
+			ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+			goto cleanup;
+		}
+
+		IMX_VPU_API_WARNING("IPU VDOA is not available; detiling decoded frames with the CPU");
+	}
+
+
+	/* Set up background detiling if requested. JPEG frames are
+	 * not detiled by the IPU, so there is no need for it then.
+	 * Without the IPU, the CPU detiles frames synchronously. */
+	if ((open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ASYNC_OUTPUT_FRAME_COPY) && (open_params->compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG) && ((*decoder)->ipu_vdoa_fd >= 0))
+	{
+		(*decoder)->detiling_queue = imx_vpu_api_imx6_coda_ipu_detiling_queue_create((*decoder)->ipu_vdoa_fd, MAX_NUM_PENDING_DETILING_TASKS);
+		if ((*decoder)->detiling_queue == NULL)
+		{
+			ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+			goto cleanup;
+		}
 	}
 
 
@@ -1533,6 +2257,16 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 	/* Make a copy of the open_params for later use. */
 	(*decoder)->open_params = *open_params;
 
+	(*decoder)->completion_timeout = (open_params->completion_timeout != 0) ? open_params->completion_timeout : VPU_DEFAULT_COMPLETION_TIMEOUT;
+
+	/* Deinterlacing is done by the IPU while detiling frames.
+	 * JPEG frames are not detiled, so they are not deinterlaced. */
+	(*decoder)->deinterlacing_enabled = (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_DEINTERLACE) && (open_params->compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG);
+	(*decoder)->deinterlacing_reference_fb_index = -1;
+	(*decoder)->post_processing_enabled = (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING) && (open_params->compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG);
+	if ((*decoder)->deinterlacing_enabled)
+		IMX_VPU_API_DEBUG("deinterlacing enabled; mode: %s", (open_params->deinterlacing_mode == IMX_VPU_API_DEC_DEINTERLACING_MODE_BOB) ? "bob" : "motion adaptive");
+
 
 	/* Fill in values into the VPU's decoder open param structure */
 	memset(&dec_open_param, 0, sizeof(dec_open_param));
@@ -1591,12 +2325,19 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 	 * since the VPU decodes it differently - it decodes JPEGs to the
 	 * framebuffer the JPEG rotator is set to. */
 	dec_open_param.mapType = (open_params->compression_format == IMX_VPU_API_COMPRESSION_FORMAT_JPEG) ? 0 : 1;
+	(*decoder)->fb_pool_tiled_color_format = IMX_VPU_API_CODA_COLOR_FORMAT_YUV420_SEMI_PLANAR_FRAME_TILED_8BIT;
 	 /* If this is not 0, the VPU may hang eventually (it is 0 in the NXP
 	  * wrapper except for MX6X). Since we anyway don't want linear data,
 	  * we keep it at 0. */
 	dec_open_param.tiled2LinearEnable = 0;
 	dec_open_param.bitstreamMode = 1;
-	dec_open_param.reorderEnable = !!(open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_FRAME_REORDERING);
+	/* In low latency mode, reordering is always disabled, since it
+	 * causes the VPU to hold back decoded frames. Each frame is then
+	 * displayable as soon as it is decoded. */
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LOW_LATENCY)
+		dec_open_param.reorderEnable = 0;
+	else
+		dec_open_param.reorderEnable = !!(open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_FRAME_REORDERING);
 
 	/* Motion-JPEG specific settings
 	 * With motion JPEG, the VPU is configured to operate in line buffer mode,
@@ -1639,6 +2380,8 @@ finish:
 cleanup:
 	if ((*decoder) != NULL)
 	{
+		imx_vpu_api_imx6_coda_ipu_detiling_queue_destroy((*decoder)->detiling_queue);
+
 		if ((*decoder)->ipu_vdoa_fd >= 0)
 		{
 			imx_vpu_api_imx6_coda_close_ipu_voda_fd((*decoder)->ipu_vdoa_fd);
@@ -1663,6 +2406,10 @@ void imx_vpu_api_dec_close(ImxVpuApiDecoder *decoder)
 
 	IMX_VPU_API_DEBUG("closing decoder");
 
+	/* This waits for any decoding step that is still in progress,
+	 * so it must be done before anything else is torn down. */
+	imx_vpu_api_dec_async_cleanup(&(decoder->async_state));
+
 
 	/* Flush the VPU bit buffer if we registered framebuffers earlier.
 	 * Calling vpu_DecBitBufferFlush() without registered framebuffers
@@ -1691,6 +2438,12 @@ void imx_vpu_api_dec_close(ImxVpuApiDecoder *decoder)
 	imx_coda_vpu_unload();
 
 
+	/* This waits for frames that are still being detiled.
+	 * Their framebuffers are not needed anymore, since the
+	 * VPU decoder is already closed at this point. */
+	imx_vpu_api_imx6_coda_ipu_detiling_queue_destroy(decoder->detiling_queue);
+
+
 	/* Close the IPU VDOA FD. */
 	if (decoder->ipu_vdoa_fd >= 0)
 	{
@@ -1729,7 +2482,7 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_add_framebuffers_to_pool(ImxVpuApiDecode
 	assert(fb_dma_buffers != NULL);
 	assert(num_framebuffers >= 1);
 
-	fb_metrics = &(decoder->stream_info.decoded_frame_framebuffer_metrics);
+	fb_metrics = &(decoder->fb_pool_framebuffer_metrics);
 
 	/* This function is only supposed to be called after new
 	 * stream info was announced, which happens exactly once
@@ -1756,6 +2509,7 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_add_framebuffers_to_pool(ImxVpuApiDecode
 
 	decoder->frame_entries = malloc(sizeof(DecFrameEntry) * num_framebuffers);
 	assert(decoder->frame_entries != NULL);
+	memset(decoder->frame_entries, 0, sizeof(DecFrameEntry) * num_framebuffers);
 
 	decoder->num_framebuffers = num_framebuffers;
 
@@ -1855,6 +2609,36 @@ cleanup:
 }
 
 
+size_t imx_vpu_api_dec_get_num_framebuffers_to_be_added(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return decoder->num_framebuffers_to_be_added;
+}
+
+
+int imx_vpu_api_dec_is_framebuffer_in_pool(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
+{
+	size_t i;
+
+	assert(decoder != NULL);
+	assert(fb_dma_buffer != NULL);
+
+	/* The CODA VPU cannot keep framebuffers across stream changes, since
+	 * framebuffers can only be registered once. Any change thus frees the
+	 * frame entries, so this only finds framebuffers of the current pool. */
+	if (decoder->frame_entries == NULL)
+		return 0;
+
+	for (i = 0; i < decoder->num_framebuffers; ++i)
+	{
+		if (decoder->frame_entries[i].fb_dma_buffer == fb_dma_buffer)
+			return 1;
+	}
+
+	return 0;
+}
+
+
 void imx_vpu_api_dec_enable_drain_mode(ImxVpuApiDecoder *decoder)
 {
 	assert(decoder != NULL);
@@ -1897,6 +2681,12 @@ void imx_vpu_api_dec_flush(ImxVpuApiDecoder *decoder)
 	}
 
 
+	/* Wait for frames that are still being detiled. Then the
+	 * previous frame is no longer needed for deinterlacing. */
+	imx_vpu_api_dec_retire_detiling_tasks(decoder, NULL, TRUE);
+	imx_vpu_api_dec_release_deinterlacing_reference(decoder);
+
+
 	/* No need to flush anything with WMV3 data. */
 	if (decoder->open_params.compression_format == IMX_VPU_API_COMPRESSION_FORMAT_WMV3)
 	{
@@ -1945,6 +2735,47 @@ void imx_vpu_api_dec_flush(ImxVpuApiDecoder *decoder)
 }
 
 
+unsigned int imx_vpu_api_dec_get_num_hardware_resets(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return decoder->num_hardware_resets;
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_set_skip_mode(ImxVpuApiDecoder *decoder, ImxVpuApiDecSkipMode skip_mode)
+{
+	assert(decoder != NULL);
+
+	/* The skip mode is mapped to the VPU's own skip frame modes
+	 * in imx_vpu_api_dec_decode(), so reject anything else. */
+	switch (skip_mode)
+	{
+		case IMX_VPU_API_DEC_SKIP_MODE_NONE:
+		case IMX_VPU_API_DEC_SKIP_MODE_NON_REFERENCE_FRAMES:
+		case IMX_VPU_API_DEC_SKIP_MODE_NON_INTRA_FRAMES:
+			break;
+
+		default:
+			IMX_VPU_API_ERROR("invalid skip mode %d", (int)skip_mode);
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+	IMX_VPU_API_DEBUG("setting skip mode to %d", (int)skip_mode);
+	decoder->skip_mode = skip_mode;
+
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+}
+
+
+void imx_vpu_api_dec_set_frame_discarding(ImxVpuApiDecoder *decoder, int discard_frames)
+{
+	assert(decoder != NULL);
+
+	IMX_VPU_API_DEBUG("%s frame discarding", discard_frames ? "enabling" : "disabling");
+	decoder->discard_frames = !!discard_frames;
+}
+
+
 ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame)
 {
 	if (decoder->drain_mode_enabled)
@@ -1982,6 +2813,8 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_frame(ImxVpuApiDecoder *dec
 	 * indexFrameDecoded field will tell us). */
 	decoder->staged_encoded_frame = *encoded_frame;
 	decoder->staged_encoded_frame_set = TRUE;
+	decoder->staged_encoded_frame_discard = decoder->discard_frames;
+	decoder->staged_encoded_frame_push_time = imx_vpu_api_get_monotonic_time();
 
 	decoder->encoded_data_got_pushed = TRUE;
 
@@ -1991,6 +2824,14 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_frame(ImxVpuApiDecoder *dec
 }
 
 
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_dma_buffer(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame, ImxDmaBuffer *encoded_dma_buffer, size_t offset, ImxVpuApiDecEncodedDmaBufferReleaseCallback release_callback, void *release_callback_user_data)
+{
+	/* The CODA960 reads encoded data from the stream buffer only,
+	 * so the data always needs to be copied into it. */
+	return imx_vpu_api_dec_push_encoded_dma_buffer_by_copy(decoder, encoded_frame, encoded_dma_buffer, offset, release_callback, release_callback_user_data);
+}
+
+
 void imx_vpu_api_dec_set_output_frame_dma_buffer(ImxVpuApiDecoder *decoder, ImxDmaBuffer *output_frame_dma_buffer, void *fb_context)
 {
 	assert(decoder != NULL);
@@ -2020,6 +2861,11 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 	*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NO_OUTPUT_YET_AVAILABLE;
 
 
+	/* Return the framebuffers of frames that finished
+	 * detiling in the meantime back to the VPU. */
+	imx_vpu_api_dec_retire_detiling_tasks(decoder, NULL, FALSE);
+
+
 	if (decoder->drain_mode_enabled)
 	{
 		/* Drain mode is enabled. Make sure the VPU is informed. */
@@ -2108,7 +2954,13 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 
 			case RETCODE_FAILURE_TIMEOUT:
 				IMX_VPU_API_ERROR("VPU reported timeout while retrieving initial info");
-				return IMX_VPU_API_DEC_RETURN_CODE_TIMEOUT;
+				imx_vpu_api_dec_reset_after_timeout(decoder);
+				/* Retry once new data is pushed. The main header has
+				 * to be pushed again, since the data that contained
+				 * it is discarded, as far as the VPU is concerned. */
+				decoder->encoded_data_got_pushed = FALSE;
+				decoder->main_header_pushed = FALSE;
+				return IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET;
 
 			case RETCODE_WRONG_CALL_SEQUENCE:
 			case RETCODE_CALLED_BEFORE:
@@ -2179,7 +3031,23 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			vpu_DecGiveCommand(decoder->handle, SET_ROTATOR_OUTPUT, (void *)(&(decoder->output_framebuffer)));
 		}
 
-		/* XXX: currently, iframe search and skip frame modes are not supported */
+		/* The VPU's I frame search mode is not used here, since it only
+		 * skips frames until the next I frame is found, and is meant for
+		 * resuming after a seek. Skip modes on the other hand stay active. */
+		if (decoder->open_params.compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG)
+		{
+			switch (decoder->skip_mode)
+			{
+				case IMX_VPU_API_DEC_SKIP_MODE_NON_REFERENCE_FRAMES:
+					params.skipframeMode = 2; /* skip non-reference frames */
+					break;
+				case IMX_VPU_API_DEC_SKIP_MODE_NON_INTRA_FRAMES:
+					params.skipframeMode = 1; /* skip all frames except I / IDR frames */
+					break;
+				default:
+					break;
+			}
+		}
 
 
 		/* Start frame decoding.
@@ -2188,6 +3056,7 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 		 * vpu_DecStartOneFrame() "locks out" most VPU calls until
 		 * vpu_DecGetOutputInfo() is called, so this must be called *always*
 		 * after vpu_DecStartOneFrame(), even if an error occurred. */
+		begin_vpu_operation();
 		dec_ret = vpu_DecStartOneFrame(decoder->handle, &params);
 
 		switch (dec_ret)
@@ -2198,6 +3067,7 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			case RETCODE_JPEG_BIT_EMPTY:
 				/* Special handling of the insufficient data case for JPEG. */
 				vpu_DecGetOutputInfo(decoder->handle, &(decoder->dec_output_info));
+				end_vpu_operation();
 				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_MORE_INPUT_DATA_NEEDED;
 				return IMX_VPU_API_DEC_RETURN_CODE_OK;
 
@@ -2212,32 +3082,14 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			default:
 				IMX_VPU_API_ERROR("vpu_DecStartOneFrame() error: %s", retcode_to_string(dec_ret));
 				vpu_DecGetOutputInfo(decoder->handle, &(decoder->dec_output_info));
+				end_vpu_operation();
 				return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
 		}
 
 
 		/* Wait for frame completion. */
-		{
-			int cnt;
-
-			IMX_VPU_API_LOG("waiting for decoding completion");
-
-			/* Wait a few times, since sometimes, it takes more than
-			 * one vpu_WaitForInt() call to cover the decoding interval. */
-			timeout = TRUE;
-			for (cnt = 0; cnt < VPU_MAX_TIMEOUT_COUNTS; ++cnt)
-			{
-				if (vpu_WaitForInt(VPU_WAIT_TIMEOUT) != RETCODE_SUCCESS)
-				{
-					IMX_VPU_API_INFO("timeout after waiting %d ms for frame completion", VPU_WAIT_TIMEOUT);
-				}
-				else
-				{
-					timeout = FALSE;
-					break;
-				}
-			}
-		}
+		IMX_VPU_API_LOG("waiting for decoding completion");
+		timeout = !wait_for_frame_completion(decoder->completion_timeout);
 
 
 		/* Retrieve information about the result of the decode process There may be no
@@ -2254,6 +3106,20 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 		 * vpu_DecGetOutputInfo() releases them. */
 
 		dec_ret = vpu_DecGetOutputInfo(decoder->handle, &(decoder->dec_output_info));
+		end_vpu_operation();
+
+
+		/* If a timeout occurred earlier, this is the correct time to reset
+		 * the decoder and return an error code, since vpu_DecGetOutputInfo()
+		 * has been called, unlocking the VPU decoder calls. (The output info
+		 * is of no use after a timeout, so its return value is ignored then.) */
+		if (timeout)
+		{
+			IMX_VPU_API_ERROR("VPU did not finish decoding within %u ms", decoder->completion_timeout);
+			imx_vpu_api_dec_reset_after_timeout(decoder);
+			return IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET;
+		}
+
 		if (dec_ret != RETCODE_SUCCESS)
 		{
 			IMX_VPU_API_ERROR("vpu_DecGetOutputInfo() error: %s", retcode_to_string(dec_ret));
@@ -2261,13 +3127,6 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 		}
 
 
-		/* If a timeout occurred earlier, this is the correct time to abort
-		 * decoding and return an error code, since vpu_DecGetOutputInfo()
-		 * has been called, unlocking the VPU decoder calls. */
-		if (timeout)
-			return IMX_VPU_API_DEC_RETURN_CODE_TIMEOUT;
-
-
 		/* Log some information about the decoded frame */
 		IMX_VPU_API_LOG(
 			"output info:  indexFrameDisplay %d  indexFrameDecoded %d  NumDecFrameBuf %d  picType %d  idrFlg %d  numOfErrMBs %d  hScaleFlag %d  vScaleFlag %d  notSufficientPsBuffer %d  notSufficientSliceBuffer %d  decodingSuccess %d  interlacedFrame %d  mp4PackedPBframe %d  h264Npf %d  pictureStructure %d  topFieldFirst %d  repeatFirstField %d  fieldSequence %d  decPicWidth %d  decPicHeight %d",
@@ -2372,7 +3231,12 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			decoder->skipped_frame_context = decoder->staged_encoded_frame.context;
 			decoder->skipped_frame_pts = decoder->staged_encoded_frame.pts;
 			decoder->skipped_frame_dts = decoder->staged_encoded_frame.dts;
-			decoder->skipped_frame_reason = skipped_frame_is_internal ? IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_INTERNAL_FRAME : IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_CORRUPTED_FRAME;
+			if (skipped_frame_is_internal)
+				decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_INTERNAL_FRAME;
+			else if (decoder->skip_mode != IMX_VPU_API_DEC_SKIP_MODE_NONE)
+				decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_SKIP_MODE;
+			else
+				decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_CORRUPTED_FRAME;
 			IMX_VPU_API_DEBUG("frame got skipped/dropped (context: %p pts %" PRIu64 " dts %" PRIu64 ")", decoder->skipped_frame_context, decoder->skipped_frame_pts, decoder->skipped_frame_dts);
 			*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
 			decoder->staged_encoded_frame_set = FALSE;
@@ -2399,6 +3263,8 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			decoder->frame_entries[idx_decoded].frame_context = decoder->staged_encoded_frame.context;
 			decoder->frame_entries[idx_decoded].pts = decoder->staged_encoded_frame.pts;
 			decoder->frame_entries[idx_decoded].dts = decoder->staged_encoded_frame.dts;
+			decoder->frame_entries[idx_decoded].discard = decoder->staged_encoded_frame_discard;
+			decoder->frame_entries[idx_decoded].push_time = decoder->staged_encoded_frame_push_time;
 			decoder->frame_entries[idx_decoded].mode = DecFrameEntryMode_ReservedForDecoding;
 			decoder->frame_entries[idx_decoded].interlacing_mode = convert_interlacing_mode(decoder->open_params.compression_format, &(decoder->dec_output_info));
 
@@ -2442,10 +3308,42 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 
 			IMX_VPU_API_LOG("decoded and displayable frame available (framebuffer display index: %d context: %p pts: %" PRIu64 " dts: %" PRIu64 ")", idx_display, entry->frame_context, entry->pts, entry->dts);
 
-			entry->mode = DecFrameEntryMode_ContainsDisplayableFrame;
+			if (entry->discard)
+			{
+				/* The frame is not wanted, so skip the detiling in
+				 * imx_vpu_api_dec_get_decoded_frame() and hand the
+				 * framebuffer back to the VPU immediately. */
+				decoder->skipped_frame_context = entry->frame_context;
+				decoder->skipped_frame_pts = entry->pts;
+				decoder->skipped_frame_dts = entry->dts;
+				decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_DISCARDED;
+
+				entry->frame_context = NULL;
+				entry->discard = FALSE;
+				entry->mode = DecFrameEntryMode_Free;
+
+				if (decoder->open_params.compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG)
+				{
+					dec_ret = vpu_DecClrDispFlag(decoder->handle, idx_display);
+					if (dec_ret != RETCODE_SUCCESS)
+					{
+						IMX_VPU_API_ERROR("vpu_DecClrDispFlag() error: %s", retcode_to_string(dec_ret));
+						return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+					}
+				}
 
-			decoder->available_decoded_frame_idx = idx_display;
-			*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_DECODED_FRAME_AVAILABLE;
+				decoder->num_used_framebuffers--;
+
+				IMX_VPU_API_LOG("discarding displayable frame (context: %p pts: %" PRIu64 " dts: %" PRIu64 ")", decoder->skipped_frame_context, decoder->skipped_frame_pts, decoder->skipped_frame_dts);
+				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
+			}
+			else
+			{
+				entry->mode = DecFrameEntryMode_ContainsDisplayableFrame;
+
+				decoder->available_decoded_frame_idx = idx_display;
+				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_DECODED_FRAME_AVAILABLE;
+			}
 		}
 		else if (decoder->dec_output_info.indexFrameDisplay == VPU_DECODER_DISPLAYIDX_ALL_FRAMES_DISPLAYED)
 		{
@@ -2464,10 +3362,44 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 }
 
 
+int imx_vpu_api_dec_get_event_fd(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return imx_vpu_api_dec_async_get_event_fd(&(decoder->async_state), decoder);
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_start_decode(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return imx_vpu_api_dec_async_start_decode(&(decoder->async_state), decoder);
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_finish_decode(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code)
+{
+	assert(decoder != NULL);
+	return imx_vpu_api_dec_async_finish_decode(&(decoder->async_state), output_code);
+}
+
+
+void imx_vpu_api_dec_set_scheduling_params(ImxVpuApiDecoder *decoder, int priority, unsigned int weight)
+{
+	assert(decoder != NULL);
+	imx_vpu_api_async_job_set_scheduling_params(&(decoder->async_state.job), priority, weight);
+}
+
+
 ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiRawFrame *decoded_frame)
 {
 	ImxVpuApiDecReturnCodes ret = IMX_VPU_API_DEC_RETURN_CODE_OK;
 	int idx;
+	int release_fb_index;
+	BOOL detiling_pending = FALSE;
+	BOOL deinterlace = FALSE;
+	ImxVpuApiInterlacingMode interlacing_mode;
+	ImxDmaBuffer *prev_fb_dma_buffer = NULL;
+	ImxVpuApiImx6CodaIpuDetilingParams detiling_params;
 
 	assert(decoder != NULL);
 	assert(decoded_frame != NULL);
@@ -2492,29 +3424,101 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *deco
 	idx = decoder->available_decoded_frame_idx;
 	assert(idx < (int)(decoder->num_framebuffers));
 
+	interlacing_mode = decoder->frame_entries[idx].interlacing_mode;
+	release_fb_index = idx;
+
+
+	/* Deinterlace the frame while detiling it if it is interlaced. With
+	 * motion adaptive deinterlacing, the framebuffer of this frame is kept
+	 * around for deinterlacing the next frame, and the framebuffer of
+	 * the previous frame is returned to the VPU instead. */
+	if (decoder->deinterlacing_enabled)
+	{
+		deinterlace = (interlacing_mode != IMX_VPU_API_INTERLACING_MODE_NO_INTERLACING) && (interlacing_mode != IMX_VPU_API_INTERLACING_MODE_UNKNOWN);
+
+		if (decoder->open_params.deinterlacing_mode == IMX_VPU_API_DEC_DEINTERLACING_MODE_MOTION_ADAPTIVE)
+		{
+			release_fb_index = decoder->deinterlacing_reference_fb_index;
+			if (release_fb_index >= 0)
+				prev_fb_dma_buffer = decoder->frame_entries[release_fb_index].fb_dma_buffer;
+		}
+	}
+
+
+	detiling_params = decoder->detiling_params;
+	detiling_params.deinterlace = deinterlace;
+	detiling_params.interlacing_mode = interlacing_mode;
+
 
 	/* Detile and copy the frame out of the framebuffer pool into the output
 	 * frame DMA buffer. For JPEG, this isn't necessary, since the JPEG
-	 * rotator is configured to do that already. */
-	if (decoder->open_params.compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG)
+	 * rotator is configured to do that already. With a detiling queue,
+	 * the IPU does this in the background, and the framebuffer is
+	 * returned to the VPU once it is done. */
+	if (decoder->detiling_queue != NULL)
 	{
-		ImxVpuApiFramebufferMetrics *fb_metrics = &(decoder->stream_info.decoded_frame_framebuffer_metrics);
+		PendingDetilingTask *task;
+
+		/* Make room in the queue if it is full. Since tasks are finished
+		 * in order, waiting for the oldest one is enough for that. */
+		imx_vpu_api_dec_retire_detiling_tasks(decoder, NULL, FALSE);
+		if (decoder->num_pending_detiling_tasks == MAX_NUM_PENDING_DETILING_TASKS)
+			imx_vpu_api_dec_retire_detiling_tasks(decoder, decoder->pending_detiling_tasks[decoder->first_pending_detiling_task_index].output_frame_dma_buffer, TRUE);
 
-		if (!imx_vpu_api_imx6_coda_detile_and_copy_frame_with_ipu_vdoa(
-			decoder->ipu_vdoa_fd,
+		if (!imx_vpu_api_imx6_coda_ipu_detiling_queue_push(
+			decoder->detiling_queue,
 			decoder->frame_entries[idx].fb_dma_buffer,
+			prev_fb_dma_buffer,
 			decoder->output_frame_dma_buffer,
-			decoder->total_padded_input_width, decoder->total_padded_input_height,
-			decoder->total_padded_output_width, decoder->total_padded_output_height,
-			fb_metrics->actual_frame_width, fb_metrics->actual_frame_height,
-			decoder->stream_info.color_format
+			&detiling_params
 		))
+		{
+			IMX_VPU_API_ERROR("could not queue detiling of decoded frame");
+			return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+		}
+
+		task = &(decoder->pending_detiling_tasks[(decoder->first_pending_detiling_task_index + decoder->num_pending_detiling_tasks) % MAX_NUM_PENDING_DETILING_TASKS]);
+		task->fb_index = release_fb_index;
+		task->output_frame_dma_buffer = decoder->output_frame_dma_buffer;
+		decoder->num_pending_detiling_tasks++;
+
+		/* The output frame is reused, so an
+		 * earlier failure is no longer relevant. */
+		imx_vpu_api_dec_remove_failed_detiling_output_frame(decoder, decoder->output_frame_dma_buffer);
+
+		detiling_pending = TRUE;
+	}
+	else if (decoder->open_params.compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG)
+	{
+		BOOL detiled = FALSE;
+
+		if (decoder->ipu_vdoa_fd >= 0)
+		{
+			detiled = imx_vpu_api_imx6_coda_detile_and_copy_frame_with_ipu_vdoa(
+				decoder->ipu_vdoa_fd,
+				decoder->frame_entries[idx].fb_dma_buffer,
+				prev_fb_dma_buffer,
+				decoder->output_frame_dma_buffer,
+				&detiling_params
+			);
+
+			if (!detiled && imx_vpu_api_dec_can_detile_with_cpu(decoder))
+				IMX_VPU_API_WARNING("IPU could not detile and copy decoded frame pixels; detiling with the CPU instead");
+		}
+
+		if (!detiled && imx_vpu_api_dec_can_detile_with_cpu(decoder))
+			detiled = imx_vpu_api_dec_detile_frame_with_cpu(decoder, &(decoder->frame_entries[idx]), decoder->output_frame_dma_buffer);
+
+		if (!detiled)
 		{
 			IMX_VPU_API_ERROR("could not detile and copy decoded frame pixels");
 			return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
 		}
 	}
 
+	if (release_fb_index != idx)
+		decoder->deinterlacing_reference_fb_index = idx;
+
 
 	decoded_frame->fb_dma_buffer = decoder->output_frame_dma_buffer;
 
@@ -2522,7 +3526,7 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *deco
 	decoded_frame->fb_context = decoder->output_frame_fb_context;
 	decoded_frame->frame_types[0] = decoder->frame_entries[idx].frame_types[0];
 	decoded_frame->frame_types[1] = decoder->frame_entries[idx].frame_types[1];
-	decoded_frame->interlacing_mode = decoder->frame_entries[idx].interlacing_mode;
+	decoded_frame->interlacing_mode = deinterlace ? IMX_VPU_API_INTERLACING_MODE_NO_INTERLACING : interlacing_mode;
 	decoded_frame->context = decoder->frame_entries[idx].frame_context;
 	decoded_frame->pts = decoder->frame_entries[idx].pts;
 	decoded_frame->dts = decoder->frame_entries[idx].dts;
@@ -2539,25 +3543,65 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *deco
 	decoder->frame_entries[idx].mode = DecFrameEntryMode_Free;
 
 
-	/* Mark it as displayed in the VPU. */
-	if (decoder->open_params.compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG)
+	/* Mark it as displayed in the VPU. If it is still being
+	 * detiled, this is done once the detiling is finished.
+	 * With motion adaptive deinterlacing, the framebuffer of
+	 * the previous frame is marked instead (if there is one). */
+	if (!detiling_pending && (release_fb_index >= 0))
 	{
-		RetCode dec_ret = vpu_DecClrDispFlag(decoder->handle, idx);
-		if (dec_ret != RETCODE_SUCCESS)
+		if (decoder->open_params.compression_format != IMX_VPU_API_COMPRESSION_FORMAT_JPEG)
 		{
-			IMX_VPU_API_ERROR("vpu_DecClrDispFlag() error: %s", retcode_to_string(dec_ret));
-			ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+			RetCode dec_ret = vpu_DecClrDispFlag(decoder->handle, release_fb_index);
+			if (dec_ret != RETCODE_SUCCESS)
+			{
+				IMX_VPU_API_ERROR("vpu_DecClrDispFlag() error: %s", retcode_to_string(dec_ret));
+				ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+			}
 		}
+
+		decoder->num_used_framebuffers--;
 	}
 
 
-	decoder->num_used_framebuffers--;
+	decoder->decoded_frame_latency = imx_vpu_api_get_monotonic_time() - decoder->frame_entries[idx].push_time;
+	IMX_VPU_API_LOG("decoded frame latency: %" PRIu64 " ns", decoder->decoded_frame_latency);
 
 
 	return ret;
 }
 
 
+uint64_t imx_vpu_api_dec_get_decoded_frame_latency(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return decoder->decoded_frame_latency;
+}
+
+
+int imx_vpu_api_dec_is_output_frame_ready(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
+{
+	assert(decoder != NULL);
+	assert(fb_dma_buffer != NULL);
+
+	imx_vpu_api_dec_retire_detiling_tasks(decoder, NULL, FALSE);
+	return !imx_vpu_api_dec_is_detiling_pending(decoder, fb_dma_buffer);
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_wait_for_output_frame(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
+{
+	assert(decoder != NULL);
+	assert(fb_dma_buffer != NULL);
+
+	imx_vpu_api_dec_retire_detiling_tasks(decoder, fb_dma_buffer, TRUE);
+
+	if (imx_vpu_api_dec_remove_failed_detiling_output_frame(decoder, fb_dma_buffer))
+		return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+}
+
+
 void imx_vpu_api_dec_return_framebuffer_to_decoder(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
 {
 	IMX_VPU_API_UNUSED_PARAM(decoder);
@@ -2671,6 +3715,14 @@ struct _ImxVpuApiEncoder
 
 	unsigned long frame_counter;
 	unsigned long interval_between_idr_frames;
+
+	/* How long to wait for the VPU to finish encoding a frame, in
+	 * milliseconds. Taken from the open_params, or set to
+	 * VPU_DEFAULT_COMPLETION_TIMEOUT if the open_params value is 0. */
+	unsigned int completion_timeout;
+
+	/* State for imx_vpu_api_enc_start_encode() / imx_vpu_api_enc_finish_encode(). */
+	ImxVpuApiEncAsyncState async_state;
 };
 
 #define IMX_VPU_API_ENC_GET_STREAM_VIRT_ADDR(IMXVPUAPIENC, STREAM_PHYS_ADDR) ((IMXVPUAPIENC)->stream_buffer_virtual_address + ((PhysicalAddress)(STREAM_PHYS_ADDR) - (PhysicalAddress)((IMXVPUAPIENC)->stream_buffer_physical_address)))
@@ -2933,6 +3985,7 @@ void imx_vpu_api_enc_set_default_open_params(ImxVpuApiCompressionFormat compress
 	open_params->closed_gop_interval = 0;
 	open_params->frame_rate_numerator = 25;
 	open_params->frame_rate_denominator = 1;
+	open_params->completion_timeout = 0;
 
 	switch (compression_format)
 	{
@@ -3006,6 +4059,7 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_open(ImxVpuApiEncoder **encoder, ImxVpuA
 	/* Set default encoder values. */
 	memset(*encoder, 0, sizeof(ImxVpuApiEncoder));
 	(*encoder)->first_frame = TRUE;
+	(*encoder)->completion_timeout = (open_params->completion_timeout != 0) ? open_params->completion_timeout : VPU_DEFAULT_COMPLETION_TIMEOUT;
 
 
 	/* Map the stream buffer. We need to keep it mapped always so we can
@@ -3450,6 +4504,10 @@ void imx_vpu_api_enc_close(ImxVpuApiEncoder *encoder)
 
 	IMX_VPU_API_DEBUG("closing encoder");
 
+	/* This waits for any encoding step that is still in progress,
+	 * so it must be done before anything else is torn down. */
+	imx_vpu_api_enc_async_cleanup(&(encoder->async_state));
+
 
 	/* Close the encoder handle */
 
@@ -3458,7 +4516,7 @@ void imx_vpu_api_enc_close(ImxVpuApiEncoder *encoder)
 	{
 		/* VPU refused to close, since a frame is partially encoded.
 		 * Force it to close by first resetting the handle and retry. */
-		vpu_SWReset(encoder->handle, 0);
+		reset_vpu(encoder->handle);
 		enc_ret = vpu_EncClose(encoder->handle);
 	}
 	if (enc_ret != RETCODE_SUCCESS)
@@ -3836,9 +4894,12 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_encode(ImxVpuApiEncoder *encoder, size_t
 	/* Initialize encoding parameters. */
 	memset(&enc_param, 0, sizeof(enc_param));
 	enc_param.sourceFrame = &source_framebuffer;
+	/* first_frame is also set after a reset, and the frame after
+	 * a reset must not refer to frames from before it. */
 	enc_param.forceIPicture = !!(encoder->staged_raw_frame.frame_types[0] & IMX_VPU_API_FRAME_TYPE_I) ||
 		                      !!(encoder->staged_raw_frame.frame_types[0] & IMX_VPU_API_FRAME_TYPE_IDR) ||
-		                      forced_idr_for_closed_gop;
+		                      forced_idr_for_closed_gop ||
+		                      encoder->first_frame;
 	enc_param.skipPicture = 0;
 	/* The quantization parameter is already used in the
 	 * set_jpeg_tables() call in imx_vpu_api_enc_open().
@@ -3849,9 +4910,11 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_encode(ImxVpuApiEncoder *encoder, size_t
 
 
 	/* Do the actual encoding. */
+	begin_vpu_operation();
 	enc_ret = vpu_EncStartOneFrame(encoder->handle, &enc_param);
 	if (enc_ret != RETCODE_SUCCESS)
 	{
+		end_vpu_operation();
 		IMX_VPU_API_ERROR("could not start encoding frame: %s (%d)", retcode_to_string(enc_ret), enc_ret);
 		ret = IMX_VPU_API_ENC_RETURN_CODE_ERROR;
 		goto finish;
@@ -3859,27 +4922,8 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_encode(ImxVpuApiEncoder *encoder, size_t
 
 
 	/* Wait for frame completion. */
-	{
-		int cnt;
-
-		IMX_VPU_API_LOG("waiting for encoding completion");
-
-		/* Wait a few times, since sometimes, it takes more than
-		 * one vpu_WaitForInt() call to cover the encoding interval. */
-		timeout = TRUE;
-		for (cnt = 0; cnt < VPU_MAX_TIMEOUT_COUNTS; ++cnt)
-		{
-			if (vpu_WaitForInt(VPU_WAIT_TIMEOUT) != RETCODE_SUCCESS)
-			{
-				IMX_VPU_API_INFO("timeout after waiting %d ms for frame completion", VPU_WAIT_TIMEOUT);
-			}
-			else
-			{
-				timeout = FALSE;
-				break;
-			}
-		}
-	}
+	IMX_VPU_API_LOG("waiting for encoding completion");
+	timeout = !wait_for_frame_completion(encoder->completion_timeout);
 
 
 	/* Retrieve information about the result of the encode process. Do so even if
@@ -3890,20 +4934,36 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_encode(ImxVpuApiEncoder *encoder, size_t
 
 	memset(&(encoder->enc_output_info), 0, sizeof(encoder->enc_output_info));
 	enc_ret = vpu_EncGetOutputInfo(encoder->handle, &(encoder->enc_output_info));
-	if (enc_ret != RETCODE_SUCCESS)
+	end_vpu_operation();
+
+
+	/* If a timeout occurred earlier, this is the correct time to reset
+	 * the encoder and return an error code, since vpu_EncGetOutputInfo()
+	 * has been called, unlocking the VPU encoder calls. (The output info
+	 * is of no use after a timeout, so its return value is ignored then.)
+	 * The registered framebuffers and the generated headers stay valid.
+	 * The next frame is encoded as an IDR frame with headers, just like
+	 * the first one, since the reference frames were lost. */
+	if (timeout)
 	{
-		IMX_VPU_API_ERROR("could not get output information: %s (%d)", retcode_to_string(enc_ret), enc_ret);
-		ret = IMX_VPU_API_ENC_RETURN_CODE_ERROR;
+		RetCode reset_ret;
+
+		IMX_VPU_API_ERROR("VPU did not finish encoding within %u ms; resetting encoder", encoder->completion_timeout);
+
+		reset_ret = reset_vpu(encoder->handle);
+		if (reset_ret != RETCODE_SUCCESS)
+			IMX_VPU_API_ERROR("vpu_SWReset() error: %s", retcode_to_string(reset_ret));
+
+		encoder->first_frame = TRUE;
+
+		ret = IMX_VPU_API_ENC_RETURN_CODE_HARDWARE_RESET;
 		goto finish;
 	}
 
-
-	/* If a timeout occurred earlier, this is the correct time to abort
-	 * encoding and return an error code, since vpu_EncGetOutputInfo()
-	 * has been called, unlocking the VPU encoder calls. */
-	if (timeout)
+	if (enc_ret != RETCODE_SUCCESS)
 	{
-		ret = IMX_VPU_API_ENC_RETURN_CODE_TIMEOUT;
+		IMX_VPU_API_ERROR("could not get output information: %s (%d)", retcode_to_string(enc_ret), enc_ret);
+		ret = IMX_VPU_API_ENC_RETURN_CODE_ERROR;
 		goto finish;
 	}
 
@@ -4041,6 +5101,34 @@ static BOOL write_header_data(ImxVpuApiEncoder *encoder, unsigned int header_dat
 }
 
 
+int imx_vpu_api_enc_get_event_fd(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_get_event_fd(&(encoder->async_state), encoder);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_start_encode(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_start_encode(&(encoder->async_state), encoder);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_finish_encode(ImxVpuApiEncoder *encoder, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_finish_encode(&(encoder->async_state), encoded_frame_size, output_code);
+}
+
+
+void imx_vpu_api_enc_set_scheduling_params(ImxVpuApiEncoder *encoder, int priority, unsigned int weight)
+{
+	assert(encoder != NULL);
+	imx_vpu_api_async_job_set_scheduling_params(&(encoder->async_state.job), priority, weight);
+}
+
+
 ImxVpuApiEncReturnCodes imx_vpu_api_enc_get_encoded_frame(ImxVpuApiEncoder *encoder, ImxVpuApiEncodedFrame *encoded_frame)
 {
 	return imx_vpu_api_enc_get_encoded_frame_ext(encoder, encoded_frame, NULL);
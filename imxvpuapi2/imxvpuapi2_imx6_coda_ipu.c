@@ -14,11 +14,14 @@
 #undef uint32_t
 #endif
 
+#include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include "imxvpuapi2_imx6_coda_ipu.h"
 
 
@@ -33,17 +36,36 @@ static uint32_t get_ipu_pixel_format(ImxVpuApiColorFormat color_format)
 		case IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_HORIZONTAL_8BIT: return IPU_PIX_FMT_NV16;
 		case IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV444_8BIT: return IPU_PIX_FMT_YUV444P;
 		case IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT: return IPU_PIX_FMT_GREY;
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_UYVY_8BIT: return IPU_PIX_FMT_UYVY;
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_YUYV_8BIT: return IPU_PIX_FMT_YUYV;
+		case IMX_VPU_API_COLOR_FORMAT_RGB565: return IPU_PIX_FMT_RGB565;
+		case IMX_VPU_API_COLOR_FORMAT_RGBA8888: return IPU_PIX_FMT_RGBA32;
+		case IMX_VPU_API_COLOR_FORMAT_BGRA8888: return IPU_PIX_FMT_BGRA32;
 		default: return 0;
 	}
 }
 
 
+static uint8_t get_ipu_rotation(ImxVpuApiDecPostProcessingOrientation orientation)
+{
+	switch (orientation)
+	{
+		case IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_90: return IPU_ROTATE_90_RIGHT;
+		case IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_180: return IPU_ROTATE_180;
+		case IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_ROTATE_270: return IPU_ROTATE_90_LEFT;
+		case IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_FLIP_HORIZONTAL: return IPU_ROTATE_HORIZ_FLIP;
+		case IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_FLIP_VERTICAL: return IPU_ROTATE_VERT_FLIP;
+		default: return IPU_ROTATE_NONE;
+	}
+}
+
+
 int imx_vpu_api_imx6_coda_open_ipu_voda_fd(void)
 {
 	int ipu_vdoa_fd = open("/dev/mxc_ipu", O_RDWR, 0);
 	if (ipu_vdoa_fd < 0)
 	{
-		IMX_VPU_API_ERROR("could not open /dev/mxc_ipu: %s (%d)", strerror(errno), errno);
+		IMX_VPU_API_WARNING("could not open /dev/mxc_ipu: %s (%d)", strerror(errno), errno);
 		return -1;
 	}
 
@@ -64,65 +86,110 @@ void imx_vpu_api_imx6_coda_close_ipu_voda_fd(int fd)
 }
 
 
-BOOL imx_vpu_api_imx6_coda_detile_and_copy_frame_with_ipu_vdoa(
-	int ipu_vdoa_fd,
+static BOOL fill_detiling_task(
+	struct ipu_task *task,
 	ImxDmaBuffer *src_fb_dma_buffer,
+	ImxDmaBuffer *prev_src_fb_dma_buffer,
 	ImxDmaBuffer *dest_fb_dma_buffer,
-	size_t total_padded_input_width, size_t total_padded_input_height,
-	size_t total_padded_output_width, size_t total_padded_output_height,
-	size_t actual_frame_width, size_t actual_frame_height,
-	ImxVpuApiColorFormat color_format
+	ImxVpuApiImx6CodaIpuDetilingParams const *params
 )
 {
-	int ioctl_ret;
-	struct ipu_task task = { 0 };
-
 	imx_physical_address_t src_paddr = imx_dma_buffer_get_physical_address(src_fb_dma_buffer);
 	imx_physical_address_t dest_paddr = imx_dma_buffer_get_physical_address(dest_fb_dma_buffer);
 
-	task.overlay_en = 0;
-	task.priority = IPU_TASK_PRIORITY_NORMAL;
-	task.task_id = IPU_TASK_ID_ANY;
-	task.timeout = 0;
+	task->overlay_en = 0;
+	task->priority = IPU_TASK_PRIORITY_NORMAL;
+	task->task_id = IPU_TASK_ID_ANY;
+	task->timeout = 0;
 
 	IMX_VPU_API_LOG(
-		"ipu task:  total padded input/output size %zux%zu / %zux%zu  actual size %zux%zu  src/dest paddr %" IMX_PHYSICAL_ADDRESS_FORMAT "/%" IMX_PHYSICAL_ADDRESS_FORMAT "  output color format: %s",
-		total_padded_input_width, total_padded_input_height,
-		total_padded_output_width, total_padded_output_height,
-		actual_frame_width, actual_frame_height,
+		"ipu task:  total padded input/output size %zux%zu / %zux%zu  input crop rectangle %zu/%zu/%zux%zu  output frame size %zux%zu  src/dest paddr %" IMX_PHYSICAL_ADDRESS_FORMAT "/%" IMX_PHYSICAL_ADDRESS_FORMAT "  output color format: %s  orientation: %d",
+		params->total_padded_input_width, params->total_padded_input_height,
+		params->total_padded_output_width, params->total_padded_output_height,
+		params->input_crop_left, params->input_crop_top, params->input_crop_width, params->input_crop_height,
+		params->output_frame_width, params->output_frame_height,
 		src_paddr, dest_paddr,
-		imx_vpu_api_color_format_string(color_format)
+		imx_vpu_api_color_format_string(params->output_color_format),
+		(int)(params->orientation)
 	);
 
-	task.input.width = total_padded_input_width;
-	task.input.height = total_padded_input_height;
-	task.input.format = IPU_PIX_FMT_TILED_NV12;
-	task.input.crop.pos.x = 0;
-	task.input.crop.pos.y = 0;
-	task.input.crop.w = total_padded_input_width;
-	task.input.crop.h = total_padded_input_height;
-	task.input.paddr = src_paddr;
-	task.input.paddr_n = 0;
-	task.input.deinterlace.enable = 0;
-	task.input.deinterlace.motion = HIGH_MOTION;
-
-	task.output.width = total_padded_output_width;
-	task.output.height = total_padded_output_height;
-	task.output.format = get_ipu_pixel_format(color_format);
-	task.output.rotate = IPU_ROTATE_NONE;
-	task.output.crop.pos.x = 0;
-	task.output.crop.pos.y = 0;
-	task.output.crop.w = total_padded_output_width;
-	task.output.crop.h = total_padded_output_height;
-	task.output.paddr = dest_paddr;
-
-	if (task.output.format == 0)
+	task->input.width = params->total_padded_input_width;
+	task->input.height = params->total_padded_input_height;
+	task->input.format = IPU_PIX_FMT_TILED_NV12;
+	task->input.crop.pos.x = params->input_crop_left;
+	task->input.crop.pos.y = params->input_crop_top;
+	task->input.crop.w = params->input_crop_width;
+	task->input.crop.h = params->input_crop_height;
+	task->input.paddr = src_paddr;
+	task->input.paddr_n = 0;
+	task->input.deinterlace.enable = 0;
+	task->input.deinterlace.motion = HIGH_MOTION;
+
+	if (params->deinterlace)
+	{
+		ImxVpuApiInterlacingMode interlacing_mode = params->interlacing_mode;
+		BOOL single_field = (interlacing_mode == IMX_VPU_API_INTERLACING_MODE_TOP_FIELD_ONLY) || (interlacing_mode == IMX_VPU_API_INTERLACING_MODE_BOTTOM_FIELD_ONLY);
+		BOOL bottom_field_first = (interlacing_mode == IMX_VPU_API_INTERLACING_MODE_BOTTOM_FIELD_FIRST) || (interlacing_mode == IMX_VPU_API_INTERLACING_MODE_BOTTOM_FIELD_ONLY);
+
+		/* The VDOA feeds the detiled fields directly into the VDI, so
+		 * the frame does not have to be written to memory in between.
+		 * In the motion adaptive modes, the VDI reads the previous
+		 * frame from paddr and the current one from paddr_n. */
+		task->input.deinterlace.enable = 1;
+		task->input.deinterlace.field_fmt = bottom_field_first ? IPU_DEINTERLACE_FIELD_BOTTOM : IPU_DEINTERLACE_FIELD_TOP;
+
+		if ((prev_src_fb_dma_buffer != NULL) && !single_field)
+		{
+			task->input.deinterlace.motion = MED_MOTION;
+			task->input.paddr = imx_dma_buffer_get_physical_address(prev_src_fb_dma_buffer);
+			task->input.paddr_n = src_paddr;
+		}
+
+		IMX_VPU_API_LOG(
+			"ipu task:  deinterlacing enabled  interlacing mode: %s  motion: %s",
+			imx_vpu_api_interlacing_mode_string(interlacing_mode),
+			(task->input.deinterlace.motion == MED_MOTION) ? "medium" : "high"
+		);
+	}
+
+	/* The detiled frame goes through the IC, which scales it to the
+	 * output crop size, rotates it, and converts it to the output
+	 * color format, all in the same pass. The output crop rectangle
+	 * is specified in output (that is, rotated) coordinates. */
+	task->output.width = params->total_padded_output_width;
+	task->output.height = params->total_padded_output_height;
+	task->output.format = get_ipu_pixel_format(params->output_color_format);
+	task->output.rotate = get_ipu_rotation(params->orientation);
+	task->output.crop.pos.x = 0;
+	task->output.crop.pos.y = 0;
+	task->output.crop.w = params->output_frame_width;
+	task->output.crop.h = params->output_frame_height;
+	task->output.paddr = dest_paddr;
+
+	if (task->output.format == 0)
 	{
-		IMX_VPU_API_ERROR("IPU does not support pixel format %s (%d)", imx_vpu_api_color_format_string(color_format), color_format);
+		IMX_VPU_API_ERROR("IPU does not support pixel format %s (%d)", imx_vpu_api_color_format_string(params->output_color_format), params->output_color_format);
 		return FALSE;
 	}
 
-	if ((ioctl_ret = ioctl(ipu_vdoa_fd, IPU_QUEUE_TASK, &task)) == -1)
+	return TRUE;
+}
+
+
+BOOL imx_vpu_api_imx6_coda_detile_and_copy_frame_with_ipu_vdoa(
+	int ipu_vdoa_fd,
+	ImxDmaBuffer *src_fb_dma_buffer,
+	ImxDmaBuffer *prev_src_fb_dma_buffer,
+	ImxDmaBuffer *dest_fb_dma_buffer,
+	ImxVpuApiImx6CodaIpuDetilingParams const *params
+)
+{
+	struct ipu_task task = { 0 };
+
+	if (!fill_detiling_task(&task, src_fb_dma_buffer, prev_src_fb_dma_buffer, dest_fb_dma_buffer, params))
+		return FALSE;
+
+	if (ioctl(ipu_vdoa_fd, IPU_QUEUE_TASK, &task) == -1)
 	{
 		IMX_VPU_API_ERROR("queuing IPU task failed: %s (%d)", strerror(errno), errno);
 		return FALSE;
@@ -130,3 +197,213 @@ BOOL imx_vpu_api_imx6_coda_detile_and_copy_frame_with_ipu_vdoa(
 
 	return TRUE;
 }
+
+
+
+typedef struct
+{
+	struct ipu_task task;
+	BOOL success;
+}
+DetilingQueueEntry;
+
+
+struct _ImxVpuApiImx6CodaIpuDetilingQueue
+{
+	int ipu_vdoa_fd;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	/* Ring buffer of tasks. The first num_finished_entries entries
+	 * (starting at first_entry_index) are finished, the remaining
+	 * ones are still waiting for the IPU. The thread always works
+	 * on the first entry that is not finished. */
+	DetilingQueueEntry *entries;
+	size_t max_num_entries;
+	size_t first_entry_index;
+	size_t num_entries;
+	size_t num_finished_entries;
+
+	BOOL shutdown;
+};
+
+
+static void* detiling_queue_thread_func(void *user_data)
+{
+	ImxVpuApiImx6CodaIpuDetilingQueue *queue = (ImxVpuApiImx6CodaIpuDetilingQueue *)user_data;
+
+	pthread_mutex_lock(&(queue->mutex));
+
+	while (TRUE)
+	{
+		DetilingQueueEntry *entry;
+		BOOL success = TRUE;
+
+		/* Pending tasks are finished even when shutting down,
+		 * since the VPU framebuffers they read from are
+		 * not returned to the VPU until then. */
+		while (!(queue->shutdown) && (queue->num_finished_entries == queue->num_entries))
+			pthread_cond_wait(&(queue->cond), &(queue->mutex));
+
+		if (queue->num_finished_entries == queue->num_entries)
+			break;
+
+		entry = &(queue->entries[(queue->first_entry_index + queue->num_finished_entries) % queue->max_num_entries]);
+
+		pthread_mutex_unlock(&(queue->mutex));
+
+		if (ioctl(queue->ipu_vdoa_fd, IPU_QUEUE_TASK, &(entry->task)) == -1)
+		{
+			IMX_VPU_API_ERROR("queuing IPU task failed: %s (%d)", strerror(errno), errno);
+			success = FALSE;
+		}
+
+		pthread_mutex_lock(&(queue->mutex));
+
+		entry->success = success;
+		queue->num_finished_entries++;
+		pthread_cond_broadcast(&(queue->cond));
+	}
+
+	pthread_mutex_unlock(&(queue->mutex));
+
+	return NULL;
+}
+
+
+ImxVpuApiImx6CodaIpuDetilingQueue* imx_vpu_api_imx6_coda_ipu_detiling_queue_create(int ipu_vdoa_fd, size_t max_num_tasks)
+{
+	int err;
+	ImxVpuApiImx6CodaIpuDetilingQueue *queue;
+
+	assert(ipu_vdoa_fd >= 0);
+	assert(max_num_tasks >= 1);
+
+	queue = malloc(sizeof(ImxVpuApiImx6CodaIpuDetilingQueue));
+	assert(queue != NULL);
+	memset(queue, 0, sizeof(ImxVpuApiImx6CodaIpuDetilingQueue));
+
+	queue->entries = malloc(sizeof(DetilingQueueEntry) * max_num_tasks);
+	assert(queue->entries != NULL);
+
+	queue->ipu_vdoa_fd = ipu_vdoa_fd;
+	queue->max_num_entries = max_num_tasks;
+
+	pthread_mutex_init(&(queue->mutex), NULL);
+	pthread_cond_init(&(queue->cond), NULL);
+
+	err = pthread_create(&(queue->thread), NULL, detiling_queue_thread_func, queue);
+	if (err != 0)
+	{
+		IMX_VPU_API_ERROR("could not start IPU detiling thread: %s (%d)", strerror(err), err);
+		pthread_cond_destroy(&(queue->cond));
+		pthread_mutex_destroy(&(queue->mutex));
+		free(queue->entries);
+		free(queue);
+		return NULL;
+	}
+
+	IMX_VPU_API_DEBUG("created IPU detiling queue with up to %zu task(s)", max_num_tasks);
+
+	return queue;
+}
+
+
+void imx_vpu_api_imx6_coda_ipu_detiling_queue_destroy(ImxVpuApiImx6CodaIpuDetilingQueue *queue)
+{
+	if (queue == NULL)
+		return;
+
+	pthread_mutex_lock(&(queue->mutex));
+	queue->shutdown = TRUE;
+	pthread_cond_broadcast(&(queue->cond));
+	pthread_mutex_unlock(&(queue->mutex));
+
+	pthread_join(queue->thread, NULL);
+
+	pthread_cond_destroy(&(queue->cond));
+	pthread_mutex_destroy(&(queue->mutex));
+	free(queue->entries);
+	free(queue);
+
+	IMX_VPU_API_DEBUG("destroyed IPU detiling queue");
+}
+
+
+BOOL imx_vpu_api_imx6_coda_ipu_detiling_queue_push(
+	ImxVpuApiImx6CodaIpuDetilingQueue *queue,
+	ImxDmaBuffer *src_fb_dma_buffer,
+	ImxDmaBuffer *prev_src_fb_dma_buffer,
+	ImxDmaBuffer *dest_fb_dma_buffer,
+	ImxVpuApiImx6CodaIpuDetilingParams const *params
+)
+{
+	DetilingQueueEntry *entry;
+
+	assert(queue != NULL);
+
+	pthread_mutex_lock(&(queue->mutex));
+
+	if (queue->num_entries == queue->max_num_entries)
+	{
+		pthread_mutex_unlock(&(queue->mutex));
+		IMX_VPU_API_ERROR("IPU detiling queue is full");
+		return FALSE;
+	}
+
+	/* The thread only accesses entries that come after the
+	 * finished ones, so this one can be filled while it runs. */
+	entry = &(queue->entries[(queue->first_entry_index + queue->num_entries) % queue->max_num_entries]);
+	memset(entry, 0, sizeof(DetilingQueueEntry));
+
+	if (!fill_detiling_task(&(entry->task), src_fb_dma_buffer, prev_src_fb_dma_buffer, dest_fb_dma_buffer, params))
+	{
+		pthread_mutex_unlock(&(queue->mutex));
+		return FALSE;
+	}
+
+	queue->num_entries++;
+	pthread_cond_broadcast(&(queue->cond));
+
+	pthread_mutex_unlock(&(queue->mutex));
+
+	return TRUE;
+}
+
+
+BOOL imx_vpu_api_imx6_coda_ipu_detiling_queue_pop(ImxVpuApiImx6CodaIpuDetilingQueue *queue, BOOL wait, BOOL *success)
+{
+	assert(queue != NULL);
+	assert(success != NULL);
+
+	pthread_mutex_lock(&(queue->mutex));
+
+	if (queue->num_entries == 0)
+	{
+		pthread_mutex_unlock(&(queue->mutex));
+		return FALSE;
+	}
+
+	if (wait)
+	{
+		while (queue->num_finished_entries == 0)
+			pthread_cond_wait(&(queue->cond), &(queue->mutex));
+	}
+	else if (queue->num_finished_entries == 0)
+	{
+		pthread_mutex_unlock(&(queue->mutex));
+		return FALSE;
+	}
+
+	*success = queue->entries[queue->first_entry_index].success;
+
+	queue->first_entry_index = (queue->first_entry_index + 1) % queue->max_num_entries;
+	queue->num_entries--;
+	queue->num_finished_entries--;
+
+	pthread_mutex_unlock(&(queue->mutex));
+
+	return TRUE;
+}
@@ -9,15 +9,79 @@
 int imx_vpu_api_imx6_coda_open_ipu_voda_fd(void);
 void imx_vpu_api_imx6_coda_close_ipu_voda_fd(int fd);
 
+/* Parameters for detiling and copying frames with the IPU VDOA. */
+typedef struct
+{
+	/* Total size of the input and output frames, including padding rows
+	 * and columns, in pixels. Plane offsets are derived from these. */
+	size_t total_padded_input_width, total_padded_input_height;
+	size_t total_padded_output_width, total_padded_output_height;
+
+	/* Rectangle within the input frame that is detiled. The VDOA
+	 * requires all of these to be aligned to macroblock (16 pixel)
+	 * boundaries. */
+	size_t input_crop_left, input_crop_top, input_crop_width, input_crop_height;
+
+	/* Size of the frame within the output frame. If this differs from
+	 * the input crop rectangle size (after the rotation was applied),
+	 * the IPU scales the frame. */
+	size_t output_frame_width, output_frame_height;
+
+	/* Color format of the output frame. */
+	ImxVpuApiColorFormat output_color_format;
+
+	/* Rotation or mirroring to apply to the frame. */
+	ImxVpuApiDecPostProcessingOrientation orientation;
+
+	/* If deinterlace is TRUE, the IPU VDI deinterlaces the frame in the
+	 * same pass. interlacing_mode then specifies the field order of the
+	 * frame. If deinterlace is FALSE, interlacing_mode is ignored. */
+	BOOL deinterlace;
+	ImxVpuApiInterlacingMode interlacing_mode;
+}
+ImxVpuApiImx6CodaIpuDetilingParams;
+
+/* Detiles the frame in src_fb_dma_buffer and copies it into dest_fb_dma_buffer.
+ * prev_src_fb_dma_buffer is the previously decoded frame, which is used for
+ * motion adaptive deinterlacing. If it is NULL, or if the frame contains
+ * only one field, bob deinterlacing is used instead. It is ignored if
+ * params->deinterlace is FALSE. */
 BOOL imx_vpu_api_imx6_coda_detile_and_copy_frame_with_ipu_vdoa(
 	int ipu_vdoa_fd,
 	ImxDmaBuffer *src_fb_dma_buffer,
+	ImxDmaBuffer *prev_src_fb_dma_buffer,
+	ImxDmaBuffer *dest_fb_dma_buffer,
+	ImxVpuApiImx6CodaIpuDetilingParams const *params
+);
+
+
+/* Queue for detiling and copying frames asynchronously. The IPU_QUEUE_TASK
+ * ioctl blocks until the IPU is done, so the queue has its own thread that
+ * issues the ioctls, one task after the other. This allows for the VPU
+ * to decode the next frame while the IPU is still detiling the previous
+ * one. Tasks are finished in the order they were pushed. */
+typedef struct _ImxVpuApiImx6CodaIpuDetilingQueue ImxVpuApiImx6CodaIpuDetilingQueue;
+
+ImxVpuApiImx6CodaIpuDetilingQueue* imx_vpu_api_imx6_coda_ipu_detiling_queue_create(int ipu_vdoa_fd, size_t max_num_tasks);
+/* Waits for all pushed tasks to finish before destroying the queue. */
+void imx_vpu_api_imx6_coda_ipu_detiling_queue_destroy(ImxVpuApiImx6CodaIpuDetilingQueue *queue);
+
+/* Pushes a task that detiles and copies a frame, just like
+ * imx_vpu_api_imx6_coda_detile_and_copy_frame_with_ipu_vdoa() does.
+ * Returns FALSE if the queue is full or if the task is invalid. */
+BOOL imx_vpu_api_imx6_coda_ipu_detiling_queue_push(
+	ImxVpuApiImx6CodaIpuDetilingQueue *queue,
+	ImxDmaBuffer *src_fb_dma_buffer,
+	ImxDmaBuffer *prev_src_fb_dma_buffer,
 	ImxDmaBuffer *dest_fb_dma_buffer,
-	size_t total_padded_input_width, size_t total_padded_input_height,
-	size_t total_padded_output_width, size_t total_padded_output_height,
-	size_t actual_frame_width, size_t actual_frame_height,
-	ImxVpuApiColorFormat color_format
+	ImxVpuApiImx6CodaIpuDetilingParams const *params
 );
 
+/* Removes the oldest task from the queue if it is finished. If wait is TRUE,
+ * this blocks until it is finished. Returns FALSE if the queue is empty,
+ * or if wait is FALSE and the oldest task is not finished yet. Otherwise,
+ * *success is set to the outcome of the task, and TRUE is returned. */
+BOOL imx_vpu_api_imx6_coda_ipu_detiling_queue_pop(ImxVpuApiImx6CodaIpuDetilingQueue *queue, BOOL wait, BOOL *success);
+
 
 #endif /* IMXVPUAPI2_IMX6_CODA_IPU_H */
@@ -1,8 +1,15 @@
+/* Needed for MAP_ANONYMOUS and mremap(), which are used
+ * for mapping the stream buffer twice in ring buffer mode. */
+#define _GNU_SOURCE
+
 #include <assert.h>
 #include <string.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include <config.h>
 
@@ -10,6 +17,15 @@
 #include "imxvpuapi2.h"
 #include "imxvpuapi2_priv.h"
 
+#ifdef IMXVPUAPI2_SIM_PLATFORM
+
+/* On the sim platform, the codec underneath this backend is simulated,
+ * and the definitions it needs come from an in-tree header instead
+ * of the imx-vpu-hantro ones. See imxvpuapi2_sim_hantro_codec.h. */
+#include "imxvpuapi2_sim_hantro_codec.h"
+
+#else
+
 /* This is necessary to turn off these warning that originate in OMX_Core.h :
  *   "ISO C restricts enumerator values to range of ‘int’""    */
 #ifdef __GNUC__
@@ -38,6 +54,8 @@
 #pragma GCC diagnostic pop
 #endif
 
+#endif
+
 
 
 
@@ -117,6 +135,14 @@ typedef struct
 	imx_physical_address_t physical_address;
 	ImxDmaBuffer *fb_dma_buffer;
 	void *fb_context;
+	/* TRUE if this framebuffer holds a decoded frame that was passed
+	 * to the user and has not yet been returned to the decoder. */
+	BOOL held_by_user;
+	/* TRUE if this framebuffer was not handed over to the codec again
+	 * when the pool was reused after new stream info came in, because
+	 * the user still held it. It stays mapped and part of the pool until
+	 * the user returns it; it is then unmapped and removed. */
+	BOOL retired;
 }
 FramebufferEntry;
 
@@ -138,10 +164,74 @@ typedef struct
 	void *context;
 	/* PTS/DTS from the ImxVpuApiEncodedFrame pts/dts fields. */
 	uint64_t pts, dts;
+	/* TRUE if the frame was pushed while frame discarding was enabled.
+	 * Its decoded picture is then handed back to the codec right away
+	 * instead of being output. */
+	BOOL discard;
+	/* Monotonic time at which the frame's encoded data was pushed.
+	 * Used for measuring the frame's latency. */
+	uint64_t push_time;
+	/* Number of frames that were pushed before this one. Used for
+	 * reporting skipped frames in the order in which they were pushed. */
+	uint64_t push_number;
+	/* If this entry is not occupied, this is the index of the next
+	 * entry in the free list, or INVALID_FRAME_ENTRY_INDEX if this
+	 * is the last free entry. */
+	size_t next_free_index;
+	/* If this entry is occupied, these are the indices of the previous
+	 * and next entries in the occupied list, or INVALID_FRAME_ENTRY_INDEX
+	 * if there is no such entry. */
+	size_t prev_occupied_index, next_occupied_index;
 }
 FrameEntry;
 
 
+/* Structure for keeping track of which frame entry the encoded data
+ * in the stream buffer belongs to. Multiple encoded frames can be
+ * queued in the stream buffer, so the bytes that the codec consumes
+ * have to be associated with the frame entry of the frame they were
+ * pushed with. Queued frames are stored in the order they were pushed,
+ * so the first queued frame always corresponds to the data at the
+ * stream buffer's read offset. */
+typedef struct
+{
+	/* Index of the FrameEntry of this queued frame. */
+	size_t frame_entry_index;
+	/* Number of bytes of this frame that are still in the stream buffer.
+	 * This includes any headers that were inserted along with the
+	 * frame's data by imx_vpu_api_dec_preprocess_input_data(). */
+	size_t num_remaining_bytes;
+	/* TRUE once the frame entry was passed to the codec as a picture ID.
+	 * If all of the bytes were consumed before that happened, then no
+	 * picture will ever refer to the frame entry, and it is released.
+	 * In byte stream input mode, this also means that any additional
+	 * picture that begins in these bytes needs a frame entry of its own. */
+	BOOL frame_entry_used;
+	/* Value of the decoder's discard_frames field at push time. Copied
+	 * into the additional frame entries mentioned above, just like
+	 * the push time and push number. */
+	BOOL discard;
+	uint64_t push_time;
+	uint64_t push_number;
+}
+QueuedFrame;
+
+
+/* Frame that was excluded by the current skip mode, or that was discarded
+ * during a resync. Such frames are never written into the stream buffer.
+ * Instead, imx_vpu_api_dec_decode() reports them as skipped, in the order
+ * in which they were pushed. A skipped frame is only reported once all
+ * frames that were pushed before it were output or reported. */
+typedef struct
+{
+	void *context;
+	uint64_t pts, dts;
+	ImxVpuApiDecSkippedFrameReasons reason;
+	uint64_t push_number;
+}
+SkippedFrame;
+
+
 /* RealVideo specific information, coming from the header. */
 /* TODO: This is not in use yet since the RealVideo decoding is not yet working. */
 typedef struct
@@ -168,12 +258,35 @@ struct _ImxVpuApiDecoder
 	uint8_t *stream_buffer_virtual_address;
 	imx_physical_address_t stream_buffer_physical_address;
 	size_t stream_buffer_size;
+	/* In ring buffer mode, the stream buffer is mapped twice, with the second
+	 * mapping immediately following the first one. This way, data that wraps
+	 * around the end of the stream buffer can still be accessed linearly by
+	 * the CPU (needed for memcpy() and for the codec's scanframe() function).
+	 * The VPU itself is informed about the ring buffer and handles the wrap
+	 * around on its own. stream_buffer_virtual_address is set to the start
+	 * of this double mapping in ring buffer mode. If this is NULL, then no
+	 * double mapping exists. */
+	uint8_t *stream_buffer_double_mapping;
 	/* Offset and size values to keep track of where to read from and write
 	 * to the stream buffer. */
 	size_t stream_buffer_read_offset;
 	size_t stream_buffer_write_offset;
 	size_t stream_buffer_fill_level;
 
+	/* DMA buffer that was pushed by imx_vpu_api_dec_push_encoded_dma_buffer()
+	 * and that is directly read by the codec instead of the stream buffer.
+	 * If this is NULL, the stream buffer is used. While this is set, the
+	 * stream buffer read offset, write offset, and fill level values above
+	 * refer to this DMA buffer instead. The virtual and physical addresses
+	 * and the size already take into account the offset that was passed to
+	 * imx_vpu_api_dec_push_encoded_dma_buffer(). */
+	ImxDmaBuffer *input_dma_buffer;
+	uint8_t *input_dma_buffer_virtual_address;
+	imx_physical_address_t input_dma_buffer_physical_address;
+	size_t input_dma_buffer_size;
+	ImxVpuApiDecEncodedDmaBufferReleaseCallback input_dma_buffer_release_callback;
+	void *input_dma_buffer_release_callback_user_data;
+
 	/* Offset used in imx_vpu_api_dec_push_encoded_frame(). The first N bytes
 	 * of the encoded frame data will be skipped, N = encoded_frame_offset. */
 	size_t encoded_frame_offset;
@@ -182,6 +295,20 @@ struct _ImxVpuApiDecoder
 	 * one frame was decoded. Used by the WebP decoder. */
 	BOOL single_frame_decoding;
 
+	/* If TRUE, then pushed data does not have to consist of complete frames.
+	 * The codec's scanframe() function finds the frame boundaries. Set if
+	 * the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT flag is used. */
+	BOOL byte_stream_input;
+
+	/* Size of the NAL length fields in pushed frames if the
+	 * IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LENGTH_PREFIXED_NAL_INPUT flag is
+	 * used, or 0 if pushed frames are in Annex-B format. In the former case,
+	 * the parameter sets from the avcC/hvcC record are converted to Annex-B
+	 * NAL units that are stored in annexb_parameter_sets, and the extra
+	 * header data in the open_params copy below is set to refer to them. */
+	unsigned int nal_length_size;
+	uint8_t *annexb_parameter_sets;
+
 	/* If TRUE, then certain "invisible frames" will be skipped. With some
 	 * formats like VP9, there are internal frames that get decoded, but are
 	 * not intended to be shown. In such cases, this internal frame needs to
@@ -210,9 +337,77 @@ struct _ImxVpuApiDecoder
 	 * then it returns with an error. This value is set to TRUE if
 	 * imx_vpu_api_dec_push_encoded_frame() finishes successfully, and
 	 * set back to FALSE once imx_vpu_api_dec_decode() returns the output
-	 * code mentioned above. */
+	 * code mentioned above. If input queuing is used, additional frames can
+	 * be pushed even if this is TRUE, as long as fewer than
+	 * max_num_queued_frames frames are queued (see queued_frames below). */
 	BOOL encoded_data_available;
 
+	/* Frames whose data is (at least partially) still in the stream buffer.
+	 * Entries are appended by imx_vpu_api_dec_push_encoded_frame() and
+	 * removed once the codec consumed all of their bytes. The array is
+	 * allocated once in imx_vpu_api_dec_open(), with one entry more than
+	 * max_num_queued_frames for leftover data of a previous push that did
+	 * not yet complete a frame (see imx_vpu_api_dec_add_pushed_frame_entry()). */
+	QueuedFrame *queued_frames;
+	size_t num_queued_frames;
+	size_t queued_frames_capacity;
+	/* Maximum number of queued frames, from the max_num_queued_encoded_frames
+	 * field in the open params. Always at least 1. */
+	size_t max_num_queued_frames;
+
+	/* Skip mode set by imx_vpu_api_dec_set_skip_mode(). Frames excluded by
+	 * it (and frames that are discarded during a resync) are recorded
+	 * in pending_skipped_frames instead of being pushed into
+	 * the stream buffer. That way, the codec never sees them, and
+	 * imx_vpu_api_dec_decode() reports them as skipped. The pending
+	 * skipped frames are stored in a ring buffer, beginning at
+	 * first_pending_skipped_frame_index. Its capacity is doubled
+	 * if necessary. */
+	ImxVpuApiDecSkipMode skip_mode;
+	SkippedFrame *pending_skipped_frames;
+	size_t num_pending_skipped_frames;
+	size_t first_pending_skipped_frame_index;
+	size_t pending_skipped_frames_capacity;
+	/* Number of frames that were pushed so far, including excluded ones. */
+	uint64_t num_pushed_frames;
+	/* Highest TemporalId in the h.265 stream, or -1 if it is not known yet.
+	 * Needed for excluding non-reference pictures. */
+	int h265_highest_temporal_id;
+
+	/* Set by imx_vpu_api_dec_set_frame_discarding(). Its value is recorded
+	 * in the frame entries of frames when these are pushed. */
+	BOOL discard_frames;
+
+	/* If TRUE, the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LOW_LATENCY flag is set.
+	 * Frame reordering is then disabled, and imx_vpu_api_dec_decode()
+	 * retrieves a decoded frame from the codec in the same call that
+	 * decoded it. */
+	BOOL low_latency;
+
+	/* If TRUE, the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS flag
+	 * is set. Suitable framebuffers are then kept in the pool when new
+	 * stream info comes in instead of clearing the entire pool. */
+	BOOL reuse_framebuffers;
+
+	/* If TRUE, the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_RESYNC_ON_ERRORS flag
+	 * is set. After a bitstream error, resync_pending is then set to TRUE,
+	 * and pushed frames are discarded until a random access point arrives. */
+	BOOL resync_on_errors;
+	BOOL resync_pending;
+
+	/* How often the decoder was reset after a hardware error. */
+	unsigned int num_hardware_resets;
+
+	/* If TRUE, the IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING
+	 * flag is set, and the codec's post-processor was configured with the
+	 * post_processing open params. The codec then reports the size and
+	 * color format of the post-processed frames in its stream info. */
+	BOOL post_processing_enabled;
+
+	/* Latency of the frame that was last retrieved by
+	 * imx_vpu_api_dec_get_decoded_frame(), in nanoseconds. */
+	uint64_t decoded_frame_latency;
+
 	/* RealVideo specific information. */
 	/* TODO: Not in use yet due to no-yet-working RealVideo decoding. */
 	int slice_info_nr;
@@ -229,18 +424,62 @@ struct _ImxVpuApiDecoder
 
 	BOOL ring_buffer_mode;
 	BOOL main_header_pushed;
+
+	/* Stream headers (parameter sets, sequence headers) found in pushed
+	 * frames. The codec forgets the headers it parsed when it is flushed,
+	 * so the cached ones are reinserted ahead of the next random access
+	 * point after a flush. */
+	ImxVpuApiStreamHeaderCache stream_header_cache;
 	BOOL drain_mode_enabled;
 	BOOL end_of_stream_reached;
 
 	FramebufferEntry *framebuffer_entries;
 	size_t num_framebuffer_entries;
-
+	/* How many of the framebuffer entries are retired. */
+	size_t num_retired_framebuffer_entries;
+	/* Open addressing hash table that maps physical addresses to indices
+	 * into framebuffer_entries. Each slot contains a framebuffer entry
+	 * index, or INVALID_FRAME_ENTRY_INDEX if the slot is empty. The table
+	 * size is a power of two, and is kept at least twice as big as the
+	 * number of framebuffer entries so that probe sequences stay short. */
+	size_t *framebuffer_entry_hash_table;
+	size_t framebuffer_entry_hash_table_size;
+
+	/* Pool of frame entries. Free entries are linked together to form
+	 * a free list, so finding a free entry does not require a scan.
+	 * Occupied entries are linked together to form a list that is
+	 * sorted by push number, so the oldest frame that is still in the
+	 * decoder is always at its head. The pool is allocated in
+	 * imx_vpu_api_dec_open() with enough entries for the queued frames,
+	 * and grown once new stream info is processed so it can also hold
+	 * entries for all frames in the DPB. Occupied entries are never
+	 * recycled, since they may belong to a queued frame, a frame that
+	 * the codec is still working on, or a decoded frame that was not
+	 * yet retrieved, and recycling one would attach the wrong context
+	 * and timestamps to that frame. */
 	FrameEntry *frame_entries;
 	size_t num_frame_entries;
+	size_t first_free_frame_entry_index;
+	size_t first_occupied_frame_entry_index;
+	size_t last_occupied_frame_entry_index;
 
 	size_t num_framebuffers_to_be_added;
-
-	size_t last_pushed_frame_entry_index;
+	/* Minimum number of framebuffers imx_vpu_api_dec_add_framebuffers_to_pool()
+	 * accepts. After new stream info, this equals num_framebuffers_to_be_added.
+	 * When additional framebuffers are needed, it is 1, since it is okay for
+	 * the user to add fewer than num_framebuffers_to_be_added framebuffers
+	 * then. The codec just asks for more again in that case. */
+	size_t min_num_framebuffers_to_be_added;
+
+	/* Index of the frame entry associated with the data that was last
+	 * passed to the codec's decode() function. Used for reporting
+	 * skipped frames. */
+	size_t current_frame_entry_index;
+	/* TRUE if decode() did not consume any bytes of the picture that
+	 * current_frame_entry_index was associated with, for example because
+	 * it first reported new stream info. The next scan then finds the
+	 * same picture again, which has to keep its frame entry. */
+	BOOL current_picture_pending;
 	size_t decoded_frame_fb_entry_index;
 	size_t decoded_frame_entry_index;
 
@@ -248,26 +487,75 @@ struct _ImxVpuApiDecoder
 	void *skipped_frame_context;
 	uint64_t skipped_frame_pts;
 	uint64_t skipped_frame_dts;
-};
 
+	/* State for imx_vpu_api_dec_start_decode() / imx_vpu_api_dec_finish_decode(). */
+	ImxVpuApiDecAsyncState async_state;
+};
 
-static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uint8_t const *extra_header_data, size_t extra_header_data_size, uint8_t *main_data, size_t main_data_size);
-static void imx_vpu_api_dec_push_input_data(ImxVpuApiDecoder *decoder, void const *data, size_t data_size);
 
+static BOOL imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uint8_t const *extra_header_data, size_t extra_header_data_size, uint8_t *main_data, size_t main_data_size);
+static BOOL imx_vpu_api_dec_push_cached_stream_headers(ImxVpuApiDecoder *decoder);
+static BOOL imx_vpu_api_dec_push_input_data(ImxVpuApiDecoder *decoder, void const *data, size_t data_size);
+static BOOL imx_vpu_api_dec_push_main_data(ImxVpuApiDecoder *decoder, uint8_t const *data, size_t data_size);
+static void imx_vpu_api_dec_discard_partially_pushed_data(ImxVpuApiDecoder *decoder, size_t prev_fill_level, BOOL prev_main_header_pushed);
+static BOOL imx_vpu_api_dec_map_stream_buffer_twice(ImxVpuApiDecoder *decoder);
+static void imx_vpu_api_dec_unmap_stream_buffer_double_mapping(ImxVpuApiDecoder *decoder);
+static void imx_vpu_api_dec_release_input_dma_buffer(ImxVpuApiDecoder *decoder, BOOL copy_leftover_data);
+static ImxVpuApiDecReturnCodes imx_vpu_api_dec_check_if_push_is_allowed(ImxVpuApiDecoder *decoder, size_t main_data_size);
+static void imx_vpu_api_dec_add_pushed_frame_entry(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame, size_t num_pushed_bytes);
+
+static QueuedFrame* imx_vpu_api_dec_find_queued_frame(ImxVpuApiDecoder *decoder, size_t offset);
+static BOOL imx_vpu_api_dec_associate_picture_with_frame_entry(ImxVpuApiDecoder *decoder, size_t offset);
+static void imx_vpu_api_dec_remove_consumed_queued_frames(ImxVpuApiDecoder *decoder, size_t num_consumed_bytes);
+
+static BOOL imx_vpu_api_dec_is_frame_excluded(ImxVpuApiDecoder *decoder, uint8_t const *data, size_t data_size, ImxVpuApiDecSkippedFrameReasons *reason);
+static void imx_vpu_api_dec_add_pending_skipped_frame(ImxVpuApiDecoder *decoder, void *context, uint64_t pts, uint64_t dts, ImxVpuApiDecSkippedFrameReasons reason, uint64_t push_number);
+static BOOL imx_vpu_api_dec_report_pending_skipped_frame(ImxVpuApiDecoder *decoder, BOOL force);
+static void imx_vpu_api_dec_abort_codec(ImxVpuApiDecoder *decoder);
+static void imx_vpu_api_dec_begin_resync(ImxVpuApiDecoder *decoder);
+static void imx_vpu_api_dec_reset_after_hardware_error(ImxVpuApiDecoder *decoder, CODEC_STATE codec_state);
+
+static BOOL imx_vpu_api_dec_grow_frame_entry_pool(ImxVpuApiDecoder *decoder, size_t new_num_entries);
 static size_t imx_vpu_api_get_free_frame_entry_index(ImxVpuApiDecoder *decoder);
+static void imx_vpu_api_dec_occupy_frame_entry(ImxVpuApiDecoder *decoder, size_t index, uint64_t push_number);
+static void imx_vpu_api_dec_release_frame_entry(ImxVpuApiDecoder *decoder, size_t index);
+static void imx_vpu_api_dec_release_all_frame_entries(ImxVpuApiDecoder *decoder);
 static void imx_vpu_api_dec_clear_frame_entries(ImxVpuApiDecoder *decoder);
 
+static size_t imx_vpu_api_dec_hash_physical_address(imx_physical_address_t physical_address);
+static void imx_vpu_api_dec_insert_framebuffer_entry_into_hash_table(ImxVpuApiDecoder *decoder, size_t index);
+static void imx_vpu_api_dec_rebuild_framebuffer_entry_hash_table(ImxVpuApiDecoder *decoder);
+static void imx_vpu_api_dec_remove_retired_framebuffer_entry(ImxVpuApiDecoder *decoder, size_t index);
 static size_t imx_vpu_api_dec_find_framebuffer_entry_index(ImxVpuApiDecoder *decoder, imx_physical_address_t physical_address);
 static size_t imx_vpu_api_dec_add_framebuffer_entries(ImxVpuApiDecoder *decoder, size_t num_new_entries);
 static void imx_vpu_api_dec_clear_added_framebuffers(ImxVpuApiDecoder *decoder);
+static size_t imx_vpu_api_dec_reuse_added_framebuffers(ImxVpuApiDecoder *decoder);
 
+static size_t imx_vpu_api_dec_get_total_num_needed_framebuffers(ImxVpuApiDecoder *decoder);
+static size_t imx_vpu_api_dec_get_num_missing_framebuffers(ImxVpuApiDecoder *decoder);
 static BOOL imx_vpu_api_dec_get_new_stream_info(ImxVpuApiDecoder *decoder);
+static ImxVpuApiDecReturnCodes imx_vpu_api_dec_retrieve_frame_from_codec(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code, BOOL *output_available);
+#ifdef HAVE_IMXVPUDEC_HANTRO_POST_PROCESSOR_ARGS
+static BOOL imx_vpu_api_dec_fill_post_processor_args(ImxVpuApiDecOpenParams const *open_params, PP_ARGS *post_processor_args);
+#endif
 
 
-static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uint8_t const *extra_header_data, size_t extra_header_data_size, uint8_t *main_data, size_t main_data_size)
+static BOOL imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uint8_t const *extra_header_data, size_t extra_header_data_size, uint8_t *main_data, size_t main_data_size)
 {
+	BOOL reinsert_stream_headers = FALSE;
+
 	assert(decoder != NULL);
 
+	/* In byte stream input mode, pushed data does not necessarily begin
+	 * at a frame boundary, so stream headers cannot be found reliably. */
+	if (!(decoder->byte_stream_input))
+	{
+		/* A caching failure does not affect the current frame;
+		 * it only means that these headers cannot be reinserted. */
+		if (!imx_vpu_api_stream_header_cache_process_frame(&(decoder->stream_header_cache), decoder->open_params.compression_format, main_data, main_data_size, decoder->nal_length_size, &reinsert_stream_headers))
+			IMX_VPU_API_WARNING("could not cache stream headers; these headers will not be reinserted after a flush");
+	}
+
 	switch (decoder->open_params.compression_format)
 	{
 		case IMX_VPU_API_COMPRESSION_FORMAT_DIVX3:
@@ -277,7 +565,8 @@ static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uin
 			if (!(decoder->main_header_pushed))
 			{
 				imx_vpu_api_insert_divx3_frame_header(header, decoder->open_params.frame_width, decoder->open_params.frame_height);
-				imx_vpu_api_dec_push_input_data(decoder, header, DIVX3_FRAME_HEADER_SIZE);
+				if (!imx_vpu_api_dec_push_input_data(decoder, header, DIVX3_FRAME_HEADER_SIZE))
+					return FALSE;
 				decoder->main_header_pushed = TRUE;
 			}
 
@@ -341,7 +630,8 @@ static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uin
 				 * integer contains the frame size), so make sure it is
 				 * left out by subtracting 4 from the size of the header
 				 * data that we want to push into the stream buffer. */
-				imx_vpu_api_dec_push_input_data(decoder, header, WMV3_RCV_SEQUENCE_LAYER_HEADER_SIZE - 4);
+				if (!imx_vpu_api_dec_push_input_data(decoder, header, WMV3_RCV_SEQUENCE_LAYER_HEADER_SIZE - 4))
+					return FALSE;
 				decoder->main_header_pushed = TRUE;
 			}
 
@@ -359,7 +649,8 @@ static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uin
 				 * which contains the size of the extra header data), since it
 				 * contains the sequence layer header */
 				IMX_VPU_API_LOG("pushing extra header data with %zu byte", extra_header_data_size - 1);
-				imx_vpu_api_dec_push_input_data(decoder, extra_header_data + 1, extra_header_data_size - 1);
+				if (!imx_vpu_api_dec_push_input_data(decoder, extra_header_data + 1, extra_header_data_size - 1))
+					return FALSE;
 
 				decoder->main_header_pushed = TRUE;
 
@@ -367,6 +658,11 @@ static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uin
 				 * block below */
 			}
 
+			/* The cached headers must come before the frame
+			 * layer header, since that one begins the frame. */
+			if (reinsert_stream_headers && !imx_vpu_api_dec_push_cached_stream_headers(decoder))
+				return FALSE;
+
 			if (decoder->main_header_pushed)
 			{
 				uint8_t header[VC1_NAL_FRAME_LAYER_HEADER_MAX_SIZE];
@@ -375,7 +671,8 @@ static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uin
 				if (actual_header_length > 0)
 				{
 					IMX_VPU_API_LOG("pushing frame layer header with %zu byte", actual_header_length);
-					imx_vpu_api_dec_push_input_data(decoder, header, actual_header_length);
+					if (!imx_vpu_api_dec_push_input_data(decoder, header, actual_header_length))
+						return FALSE;
 				}
 			}
 
@@ -385,14 +682,40 @@ static void imx_vpu_api_dec_preprocess_input_data(ImxVpuApiDecoder *decoder, uin
 		default:
 			if (!(decoder->main_header_pushed) && (extra_header_data != NULL) && (extra_header_data_size > 0))
 			{
-				imx_vpu_api_dec_push_input_data(decoder, extra_header_data, extra_header_data_size);
+				if (!imx_vpu_api_dec_push_input_data(decoder, extra_header_data, extra_header_data_size))
+					return FALSE;
 				decoder->main_header_pushed = TRUE;
 			}
+
+			/* Push the cached headers after the extra header data,
+			 * since in-band headers may have replaced the latter. */
+			if (reinsert_stream_headers && !imx_vpu_api_dec_push_cached_stream_headers(decoder))
+				return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static BOOL imx_vpu_api_dec_push_cached_stream_headers(ImxVpuApiDecoder *decoder)
+{
+	size_t i;
+	ImxVpuApiStreamHeaderCache *cache = &(decoder->stream_header_cache);
+
+	for (i = 0; i < cache->num_entries; ++i)
+	{
+		ImxVpuApiStreamHeaderCacheEntry *entry = &(cache->entries[i]);
+
+		IMX_VPU_API_LOG("reinserting %zu byte(s) of cached stream header (type order %u ID %u)", entry->size, entry->type_order, entry->id);
+		if (!imx_vpu_api_dec_push_input_data(decoder, entry->data, entry->size))
+			return FALSE;
 	}
+
+	return TRUE;
 }
 
 
-static void imx_vpu_api_dec_push_input_data(ImxVpuApiDecoder *decoder, void const *data, size_t data_size)
+static BOOL imx_vpu_api_dec_push_input_data(ImxVpuApiDecoder *decoder, void const *data, size_t data_size)
 {
 	size_t read_offset, write_offset, fill_level;
 	size_t bbuf_size;
@@ -412,39 +735,54 @@ static void imx_vpu_api_dec_push_input_data(ImxVpuApiDecoder *decoder, void cons
 	src_data_bytes = (uint8_t const *)data;
 	streambuf_bytes = (uint8_t *)(decoder->stream_buffer_virtual_address);
 
+	/* The size of pushed frames is up to the caller, so this
+	 * is an error, not an assertion. In non ring buffer mode,
+	 * the leftover data is moved to the front below if needed,
+	 * so the same check applies there. */
+	if ((fill_level + data_size) > bbuf_size)
+	{
+		IMX_VPU_API_ERROR("cannot push %zu byte(s) into stream buffer:  fill level %zu  size %zu", data_size, fill_level, bbuf_size);
+		return FALSE;
+	}
+
 	/**
 	 * In ring buffer mode, the read offset must not be touched here.
 	 * Instead, the write operation has to wrap around the stream
 	 * buffer size if writing the entire data set would exceed the
-	 * boundary of the buffer.
+	 * boundary of the buffer. Since the stream buffer is mapped twice
+	 * in this mode, a single memcpy() suffices even if the data wraps
+	 * around; the bytes that are written past the end of the first
+	 * mapping end up at the beginning of the stream buffer.
 	 *
 	 * In non ring buffer mode, no such wrap around is done. Instead,
 	 * the data that is still to be read is shifted forwards so that
 	 * the read offset is 0 (but only if the write operation would
-	 * exceed the boundary of the buffer).
+	 * exceed the boundary of the buffer). The Hantro G1 decoders
+	 * cannot read stream data that wraps around, so this is necessary
+	 * with the formats they handle.
 	 *
 	 * JPEG data is a special case. JPEG frames are always read from
 	 * the start, so we have to constantly move leftover data to the
 	 * front of the ringbuffer.
 	 */
-	if (((write_offset + data_size) > bbuf_size) || (decoder->open_params.compression_format == IMX_VPU_API_COMPRESSION_FORMAT_JPEG))
+	if (decoder->ring_buffer_mode)
 	{
-		if (decoder->ring_buffer_mode)
-		{
-			size_t first_copy_size = bbuf_size - write_offset;
-			size_t second_copy_size = data_size - first_copy_size;
-			memcpy(streambuf_bytes + write_offset, src_data_bytes, first_copy_size);
-			memcpy(streambuf_bytes, src_data_bytes + first_copy_size, second_copy_size);
-			decoder->stream_buffer_write_offset = second_copy_size;
-		}
-		else
-		{
+		memcpy(streambuf_bytes + write_offset, src_data_bytes, data_size);
+		write_offset += data_size;
+		if (write_offset >= bbuf_size)
+			write_offset -= bbuf_size;
+		decoder->stream_buffer_write_offset = write_offset;
+	}
+	else if (((write_offset + data_size) > bbuf_size) || (decoder->open_params.compression_format == IMX_VPU_API_COMPRESSION_FORMAT_JPEG))
+	{
+		/* Nothing needs to be moved if there is no leftover
+		 * data or if it already is at the front. */
+		if ((fill_level > 0) && (read_offset > 0))
 			memmove(streambuf_bytes, streambuf_bytes + read_offset, fill_level);
-			decoder->stream_buffer_read_offset = 0;
-			decoder->stream_buffer_write_offset = fill_level;
-			memcpy(streambuf_bytes + decoder->stream_buffer_write_offset, src_data_bytes, data_size);
-			decoder->stream_buffer_write_offset += data_size;
-		}
+		decoder->stream_buffer_read_offset = 0;
+		decoder->stream_buffer_write_offset = fill_level;
+		memcpy(streambuf_bytes + decoder->stream_buffer_write_offset, src_data_bytes, data_size);
+		decoder->stream_buffer_write_offset += data_size;
 	}
 	else
 	{
@@ -453,230 +791,1253 @@ static void imx_vpu_api_dec_push_input_data(ImxVpuApiDecoder *decoder, void cons
 	}
 
 	decoder->stream_buffer_fill_level += data_size;
+
+	return TRUE;
 }
 
 
-static size_t imx_vpu_api_get_free_frame_entry_index(ImxVpuApiDecoder *decoder)
+static BOOL imx_vpu_api_dec_push_main_data(ImxVpuApiDecoder *decoder, uint8_t const *data, size_t data_size)
 {
-	size_t index;
-	FrameEntry *new_entries;
-
 	assert(decoder != NULL);
 
-	for (index = 0; index < decoder->num_frame_entries; ++index)
-	{
-		FrameEntry *entry = &(decoder->frame_entries[index]);
-		if (!(entry->occupied))
-			return index;
-	}
+	if (decoder->nal_length_size == 0)
+		return imx_vpu_api_dec_push_input_data(decoder, data, data_size);
 
-	new_entries = realloc(decoder->frame_entries, sizeof(FrameEntry) * (decoder->num_frame_entries + 1));
-	assert(new_entries != NULL);
+	/* Replace the NAL length fields with start codes while copying the
+	 * NAL units into the stream buffer. The data was already validated
+	 * by imx_vpu_api_get_annexb_size_of_length_prefixed_data(). */
+	while (data_size > 0)
+	{
+		uint8_t const *nal;
+		size_t nal_size;
+		size_t num_read_bytes = imx_vpu_api_get_next_length_prefixed_nal(data, data_size, decoder->nal_length_size, &nal, &nal_size);
 
-	IMX_VPU_API_DEBUG("(re)allocated space for additional frame entry");
+		if (!imx_vpu_api_dec_push_input_data(decoder, annexb_start_code, ANNEXB_START_CODE_SIZE))
+			return FALSE;
+		if ((nal_size > 0) && !imx_vpu_api_dec_push_input_data(decoder, nal, nal_size))
+			return FALSE;
 
-	index = decoder->num_frame_entries;
-	decoder->num_frame_entries++;
-	decoder->frame_entries = new_entries;
+		data += num_read_bytes;
+		data_size -= num_read_bytes;
+	}
 
-	return index;
+	return TRUE;
 }
 
 
-static void imx_vpu_api_dec_clear_frame_entries(ImxVpuApiDecoder *decoder)
+static void imx_vpu_api_dec_discard_partially_pushed_data(ImxVpuApiDecoder *decoder, size_t prev_fill_level, BOOL prev_main_header_pushed)
 {
+	size_t write_offset;
+
 	assert(decoder != NULL);
-	IMX_VPU_API_LOG("clearing %zu frame entries", decoder->num_frame_entries);
-	free(decoder->frame_entries);
-	decoder->frame_entries = NULL;
-	decoder->num_frame_entries = 0;
+	assert(decoder->stream_buffer_fill_level >= prev_fill_level);
+
+	/* Undo the pushes of a frame that did not fit in the stream buffer,
+	 * so that the data of the previously pushed frames stays intact. The
+	 * read offset is not touched by a push, except for when the leftover
+	 * data is moved to the front, and in that case, the leftover data
+	 * still begins at the (new) read offset. */
+	IMX_VPU_API_DEBUG("discarding %zu byte(s) of partially pushed data", decoder->stream_buffer_fill_level - prev_fill_level);
+
+	write_offset = decoder->stream_buffer_read_offset + prev_fill_level;
+	if (decoder->ring_buffer_mode && (write_offset >= decoder->stream_buffer_size))
+		write_offset -= decoder->stream_buffer_size;
+
+	decoder->stream_buffer_write_offset = write_offset;
+	decoder->stream_buffer_fill_level = prev_fill_level;
+	decoder->main_header_pushed = prev_main_header_pushed;
 }
 
 
-static size_t imx_vpu_api_dec_find_framebuffer_entry_index(ImxVpuApiDecoder *decoder, imx_physical_address_t physical_address)
+static BOOL imx_vpu_api_dec_map_stream_buffer_twice(ImxVpuApiDecoder *decoder)
 {
-	size_t index;
+	long page_size;
+	size_t size;
+	uint8_t *reserved_region;
+	int i;
 
 	assert(decoder != NULL);
-	assert(physical_address != 0);
+	assert(decoder->stream_buffer_virtual_address != NULL);
+	assert(decoder->stream_buffer_double_mapping == NULL);
 
-	for (index = 0; index < decoder->num_framebuffer_entries; ++index)
+	page_size = sysconf(_SC_PAGESIZE);
+	size = decoder->stream_buffer_size;
+	if ((page_size <= 0) || ((size % (size_t)page_size) != 0) || ((((uintptr_t)(decoder->stream_buffer_virtual_address)) % (uintptr_t)page_size) != 0))
 	{
-		FramebufferEntry *entry = &(decoder->framebuffer_entries[index]);
-		if (entry->physical_address == physical_address)
-			return index;
+		IMX_VPU_API_DEBUG("stream buffer size %zu or its mapping is not aligned to the page size %ld; cannot map it twice", size, page_size);
+		return FALSE;
 	}
 
-	return INVALID_FRAME_ENTRY_INDEX;
-}
+	/* Reserve a region in the address space that is large enough
+	 * for both mappings, then place the mappings inside it. */
+	reserved_region = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserved_region == MAP_FAILED)
+	{
+		IMX_VPU_API_DEBUG("could not reserve %zu byte(s) of address space for stream buffer double mapping: %s (%d)", size * 2, strerror(errno), errno);
+		return FALSE;
+	}
+
+	/* The mappings are created from the one that imx_dma_buffer_map()
+	 * set up in imx_vpu_api_dec_open(), and not from the DMA-BUF FD,
+	 * since not all imxdmabuffer allocators have an FD, and the way
+	 * a DMA buffer is mapped is up to its allocator. mremap() with an
+	 * old size of 0 does not move that mapping. Instead, it creates
+	 * another mapping of the same pages. This only works with shared
+	 * mappings, which DMA buffer mappings always are. That original
+	 * mapping stays in place, and is unmapped with imx_dma_buffer_unmap()
+	 * as usual. */
+	for (i = 0; i < 2; ++i)
+	{
+		void *mapping = mremap(decoder->stream_buffer_virtual_address, 0, size, MREMAP_MAYMOVE | MREMAP_FIXED, reserved_region + i * size);
+		if (mapping == MAP_FAILED)
+		{
+			IMX_VPU_API_DEBUG("could not map stream buffer twice: %s (%d)", strerror(errno), errno);
+			munmap(reserved_region, size * 2);
+			return FALSE;
+		}
+	}
 
+	IMX_VPU_API_DEBUG("mapped stream buffer twice at virtual address %p", (void *)reserved_region);
 
-static size_t imx_vpu_api_dec_add_framebuffer_entries(ImxVpuApiDecoder *decoder, size_t num_new_entries)
-{
-	int new_entries_index;
-	FramebufferEntry *new_entries;
+	decoder->stream_buffer_double_mapping = reserved_region;
+	decoder->stream_buffer_virtual_address = reserved_region;
 
-	assert(decoder != NULL);
-	assert(num_new_entries > 0);
+	return TRUE;
+}
 
-	new_entries = realloc(decoder->framebuffer_entries, sizeof(FramebufferEntry) * (decoder->num_framebuffer_entries + num_new_entries));
-	assert(new_entries != NULL);
 
-	new_entries_index = decoder->num_framebuffer_entries;
-	IMX_VPU_API_DEBUG("(re)allocated space for additional %d framebuffer entries", num_new_entries);
-	decoder->num_framebuffer_entries += num_new_entries;
-	decoder->framebuffer_entries = new_entries;
+static void imx_vpu_api_dec_unmap_stream_buffer_double_mapping(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
 
-	memset(&decoder->framebuffer_entries[new_entries_index], 0, sizeof(FramebufferEntry) * num_new_entries);
+	if (decoder->stream_buffer_double_mapping == NULL)
+		return;
 
-	return new_entries_index;
+	munmap(decoder->stream_buffer_double_mapping, decoder->stream_buffer_size * 2);
+	decoder->stream_buffer_double_mapping = NULL;
 }
 
 
-static void imx_vpu_api_dec_clear_added_framebuffers(ImxVpuApiDecoder *decoder)
+static void imx_vpu_api_dec_release_input_dma_buffer(ImxVpuApiDecoder *decoder, BOOL copy_leftover_data)
 {
-	size_t index;
+	ImxDmaBuffer *input_dma_buffer;
 
 	assert(decoder != NULL);
 
-	IMX_VPU_API_LOG("clearing %zu added framebuffer(s)", decoder->num_framebuffer_entries);
+	input_dma_buffer = decoder->input_dma_buffer;
+	if (input_dma_buffer == NULL)
+		return;
 
-	for (index = 0; index < decoder->num_framebuffer_entries; ++index)
+	/* If the codec did not consume all of the data in the input DMA buffer,
+	 * move the rest into the stream buffer, since any data that is pushed
+	 * later has to be appended to it. The stream buffer is always empty
+	 * while an input DMA buffer is in use, and input DMA buffers are only
+	 * used if their data fits in the stream buffer, so the rest can simply
+	 * be copied to the beginning of the stream buffer. */
+	if (copy_leftover_data && (decoder->stream_buffer_fill_level > 0))
 	{
-		FramebufferEntry *entry = &(decoder->framebuffer_entries[index]);
-		if (entry->mapped_virtual_address != NULL)
-			imx_dma_buffer_unmap(entry->fb_dma_buffer);
+		IMX_VPU_API_LOG("copying %zu byte(s) of leftover data from input DMA buffer into stream buffer", decoder->stream_buffer_fill_level);
+
+		imx_dma_buffer_start_sync_session(decoder->stream_buffer);
+		memcpy(decoder->stream_buffer_virtual_address, decoder->input_dma_buffer_virtual_address + decoder->stream_buffer_read_offset, decoder->stream_buffer_fill_level);
+		imx_dma_buffer_stop_sync_session(decoder->stream_buffer);
+
+		decoder->stream_buffer_read_offset = 0;
+		decoder->stream_buffer_write_offset = decoder->stream_buffer_fill_level;
+	}
+	else
+	{
+		decoder->stream_buffer_read_offset = 0;
+		decoder->stream_buffer_write_offset = 0;
+		decoder->stream_buffer_fill_level = 0;
 	}
 
-	free(decoder->framebuffer_entries);
-	decoder->framebuffer_entries = NULL;
-	decoder->num_framebuffer_entries = 0;
+	imx_dma_buffer_unmap(input_dma_buffer);
+
+	decoder->input_dma_buffer = NULL;
+	decoder->input_dma_buffer_virtual_address = NULL;
+	decoder->input_dma_buffer_physical_address = 0;
+	decoder->input_dma_buffer_size = 0;
+
+	IMX_VPU_API_LOG("released input DMA buffer %p", (void *)input_dma_buffer);
+
+	if (decoder->input_dma_buffer_release_callback != NULL)
+		decoder->input_dma_buffer_release_callback(decoder, input_dma_buffer, decoder->input_dma_buffer_release_callback_user_data);
+
+	decoder->input_dma_buffer_release_callback = NULL;
+	decoder->input_dma_buffer_release_callback_user_data = NULL;
 }
 
 
-static BOOL imx_vpu_api_dec_get_new_stream_info(ImxVpuApiDecoder *decoder)
+static ImxVpuApiDecReturnCodes imx_vpu_api_dec_check_if_push_is_allowed(ImxVpuApiDecoder *decoder, size_t main_data_size)
 {
-	CODEC_STATE codec_state;
-	STREAM_INFO hantro_stream_info = { 0 };
-	ImxVpuApiDecStreamInfo *stream_info = &(decoder->stream_info);
-	BOOL is_8bit;
-
-	codec_state = decoder->codec->getinfo(decoder->codec, &hantro_stream_info);
-	if (codec_state != CODEC_OK)
+	if (decoder->drain_mode_enabled)
 	{
-		IMX_VPU_API_ERROR("could not get stream info: %s (%d)", codec_state_to_string(codec_state), codec_state);
-		return FALSE;
+		IMX_VPU_API_ERROR("tried to push an encoded frame after drain mode was enabled");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
 	}
 
-	is_8bit = (hantro_stream_info.bit_depth != 10);
+	if (decoder->encoded_data_available)
+	{
+		if (decoder->num_queued_frames >= decoder->max_num_queued_frames)
+		{
+			IMX_VPU_API_ERROR("tried to push an encoded frame while %zu previously pushed frame(s) are not yet fully processed", decoder->num_queued_frames);
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+		}
 
-	stream_info->flags = 0;
+		/* The data of the queued frames is still in the stream buffer,
+		 * so there has to be enough room left for the new frame. Room
+		 * for a VC-1 frame layer header is added, since that is the only
+		 * header that may be inserted once the main header was pushed. */
+		if ((decoder->stream_buffer_fill_level + main_data_size + VC1_NAL_FRAME_LAYER_HEADER_MAX_SIZE) > decoder->stream_buffer_size)
+		{
+			IMX_VPU_API_ERROR("not enough room in stream buffer to queue an encoded frame with %zu byte(s); fill level: %zu byte(s)", main_data_size, decoder->stream_buffer_fill_level);
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+		}
+	}
 
-	switch ((int)(hantro_stream_info.format))
+	/* Make sure that the frame can get a frame entry before anything is
+	 * written into the stream buffer. This can only fail if the caller
+	 * holds on to a lot of decoded frames, or if entries were leaked. */
+	if (imx_vpu_api_get_free_frame_entry_index(decoder) == INVALID_FRAME_ENTRY_INDEX)
 	{
-		case OMX_COLOR_FormatYUV420Planar:
-		case OMX_COLOR_FormatYUV420PackedPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_10BIT;
-			break;
+		IMX_VPU_API_ERROR("cannot push an encoded frame since no free frame entry is available");
+		return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+	}
 
-		case OMX_COLOR_FormatYUV420SemiPlanar:
-		case OMX_COLOR_FormatYUV420PackedSemiPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_10BIT;
-			break;
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+}
 
-		case OMX_COLOR_FormatYUV411Planar:
-		case OMX_COLOR_FormatYUV411PackedPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV411_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV411_10BIT;
-			break;
 
-		case OMX_COLOR_FormatYUV411SemiPlanar:
-		case OMX_COLOR_FormatYUV411PackedSemiPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV411_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV411_10BIT;
-			break;
+static void imx_vpu_api_dec_add_pushed_frame_entry(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame, size_t num_pushed_bytes)
+{
+	size_t frame_entry_index;
+	FrameEntry *frame_entry;
+	QueuedFrame *queued_frame;
+
+	/* The queue can only be full here if the codec did not consume the
+	 * data of the queued frames and asked for more. This happens when
+	 * chunks are pushed in byte stream input mode that do not complete
+	 * a frame. The queue has a fixed size, so merge the last queued frame
+	 * into the one before it to make room. The first of several chunks
+	 * that make up a frame usually is the one the frame begins in, so the
+	 * merged chunk's context and timestamps are discarded, just like
+	 * those of a chunk in which no frame begins. The capacity is always
+	 * at least 2 (see imx_vpu_api_dec_open()), so the last queued frame
+	 * always has a predecessor here. */
+	if (decoder->num_queued_frames == decoder->queued_frames_capacity)
+	{
+		QueuedFrame *last_queued_frame = &(decoder->queued_frames[decoder->num_queued_frames - 1]);
+		queued_frame = last_queued_frame - 1;
 
-		case OMX_COLOR_FormatYUV422Planar:
-		case OMX_COLOR_FormatYUV422PackedPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_HORIZONTAL_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_HORIZONTAL_10BIT;
-			break;
+		IMX_VPU_API_LOG("input queue is full; merging queued frame with frame entry index %zu into the one before it", last_queued_frame->frame_entry_index);
 
-		case OMX_COLOR_FormatYUV422SemiPlanar:
-		case OMX_COLOR_FormatYUV422PackedSemiPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_HORIZONTAL_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_HORIZONTAL_10BIT;
-			break;
+		queued_frame->num_remaining_bytes += last_queued_frame->num_remaining_bytes;
+		if (!(last_queued_frame->frame_entry_used))
+			imx_vpu_api_dec_release_frame_entry(decoder, last_queued_frame->frame_entry_index);
+		decoder->num_queued_frames--;
+	}
 
-		case OMX_COLOR_FormatYUV440SemiPlanar:
-		case OMX_COLOR_FormatYUV440PackedSemiPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_VERTICAL_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_VERTICAL_10BIT;
-			break;
+	frame_entry_index = imx_vpu_api_get_free_frame_entry_index(decoder);
+	assert(frame_entry_index != INVALID_FRAME_ENTRY_INDEX);
+	imx_vpu_api_dec_occupy_frame_entry(decoder, frame_entry_index, decoder->num_pushed_frames);
 
-		case OMX_COLOR_FormatYUV444SemiPlanar:
-		case OMX_COLOR_FormatYUV444PackedSemiPlanar:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV444_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV444_10BIT;
-			break;
+	IMX_VPU_API_LOG("pushed frame with context %p PTS %" PRIu64 " DTS %" PRIu64 " frame entry index %zu and %zu bytes of main data", encoded_frame->context, encoded_frame->pts, encoded_frame->dts, frame_entry_index, encoded_frame->data_size);
 
-		case OMX_COLOR_FormatL8:
-			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT : IMX_VPU_API_COLOR_FORMAT_YUV400_10BIT;
-			break;
+	frame_entry = &(decoder->frame_entries[frame_entry_index]);
+	frame_entry->context = encoded_frame->context;
+	frame_entry->pts = encoded_frame->pts;
+	frame_entry->dts = encoded_frame->dts;
+	frame_entry->discard = decoder->discard_frames;
+	frame_entry->push_time = imx_vpu_api_get_monotonic_time();
+	frame_entry->push_number = decoder->num_pushed_frames++;
 
-		case OMX_COLOR_FormatYUV420SemiPlanar4x4Tiled:
-			stream_info->color_format = (ImxVpuApiColorFormat)(is_8bit ? IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_8BIT : IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_10BIT);
-			break;
+	queued_frame = &(decoder->queued_frames[decoder->num_queued_frames]);
+	queued_frame->frame_entry_index = frame_entry_index;
+	queued_frame->num_remaining_bytes = num_pushed_bytes;
+	queued_frame->frame_entry_used = FALSE;
+	queued_frame->discard = decoder->discard_frames;
+	queued_frame->push_time = frame_entry->push_time;
+	queued_frame->push_number = frame_entry->push_number;
+	decoder->num_queued_frames++;
 
-		case OMX_COLOR_FormatYUV420SemiPlanar8x4Tiled:
-			stream_info->color_format = (ImxVpuApiColorFormat)(is_8bit ? IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_8BIT : IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_10BIT);
-			break;
+	IMX_VPU_API_LOG("number of queued frames: %zu", decoder->num_queued_frames);
 
-		case OMX_COLOR_FormatYUV420SemiPlanarP010:
-			stream_info->color_format = (ImxVpuApiColorFormat)IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_P010_10BIT;
-			break;
+	decoder->encoded_data_available = TRUE;
 
-		default:
-			if (decoder->open_params.compression_format == IMX_VPU_API_COMPRESSION_FORMAT_DIVX3)
-			{
-				IMX_VPU_API_DEBUG("using workaround for bug in DivX 3 codec; it always outputs invalid color format, even though it is always actually semi-planar YUV420 8-bit");
-				stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT;
-			}
-			else
-			{
-				IMX_VPU_API_ERROR("unrecognized pixel format %#x", hantro_stream_info.format);
-				stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT;
-				return FALSE;
-			}
-	}
+	/* Clear end_of_stream_reached flag since feeding in data
+	 * means that we are no longer at the end of stream. */
+	decoder->end_of_stream_reached = FALSE;
+}
 
 
-	/* Determine if the chroma planes are interleaved. */
-	switch ((int)(hantro_stream_info.format))
-	{
-		case OMX_COLOR_FormatYUV420Planar:
-		case OMX_COLOR_FormatYUV420PackedPlanar:
-		case OMX_COLOR_FormatYUV411Planar:
-		case OMX_COLOR_FormatYUV411PackedPlanar:
-		case OMX_COLOR_FormatL8:
-			break;
+static QueuedFrame* imx_vpu_api_dec_find_queued_frame(ImxVpuApiDecoder *decoder, size_t offset)
+{
+	size_t i;
 
-		case OMX_COLOR_FormatYUV420SemiPlanar:
-		case OMX_COLOR_FormatYUV420PackedSemiPlanar:
-		case OMX_COLOR_FormatYUV411SemiPlanar:
-		case OMX_COLOR_FormatYUV411PackedSemiPlanar:
-		case OMX_COLOR_FormatYUV440SemiPlanar:
-		case OMX_COLOR_FormatYUV440PackedSemiPlanar:
-		case OMX_COLOR_FormatYUV444SemiPlanar:
-		case OMX_COLOR_FormatYUV444PackedSemiPlanar:
-			stream_info->flags |= IMX_VPU_API_DEC_STREAM_INFO_FLAG_SEMI_PLANAR_FRAMES;
-			break;
+	assert(decoder != NULL);
 
-		default:
-			break;
+	/* Look for the queued frame that contains the byte
+	 * at the given offset (relative to the read offset). */
+	for (i = 0; i < decoder->num_queued_frames; ++i)
+	{
+		QueuedFrame *queued_frame = &(decoder->queued_frames[i]);
+		if (offset < queued_frame->num_remaining_bytes)
+			return queued_frame;
+		offset -= queued_frame->num_remaining_bytes;
 	}
 
-	codec_state = decoder->codec->setnoreorder(decoder->codec, (decoder->open_params.flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_FRAME_REORDERING) ? OMX_FALSE : OMX_TRUE);
-	IMX_VPU_API_DEBUG("setnoreorder() called;  frame reordering: %d  codec state: %s (%d)", !!(decoder->open_params.flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_FRAME_REORDERING), codec_state_to_string(codec_state), codec_state);
+	return NULL;
+}
+
+
+static BOOL imx_vpu_api_dec_associate_picture_with_frame_entry(ImxVpuApiDecoder *decoder, size_t offset)
+{
+	size_t frame_entry_index;
+	FrameEntry *frame_entry;
+	QueuedFrame *queued_frame;
+
+	assert(decoder != NULL);
+
+	/* Set current_frame_entry_index to the frame entry for the picture
+	 * whose first byte is at the given offset (relative to the read
+	 * offset). That is the frame entry of the queued frame this byte
+	 * belongs to. If no such queued frame exists (which should not
+	 * happen), keep the previous association. Also keep it if decode()
+	 * did not consume anything of the previous picture, since this then
+	 * is the same picture again. */
+
+	if (decoder->current_picture_pending && (decoder->current_frame_entry_index != INVALID_FRAME_ENTRY_INDEX) && decoder->frame_entries[decoder->current_frame_entry_index].occupied)
+		return TRUE;
+
+	queued_frame = imx_vpu_api_dec_find_queued_frame(decoder, offset);
+	if (queued_frame == NULL)
+		return TRUE;
+
+	/* Pushed frames are complete frames unless byte stream input is used,
+	 * so if a pushed frame yields more than one picture, these pictures
+	 * are parts of the same frame (fields for example), and share the
+	 * frame entry. In byte stream input mode, the pictures are separate
+	 * frames that happen to begin in the same pushed chunk. Only the
+	 * first one gets the chunk's frame entry; the others get new frame
+	 * entries without context and timestamps. */
+	if (!(queued_frame->frame_entry_used) || !(decoder->byte_stream_input))
+	{
+		queued_frame->frame_entry_used = TRUE;
+		decoder->current_frame_entry_index = queued_frame->frame_entry_index;
+		return TRUE;
+	}
+
+	frame_entry_index = imx_vpu_api_get_free_frame_entry_index(decoder);
+	if (frame_entry_index == INVALID_FRAME_ENTRY_INDEX)
+		return FALSE;
+	imx_vpu_api_dec_occupy_frame_entry(decoder, frame_entry_index, queued_frame->push_number);
+
+	frame_entry = &(decoder->frame_entries[frame_entry_index]);
+	frame_entry->context = NULL;
+	frame_entry->pts = IMX_VPU_API_NO_TIMESTAMP;
+	frame_entry->dts = IMX_VPU_API_NO_TIMESTAMP;
+	frame_entry->discard = queued_frame->discard;
+	frame_entry->push_time = queued_frame->push_time;
+	frame_entry->push_number = queued_frame->push_number;
+
+	IMX_VPU_API_LOG("picture begins in pushed chunk whose frame entry is already in use; using new frame entry with index %zu", frame_entry_index);
+
+	decoder->current_frame_entry_index = frame_entry_index;
+
+	return TRUE;
+}
+
+
+static void imx_vpu_api_dec_remove_consumed_queued_frames(ImxVpuApiDecoder *decoder, size_t num_consumed_bytes)
+{
+	size_t num_consumed_frames = 0;
+
+	assert(decoder != NULL);
+
+	while ((num_consumed_bytes > 0) && (num_consumed_frames < decoder->num_queued_frames))
+	{
+		QueuedFrame *queued_frame = &(decoder->queued_frames[num_consumed_frames]);
+
+		if (num_consumed_bytes < queued_frame->num_remaining_bytes)
+		{
+			queued_frame->num_remaining_bytes -= num_consumed_bytes;
+			break;
+		}
+
+		num_consumed_bytes -= queued_frame->num_remaining_bytes;
+		num_consumed_frames++;
+
+		if (!(queued_frame->frame_entry_used))
+		{
+			IMX_VPU_API_LOG("all data of queued frame with frame entry index %zu was consumed without a picture beginning in it; releasing frame entry", queued_frame->frame_entry_index);
+			imx_vpu_api_dec_release_frame_entry(decoder, queued_frame->frame_entry_index);
+		}
+	}
+
+	if (num_consumed_frames == 0)
+		return;
+
+	/* The queue is short, so just move the remaining entries to the front. */
+	decoder->num_queued_frames -= num_consumed_frames;
+	memmove(decoder->queued_frames, decoder->queued_frames + num_consumed_frames, sizeof(QueuedFrame) * decoder->num_queued_frames);
+
+	IMX_VPU_API_LOG("codec consumed all data of %zu queued frame(s); %zu queued frame(s) left", num_consumed_frames, decoder->num_queued_frames);
+}
+
+
+static BOOL imx_vpu_api_dec_is_frame_excluded(ImxVpuApiDecoder *decoder, uint8_t const *data, size_t data_size, ImxVpuApiDecSkippedFrameReasons *reason)
+{
+	uint32_t properties;
+
+	assert(decoder != NULL);
+	assert(reason != NULL);
+
+	if (decoder->open_params.compression_format == IMX_VPU_API_COMPRESSION_FORMAT_H265)
+		imx_vpu_api_update_h265_highest_temporal_id(data, data_size, decoder->nal_length_size, &(decoder->h265_highest_temporal_id));
+
+	if (imx_vpu_api_dec_is_frame_excluded_by_skip_mode(decoder->skip_mode, decoder->open_params.compression_format, data, data_size, decoder->nal_length_size, decoder->h265_highest_temporal_id))
+	{
+		*reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_SKIP_MODE;
+		return TRUE;
+	}
+
+	if (!(decoder->resync_pending))
+		return FALSE;
+
+	/* During a resync, everything up to the next random access point is
+	 * discarded. Frames whose properties are unknown end the resync,
+	 * since otherwise, formats that the parser does not support would
+	 * never be decoded again. */
+	if (imx_vpu_api_parse_frame_properties(decoder->open_params.compression_format, data, data_size, decoder->nal_length_size, &properties) && !(properties & IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT))
+	{
+		*reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_RESYNC;
+		return TRUE;
+	}
+
+	IMX_VPU_API_DEBUG("found frame to resume decoding at; resync finished");
+	decoder->resync_pending = FALSE;
+
+	return FALSE;
+}
+
+
+static void imx_vpu_api_dec_add_pending_skipped_frame(ImxVpuApiDecoder *decoder, void *context, uint64_t pts, uint64_t dts, ImxVpuApiDecSkippedFrameReasons reason, uint64_t push_number)
+{
+	SkippedFrame *skipped_frame;
+
+	assert(decoder != NULL);
+
+	if (decoder->num_pending_skipped_frames == decoder->pending_skipped_frames_capacity)
+	{
+		size_t i;
+		size_t new_capacity = (decoder->pending_skipped_frames_capacity > 0) ? (decoder->pending_skipped_frames_capacity * 2) : 8;
+		SkippedFrame *new_pending_skipped_frames = malloc(sizeof(SkippedFrame) * new_capacity);
+		assert(new_pending_skipped_frames != NULL);
+
+		/* Unwrap the ring buffer contents while copying them. */
+		for (i = 0; i < decoder->num_pending_skipped_frames; ++i)
+			new_pending_skipped_frames[i] = decoder->pending_skipped_frames[(decoder->first_pending_skipped_frame_index + i) % decoder->pending_skipped_frames_capacity];
+
+		IMX_VPU_API_DEBUG("(re)allocated space for %zu pending skipped frames", new_capacity);
+
+		free(decoder->pending_skipped_frames);
+		decoder->pending_skipped_frames = new_pending_skipped_frames;
+		decoder->pending_skipped_frames_capacity = new_capacity;
+		decoder->first_pending_skipped_frame_index = 0;
+	}
+
+	skipped_frame = &(decoder->pending_skipped_frames[(decoder->first_pending_skipped_frame_index + decoder->num_pending_skipped_frames) % decoder->pending_skipped_frames_capacity]);
+	skipped_frame->context = context;
+	skipped_frame->pts = pts;
+	skipped_frame->dts = dts;
+	skipped_frame->reason = reason;
+	skipped_frame->push_number = push_number;
+	decoder->num_pending_skipped_frames++;
+}
+
+
+static BOOL imx_vpu_api_dec_report_pending_skipped_frame(ImxVpuApiDecoder *decoder, BOOL force)
+{
+	SkippedFrame *skipped_frame;
+
+	assert(decoder != NULL);
+
+	if (decoder->num_pending_skipped_frames == 0)
+		return FALSE;
+
+	skipped_frame = &(decoder->pending_skipped_frames[decoder->first_pending_skipped_frame_index]);
+
+	/* Frames that were pushed earlier and are still in the decoder
+	 * have to be output (or reported as skipped) first. The oldest
+	 * of them is at the head of the occupied list. */
+	if (!force && (decoder->first_occupied_frame_entry_index != INVALID_FRAME_ENTRY_INDEX))
+	{
+		if (decoder->frame_entries[decoder->first_occupied_frame_entry_index].push_number < skipped_frame->push_number)
+			return FALSE;
+	}
+
+	decoder->skipped_frame_reason = skipped_frame->reason;
+	decoder->skipped_frame_context = skipped_frame->context;
+	decoder->skipped_frame_pts = skipped_frame->pts;
+	decoder->skipped_frame_dts = skipped_frame->dts;
+
+	decoder->first_pending_skipped_frame_index = (decoder->first_pending_skipped_frame_index + 1) % decoder->pending_skipped_frames_capacity;
+	decoder->num_pending_skipped_frames--;
+
+	IMX_VPU_API_LOG("reporting frame with context %p PTS %" PRIu64 " DTS %" PRIu64 " as skipped (reason: %s)", decoder->skipped_frame_context, decoder->skipped_frame_pts, decoder->skipped_frame_dts, imx_vpu_api_dec_skipped_frame_reason_string(decoder->skipped_frame_reason));
+
+	return TRUE;
+}
+
+
+static void imx_vpu_api_dec_abort_codec(ImxVpuApiDecoder *decoder)
+{
+	CODEC_STATE codec_state;
+	BOOL do_loop = TRUE;
+	FRAME frame = { 0 };
+
+	assert(decoder != NULL);
+	assert(decoder->codec != NULL);
+
+	while (do_loop)
+	{
+		codec_state = decoder->codec->getframe(decoder->codec, &frame, decoder->drain_mode_enabled ? OMX_TRUE : OMX_FALSE);
+		IMX_VPU_API_DEBUG("attempting to retrieve frame (to discard it) before aborting; codec state: %s (%d)", codec_state_to_string(codec_state), codec_state);
+		switch (codec_state)
+		{
+			case CODEC_HAS_FRAME:
+			{
+				BUFFER buffer = { 0 };
+
+				buffer.bus_data = frame.fb_bus_data;
+				buffer.bus_address = frame.fb_bus_address;
+
+				codec_state = decoder->codec->pictureconsumed(decoder->codec, &buffer);
+				IMX_VPU_API_DEBUG("discarded picture before aborting;  virtual address %p  physical address %" IMX_PHYSICAL_ADDRESS_FORMAT "  codec state: %s (%d)", (void*)(frame.fb_bus_data), (imx_physical_address_t)(frame.fb_bus_address), codec_state_to_string(codec_state), codec_state);
+
+				break;
+			}
+
+			default:
+				do_loop = FALSE;
+				break;
+		}
+	}
+
+	codec_state = decoder->codec->abort(decoder->codec);
+	if (codec_state != CODEC_OK)
+		IMX_VPU_API_ERROR("error while calling abort(): %s (%d)", codec_state_to_string(codec_state), codec_state);
+	codec_state = decoder->codec->abortafter(decoder->codec);
+	if (codec_state != CODEC_OK)
+		IMX_VPU_API_ERROR("error while calling abortafter(): %s (%d)", codec_state_to_string(codec_state), codec_state);
+}
+
+
+static void imx_vpu_api_dec_begin_resync(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+
+	IMX_VPU_API_DEBUG("bitstream error; discarding queued data and resyncing to the next random access point");
+
+	/* Abort the codec first, like a flush does. Otherwise, it would still
+	 * refer to stream buffer data that is about to be dropped, and to the
+	 * state of the stream that was lost. Just like in a flush, this is
+	 * only done once the pool is set up. */
+	if (decoder->framebuffer_entries != NULL)
+		imx_vpu_api_dec_abort_codec(decoder);
+
+	/* The abort discarded all frames that the codec was working on, and
+	 * the frames that are still queued in the stream buffer most likely
+	 * refer to the one that failed. Report all of them as skipped, in the
+	 * order in which they were pushed, and release their frame entries.
+	 * This includes the entries of queued frames that were already passed
+	 * to the codec. The frame that failed was already released by the
+	 * caller, and a decoded frame that was output is not in an entry
+	 * anymore, so every occupied entry belongs to a lost frame. */
+	while (decoder->first_occupied_frame_entry_index != INVALID_FRAME_ENTRY_INDEX)
+	{
+		size_t oldest_index = decoder->first_occupied_frame_entry_index;
+		FrameEntry *frame_entry = &(decoder->frame_entries[oldest_index]);
+
+		imx_vpu_api_dec_add_pending_skipped_frame(decoder, frame_entry->context, frame_entry->pts, frame_entry->dts, frame_entry->discard ? IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_DISCARDED : IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_RESYNC, frame_entry->push_number);
+		imx_vpu_api_dec_release_frame_entry(decoder, oldest_index);
+	}
+
+	decoder->num_queued_frames = 0;
+	decoder->current_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	decoder->current_picture_pending = FALSE;
+
+	imx_vpu_api_dec_release_input_dma_buffer(decoder, FALSE);
+
+	decoder->stream_buffer_read_offset = 0;
+	decoder->stream_buffer_write_offset = 0;
+	decoder->stream_buffer_fill_level = 0;
+
+	decoder->encoded_data_available = FALSE;
+
+	/* The abort made the codec forget the stream headers, so push
+	 * them again along with the frame that ends the resync. */
+	decoder->main_header_pushed = FALSE;
+	imx_vpu_api_stream_header_cache_schedule_reinsertion(&(decoder->stream_header_cache));
+
+	decoder->resync_pending = TRUE;
+}
+
+
+static void imx_vpu_api_dec_reset_after_hardware_error(ImxVpuApiDecoder *decoder, CODEC_STATE codec_state)
+{
+	assert(decoder != NULL);
+
+	IMX_VPU_API_ERROR("hardware error during decoding:  codec state %s (%d); resetting decoder", codec_state_to_string(codec_state), codec_state);
+
+	/* The abort() and abortafter() calls in the flush reinitialize the
+	 * codec's internal state. The framebuffers that were handed over to
+	 * the codec are kept, so the pool does not have to be set up again. */
+	imx_vpu_api_dec_flush(decoder);
+
+	decoder->num_hardware_resets++;
+	IMX_VPU_API_DEBUG("decoder reset; %u reset(s) so far", decoder->num_hardware_resets);
+}
+
+
+static BOOL imx_vpu_api_dec_grow_frame_entry_pool(ImxVpuApiDecoder *decoder, size_t new_num_entries)
+{
+	size_t index;
+	FrameEntry *new_entries;
+
+	assert(decoder != NULL);
+
+	if (new_num_entries <= decoder->num_frame_entries)
+		return TRUE;
+
+	/* Entries are referred to by index, so moving them is fine. */
+	new_entries = realloc(decoder->frame_entries, sizeof(FrameEntry) * new_num_entries);
+	if (new_entries == NULL)
+	{
+		IMX_VPU_API_ERROR("could not allocate space for %zu frame entries", new_num_entries);
+		return FALSE;
+	}
+
+	IMX_VPU_API_DEBUG("(re)allocated space for frame entry pool; old size: %zu new size: %zu", decoder->num_frame_entries, new_num_entries);
+
+	memset(&new_entries[decoder->num_frame_entries], 0, sizeof(FrameEntry) * (new_num_entries - decoder->num_frame_entries));
+
+	/* Prepend the new entries to the free list. This is done in
+	 * reverse order so that the lowest new index comes first. */
+	for (index = new_num_entries; index > decoder->num_frame_entries; --index)
+	{
+		new_entries[index - 1].next_free_index = decoder->first_free_frame_entry_index;
+		decoder->first_free_frame_entry_index = index - 1;
+	}
+
+	decoder->num_frame_entries = new_num_entries;
+	decoder->frame_entries = new_entries;
+
+	return TRUE;
+}
+
+
+static size_t imx_vpu_api_get_free_frame_entry_index(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+
+	if (decoder->first_free_frame_entry_index == INVALID_FRAME_ENTRY_INDEX)
+		IMX_VPU_API_ERROR("all %zu frame entries are occupied", decoder->num_frame_entries);
+
+	return decoder->first_free_frame_entry_index;
+}
+
+
+static void imx_vpu_api_dec_occupy_frame_entry(ImxVpuApiDecoder *decoder, size_t index, uint64_t push_number)
+{
+	FrameEntry *entry;
+	size_t prev_index;
+
+	assert(decoder != NULL);
+	assert(index == decoder->first_free_frame_entry_index);
+
+	entry = &(decoder->frame_entries[index]);
+	assert(!(entry->occupied));
+
+	decoder->first_free_frame_entry_index = entry->next_free_index;
+
+	entry->occupied = TRUE;
+	entry->next_free_index = INVALID_FRAME_ENTRY_INDEX;
+	entry->push_number = push_number;
+
+	/* Keep the occupied list sorted by push number. Entries are
+	 * almost always occupied in push order, so search from the tail.
+	 * Equal push numbers stay in the order they were occupied in. */
+	prev_index = decoder->last_occupied_frame_entry_index;
+	while ((prev_index != INVALID_FRAME_ENTRY_INDEX) && (decoder->frame_entries[prev_index].push_number > push_number))
+		prev_index = decoder->frame_entries[prev_index].prev_occupied_index;
+
+	entry->prev_occupied_index = prev_index;
+	if (prev_index == INVALID_FRAME_ENTRY_INDEX)
+	{
+		entry->next_occupied_index = decoder->first_occupied_frame_entry_index;
+		decoder->first_occupied_frame_entry_index = index;
+	}
+	else
+	{
+		entry->next_occupied_index = decoder->frame_entries[prev_index].next_occupied_index;
+		decoder->frame_entries[prev_index].next_occupied_index = index;
+	}
+
+	if (entry->next_occupied_index == INVALID_FRAME_ENTRY_INDEX)
+		decoder->last_occupied_frame_entry_index = index;
+	else
+		decoder->frame_entries[entry->next_occupied_index].prev_occupied_index = index;
+}
+
+
+static void imx_vpu_api_dec_release_frame_entry(ImxVpuApiDecoder *decoder, size_t index)
+{
+	FrameEntry *entry;
+
+	assert(decoder != NULL);
+	assert(index < decoder->num_frame_entries);
+
+	entry = &(decoder->frame_entries[index]);
+
+	/* Releasing an entry twice would corrupt the lists. */
+	if (!(entry->occupied))
+		return;
+
+	if (entry->prev_occupied_index == INVALID_FRAME_ENTRY_INDEX)
+		decoder->first_occupied_frame_entry_index = entry->next_occupied_index;
+	else
+		decoder->frame_entries[entry->prev_occupied_index].next_occupied_index = entry->next_occupied_index;
+
+	if (entry->next_occupied_index == INVALID_FRAME_ENTRY_INDEX)
+		decoder->last_occupied_frame_entry_index = entry->prev_occupied_index;
+	else
+		decoder->frame_entries[entry->next_occupied_index].prev_occupied_index = entry->prev_occupied_index;
+
+	entry->occupied = FALSE;
+	entry->next_free_index = decoder->first_free_frame_entry_index;
+	decoder->first_free_frame_entry_index = index;
+}
+
+
+static void imx_vpu_api_dec_release_all_frame_entries(ImxVpuApiDecoder *decoder)
+{
+	size_t index;
+
+	assert(decoder != NULL);
+
+	IMX_VPU_API_LOG("releasing all %zu frame entries", decoder->num_frame_entries);
+
+	decoder->first_free_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	decoder->first_occupied_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	decoder->last_occupied_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+
+	for (index = decoder->num_frame_entries; index > 0; --index)
+	{
+		FrameEntry *entry = &(decoder->frame_entries[index - 1]);
+		entry->occupied = FALSE;
+		entry->next_free_index = decoder->first_free_frame_entry_index;
+		decoder->first_free_frame_entry_index = index - 1;
+	}
+}
+
+
+static void imx_vpu_api_dec_clear_frame_entries(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	IMX_VPU_API_LOG("clearing %zu frame entries", decoder->num_frame_entries);
+	free(decoder->frame_entries);
+	decoder->frame_entries = NULL;
+	decoder->num_frame_entries = 0;
+	decoder->first_free_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	decoder->first_occupied_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	decoder->last_occupied_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+}
+
+
+static size_t imx_vpu_api_dec_hash_physical_address(imx_physical_address_t physical_address)
+{
+	/* Framebuffers are page aligned, so the lower 12 bits carry no
+	 * information. The remaining bits are scrambled by multiplying with
+	 * 2^64 divided by the golden ratio (Fibonacci hashing), and folding
+	 * the upper half in, since the table index uses the lowest bits. */
+	uint64_t hash = ((uint64_t)physical_address >> 12) * UINT64_C(0x9E3779B97F4A7C15);
+	return (size_t)(hash ^ (hash >> 32));
+}
+
+
+static void imx_vpu_api_dec_insert_framebuffer_entry_into_hash_table(ImxVpuApiDecoder *decoder, size_t index)
+{
+	size_t slot, mask;
+	imx_physical_address_t physical_address;
+
+	assert(decoder != NULL);
+	assert(decoder->framebuffer_entry_hash_table != NULL);
+	assert(index < decoder->num_framebuffer_entries);
+
+	physical_address = decoder->framebuffer_entries[index].physical_address;
+	if (physical_address == 0)
+		return;
+
+	mask = decoder->framebuffer_entry_hash_table_size - 1;
+
+	for (slot = imx_vpu_api_dec_hash_physical_address(physical_address) & mask; ; slot = (slot + 1) & mask)
+	{
+		size_t existing_index = decoder->framebuffer_entry_hash_table[slot];
+
+		if (existing_index == INVALID_FRAME_ENTRY_INDEX)
+		{
+			decoder->framebuffer_entry_hash_table[slot] = index;
+			return;
+		}
+
+		/* If the same physical address was added before, keep
+		 * the older entry, since that one is found first. */
+		if (decoder->framebuffer_entries[existing_index].physical_address == physical_address)
+			return;
+	}
+}
+
+
+static void imx_vpu_api_dec_rebuild_framebuffer_entry_hash_table(ImxVpuApiDecoder *decoder)
+{
+	size_t index;
+
+	assert(decoder != NULL);
+
+	if (decoder->framebuffer_entry_hash_table == NULL)
+		return;
+
+	/* The table size is not changed, since removing entries
+	 * never makes the table too small. */
+	for (index = 0; index < decoder->framebuffer_entry_hash_table_size; ++index)
+		decoder->framebuffer_entry_hash_table[index] = INVALID_FRAME_ENTRY_INDEX;
+
+	for (index = 0; index < decoder->num_framebuffer_entries; ++index)
+		imx_vpu_api_dec_insert_framebuffer_entry_into_hash_table(decoder, index);
+}
+
+
+static void imx_vpu_api_dec_remove_retired_framebuffer_entry(ImxVpuApiDecoder *decoder, size_t index)
+{
+	FramebufferEntry *entry;
+
+	assert(decoder != NULL);
+	assert(index < decoder->num_framebuffer_entries);
+
+	entry = &(decoder->framebuffer_entries[index]);
+	assert(entry->retired);
+
+	IMX_VPU_API_DEBUG("removing retired framebuffer with physical address %" IMX_PHYSICAL_ADDRESS_FORMAT " from the pool", entry->physical_address);
+
+	if (entry->mapped_virtual_address != NULL)
+		imx_dma_buffer_unmap(entry->fb_dma_buffer);
+
+	decoder->num_framebuffer_entries--;
+	decoder->num_retired_framebuffer_entries--;
+	memmove(entry, entry + 1, sizeof(FramebufferEntry) * (decoder->num_framebuffer_entries - index));
+
+	/* The entries after the removed one moved down by one. */
+	if ((decoder->decoded_frame_fb_entry_index != INVALID_FRAME_ENTRY_INDEX) && (decoder->decoded_frame_fb_entry_index > index))
+		decoder->decoded_frame_fb_entry_index--;
+
+	imx_vpu_api_dec_rebuild_framebuffer_entry_hash_table(decoder);
+}
+
+
+static size_t imx_vpu_api_dec_find_framebuffer_entry_index(ImxVpuApiDecoder *decoder, imx_physical_address_t physical_address)
+{
+	size_t slot, mask;
+
+	assert(decoder != NULL);
+	assert(physical_address != 0);
+
+	if (decoder->framebuffer_entry_hash_table == NULL)
+		return INVALID_FRAME_ENTRY_INDEX;
+
+	mask = decoder->framebuffer_entry_hash_table_size - 1;
+
+	/* The table is never full, so this loop always reaches an empty slot
+	 * if the physical address is not in the table. */
+	for (slot = imx_vpu_api_dec_hash_physical_address(physical_address) & mask; ; slot = (slot + 1) & mask)
+	{
+		size_t index = decoder->framebuffer_entry_hash_table[slot];
+
+		if (index == INVALID_FRAME_ENTRY_INDEX)
+			return INVALID_FRAME_ENTRY_INDEX;
+
+		if (decoder->framebuffer_entries[index].physical_address == physical_address)
+			return index;
+	}
+}
+
+
+static size_t imx_vpu_api_dec_add_framebuffer_entries(ImxVpuApiDecoder *decoder, size_t num_new_entries)
+{
+	int new_entries_index;
+	FramebufferEntry *new_entries;
+
+	assert(decoder != NULL);
+	assert(num_new_entries > 0);
+
+	new_entries = realloc(decoder->framebuffer_entries, sizeof(FramebufferEntry) * (decoder->num_framebuffer_entries + num_new_entries));
+	assert(new_entries != NULL);
+
+	new_entries_index = decoder->num_framebuffer_entries;
+	IMX_VPU_API_DEBUG("(re)allocated space for additional %d framebuffer entries", num_new_entries);
+	decoder->num_framebuffer_entries += num_new_entries;
+	decoder->framebuffer_entries = new_entries;
+
+	memset(&decoder->framebuffer_entries[new_entries_index], 0, sizeof(FramebufferEntry) * num_new_entries);
+
+	/* Grow the hash table if necessary, and reinsert the existing entries.
+	 * The new entries are inserted once their physical addresses are known. */
+	if (decoder->framebuffer_entry_hash_table_size < (decoder->num_framebuffer_entries * 2))
+	{
+		size_t i;
+		size_t new_table_size = 16;
+
+		while (new_table_size < (decoder->num_framebuffer_entries * 2))
+			new_table_size *= 2;
+
+		free(decoder->framebuffer_entry_hash_table);
+		decoder->framebuffer_entry_hash_table = malloc(sizeof(size_t) * new_table_size);
+		assert(decoder->framebuffer_entry_hash_table != NULL);
+		decoder->framebuffer_entry_hash_table_size = new_table_size;
+
+		IMX_VPU_API_DEBUG("(re)allocated framebuffer entry hash table with %zu slots", new_table_size);
+
+		for (i = 0; i < new_table_size; ++i)
+			decoder->framebuffer_entry_hash_table[i] = INVALID_FRAME_ENTRY_INDEX;
+
+		for (i = 0; i < (size_t)new_entries_index; ++i)
+			imx_vpu_api_dec_insert_framebuffer_entry_into_hash_table(decoder, i);
+	}
+
+	return new_entries_index;
+}
+
+
+static void imx_vpu_api_dec_clear_added_framebuffers(ImxVpuApiDecoder *decoder)
+{
+	size_t index;
+
+	assert(decoder != NULL);
+
+	IMX_VPU_API_LOG("clearing %zu added framebuffer(s)", decoder->num_framebuffer_entries);
+
+	for (index = 0; index < decoder->num_framebuffer_entries; ++index)
+	{
+		FramebufferEntry *entry = &(decoder->framebuffer_entries[index]);
+		if (entry->mapped_virtual_address != NULL)
+			imx_dma_buffer_unmap(entry->fb_dma_buffer);
+	}
+
+	free(decoder->framebuffer_entries);
+	decoder->framebuffer_entries = NULL;
+	decoder->num_framebuffer_entries = 0;
+	decoder->num_retired_framebuffer_entries = 0;
+
+	free(decoder->framebuffer_entry_hash_table);
+	decoder->framebuffer_entry_hash_table = NULL;
+	decoder->framebuffer_entry_hash_table_size = 0;
+}
+
+
+static size_t imx_vpu_api_dec_reuse_added_framebuffers(ImxVpuApiDecoder *decoder)
+{
+	size_t index, num_kept_entries = 0, num_reusable_entries = 0, num_reused_entries = 0;
+	size_t min_size, alignment;
+
+	assert(decoder != NULL);
+
+	min_size = decoder->stream_info.min_fb_pool_framebuffer_size;
+	alignment = decoder->stream_info.fb_pool_framebuffer_alignment;
+
+	/* Go through the old framebuffers and hand those that fit the new
+	 * stream info over to the codec again. Entries that are kept are
+	 * moved to the beginning of the array, in their original order.
+	 * Framebuffers that are still held by the user are not reused,
+	 * since the codec would otherwise consider them free and could
+	 * overwrite their contents. They are not dropped either, since the
+	 * user may still access them. Instead, they are retired, and removed
+	 * once the user returns them. The remaining framebuffers are unmapped
+	 * and dropped, so the user can deallocate them. */
+	for (index = 0; index < decoder->num_framebuffer_entries; ++index)
+	{
+		FramebufferEntry *entry = &(decoder->framebuffer_entries[index]);
+		size_t dma_buffer_size = imx_dma_buffer_get_size(entry->fb_dma_buffer);
+		BOOL is_aligned = (alignment <= 1) || ((entry->physical_address % alignment) == 0);
+
+		if (entry->held_by_user)
+		{
+			IMX_VPU_API_DEBUG("retiring framebuffer with physical address %" IMX_PHYSICAL_ADDRESS_FORMAT " until the user returns it", entry->physical_address);
+			if (!(entry->retired))
+				decoder->num_retired_framebuffer_entries++;
+			entry->retired = TRUE;
+		}
+		else if ((dma_buffer_size < min_size) || !is_aligned)
+		{
+			IMX_VPU_API_DEBUG("not reusing framebuffer with physical address %" IMX_PHYSICAL_ADDRESS_FORMAT ":  size %zu", entry->physical_address, dma_buffer_size);
+			if (entry->mapped_virtual_address != NULL)
+				imx_dma_buffer_unmap(entry->fb_dma_buffer);
+			continue;
+		}
+		else
+			++num_reusable_entries;
+
+		if (num_kept_entries != index)
+			decoder->framebuffer_entries[num_kept_entries] = *entry;
+		++num_kept_entries;
+	}
+
+	decoder->num_framebuffer_entries = num_kept_entries;
+
+	/* Hand the reusable framebuffers over to the codec. They are counted
+	 * just like in imx_vpu_api_dec_add_framebuffers_to_pool(), where the
+	 * number of framebuffers that are set in one go is passed to the
+	 * setframebuffer() calls. Framebuffers that the codec rejects are
+	 * dropped as well. */
+	num_kept_entries = 0;
+	for (index = 0; index < decoder->num_framebuffer_entries; ++index)
+	{
+		FramebufferEntry *entry = &(decoder->framebuffer_entries[index]);
+		CODEC_STATE codec_state;
+		BUFFER buffer = { 0 };
+
+		if (!(entry->retired))
+		{
+			buffer.bus_data = entry->mapped_virtual_address;
+			buffer.bus_address = (OSAL_BUS_WIDTH)(entry->physical_address);
+			buffer.allocsize = imx_dma_buffer_get_size(entry->fb_dma_buffer);
+
+			codec_state = decoder->codec->setframebuffer(decoder->codec, &buffer, num_reusable_entries);
+			if ((codec_state != CODEC_OK) && (codec_state != CODEC_NEED_MORE))
+			{
+				IMX_VPU_API_ERROR("could not re-add framebuffer with physical address %" IMX_PHYSICAL_ADDRESS_FORMAT ": %s", entry->physical_address, codec_state_to_string(codec_state));
+				imx_dma_buffer_unmap(entry->fb_dma_buffer);
+				continue;
+			}
+
+			++num_reused_entries;
+		}
+
+		if (num_kept_entries != index)
+			decoder->framebuffer_entries[num_kept_entries] = *entry;
+		++num_kept_entries;
+	}
+
+	IMX_VPU_API_LOG("reusing %zu of %zu reusable framebuffer(s); %zu framebuffer(s) retired", num_reused_entries, num_reusable_entries, decoder->num_retired_framebuffer_entries);
+
+	decoder->num_framebuffer_entries = num_kept_entries;
+
+	if (num_kept_entries == 0)
+	{
+		free(decoder->framebuffer_entries);
+		decoder->framebuffer_entries = NULL;
+	}
+
+	/* The indices of the kept entries may have changed,
+	 * so the hash table has to be rebuilt. */
+	imx_vpu_api_dec_rebuild_framebuffer_entry_hash_table(decoder);
+
+	return num_reused_entries;
+}
+
+
+static size_t imx_vpu_api_dec_get_total_num_needed_framebuffers(ImxVpuApiDecoder *decoder)
+{
+	CODEC_STATE codec_state;
+	FRAME_BUFFER_INFO fb_info = { 0 };
+
+	/* Not all codecs implement getframebufferinfo(). */
+	if (decoder->codec->getframebufferinfo == NULL)
+		return 0;
+
+	codec_state = decoder->codec->getframebufferinfo(decoder->codec, &fb_info);
+	if (codec_state != CODEC_OK)
+	{
+		IMX_VPU_API_DEBUG("could not get framebuffer info: %s (%d)", codec_state_to_string(codec_state), codec_state);
+		return 0;
+	}
+
+	IMX_VPU_API_LOG("framebuffer info:  buffer size %zu  number of buffers %zu", (size_t)(fb_info.bufferSize), (size_t)(fb_info.numberOfBuffers));
+
+	return fb_info.numberOfBuffers;
+}
+
+
+static size_t imx_vpu_api_dec_get_num_missing_framebuffers(ImxVpuApiDecoder *decoder)
+{
+	/* The codec reports the total number of framebuffers it needs,
+	 * so subtract the ones that are already in the pool. If the
+	 * codec does not know how many are missing, request just one.
+	 * It will ask for more later if that is not enough. */
+	size_t total_num_needed_framebuffers = imx_vpu_api_dec_get_total_num_needed_framebuffers(decoder);
+	/* Retired framebuffers are not used by the codec anymore. */
+	size_t num_framebuffers_in_codec = decoder->num_framebuffer_entries - decoder->num_retired_framebuffer_entries;
+
+	if (total_num_needed_framebuffers <= num_framebuffers_in_codec)
+		return 1;
+	else
+		return total_num_needed_framebuffers - num_framebuffers_in_codec;
+}
+
+
+static BOOL imx_vpu_api_dec_get_new_stream_info(ImxVpuApiDecoder *decoder)
+{
+	CODEC_STATE codec_state;
+	STREAM_INFO hantro_stream_info = { 0 };
+	ImxVpuApiDecStreamInfo *stream_info = &(decoder->stream_info);
+	BOOL is_8bit;
+
+	codec_state = decoder->codec->getinfo(decoder->codec, &hantro_stream_info);
+	if (codec_state != CODEC_OK)
+	{
+		IMX_VPU_API_ERROR("could not get stream info: %s (%d)", codec_state_to_string(codec_state), codec_state);
+		return FALSE;
+	}
+
+	is_8bit = (hantro_stream_info.bit_depth != 10);
+
+	stream_info->flags = 0;
+
+	switch ((int)(hantro_stream_info.format))
+	{
+		case OMX_COLOR_FormatYUV420Planar:
+		case OMX_COLOR_FormatYUV420PackedPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV420SemiPlanar:
+		case OMX_COLOR_FormatYUV420PackedSemiPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV411Planar:
+		case OMX_COLOR_FormatYUV411PackedPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV411_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV411_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV411SemiPlanar:
+		case OMX_COLOR_FormatYUV411PackedSemiPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV411_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV411_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV422Planar:
+		case OMX_COLOR_FormatYUV422PackedPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_HORIZONTAL_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_HORIZONTAL_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV422SemiPlanar:
+		case OMX_COLOR_FormatYUV422PackedSemiPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_HORIZONTAL_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_HORIZONTAL_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV440SemiPlanar:
+		case OMX_COLOR_FormatYUV440PackedSemiPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_VERTICAL_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_VERTICAL_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV444SemiPlanar:
+		case OMX_COLOR_FormatYUV444PackedSemiPlanar:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV444_8BIT : IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV444_10BIT;
+			break;
+
+		case OMX_COLOR_FormatL8:
+			stream_info->color_format = is_8bit ? IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT : IMX_VPU_API_COLOR_FORMAT_YUV400_10BIT;
+			break;
+
+		case OMX_COLOR_FormatYUV420SemiPlanar4x4Tiled:
+			stream_info->color_format = (ImxVpuApiColorFormat)(is_8bit ? IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_8BIT : IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_4x4TILED_10BIT);
+			break;
+
+		case OMX_COLOR_FormatYUV420SemiPlanar8x4Tiled:
+			stream_info->color_format = (ImxVpuApiColorFormat)(is_8bit ? IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_8BIT : IMX_VPU_API_HANTRO_COLOR_FORMAT_YUV420_SEMI_PLANAR_8x4TILED_10BIT);
+			break;
+
+		case OMX_COLOR_FormatYUV420SemiPlanarP010:
+			stream_info->color_format = (ImxVpuApiColorFormat)IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_P010_10BIT;
+			break;
+
+		/* These can only be produced by the post-processor. */
+
+		case OMX_COLOR_FormatYCbYCr:
+			stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_YUYV_8BIT;
+			break;
+
+		case OMX_COLOR_FormatCbYCrY:
+			stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_UYVY_8BIT;
+			break;
+
+		case OMX_COLOR_Format16bitRGB565:
+			stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_RGB565;
+			break;
+
+		case OMX_COLOR_Format16bitBGR565:
+			stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_BGR565;
+			break;
+
+		case OMX_COLOR_Format32bitARGB8888:
+			stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_BGRA8888;
+			break;
+
+		default:
+			if (decoder->open_params.compression_format == IMX_VPU_API_COMPRESSION_FORMAT_DIVX3)
+			{
+				IMX_VPU_API_DEBUG("using workaround for bug in DivX 3 codec; it always outputs invalid color format, even though it is always actually semi-planar YUV420 8-bit");
+				stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT;
+			}
+			else
+			{
+				IMX_VPU_API_ERROR("unrecognized pixel format %#x", hantro_stream_info.format);
+				stream_info->color_format = IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT;
+				return FALSE;
+			}
+	}
+
+
+	/* Determine if the chroma planes are interleaved. */
+	switch ((int)(hantro_stream_info.format))
+	{
+		case OMX_COLOR_FormatYUV420Planar:
+		case OMX_COLOR_FormatYUV420PackedPlanar:
+		case OMX_COLOR_FormatYUV411Planar:
+		case OMX_COLOR_FormatYUV411PackedPlanar:
+		case OMX_COLOR_FormatL8:
+			break;
+
+		case OMX_COLOR_FormatYUV420SemiPlanar:
+		case OMX_COLOR_FormatYUV420PackedSemiPlanar:
+		case OMX_COLOR_FormatYUV411SemiPlanar:
+		case OMX_COLOR_FormatYUV411PackedSemiPlanar:
+		case OMX_COLOR_FormatYUV440SemiPlanar:
+		case OMX_COLOR_FormatYUV440PackedSemiPlanar:
+		case OMX_COLOR_FormatYUV444SemiPlanar:
+		case OMX_COLOR_FormatYUV444PackedSemiPlanar:
+			stream_info->flags |= IMX_VPU_API_DEC_STREAM_INFO_FLAG_SEMI_PLANAR_FRAMES;
+			break;
+
+		default:
+			break;
+	}
+
+	{
+		/* Low latency mode always outputs frames in decoding order. */
+		BOOL enable_frame_reordering = !(decoder->low_latency) && (decoder->open_params.flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_FRAME_REORDERING);
+		codec_state = decoder->codec->setnoreorder(decoder->codec, enable_frame_reordering ? OMX_FALSE : OMX_TRUE);
+		IMX_VPU_API_DEBUG("setnoreorder() called;  frame reordering: %d  codec state: %s (%d)", enable_frame_reordering, codec_state_to_string(codec_state), codec_state);
+	}
 
 	stream_info->decoded_frame_framebuffer_metrics.aligned_frame_width = hantro_stream_info.width;
 	stream_info->decoded_frame_framebuffer_metrics.aligned_frame_height = hantro_stream_info.height;
 
-	if (hantro_stream_info.crop_available)
+	/* The post-processor already applies the crop rectangle from the
+	 * post_processing open params, and scales the frames afterwards, so
+	 * the crop rectangle of the decoded frames does not apply to the
+	 * post-processed frames. */
+	if (hantro_stream_info.crop_available && !(decoder->post_processing_enabled))
 	{
 		stream_info->decoded_frame_framebuffer_metrics.actual_frame_width = hantro_stream_info.crop_width;
 		stream_info->decoded_frame_framebuffer_metrics.actual_frame_height = hantro_stream_info.crop_height;
@@ -710,7 +2071,26 @@ static BOOL imx_vpu_api_dec_get_new_stream_info(ImxVpuApiDecoder *decoder)
 	}
 
 	stream_info->decoded_frame_framebuffer_metrics.y_stride = hantro_stream_info.stride;
-	stream_info->decoded_frame_framebuffer_metrics.y_size = hantro_stream_info.stride * hantro_stream_info.sliceheight;
+
+	/* The stride is given in pixels. With the packed formats
+	 * that the post-processor produces, pixels are made of
+	 * more than one byte, so the stride needs to be scaled. */
+	switch (stream_info->color_format)
+	{
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_UYVY_8BIT:
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_YUYV_8BIT:
+		case IMX_VPU_API_COLOR_FORMAT_RGB565:
+		case IMX_VPU_API_COLOR_FORMAT_BGR565:
+			stream_info->decoded_frame_framebuffer_metrics.y_stride *= 2;
+			break;
+		case IMX_VPU_API_COLOR_FORMAT_BGRA8888:
+			stream_info->decoded_frame_framebuffer_metrics.y_stride *= 4;
+			break;
+		default:
+			break;
+	}
+
+	stream_info->decoded_frame_framebuffer_metrics.y_size = stream_info->decoded_frame_framebuffer_metrics.y_stride * hantro_stream_info.sliceheight;
 
 	/* Fill the CbCr values. */
 	switch (stream_info->color_format)
@@ -746,6 +2126,11 @@ static BOOL imx_vpu_api_dec_get_new_stream_info(ImxVpuApiDecoder *decoder)
 			break;
 		case IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT:
 		case IMX_VPU_API_COLOR_FORMAT_YUV400_10BIT:
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_UYVY_8BIT:
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_YUYV_8BIT:
+		case IMX_VPU_API_COLOR_FORMAT_RGB565:
+		case IMX_VPU_API_COLOR_FORMAT_BGR565:
+		case IMX_VPU_API_COLOR_FORMAT_BGRA8888:
 			stream_info->decoded_frame_framebuffer_metrics.uv_stride = 0;
 			stream_info->decoded_frame_framebuffer_metrics.uv_size = 0;
 			break;
@@ -780,6 +2165,15 @@ static BOOL imx_vpu_api_dec_get_new_stream_info(ImxVpuApiDecoder *decoder)
 
 	stream_info->min_num_required_framebuffers = hantro_stream_info.frame_buffers;
 
+	/* Some codecs need more framebuffers than frame_buffers indicates, for
+	 * example because of extra buffers for output reordering. Include these
+	 * right away, otherwise the codec would ask for the rest one by one. */
+	{
+		size_t total_num_needed_framebuffers = imx_vpu_api_dec_get_total_num_needed_framebuffers(decoder);
+		if (total_num_needed_framebuffers > stream_info->min_num_required_framebuffers)
+			stream_info->min_num_required_framebuffers = total_num_needed_framebuffers;
+	}
+
 	if (hantro_stream_info.interlaced)
 		stream_info->flags |= IMX_VPU_API_DEC_STREAM_INFO_FLAG_INTERLACED;
 	if (hantro_stream_info.bit_depth == 10)
@@ -889,6 +2283,101 @@ static BOOL imx_vpu_api_dec_get_new_stream_info(ImxVpuApiDecoder *decoder)
 	return TRUE;
 }
 
+
+#ifdef HAVE_IMXVPUDEC_HANTRO_POST_PROCESSOR_ARGS
+
+static BOOL imx_vpu_api_dec_fill_post_processor_args(ImxVpuApiDecOpenParams const *open_params, PP_ARGS *post_processor_args)
+{
+	ImxVpuApiDecPostProcessingParams const *params = &(open_params->post_processing);
+	BOOL is_g2_format;
+
+	switch (open_params->compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_H265:
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP9:
+			is_g2_format = TRUE;
+			break;
+		default:
+			is_g2_format = FALSE;
+	}
+
+	switch (params->output_color_format)
+	{
+		case IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT:
+			post_processor_args->format = OMX_COLOR_FormatYUV420SemiPlanar;
+			break;
+
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_YUYV_8BIT:
+			post_processor_args->format = OMX_COLOR_FormatYCbYCr;
+			break;
+
+		case IMX_VPU_API_COLOR_FORMAT_PACKED_YUV422_UYVY_8BIT:
+			post_processor_args->format = OMX_COLOR_FormatCbYCrY;
+			break;
+
+		case IMX_VPU_API_COLOR_FORMAT_RGB565:
+			post_processor_args->format = OMX_COLOR_Format16bitRGB565;
+			break;
+
+		case IMX_VPU_API_COLOR_FORMAT_BGR565:
+			post_processor_args->format = OMX_COLOR_Format16bitBGR565;
+			break;
+
+		/* OMX defines its 32-bit RGB formats in terms of 32-bit words.
+		 * In little-endian memory, ARGB8888 words are stored as B-G-R-A. */
+		case IMX_VPU_API_COLOR_FORMAT_BGRA8888:
+			post_processor_args->format = OMX_COLOR_Format32bitARGB8888;
+			break;
+
+		default:
+			IMX_VPU_API_ERROR("post-processor cannot produce color format %s", imx_vpu_api_color_format_string(params->output_color_format));
+			return FALSE;
+	}
+
+	/* The G2 core has no full post-processor. It can only crop, and
+	 * scale down by fixed ratios; it cannot convert the color format. */
+	if (is_g2_format && (params->output_color_format != IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT))
+	{
+		IMX_VPU_API_ERROR("post-processor cannot produce color format %s with compression format %s", imx_vpu_api_color_format_string(params->output_color_format), imx_vpu_api_compression_format_string(open_params->compression_format));
+		return FALSE;
+	}
+
+	/* PP_ARGS has no rotation settings. */
+	if (params->orientation != IMX_VPU_API_DEC_POST_PROCESSING_ORIENTATION_NORMAL)
+	{
+		IMX_VPU_API_ERROR("post-processor cannot rotate or flip frames");
+		return FALSE;
+	}
+
+	if ((params->crop_width != 0) && (params->crop_height != 0))
+	{
+		post_processor_args->crop.left = params->crop_left;
+		post_processor_args->crop.top = params->crop_top;
+		post_processor_args->crop.width = params->crop_width;
+		post_processor_args->crop.height = params->crop_height;
+	}
+
+	/* The codec picks the closest supported ratio
+	 * if the core can only scale by fixed ratios. */
+	if ((params->output_width != 0) && (params->output_height != 0))
+	{
+		post_processor_args->scale.width = params->output_width;
+		post_processor_args->scale.height = params->output_height;
+	}
+
+	IMX_VPU_API_DEBUG(
+		"post-processor args:  crop rectangle: left %" PRIu32 " top %" PRIu32 " width %" PRIu32 " height %" PRIu32 "  output width/height: %" PRIu32 "/%" PRIu32 "  output color format: %s",
+		params->crop_left, params->crop_top, params->crop_width, params->crop_height,
+		params->output_width, params->output_height,
+		imx_vpu_api_color_format_string(params->output_color_format)
+	);
+
+	return TRUE;
+}
+
+#endif
+
+
 static ImxVpuApiColorFormat const jpeg_supported_color_formats[] =
 {
 	IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT,
@@ -958,8 +2447,14 @@ static ImxVpuApiCompressionFormat const supported_compression_formats[] =
 #endif
 };
 
+#ifdef HAVE_IMXVPUDEC_HANTRO_POST_PROCESSOR_ARGS
+#define POST_PROCESSING_GLOBAL_INFO_FLAG IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_POST_PROCESSING_SUPPORTED
+#else
+#define POST_PROCESSING_GLOBAL_INFO_FLAG 0
+#endif
+
 static ImxVpuApiDecGlobalInfo const global_info = {
-	.flags = IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_HAS_DECODER | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SEMI_PLANAR_FRAMES_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL,
+	.flags = IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_HAS_DECODER | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SEMI_PLANAR_FRAMES_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ZERO_COPY_INPUT_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_INPUT_QUEUE_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_BYTE_STREAM_INPUT_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_LENGTH_PREFIXED_NAL_INPUT_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_SKIP_MODES_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_FRAMEBUFFER_REUSE_SUPPORTED | IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_ERROR_RESYNC_SUPPORTED | POST_PROCESSING_GLOBAL_INFO_FLAG,
 	.hardware_type = IMX_VPU_API_HARDWARE_TYPE_HANTRO,
 	.min_required_stream_buffer_size = VPU_DEC_MIN_REQUIRED_STREAM_BUFFER_SIZE,
 	.required_stream_buffer_physaddr_alignment = STREAM_BUFFER_PHYSADDR_ALIGNMENT,
@@ -1168,6 +2663,69 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 	}
 
 
+	/* Byte stream input relies on scanframe() finding the frame boundaries,
+	 * which works only with formats that use start codes for that. */
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT)
+	{
+		switch (open_params->compression_format)
+		{
+			case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+			case IMX_VPU_API_COMPRESSION_FORMAT_H265:
+				break;
+
+			default:
+				IMX_VPU_API_ERROR("byte stream input is not supported for compression format %s", imx_vpu_api_compression_format_string(open_params->compression_format));
+				return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+		}
+	}
+
+
+	/* Frames are checked for random access points at push time during
+	 * a resync, which requires them to begin at a frame boundary. */
+	if ((open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_RESYNC_ON_ERRORS) && (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT))
+	{
+		IMX_VPU_API_ERROR("resync on errors cannot be combined with byte stream input");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+
+	/* Length-prefixed NAL input requires the avcC/hvcC record, and
+	 * cannot be used for arbitrary chunks of data. */
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LENGTH_PREFIXED_NAL_INPUT)
+	{
+		size_t annexb_parameter_sets_size;
+		unsigned int nal_length_size;
+
+		if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT)
+		{
+			IMX_VPU_API_ERROR("length-prefixed NAL input cannot be combined with byte stream input");
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+		}
+
+		if ((open_params->extra_header_data == NULL) || (open_params->extra_header_data_size == 0))
+		{
+			IMX_VPU_API_ERROR("length-prefixed NAL input expects an avcC/hvcC record as extra header data, but none has been set");
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_EXTRA_HEADER_DATA;
+		}
+
+		if (!imx_vpu_api_convert_nal_config_to_annexb(open_params->compression_format, open_params->extra_header_data, open_params->extra_header_data_size, NULL, &annexb_parameter_sets_size, &nal_length_size))
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_EXTRA_HEADER_DATA;
+	}
+
+
+	/* Translate the post-processing params into post processor arguments.
+	 * These are passed to the codec once it is set up below. */
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING)
+	{
+#ifdef HAVE_IMXVPUDEC_HANTRO_POST_PROCESSOR_ARGS
+		if (!imx_vpu_api_dec_fill_post_processor_args(open_params, &post_processor_args))
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+#else
+		IMX_VPU_API_WARNING("post-processing is not supported by the Hantro codec library; ignoring post-processing params");
+#endif
+	}
+
+
 	/* Allocate decoder instance */
 	*decoder = malloc(sizeof(ImxVpuApiDecoder));
 	assert((*decoder) != NULL);
@@ -1229,10 +2787,84 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 
 	(*decoder)->open_params = *open_params;
 
-	(*decoder)->last_pushed_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	if (open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LENGTH_PREFIXED_NAL_INPUT)
+	{
+		size_t annexb_parameter_sets_size;
+
+		/* Validity of the avcC/hvcC record was already checked above. */
+		imx_vpu_api_convert_nal_config_to_annexb(open_params->compression_format, open_params->extra_header_data, open_params->extra_header_data_size, NULL, &annexb_parameter_sets_size, &((*decoder)->nal_length_size));
+
+		if (annexb_parameter_sets_size > 0)
+		{
+			(*decoder)->annexb_parameter_sets = malloc(annexb_parameter_sets_size);
+			assert((*decoder)->annexb_parameter_sets != NULL);
+			imx_vpu_api_convert_nal_config_to_annexb(open_params->compression_format, open_params->extra_header_data, open_params->extra_header_data_size, (*decoder)->annexb_parameter_sets, &annexb_parameter_sets_size, &((*decoder)->nal_length_size));
+		}
+
+		IMX_VPU_API_DEBUG("using length-prefixed NAL input with %u byte(s) NAL length size and %zu byte(s) of Annex-B parameter sets", (*decoder)->nal_length_size, annexb_parameter_sets_size);
+
+		/* imx_vpu_api_dec_preprocess_input_data() pushes the
+		 * extra header data once, as-is, before the first frame. */
+		(*decoder)->open_params.extra_header_data = (*decoder)->annexb_parameter_sets;
+		(*decoder)->open_params.extra_header_data_size = annexb_parameter_sets_size;
+	}
+
+	(*decoder)->current_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
 	(*decoder)->decoded_frame_fb_entry_index = INVALID_FRAME_ENTRY_INDEX;
 	(*decoder)->decoded_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
 
+	(*decoder)->first_free_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	(*decoder)->first_occupied_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	(*decoder)->last_occupied_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+
+	(*decoder)->byte_stream_input = !!(open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_BYTE_STREAM_INPUT);
+	(*decoder)->low_latency = !!(open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_LOW_LATENCY);
+	(*decoder)->reuse_framebuffers = !!(open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS);
+	(*decoder)->resync_on_errors = !!(open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_RESYNC_ON_ERRORS);
+#ifdef HAVE_IMXVPUDEC_HANTRO_POST_PROCESSOR_ARGS
+	(*decoder)->post_processing_enabled = !!(open_params->flags & IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_ENABLE_POST_PROCESSING);
+#endif
+
+	(*decoder)->max_num_queued_frames = (open_params->max_num_queued_encoded_frames > 1) ? open_params->max_num_queued_encoded_frames : 1;
+
+	(*decoder)->queued_frames_capacity = (*decoder)->max_num_queued_frames + 1;
+	(*decoder)->queued_frames = malloc(sizeof(QueuedFrame) * (*decoder)->queued_frames_capacity);
+	if ((*decoder)->queued_frames == NULL)
+	{
+		IMX_VPU_API_ERROR("could not allocate space for %zu queued frame(s)", (*decoder)->queued_frames_capacity);
+		ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+		goto cleanup;
+	}
+
+	/* Until the stream info is known, frame entries are only
+	 * needed for the queued frames and the picture that the
+	 * codec reads the stream info from. */
+	if (!imx_vpu_api_dec_grow_frame_entry_pool(*decoder, (*decoder)->queued_frames_capacity + 1))
+	{
+		ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+		goto cleanup;
+	}
+
+	/* The extra header data is in Annex-B format at this point. */
+	(*decoder)->h265_highest_temporal_id = -1;
+	if ((open_params->compression_format == IMX_VPU_API_COMPRESSION_FORMAT_H265) && ((*decoder)->open_params.extra_header_data != NULL))
+		imx_vpu_api_update_h265_highest_temporal_id((*decoder)->open_params.extra_header_data, (*decoder)->open_params.extra_header_data_size, 0, &((*decoder)->h265_highest_temporal_id));
+
+	/* h.265 and VP9 are decoded by the G2 core, everything else by the G1
+	 * core. Route asynchronous decoding jobs accordingly, so that they only
+	 * wait for jobs that actually use the same core. */
+	switch (open_params->compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP9:
+		case IMX_VPU_API_COMPRESSION_FORMAT_H265:
+			imx_vpu_api_async_job_set_core(&((*decoder)->async_state.job), IMX_VPU_API_ASYNC_CORE_SECONDARY_DECODER);
+			break;
+
+		default:
+			imx_vpu_api_async_job_set_core(&((*decoder)->async_state.job), IMX_VPU_API_ASYNC_CORE_DECODER);
+			break;
+	}
+
 	(*decoder)->skipped_frame_context = NULL;
 	(*decoder)->skipped_frame_pts = 0;
 	(*decoder)->skipped_frame_dts = 0;
@@ -1269,8 +2901,33 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 			break;
 	}
 
+	/* The G2 decoder can read stream data that wraps around the end of
+	 * the stream buffer, so use ring buffer mode with the formats it
+	 * handles. This avoids having to shift leftover data to the front
+	 * of the stream buffer in imx_vpu_api_dec_push_input_data(). The G1
+	 * decoder lacks this capability. Ring buffer mode also requires the
+	 * stream buffer to be mapped twice (see stream_buffer_double_mapping). */
 	(*decoder)->ring_buffer_mode = FALSE;
 
+	switch (open_params->compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP9:
+		case IMX_VPU_API_COMPRESSION_FORMAT_H265:
+			if (imx_vpu_api_dec_map_stream_buffer_twice(*decoder))
+			{
+				codec_config.g2_conf.bEnableRingBuffer = OMX_TRUE;
+				(*decoder)->ring_buffer_mode = TRUE;
+			}
+			else
+				IMX_VPU_API_DEBUG("not using ring buffer mode since the stream buffer could not be mapped twice");
+			break;
+
+		default:
+			break;
+	}
+
+	IMX_VPU_API_DEBUG("ring buffer mode: %d", (*decoder)->ring_buffer_mode);
+
 	switch (open_params->compression_format)
 	{
 		case IMX_VPU_API_COMPRESSION_FORMAT_JPEG:
@@ -1301,13 +2958,6 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 		}
 
 		case IMX_VPU_API_COMPRESSION_FORMAT_H265:
-#if 0
-			if (open_params->use_secure_mode)
-			{
-				codec_config.g2_conf.bEnableRingBuffer = OMX_TRUE;
-				(*decoder)->ring_buffer_mode = TRUE;
-			}
-#endif
 			(*decoder)->codec = HantroHwDecOmx_decoder_create_hevc((*decoder)->dwl_instance, &(codec_config.g2_conf));
 			break;
 
@@ -1430,7 +3080,18 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_open(ImxVpuApiDecoder **decoder, ImxVpuA
 	/* Set post processor arguments */
 	codec_state = (*decoder)->codec->setppargs((*decoder)->codec, &post_processor_args);
 	if (codec_state != CODEC_OK)
-		IMX_VPU_API_WARNING("could not set post processor arguments: %s", codec_state_to_string(codec_state));
+	{
+		/* Without post-processing, the arguments are all zero,
+		 * and the codec works fine even if it rejects them. */
+		if ((*decoder)->post_processing_enabled)
+		{
+			IMX_VPU_API_ERROR("could not set post processor arguments: %s", codec_state_to_string(codec_state));
+			ret = IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+			goto cleanup;
+		}
+		else
+			IMX_VPU_API_WARNING("could not set post processor arguments: %s", codec_state_to_string(codec_state));
+	}
 
 
 	/* Finish & cleanup (in case of error) */
@@ -1441,13 +3102,20 @@ finish:
 	return ret;
 
 cleanup:
+	if ((*decoder)->codec != NULL)
+		(*decoder)->codec->destroy((*decoder)->codec);
+
 	if ((*decoder)->dwl_instance != NULL)
 		DWLRelease((*decoder)->dwl_instance);
 
 	if ((*decoder) != NULL)
 	{
+		imx_vpu_api_dec_unmap_stream_buffer_double_mapping(*decoder);
 		if ((*decoder)->stream_buffer_virtual_address != NULL)
 			imx_dma_buffer_unmap((*decoder)->stream_buffer);
+		free((*decoder)->frame_entries);
+		free((*decoder)->queued_frames);
+		free((*decoder)->annexb_parameter_sets);
 		free(*decoder);
 		*decoder = NULL;
 	}
@@ -1462,17 +3130,28 @@ void imx_vpu_api_dec_close(ImxVpuApiDecoder *decoder)
 
 	IMX_VPU_API_DEBUG("closing decoder");
 
-		if (decoder->stream_buffer_virtual_address != NULL)
-			imx_dma_buffer_unmap(decoder->stream_buffer);
+	/* This waits for any decoding step that is still in progress,
+	 * so it must be done before anything else is torn down. */
+	imx_vpu_api_dec_async_cleanup(&(decoder->async_state));
+
+	imx_vpu_api_dec_unmap_stream_buffer_double_mapping(decoder);
+	if (decoder->stream_buffer_virtual_address != NULL)
+		imx_dma_buffer_unmap(decoder->stream_buffer);
 
 	if (decoder->codec != NULL)
 		decoder->codec->destroy(decoder->codec);
 
+	imx_vpu_api_dec_release_input_dma_buffer(decoder, FALSE);
+
 	if (decoder->dwl_instance != NULL)
 		DWLRelease(decoder->dwl_instance);
 
 	imx_vpu_api_dec_clear_added_framebuffers(decoder);
 	imx_vpu_api_dec_clear_frame_entries(decoder);
+	free(decoder->queued_frames);
+	free(decoder->pending_skipped_frames);
+	free(decoder->annexb_parameter_sets);
+	imx_vpu_api_stream_header_cache_cleanup(&(decoder->stream_header_cache));
 
 	free(decoder);
 }
@@ -1505,9 +3184,9 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_add_framebuffers_to_pool(ImxVpuApiDecode
 		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
 	}
 
-	if (num_framebuffers < decoder->num_framebuffers_to_be_added)
+	if (num_framebuffers < decoder->min_num_framebuffers_to_be_added)
 	{
-		IMX_VPU_API_ERROR("decoder needs %zu framebuffers to be added, got %zu", decoder->num_framebuffers_to_be_added, num_framebuffers);
+		IMX_VPU_API_ERROR("decoder needs %zu framebuffers to be added, got %zu", decoder->min_num_framebuffers_to_be_added, num_framebuffers);
 		return IMX_VPU_API_DEC_RETURN_CODE_INSUFFICIENT_FRAMEBUFFERS;
 	}
 
@@ -1549,6 +3228,8 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_add_framebuffers_to_pool(ImxVpuApiDecode
 		if (fb_contexts != NULL)
 			fb_entry->fb_context = fb_contexts[i];
 
+		imx_vpu_api_dec_insert_framebuffer_entry_into_hash_table(decoder, new_fb_entry_index);
+
 		buffer.bus_data = virtual_address;
 		buffer.bus_address = (OSAL_BUS_WIDTH)physical_address;
 		buffer.allocsize = dma_buffer_size;
@@ -1579,6 +3260,7 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_add_framebuffers_to_pool(ImxVpuApiDecode
 
 finish:
 	decoder->num_framebuffers_to_be_added = 0;
+	decoder->min_num_framebuffers_to_be_added = 0;
 	return ret;
 
 cleanup:
@@ -1592,6 +3274,28 @@ cleanup:
 }
 
 
+size_t imx_vpu_api_dec_get_num_framebuffers_to_be_added(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return decoder->num_framebuffers_to_be_added;
+}
+
+
+int imx_vpu_api_dec_is_framebuffer_in_pool(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
+{
+	imx_physical_address_t physical_address;
+
+	assert(decoder != NULL);
+	assert(fb_dma_buffer != NULL);
+
+	physical_address = imx_dma_buffer_get_physical_address(fb_dma_buffer);
+	if (physical_address == 0)
+		return 0;
+
+	return imx_vpu_api_dec_find_framebuffer_entry_index(decoder, physical_address) != INVALID_FRAME_ENTRY_INDEX;
+}
+
+
 void imx_vpu_api_dec_enable_drain_mode(ImxVpuApiDecoder *decoder)
 {
 	assert(decoder != NULL);
@@ -1608,131 +3312,304 @@ int imx_vpu_api_dec_is_drain_mode_enabled(ImxVpuApiDecoder *decoder)
 
 void imx_vpu_api_dec_flush(ImxVpuApiDecoder *decoder)
 {
-	CODEC_STATE codec_state;
-	BOOL do_loop = TRUE;
-	FRAME frame = { 0 };
-
 	assert(decoder != NULL);
 	assert(decoder->codec != NULL);
 
-	if (decoder->framebuffer_entries == NULL)
-	{
-		IMX_VPU_API_DEBUG("attempted to flush, but there are no framebuffers in the pool; ignoring call");
-		return;
-	}
+	/* Frames excluded by the skip mode never reach the codec, and
+	 * pushed data may be pending even if there is no pool yet (the
+	 * codec needs some of it to report the stream info), so discard
+	 * all of this before checking for the pool. Otherwise, an input
+	 * DMA buffer would never be released, and the queued frames would
+	 * be mixed up with the frames that are pushed after the flush. */
+	decoder->num_pending_skipped_frames = 0;
+	decoder->first_pending_skipped_frame_index = 0;
+	decoder->resync_pending = FALSE;
+
+	imx_vpu_api_dec_release_input_dma_buffer(decoder, FALSE);
 
 	decoder->stream_buffer_read_offset = 0;
 	decoder->stream_buffer_write_offset = 0;
 	decoder->stream_buffer_fill_level = 0;
 
-	decoder->has_new_stream_info = FALSE;
+	decoder->num_queued_frames = 0;
 
-	decoder->main_header_pushed = FALSE;
+	/* Any frames that were in flight are discarded by the flush, so their
+	 * frame entries can be reused. The pool itself is kept allocated. */
+	imx_vpu_api_dec_release_all_frame_entries(decoder);
 
-	decoder->last_pushed_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	decoder->current_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+	decoder->current_picture_pending = FALSE;
 	decoder->decoded_frame_fb_entry_index = INVALID_FRAME_ENTRY_INDEX;
 	decoder->decoded_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
 
+	decoder->encoded_data_available = FALSE;
+
+	if (decoder->framebuffer_entries == NULL)
+	{
+		IMX_VPU_API_DEBUG("attempted to flush, but there are no framebuffers in the pool; only discarded pushed data");
+		return;
+	}
+
+	decoder->has_new_stream_info = FALSE;
+
+	/* The extra header data from the open params has to be pushed again,
+	 * and so do any headers that were found in previously pushed frames,
+	 * since the abort() call below makes the codec forget them. This way,
+	 * callers can push frames right after the flush without having to
+	 * resend any headers. */
+	decoder->main_header_pushed = FALSE;
+	imx_vpu_api_stream_header_cache_schedule_reinsertion(&(decoder->stream_header_cache));
+
 	decoder->skipped_frame_context = NULL;
 	decoder->skipped_frame_pts = 0;
 	decoder->skipped_frame_dts = 0;
 
 	decoder->decoded_frame_reported = FALSE;
-	decoder->encoded_data_available = FALSE;
 
 	decoder->end_of_stream_reached = FALSE;
 	decoder->drain_mode_enabled = FALSE;
 
 	IMX_VPU_API_DEBUG("flushing decoder");
 
-	while (do_loop)
+	imx_vpu_api_dec_abort_codec(decoder);
+
+	IMX_VPU_API_DEBUG("flushed decoder");
+}
+
+
+unsigned int imx_vpu_api_dec_get_num_hardware_resets(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return decoder->num_hardware_resets;
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_set_skip_mode(ImxVpuApiDecoder *decoder, ImxVpuApiDecSkipMode skip_mode)
+{
+	assert(decoder != NULL);
+
+	switch (skip_mode)
 	{
-		codec_state = decoder->codec->getframe(decoder->codec, &frame, decoder->drain_mode_enabled ? OMX_TRUE : OMX_FALSE);
-		IMX_VPU_API_DEBUG("attempting to retrieve frame (to discard it) during flush; codec state: %s (%d)", codec_state_to_string(codec_state), codec_state);
-		switch (codec_state)
+		case IMX_VPU_API_DEC_SKIP_MODE_NONE:
+		case IMX_VPU_API_DEC_SKIP_MODE_NON_REFERENCE_FRAMES:
+		case IMX_VPU_API_DEC_SKIP_MODE_NON_INTRA_FRAMES:
+			break;
+
+		default:
+			IMX_VPU_API_ERROR("invalid skip mode %d", (int)skip_mode);
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+	/* In byte stream input mode, pushed data does not necessarily
+	 * begin at a frame boundary, so frames cannot be classified
+	 * at push time. */
+	if (decoder->byte_stream_input && (skip_mode != IMX_VPU_API_DEC_SKIP_MODE_NONE))
+	{
+		IMX_VPU_API_ERROR("skip modes are not supported in byte stream input mode");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+	IMX_VPU_API_DEBUG("setting skip mode to %d", (int)skip_mode);
+	decoder->skip_mode = skip_mode;
+
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+}
+
+
+void imx_vpu_api_dec_set_frame_discarding(ImxVpuApiDecoder *decoder, int discard_frames)
+{
+	assert(decoder != NULL);
+
+	IMX_VPU_API_DEBUG("%s frame discarding", discard_frames ? "enabling" : "disabling");
+	decoder->discard_frames = !!discard_frames;
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame)
+{
+	ImxVpuApiDecReturnCodes ret;
+	size_t prev_fill_level;
+	BOOL prev_main_header_pushed;
+	size_t main_data_size;
+	ImxVpuApiDecSkippedFrameReasons skipped_frame_reason;
+
+	assert(decoder != NULL);
+	assert(decoder->codec != NULL);
+	assert(encoded_frame != NULL);
+
+	main_data_size = encoded_frame->data_size - decoder->encoded_frame_offset;
+
+	if (decoder->nal_length_size != 0)
+	{
+		if (!imx_vpu_api_get_annexb_size_of_length_prefixed_data(encoded_frame->data, encoded_frame->data_size, decoder->nal_length_size, &main_data_size))
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+	if (imx_vpu_api_dec_is_frame_excluded(decoder, encoded_frame->data + decoder->encoded_frame_offset, encoded_frame->data_size - decoder->encoded_frame_offset, &skipped_frame_reason))
+	{
+		if (decoder->drain_mode_enabled)
 		{
-			case CODEC_HAS_FRAME:
-			{
-				BUFFER buffer = { 0 };
+			IMX_VPU_API_ERROR("tried to push an encoded frame after drain mode was enabled");
+			return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+		}
+
+		/* Any stream headers in the frame still have to reach the
+		 * codec, so they are inserted in front of the next frame. */
+		if (!imx_vpu_api_stream_header_cache_process_skipped_frame(&(decoder->stream_header_cache), decoder->open_params.compression_format, encoded_frame->data + decoder->encoded_frame_offset, encoded_frame->data_size - decoder->encoded_frame_offset, decoder->nal_length_size))
+			IMX_VPU_API_WARNING("could not cache stream headers of excluded frame; these headers will not reach the decoder");
+
+		imx_vpu_api_dec_add_pending_skipped_frame(decoder, encoded_frame->context, encoded_frame->pts, encoded_frame->dts, skipped_frame_reason, decoder->num_pushed_frames++);
+
+		IMX_VPU_API_LOG("frame with context %p PTS %" PRIu64 " DTS %" PRIu64 " is excluded (reason: %s); not pushing it into the stream buffer", encoded_frame->context, encoded_frame->pts, encoded_frame->dts, imx_vpu_api_dec_skipped_frame_reason_string(skipped_frame_reason));
+
+		return IMX_VPU_API_DEC_RETURN_CODE_OK;
+	}
 
-				buffer.bus_data = frame.fb_bus_data;
-				buffer.bus_address = frame.fb_bus_address;
+	if ((ret = imx_vpu_api_dec_check_if_push_is_allowed(decoder, main_data_size)) != IMX_VPU_API_DEC_RETURN_CODE_OK)
+		return ret;
 
-				codec_state = decoder->codec->pictureconsumed(decoder->codec, &buffer);
-				IMX_VPU_API_DEBUG("discarded picture during flush;  virtual address %p  physical address %" IMX_PHYSICAL_ADDRESS_FORMAT "  codec state: %s (%d)", (void*)(frame.fb_bus_data), (imx_physical_address_t)(frame.fb_bus_address), codec_state_to_string(codec_state), codec_state);
+	/* Any leftover data from a previously pushed input DMA buffer
+	 * has to be in the stream buffer before new data is appended. */
+	imx_vpu_api_dec_release_input_dma_buffer(decoder, TRUE);
 
-				break;
-			}
+	prev_fill_level = decoder->stream_buffer_fill_level;
+	prev_main_header_pushed = decoder->main_header_pushed;
 
-			default:
-				do_loop = FALSE;
-				break;
-		}
+	/* Begin synced access since we have to copy the encoded
+	 * data into the stream buffer. */
+	imx_dma_buffer_start_sync_session(decoder->stream_buffer);
+
+	/* Process input data first to make sure any headers are
+	 * inserted and any necessary parsing is done before the
+	 * main frame. */
+	if (!imx_vpu_api_dec_preprocess_input_data(decoder, decoder->open_params.extra_header_data, decoder->open_params.extra_header_data_size, encoded_frame->data, encoded_frame->data_size)
+	 || !imx_vpu_api_dec_push_main_data(decoder, encoded_frame->data + decoder->encoded_frame_offset, encoded_frame->data_size - decoder->encoded_frame_offset))
+	{
+		imx_vpu_api_dec_discard_partially_pushed_data(decoder, prev_fill_level, prev_main_header_pushed);
+		imx_dma_buffer_stop_sync_session(decoder->stream_buffer);
+		return IMX_VPU_API_DEC_RETURN_CODE_INSUFFICIENT_STREAM_BUFFER_SIZE;
 	}
 
-	codec_state = decoder->codec->abort(decoder->codec);
-	if (codec_state != CODEC_OK)
-		IMX_VPU_API_ERROR("error while calling abort() during flush: %s (%d)", codec_state_to_string(codec_state), codec_state);
-	decoder->codec->abortafter(decoder->codec);
-	if (codec_state != CODEC_OK)
-		IMX_VPU_API_ERROR("error while calling abortafter() during flush: %s (%d)", codec_state_to_string(codec_state), codec_state);
+	imx_vpu_api_dec_add_pushed_frame_entry(decoder, encoded_frame, decoder->stream_buffer_fill_level - prev_fill_level);
 
-	IMX_VPU_API_DEBUG("flushed decoder");
+	imx_dma_buffer_stop_sync_session(decoder->stream_buffer);
+
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
 }
 
 
-ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame)
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_dma_buffer(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame, ImxDmaBuffer *encoded_dma_buffer, size_t offset, ImxVpuApiDecEncodedDmaBufferReleaseCallback release_callback, void *release_callback_user_data)
 {
-	FrameEntry *frame_entry;
+	int err;
+	ImxVpuApiDecReturnCodes ret;
+	uint8_t *virtual_address;
+	imx_physical_address_t physical_address;
+	BOOL zero_copy;
+	size_t prev_fill_level;
+	BOOL prev_main_header_pushed;
 
 	assert(decoder != NULL);
 	assert(decoder->codec != NULL);
 	assert(encoded_frame != NULL);
+	assert(encoded_dma_buffer != NULL);
 
-	if (decoder->drain_mode_enabled)
+	/* Length-prefixed NAL units have to be converted, so they can never
+	 * be read directly by the VPU. Also, if a skip mode is set or a resync
+	 * is pending, the frame has to be inspected with the CPU first, which
+	 * the copy path does. */
+	if ((decoder->nal_length_size != 0) || (decoder->skip_mode != IMX_VPU_API_DEC_SKIP_MODE_NONE) || decoder->resync_pending)
+		return imx_vpu_api_dec_push_encoded_dma_buffer_by_copy(decoder, encoded_frame, encoded_dma_buffer, offset, release_callback, release_callback_user_data);
+
+	if ((ret = imx_vpu_api_dec_check_if_push_is_allowed(decoder, encoded_frame->data_size)) != IMX_VPU_API_DEC_RETURN_CODE_OK)
+		return ret;
+
+	if ((offset + encoded_frame->data_size) > imx_dma_buffer_get_size(encoded_dma_buffer))
 	{
-		IMX_VPU_API_ERROR("tried to push an encoded frame after drain mode was enabled");
-		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+		IMX_VPU_API_ERROR("encoded data with offset %zu and size %zu does not fit in DMA buffer of size %zu", offset, encoded_frame->data_size, imx_dma_buffer_get_size(encoded_dma_buffer));
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
 	}
 
-	if (decoder->encoded_data_available)
+	/* The mapping is kept until the codec consumed the data, since
+	 * scanframe() parses the data with the CPU. The mapping is read-only,
+	 * so it does not leave any dirty cache lines behind that could
+	 * interfere with the VPU reading the data via its physical address. */
+	virtual_address = imx_dma_buffer_map(encoded_dma_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_READ, &err);
+	if (virtual_address == NULL)
 	{
-		IMX_VPU_API_ERROR("tried to push an encoded frame before previously pushed frame was fully processed");
-		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+		IMX_VPU_API_ERROR("mapping encoded DMA buffer to virtual address space failed: %s (%d)", strerror(err), err);
+		return IMX_VPU_API_DEC_RETURN_CODE_DMA_MEMORY_ACCESS_ERROR;
 	}
 
-	/* Begin synced access since we have to copy the encoded
-	 * data into the stream buffer. */
-	imx_dma_buffer_start_sync_session(decoder->stream_buffer);
+	virtual_address += offset;
+	physical_address = imx_dma_buffer_get_physical_address(encoded_dma_buffer) + offset;
 
-	/* Process input data first to make sure any headers are
-	 * inserted and any necessary parsing is done before the
-	 * main frame. */
-	imx_vpu_api_dec_preprocess_input_data(decoder, decoder->open_params.extra_header_data, decoder->open_params.extra_header_data_size, encoded_frame->data, encoded_frame->data_size);
+	imx_vpu_api_dec_release_input_dma_buffer(decoder, TRUE);
 
-		/* Handle main frame data */
-	imx_vpu_api_dec_push_input_data(decoder, encoded_frame->data + decoder->encoded_frame_offset, encoded_frame->data_size - decoder->encoded_frame_offset);
+	prev_fill_level = decoder->stream_buffer_fill_level;
+	prev_main_header_pushed = decoder->main_header_pushed;
 
-	decoder->last_pushed_frame_entry_index = imx_vpu_api_get_free_frame_entry_index(decoder);
-	assert(decoder->last_pushed_frame_entry_index != INVALID_FRAME_ENTRY_INDEX);
+	imx_dma_buffer_start_sync_session(decoder->stream_buffer);
 
-	IMX_VPU_API_LOG("pushed frame with context %p PTS %" PRIu64 " DTS %" PRIu64 " frame entry index %zu and %zu bytes of main data", encoded_frame->context, encoded_frame->pts, encoded_frame->dts, decoder->last_pushed_frame_entry_index, encoded_frame->data_size);
+	if (!imx_vpu_api_dec_preprocess_input_data(decoder, decoder->open_params.extra_header_data, decoder->open_params.extra_header_data_size, virtual_address, encoded_frame->data_size))
+	{
+		ret = IMX_VPU_API_DEC_RETURN_CODE_INSUFFICIENT_STREAM_BUFFER_SIZE;
+		goto error;
+	}
 
-	frame_entry = &(decoder->frame_entries[decoder->last_pushed_frame_entry_index]);
-	frame_entry->occupied = TRUE;
-	frame_entry->context = encoded_frame->context;
-	frame_entry->pts = encoded_frame->pts;
-	frame_entry->dts = encoded_frame->dts;
+	/* The data can only be read directly from the DMA buffer if nothing
+	 * else has to be read before it, that is, if the stream buffer is
+	 * empty (which also means that preprocessing did not insert any
+	 * headers) and no initial bytes have to be skipped. Also, the data
+	 * must fit in the stream buffer, since any data that is not consumed
+	 * by the codec gets copied into the stream buffer later. */
+	zero_copy = (decoder->stream_buffer_fill_level == 0)
+	         && (decoder->encoded_frame_offset == 0)
+	         && ((physical_address % STREAM_BUFFER_PHYSADDR_ALIGNMENT) == 0)
+	         && (encoded_frame->data_size <= decoder->stream_buffer_size);
+
+	if (zero_copy)
+	{
+		IMX_VPU_API_LOG("using DMA buffer %p with %zu byte(s) of encoded data at offset %zu directly as input", (void *)encoded_dma_buffer, encoded_frame->data_size, offset);
+
+		decoder->input_dma_buffer = encoded_dma_buffer;
+		decoder->input_dma_buffer_virtual_address = virtual_address;
+		decoder->input_dma_buffer_physical_address = physical_address;
+		decoder->input_dma_buffer_size = encoded_frame->data_size;
+		decoder->input_dma_buffer_release_callback = release_callback;
+		decoder->input_dma_buffer_release_callback_user_data = release_callback_user_data;
+
+		decoder->stream_buffer_read_offset = 0;
+		decoder->stream_buffer_write_offset = encoded_frame->data_size;
+		decoder->stream_buffer_fill_level = encoded_frame->data_size;
+	}
+	else
+	{
+		IMX_VPU_API_LOG("cannot use DMA buffer %p directly as input; copying its encoded data into the stream buffer", (void *)encoded_dma_buffer);
 
-	decoder->encoded_data_available = TRUE;
+		if (!imx_vpu_api_dec_push_input_data(decoder, virtual_address + decoder->encoded_frame_offset, encoded_frame->data_size - decoder->encoded_frame_offset))
+		{
+			ret = IMX_VPU_API_DEC_RETURN_CODE_INSUFFICIENT_STREAM_BUFFER_SIZE;
+			goto error;
+		}
+		imx_dma_buffer_unmap(encoded_dma_buffer);
+	}
 
-	/* Clear end_of_stream_reached flag since feeding in data
-	 * means that we are no longer at the end of stream. */
-	decoder->end_of_stream_reached = FALSE;
+	imx_vpu_api_dec_add_pushed_frame_entry(decoder, encoded_frame, decoder->stream_buffer_fill_level - prev_fill_level);
 
 	imx_dma_buffer_stop_sync_session(decoder->stream_buffer);
 
+	if (!zero_copy && (release_callback != NULL))
+		release_callback(decoder, encoded_dma_buffer, release_callback_user_data);
+
 	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+
+error:
+	/* The DMA buffer is still owned by the caller in this case,
+	 * so the release callback is not invoked. */
+	imx_vpu_api_dec_discard_partially_pushed_data(decoder, prev_fill_level, prev_main_header_pushed);
+	imx_dma_buffer_stop_sync_session(decoder->stream_buffer);
+	imx_dma_buffer_unmap(encoded_dma_buffer);
+	return ret;
 }
 
 
@@ -1744,38 +3621,14 @@ void imx_vpu_api_dec_set_output_frame_dma_buffer(ImxVpuApiDecoder *decoder, ImxD
 }
 
 
-ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code)
+static ImxVpuApiDecReturnCodes imx_vpu_api_dec_retrieve_frame_from_codec(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code, BOOL *output_available)
 {
 	CODEC_STATE codec_state;
-	OMX_S32 scan_ret;
-	ImxVpuApiDecReturnCodes ret = IMX_VPU_API_DEC_RETURN_CODE_OK;
-	OMX_U32 first_offset_ptr = 0, last_offset_ptr = 0;
-	OMX_U32 num_used_input_bytes = 0;
 	FRAME frame = { 0 };
-	STREAM_BUFFER stream_buffer = { 0 };
-	BOOL do_loop = TRUE;
-
-	assert(decoder != NULL);
-	assert(output_code != NULL);
-
-	if (decoder->decoded_frame_entry_index != INVALID_FRAME_ENTRY_INDEX)
-	{
-		IMX_VPU_API_ERROR("there is a decoded frame to be retrieved, but imx_vpu_api_dec_get_decoded_frame() wasn't called");
-		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
-	}
 
-	if (decoder->end_of_stream_reached)
-	{
-		IMX_VPU_API_LOG("end of stream already reached; not doing anything");
-		*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_EOS;
-		return IMX_VPU_API_DEC_RETURN_CODE_OK;
-	}
-
-	if ((decoder->stream_info.min_num_required_framebuffers > 0) && decoder->frame_entries == NULL)
-	{
-		IMX_VPU_API_LOG("no framebuffers have been added to the pool");
-		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
-	}
+	/* Every path in the switch block below that returns
+	 * sets the output code or reports an error. */
+	*output_available = TRUE;
 
 	codec_state = decoder->codec->getframe(decoder->codec, &frame, decoder->drain_mode_enabled ? OMX_TRUE : OMX_FALSE);
 	IMX_VPU_API_LOG("decoding frame(s);  drain mode enabled: %d  codec state %s (%d)", decoder->drain_mode_enabled, codec_state_to_string(codec_state), codec_state);
@@ -1816,7 +3669,38 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			decoder->decoded_frame_entry_index = frame.outBufPrivate.nPicId[0];
 			IMX_VPU_API_LOG("found frame entry at index %zu and framebuffer entry at index %zu for decoded frame with physical address %" IMX_PHYSICAL_ADDRESS_FORMAT, decoder->decoded_frame_entry_index, decoder->decoded_frame_fb_entry_index, physical_address);
 
-			*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_DECODED_FRAME_AVAILABLE;
+			if ((decoder->decoded_frame_entry_index < decoder->num_frame_entries) && decoder->frame_entries[decoder->decoded_frame_entry_index].discard)
+			{
+				FrameEntry *frame_entry = &(decoder->frame_entries[decoder->decoded_frame_entry_index]);
+				BUFFER buffer = { 0 };
+
+				/* The frame was only decoded so that subsequent frames
+				 * can refer to it. Give the picture back to the codec
+				 * right away instead of going through the output path. */
+				buffer.bus_data = frame.fb_bus_data;
+				buffer.bus_address = frame.fb_bus_address;
+				codec_state = decoder->codec->pictureconsumed(decoder->codec, &buffer);
+				if (codec_state != CODEC_OK)
+				{
+					IMX_VPU_API_ERROR("could not return discarded picture to decoder:  codec state %s (%d)", codec_state_to_string(codec_state), codec_state);
+					return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+				}
+
+				decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_DISCARDED;
+				decoder->skipped_frame_context = frame_entry->context;
+				decoder->skipped_frame_pts = frame_entry->pts;
+				decoder->skipped_frame_dts = frame_entry->dts;
+
+				IMX_VPU_API_LOG("discarding decoded frame with context %p PTS %" PRIu64 " DTS %" PRIu64, frame_entry->context, frame_entry->pts, frame_entry->dts);
+
+				imx_vpu_api_dec_release_frame_entry(decoder, decoder->decoded_frame_entry_index);
+				decoder->decoded_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
+				decoder->decoded_frame_fb_entry_index = INVALID_FRAME_ENTRY_INDEX;
+
+				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
+			}
+			else
+				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_DECODED_FRAME_AVAILABLE;
 
 			if (decoder->single_frame_decoding)
 			{
@@ -1832,7 +3716,12 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			IMX_VPU_API_DEBUG("video codec reports end of stream");
 			decoder->end_of_stream_reached = TRUE;
 			decoder->drain_mode_enabled = FALSE;
-			*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_EOS;
+			/* Skipped frames that are still pending come before the EOS.
+			 * The EOS is then reported once all of them were reported. */
+			if (imx_vpu_api_dec_report_pending_skipped_frame(decoder, TRUE))
+				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
+			else
+				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_EOS;
 			return IMX_VPU_API_DEC_RETURN_CODE_OK;
 
 		/* These are not errors, we just have no frame to output. */
@@ -1852,22 +3741,22 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 
 				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
 
-				if ((decoder->last_pushed_frame_entry_index != INVALID_FRAME_ENTRY_INDEX) || (decoder->last_pushed_frame_entry_index < decoder->num_frame_entries))
+				if ((decoder->current_frame_entry_index != INVALID_FRAME_ENTRY_INDEX) && (decoder->current_frame_entry_index < decoder->num_frame_entries))
 				{
-					frame_entry = &(decoder->frame_entries[decoder->last_pushed_frame_entry_index]);
+					frame_entry = &(decoder->frame_entries[decoder->current_frame_entry_index]);
 					decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_INTERNAL_FRAME;
 					decoder->skipped_frame_context = frame_entry->context;
 					decoder->skipped_frame_pts = frame_entry->pts;
 					decoder->skipped_frame_dts = frame_entry->dts;
-					frame_entry->occupied = FALSE;
+					imx_vpu_api_dec_release_frame_entry(decoder, decoder->current_frame_entry_index);
 
-					IMX_VPU_API_LOG("frame at entry index %zu with context %p PTS %" PRIu64 " DTS %" PRIu64 " got skipped because it is an invisible internal frame", decoder->last_pushed_frame_entry_index, frame_entry->context, frame_entry->pts, frame_entry->dts);
+					IMX_VPU_API_LOG("frame at entry index %zu with context %p PTS %" PRIu64 " DTS %" PRIu64 " got skipped because it is an invisible internal frame", decoder->current_frame_entry_index, frame_entry->context, frame_entry->pts, frame_entry->dts);
 
 					return IMX_VPU_API_DEC_RETURN_CODE_OK;
 				}
 				else
 				{
-					IMX_VPU_API_ERROR("could not get context for skipped invisible internal frame; last pushed frame entry index is invalid (%zu)", decoder->last_pushed_frame_entry_index);
+					IMX_VPU_API_ERROR("could not get context for skipped invisible internal frame; current frame entry index is invalid (%zu)", decoder->current_frame_entry_index);
 					return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
 				}
 				decoder->decoded_frame_reported = FALSE;
@@ -1882,6 +3771,63 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			break;
 	}
 
+	*output_available = FALSE;
+
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code)
+{
+	CODEC_STATE codec_state;
+	OMX_S32 scan_ret;
+	ImxVpuApiDecReturnCodes ret = IMX_VPU_API_DEC_RETURN_CODE_OK;
+	OMX_U32 first_offset_ptr = 0, last_offset_ptr = 0;
+	OMX_U32 num_used_input_bytes = 0;
+	FRAME frame = { 0 };
+	STREAM_BUFFER stream_buffer = { 0 };
+	BOOL do_loop = TRUE;
+	uint8_t *input_virtual_address;
+	imx_physical_address_t input_physical_address;
+	size_t input_size;
+	BOOL output_available;
+
+	assert(decoder != NULL);
+	assert(output_code != NULL);
+
+	if (decoder->decoded_frame_entry_index != INVALID_FRAME_ENTRY_INDEX)
+	{
+		IMX_VPU_API_ERROR("there is a decoded frame to be retrieved, but imx_vpu_api_dec_get_decoded_frame() wasn't called");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+	}
+
+	/* Report frames that were excluded by the skip mode or discarded
+	 * during a resync once the frames pushed before them are out. The
+	 * codec never saw them, so no decoding is needed. After the end of
+	 * stream, no other frames will come out, so report them right away. */
+	if (imx_vpu_api_dec_report_pending_skipped_frame(decoder, decoder->end_of_stream_reached))
+	{
+		*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
+		return IMX_VPU_API_DEC_RETURN_CODE_OK;
+	}
+
+	if (decoder->end_of_stream_reached)
+	{
+		IMX_VPU_API_LOG("end of stream already reached; not doing anything");
+		*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_EOS;
+		return IMX_VPU_API_DEC_RETURN_CODE_OK;
+	}
+
+	if ((decoder->stream_info.min_num_required_framebuffers > 0) && decoder->frame_entries == NULL)
+	{
+		IMX_VPU_API_LOG("no framebuffers have been added to the pool");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+	}
+
+	ret = imx_vpu_api_dec_retrieve_frame_from_codec(decoder, output_code, &output_available);
+	if (output_available)
+		return ret;
+
 	*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NO_OUTPUT_YET_AVAILABLE;
 
 	if (decoder->stream_buffer_fill_level == 0)
@@ -1919,49 +3865,109 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 
 	do
 	{
+		/* Read directly from the input DMA buffer if one is in use. */
+		if (decoder->input_dma_buffer != NULL)
+		{
+			input_virtual_address = decoder->input_dma_buffer_virtual_address;
+			input_physical_address = decoder->input_dma_buffer_physical_address;
+			input_size = decoder->input_dma_buffer_size;
+		}
+		else
+		{
+			input_virtual_address = decoder->stream_buffer_virtual_address;
+			input_physical_address = decoder->stream_buffer_physical_address;
+			input_size = decoder->stream_buffer_size;
+		}
+
 		IMX_VPU_API_LOG(
-			"scanning for frames in the stream buffer; read offset %zu write offset %zu fill level %zu",
+			"scanning for frames in the %s; read offset %zu write offset %zu fill level %zu",
+			(decoder->input_dma_buffer != NULL) ? "input DMA buffer" : "stream buffer",
 			decoder->stream_buffer_read_offset,
 			decoder->stream_buffer_write_offset,
 			decoder->stream_buffer_fill_level
 		);
 
-		stream_buffer.bus_data = decoder->stream_buffer_virtual_address + decoder->stream_buffer_read_offset;
-		stream_buffer.bus_address = (OSAL_BUS_WIDTH)(decoder->stream_buffer_physical_address + decoder->stream_buffer_read_offset);
+		stream_buffer.bus_data = input_virtual_address + decoder->stream_buffer_read_offset;
+		stream_buffer.bus_address = (OSAL_BUS_WIDTH)(input_physical_address + decoder->stream_buffer_read_offset);
 		stream_buffer.streamlen = decoder->stream_buffer_fill_level;
-		stream_buffer.allocsize = decoder->stream_buffer_size;
+		stream_buffer.allocsize = input_size;
 
 		scan_ret = decoder->codec->scanframe(decoder->codec, &stream_buffer, &first_offset_ptr, &last_offset_ptr);
-		if ((scan_ret == -1) || (first_offset_ptr == last_offset_ptr))
+
+		/* In byte stream input mode, scanframe() does not find the last frame,
+		 * since it only knows that a frame is complete once the next one
+		 * begins. In drain mode, no more data will come, so the remaining
+		 * data is passed to the codec as the last frame. */
+		if (((scan_ret == -1) || (first_offset_ptr == last_offset_ptr)) && decoder->byte_stream_input && decoder->drain_mode_enabled)
+		{
+			/* If that data was already passed to the codec, then there
+			 * is nothing left to decode. Exit the loop instead of calling
+			 * decode() with an empty stream; the next call then initiates
+			 * the codec's drain (see the fill level check above). */
+			if (decoder->stream_buffer_fill_level == 0)
+			{
+				IMX_VPU_API_LOG("drain mode enabled in byte stream input mode, and all data was passed to the codec");
+				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NO_OUTPUT_YET_AVAILABLE;
+				break;
+			}
+
+			IMX_VPU_API_LOG("drain mode enabled in byte stream input mode; passing remaining %zu byte(s) to the codec as last frame", decoder->stream_buffer_fill_level);
+			first_offset_ptr = 0;
+			last_offset_ptr = decoder->stream_buffer_fill_level;
+		}
+		else if ((scan_ret == -1) || (first_offset_ptr == last_offset_ptr))
 		{
 			IMX_VPU_API_LOG("scanning for frames in stream buffer found nothing");
+			/* More data is needed, and it will have to be appended
+			 * to the remaining data, so move that remaining data
+			 * to the stream buffer if an input DMA buffer is used. */
+			imx_vpu_api_dec_release_input_dma_buffer(decoder, TRUE);
 			decoder->encoded_data_available = FALSE;
 			*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_MORE_INPUT_DATA_NEEDED;
 			return IMX_VPU_API_DEC_RETURN_CODE_OK;
 		}
 
-		IMX_VPU_API_LOG("found frame, offsets:  first %zu  last %zu  associated frame entry index: %zu", (size_t)(first_offset_ptr), (size_t)(last_offset_ptr), decoder->last_pushed_frame_entry_index);
+		/* Associate the frame that was found with the queued frame its
+		 * first byte belongs to. The data is left in the stream buffer
+		 * if no frame entry is available for it, so decoding can resume
+		 * once the caller retrieved or skipped decoded frames. */
+		if (!imx_vpu_api_dec_associate_picture_with_frame_entry(decoder, first_offset_ptr))
+		{
+			IMX_VPU_API_ERROR("cannot decode frame since no free frame entry is available");
+			return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+		}
+
+		IMX_VPU_API_LOG("found frame, offsets:  first %zu  last %zu  associated frame entry index: %zu", (size_t)(first_offset_ptr), (size_t)(last_offset_ptr), decoder->current_frame_entry_index);
 
 		stream_buffer.streamlen = last_offset_ptr - first_offset_ptr;
 
-		stream_buffer.bus_data = decoder->stream_buffer_virtual_address + decoder->stream_buffer_read_offset + first_offset_ptr;
-		stream_buffer.buf_data = decoder->stream_buffer_virtual_address;
-		stream_buffer.bus_address = (OSAL_BUS_WIDTH)(decoder->stream_buffer_physical_address + decoder->stream_buffer_read_offset + first_offset_ptr);
-		stream_buffer.buf_address = (OSAL_BUS_WIDTH)(decoder->stream_buffer_physical_address);
+		stream_buffer.bus_data = input_virtual_address + decoder->stream_buffer_read_offset + first_offset_ptr;
+		stream_buffer.buf_data = input_virtual_address;
+		stream_buffer.bus_address = (OSAL_BUS_WIDTH)(input_physical_address + decoder->stream_buffer_read_offset + first_offset_ptr);
+		stream_buffer.buf_address = (OSAL_BUS_WIDTH)(input_physical_address);
 		stream_buffer.sliceInfoNum = decoder->slice_info_nr;
 		stream_buffer.pSliceInfo = (OMX_U8 *)(&(decoder->slice_info[0]));
-		stream_buffer.picId = (OMX_U32)(decoder->last_pushed_frame_entry_index);
+		stream_buffer.picId = (OMX_U32)(decoder->current_frame_entry_index);
 
 		codec_state = decoder->codec->decode(decoder->codec, &stream_buffer, &num_used_input_bytes, &frame);
 		IMX_VPU_API_LOG("decode() result:  codec state %s (%d)  num used input bytes %zu", codec_state_to_string(codec_state), codec_state, (size_t)(num_used_input_bytes));
 
+		decoder->current_picture_pending = (num_used_input_bytes == 0);
+
 		num_used_input_bytes += first_offset_ptr;
 
 		assert(decoder->stream_buffer_fill_level >= num_used_input_bytes);
 		decoder->stream_buffer_fill_level -= num_used_input_bytes;
 		decoder->stream_buffer_read_offset += num_used_input_bytes;
-		if (decoder->stream_buffer_read_offset >= decoder->stream_buffer_size)
-			decoder->stream_buffer_read_offset -= decoder->stream_buffer_size;
+		if (decoder->stream_buffer_read_offset >= input_size)
+			decoder->stream_buffer_read_offset -= input_size;
+
+		imx_vpu_api_dec_remove_consumed_queued_frames(decoder, num_used_input_bytes);
+
+		/* Release the input DMA buffer as soon as the codec is done with it
+		 * so the user can reuse it as early as possible. */
+		if ((decoder->input_dma_buffer != NULL) && (decoder->stream_buffer_fill_level == 0))
+			imx_vpu_api_dec_release_input_dma_buffer(decoder, FALSE);
 
 		switch (codec_state)
 		{
@@ -1989,14 +3995,29 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 				 * reopen the decoder, get rid of old framebuffers, and
 				 * allocate new ones when requested. */
 				do_loop = FALSE;
-				IMX_VPU_API_DEBUG("decoder is in a pending-flush state -> video params changed");
-				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_VIDEO_PARAMETERS_CHANGED;
+				if (decoder->reuse_framebuffers)
+				{
+					/* If framebuffers are to be reused, the decoder is
+					 * not reopened. Instead, the remaining frames are
+					 * retrieved by the next imx_vpu_api_dec_decode()
+					 * calls, after which the codec reports the new stream
+					 * info, and the framebuffers that still fit are
+					 * handed over to the codec again. */
+					IMX_VPU_API_DEBUG("decoder is in a pending-flush state -> video params changed; continuing since framebuffers are reused");
+					*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NO_OUTPUT_YET_AVAILABLE;
+				}
+				else
+				{
+					IMX_VPU_API_DEBUG("decoder is in a pending-flush state -> video params changed");
+					*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_VIDEO_PARAMETERS_CHANGED;
+				}
 				break;
 
 			case CODEC_NO_DECODING_BUFFER:
 				do_loop = FALSE;
-				IMX_VPU_API_DEBUG("could not decode because there is no available framebuffer; requesting more framebuffers");
-				decoder->num_framebuffers_to_be_added = 1;
+				decoder->num_framebuffers_to_be_added = imx_vpu_api_dec_get_num_missing_framebuffers(decoder);
+				decoder->min_num_framebuffers_to_be_added = 1;
+				IMX_VPU_API_DEBUG("could not decode because there is no available framebuffer; requesting %zu more framebuffer(s)", decoder->num_framebuffers_to_be_added);
 				*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NEED_ADDITIONAL_FRAMEBUFFER;
 				break;
 
@@ -2028,6 +4049,8 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 				do_loop = FALSE;
 				if (decoder->has_new_stream_info)
 				{
+					size_t num_reused_framebuffers = 0;
+
 					/* Clear out old framebuffers and frame entries, since
 					 * they are not needed anymore. Furthermore, if they
 					 * remained, they'd be causing errors during video
@@ -2040,25 +4063,46 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 					 * This also means that at this point, any previously
 					 * added framebuffer is no longer added to the VPU's
 					 * pool, so these old framebuffers can be safely discarded
-					 * at this point. */
-					imx_vpu_api_dec_clear_added_framebuffers(decoder);
+					 * at this point.
+					 *
+					 * If framebuffers are to be reused, the old ones that
+					 * fit the new stream info are added to the VPU's pool
+					 * again instead, so that only the missing ones have to
+					 * be added by the user. */
+					if (!(decoder->reuse_framebuffers))
+						imx_vpu_api_dec_clear_added_framebuffers(decoder);
 
 					if (!imx_vpu_api_dec_get_new_stream_info(decoder))
 						return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
 
+					if (decoder->reuse_framebuffers)
+						num_reused_framebuffers = imx_vpu_api_dec_reuse_added_framebuffers(decoder);
+
 					/* Turn off this flag again to make sure we don't
 					 * wrongly announce new stream info even though there
 					 * isn't any new one. */
 					decoder->has_new_stream_info = FALSE;
 
 					IMX_VPU_API_LOG("new stream info was seen earlier, and new framebuffers are needed");
-					decoder->num_framebuffers_to_be_added = decoder->stream_info.min_num_required_framebuffers;
+					if (num_reused_framebuffers < decoder->stream_info.min_num_required_framebuffers)
+						decoder->num_framebuffers_to_be_added = decoder->stream_info.min_num_required_framebuffers - num_reused_framebuffers;
+					else
+						decoder->num_framebuffers_to_be_added = 0;
+					decoder->min_num_framebuffers_to_be_added = decoder->num_framebuffers_to_be_added;
+
+					/* Make sure the frame entry pool can hold entries for
+					 * all frames in the DPB plus all queued frames plus the
+					 * decoded frame that is about to be retrieved. This is
+					 * the only place where the pool grows after opening. */
+					if (!imx_vpu_api_dec_grow_frame_entry_pool(decoder, decoder->stream_info.min_num_required_framebuffers + decoder->queued_frames_capacity + 1))
+						return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
 					*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NEW_STREAM_INFO_AVAILABLE;
 				}
 				else
 				{
-					IMX_VPU_API_LOG("more framebuffers are needed for decoding");
-					decoder->num_framebuffers_to_be_added = 1;
+					decoder->num_framebuffers_to_be_added = imx_vpu_api_dec_get_num_missing_framebuffers(decoder);
+					decoder->min_num_framebuffers_to_be_added = 1;
+					IMX_VPU_API_LOG("%zu more framebuffer(s) are needed for decoding", decoder->num_framebuffers_to_be_added);
 					*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NEED_ADDITIONAL_FRAMEBUFFER;
 				}
 				break;
@@ -2079,6 +4123,48 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 				break;
 			}
 
+			case CODEC_ERROR_STREAM:
+			{
+				FrameEntry *frame_entry;
+
+				/* Bitstream errors mean that the stream state was lost.
+				 * They are fatal unless resync on errors is enabled. In
+				 * that case, the frame is reported as a corrupted one,
+				 * and decoding resumes at the next random access point. */
+				if (!(decoder->resync_on_errors))
+				{
+					IMX_VPU_API_ERROR("decoding failure:  codec state %s (%d)", codec_state_to_string(codec_state), codec_state);
+					ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+					do_loop = FALSE;
+					break;
+				}
+
+				if ((decoder->current_frame_entry_index != INVALID_FRAME_ENTRY_INDEX) && (decoder->current_frame_entry_index < decoder->num_frame_entries))
+				{
+					frame_entry = &(decoder->frame_entries[decoder->current_frame_entry_index]);
+					decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_CORRUPTED_FRAME;
+					decoder->skipped_frame_context = frame_entry->context;
+					decoder->skipped_frame_pts = frame_entry->pts;
+					decoder->skipped_frame_dts = frame_entry->dts;
+					imx_vpu_api_dec_release_frame_entry(decoder, decoder->current_frame_entry_index);
+
+					*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
+
+					IMX_VPU_API_LOG("frame at entry index %zu with context %p PTS %" PRIu64 " DTS %" PRIu64 " is corrupted", decoder->current_frame_entry_index, frame_entry->context, frame_entry->pts, frame_entry->dts);
+				}
+				else
+				{
+					/* Even without a frame to report, the stream
+					 * state is lost, so resync anyway. */
+					IMX_VPU_API_WARNING("bitstream error without a current frame entry");
+				}
+
+				imx_vpu_api_dec_begin_resync(decoder);
+
+				do_loop = FALSE;
+				break;
+			}
+
 			case CODEC_PIC_SKIPPED:
 #ifdef HAVE_IMXVPUDEC_HANTRO_CODEC_ERROR_FRAME
 			case CODEC_ERROR_FRAME:
@@ -2086,28 +4172,31 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 			{
 				FrameEntry *frame_entry;
 
-				if ((decoder->last_pushed_frame_entry_index != INVALID_FRAME_ENTRY_INDEX) || (decoder->last_pushed_frame_entry_index < decoder->num_frame_entries))
+				/* Errors in a single frame are concealed by the codec,
+				 * and the stream state remains intact, so no resync
+				 * is needed here. */
+				if ((decoder->current_frame_entry_index != INVALID_FRAME_ENTRY_INDEX) && (decoder->current_frame_entry_index < decoder->num_frame_entries))
 				{
-					frame_entry = &(decoder->frame_entries[decoder->last_pushed_frame_entry_index]);
+					frame_entry = &(decoder->frame_entries[decoder->current_frame_entry_index]);
 					decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_INTERNAL_FRAME;
 #ifdef HAVE_IMXVPUDEC_HANTRO_CODEC_ERROR_FRAME
-					if (codec_state == CODEC_PIC_SKIPPED)
+					if (codec_state == CODEC_ERROR_FRAME)
 						decoder->skipped_frame_reason = IMX_VPU_API_DEC_SKIPPED_FRAME_REASON_CORRUPTED_FRAME;
 #endif
 					decoder->skipped_frame_context = frame_entry->context;
 					decoder->skipped_frame_pts = frame_entry->pts;
 					decoder->skipped_frame_dts = frame_entry->dts;
-					frame_entry->occupied = FALSE;
+					imx_vpu_api_dec_release_frame_entry(decoder, decoder->current_frame_entry_index);
 
 					decoder->encoded_data_available = FALSE;
 
 					*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_FRAME_SKIPPED;
 
-					IMX_VPU_API_LOG("frame at entry index %zu with context %p PTS %" PRIu64 " DTS %" PRIu64 " got skipped", decoder->last_pushed_frame_entry_index, frame_entry->context, frame_entry->pts, frame_entry->dts);
+					IMX_VPU_API_LOG("frame at entry index %zu with context %p PTS %" PRIu64 " DTS %" PRIu64 " got skipped", decoder->current_frame_entry_index, frame_entry->context, frame_entry->pts, frame_entry->dts);
 				}
 				else
 				{
-					IMX_VPU_API_ERROR("Could not get context for skipped frame; last pushed frame entry index is invalid (%zu)", decoder->last_pushed_frame_entry_index);
+					IMX_VPU_API_ERROR("Could not get context for skipped frame; current frame entry index is invalid (%zu)", decoder->current_frame_entry_index);
 					ret = IMX_VPU_API_DEC_RETURN_CODE_ERROR;
 				}
 
@@ -2115,6 +4204,13 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 				break;
 			}
 
+			case CODEC_ERROR_HW_TIMEOUT:
+			case CODEC_ERROR_HW_BUS_ERROR:
+				imx_vpu_api_dec_reset_after_hardware_error(decoder, codec_state);
+				ret = IMX_VPU_API_DEC_RETURN_CODE_HARDWARE_RESET;
+				do_loop = FALSE;
+				break;
+
 			case CODEC_ERROR_STREAM_NOT_SUPPORTED:
 				IMX_VPU_API_ERROR("this bitstream is not supported");
 				ret = IMX_VPU_API_DEC_RETURN_CODE_UNSUPPORTED_BITSTREAM;
@@ -2130,10 +4226,51 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_decode(ImxVpuApiDecoder *decoder, ImxVpu
 	}
 	while (do_loop);
 
+	/* Normally, a frame that decode() reported is retrieved with getframe()
+	 * in the next imx_vpu_api_dec_decode() call. In low latency mode, do
+	 * that right away, so the frame is output in the same call. This only
+	 * retrieves the frame; no more encoded data is decoded, so each call
+	 * consumes at most one frame. */
+	if ((ret == IMX_VPU_API_DEC_RETURN_CODE_OK) && decoder->low_latency && decoder->decoded_frame_reported && (*output_code == IMX_VPU_API_DEC_OUTPUT_CODE_NO_OUTPUT_YET_AVAILABLE))
+	{
+		IMX_VPU_API_LOG("low latency mode enabled; retrieving decoded frame immediately");
+		ret = imx_vpu_api_dec_retrieve_frame_from_codec(decoder, output_code, &output_available);
+		if (!output_available)
+			*output_code = IMX_VPU_API_DEC_OUTPUT_CODE_NO_OUTPUT_YET_AVAILABLE;
+	}
+
 	return ret;
 }
 
 
+int imx_vpu_api_dec_get_event_fd(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return imx_vpu_api_dec_async_get_event_fd(&(decoder->async_state), decoder);
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_start_decode(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return imx_vpu_api_dec_async_start_decode(&(decoder->async_state), decoder);
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_finish_decode(ImxVpuApiDecoder *decoder, ImxVpuApiDecOutputCodes *output_code)
+{
+	assert(decoder != NULL);
+	return imx_vpu_api_dec_async_finish_decode(&(decoder->async_state), output_code);
+}
+
+
+void imx_vpu_api_dec_set_scheduling_params(ImxVpuApiDecoder *decoder, int priority, unsigned int weight)
+{
+	assert(decoder != NULL);
+	imx_vpu_api_async_job_set_scheduling_params(&(decoder->async_state.job), priority, weight);
+}
+
+
 ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *decoder, ImxVpuApiRawFrame *decoded_frame)
 {
 	FrameEntry *frame_entry;
@@ -2157,6 +4294,7 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *deco
 
 	decoded_frame->fb_dma_buffer = framebuffer_entry->fb_dma_buffer;
 	decoded_frame->fb_context = framebuffer_entry->fb_context;
+	framebuffer_entry->held_by_user = TRUE;
 	decoded_frame->context = frame_entry->context;
 	decoded_frame->pts = frame_entry->pts;
 	decoded_frame->dts = frame_entry->dts;
@@ -2167,7 +4305,10 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *deco
 	 * arranged. It seems to use bottom-field-first for all formats. */
 	decoded_frame->interlacing_mode = IMX_VPU_API_INTERLACING_MODE_BOTTOM_FIELD_FIRST;
 
-	frame_entry->occupied = FALSE;
+	decoder->decoded_frame_latency = imx_vpu_api_get_monotonic_time() - frame_entry->push_time;
+	IMX_VPU_API_LOG("decoded frame latency: %" PRIu64 " ns", decoder->decoded_frame_latency);
+
+	imx_vpu_api_dec_release_frame_entry(decoder, decoder->decoded_frame_entry_index);
 
 	decoder->decoded_frame_entry_index = INVALID_FRAME_ENTRY_INDEX;
 	decoder->decoded_frame_fb_entry_index = INVALID_FRAME_ENTRY_INDEX;
@@ -2176,6 +4317,29 @@ ImxVpuApiDecReturnCodes imx_vpu_api_dec_get_decoded_frame(ImxVpuApiDecoder *deco
 }
 
 
+uint64_t imx_vpu_api_dec_get_decoded_frame_latency(ImxVpuApiDecoder *decoder)
+{
+	assert(decoder != NULL);
+	return decoder->decoded_frame_latency;
+}
+
+
+int imx_vpu_api_dec_is_output_frame_ready(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(decoder);
+	IMX_VPU_API_UNUSED_PARAM(fb_dma_buffer);
+	return 1;
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_wait_for_output_frame(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(decoder);
+	IMX_VPU_API_UNUSED_PARAM(fb_dma_buffer);
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+}
+
+
 void imx_vpu_api_dec_return_framebuffer_to_decoder(ImxVpuApiDecoder *decoder, ImxDmaBuffer *fb_dma_buffer)
 {
 	CODEC_STATE codec_state;
@@ -2196,6 +4360,16 @@ void imx_vpu_api_dec_return_framebuffer_to_decoder(ImxVpuApiDecoder *decoder, Im
 	framebuffer_entry = &(decoder->framebuffer_entries[fb_entry_index]);
 	assert(framebuffer_entry != NULL);
 
+	framebuffer_entry->held_by_user = FALSE;
+
+	/* The codec does not know about retired framebuffers anymore,
+	 * so they are removed from the pool instead. */
+	if (framebuffer_entry->retired)
+	{
+		imx_vpu_api_dec_remove_retired_framebuffer_entry(decoder, fb_entry_index);
+		return;
+	}
+
 	buffer.bus_data = framebuffer_entry->mapped_virtual_address;
 	buffer.bus_address = (OSAL_BUS_WIDTH)physical_address;
 
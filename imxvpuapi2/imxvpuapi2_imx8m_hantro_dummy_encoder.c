@@ -119,6 +119,34 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_encode(ImxVpuApiEncoder *encoder, size_t
 	return IMX_VPU_API_ENC_RETURN_CODE_OK;
 }
 
+int imx_vpu_api_enc_get_event_fd(ImxVpuApiEncoder *encoder)
+{
+	IMX_VPU_API_UNUSED_PARAM(encoder);
+	return -1;
+}
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_start_encode(ImxVpuApiEncoder *encoder)
+{
+	IMX_VPU_API_UNUSED_PARAM(encoder);
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_finish_encode(ImxVpuApiEncoder *encoder, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code)
+{
+	IMX_VPU_API_UNUSED_PARAM(encoder);
+	/* Nothing is ever encoded, so there is never any output. */
+	*encoded_frame_size = 0;
+	*output_code = IMX_VPU_API_ENC_OUTPUT_CODE_MORE_INPUT_DATA_NEEDED;
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
+
+void imx_vpu_api_enc_set_scheduling_params(ImxVpuApiEncoder *encoder, int priority, unsigned int weight)
+{
+	IMX_VPU_API_UNUSED_PARAM(encoder);
+	IMX_VPU_API_UNUSED_PARAM(priority);
+	IMX_VPU_API_UNUSED_PARAM(weight);
+}
+
 ImxVpuApiEncReturnCodes imx_vpu_api_enc_get_encoded_frame(ImxVpuApiEncoder *encoder, ImxVpuApiEncodedFrame *encoded_frame)
 {
 	return imx_vpu_api_enc_get_encoded_frame_ext(encoder, encoded_frame, NULL);
@@ -237,6 +237,9 @@ struct _ImxVpuApiEncoder
 	 * ImxVpuApiEncEncodedFrame structure when getting the encoded
 	 * frame with imx_vpu_api_enc_get_encoded_frame(). */
 	size_t encoded_frame_data_size;
+
+	/* State for imx_vpu_api_enc_start_encode() / imx_vpu_api_enc_finish_encode(). */
+	ImxVpuApiEncAsyncState async_state;
 };
 
 
@@ -444,6 +447,8 @@ ImxVpuApiEncReturnCodes imx_vpu_api_enc_open(ImxVpuApiEncoder **encoder, ImxVpuA
 	/* Make a copy of the open_params for later use. */
 	(*encoder)->open_params = *open_params;
 
+	imx_vpu_api_async_job_set_core(&((*encoder)->async_state.job), IMX_VPU_API_ASYNC_CORE_ENCODER);
+
 
 	/* Calculate framebuffer metrics. */
 
@@ -1036,6 +1041,10 @@ void imx_vpu_api_enc_close(ImxVpuApiEncoder *encoder)
 
 	IMX_VPU_API_DEBUG("closing encoder");
 
+	/* This waits for any encoding step that is still in progress,
+	 * so it must be done before anything else is torn down. */
+	imx_vpu_api_enc_async_cleanup(&(encoder->async_state));
+
 	if (encoder->encoder != NULL)
 		VCEncRelease(encoder->encoder);
 
@@ -1355,6 +1364,34 @@ error:
 }
 
 
+int imx_vpu_api_enc_get_event_fd(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_get_event_fd(&(encoder->async_state), encoder);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_start_encode(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_start_encode(&(encoder->async_state), encoder);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_finish_encode(ImxVpuApiEncoder *encoder, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_finish_encode(&(encoder->async_state), encoded_frame_size, output_code);
+}
+
+
+void imx_vpu_api_enc_set_scheduling_params(ImxVpuApiEncoder *encoder, int priority, unsigned int weight)
+{
+	assert(encoder != NULL);
+	imx_vpu_api_async_job_set_scheduling_params(&(encoder->async_state.job), priority, weight);
+}
+
+
 ImxVpuApiEncReturnCodes imx_vpu_api_enc_get_encoded_frame(ImxVpuApiEncoder *encoder, ImxVpuApiEncodedFrame *encoded_frame)
 {
 	return imx_vpu_api_enc_get_encoded_frame_ext(encoder, encoded_frame, NULL);
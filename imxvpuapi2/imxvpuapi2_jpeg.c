@@ -120,6 +120,8 @@ struct _ImxVpuApiJpegDecoder
 
 static BOOL imx_vpu_api_jpeg_dec_add_framebuffers(ImxVpuApiJpegDecoder *jpeg_decoder, size_t num_framebuffers_to_add);
 static void imx_vpu_api_jpeg_dec_deallocate_fb_dma_buffers(ImxVpuApiJpegDecoder *jpeg_decoder);
+static void imx_vpu_api_jpeg_dec_deallocate_unused_fb_dma_buffers(ImxVpuApiJpegDecoder *jpeg_decoder);
+static void imx_vpu_api_jpeg_dec_return_fb_dma_buffer(ImxVpuApiJpegDecoder *jpeg_decoder);
 
 
 static BOOL imx_vpu_api_jpeg_dec_add_framebuffers(ImxVpuApiJpegDecoder *jpeg_decoder, size_t num_framebuffers_to_add)
@@ -164,6 +166,53 @@ static void imx_vpu_api_jpeg_dec_deallocate_fb_dma_buffers(ImxVpuApiJpegDecoder
 }
 
 
+static void imx_vpu_api_jpeg_dec_deallocate_unused_fb_dma_buffers(ImxVpuApiJpegDecoder *jpeg_decoder)
+{
+	size_t i, num_remaining_framebuffers = 0;
+
+	/* Deallocate the framebuffers the decoder dropped from its pool,
+	 * and move the remaining ones to the beginning of the array.
+	 * The framebuffer that was last passed to the user is still part
+	 * of the pool if it was not returned yet, so it is kept here. */
+	for (i = 0; i < jpeg_decoder->num_framebuffers; ++i)
+	{
+		ImxDmaBuffer *fb_dma_buffer = jpeg_decoder->fb_dma_buffers[i];
+
+		if (!imx_vpu_api_dec_is_framebuffer_in_pool(jpeg_decoder->decoder, fb_dma_buffer))
+		{
+			imx_dma_buffer_deallocate(fb_dma_buffer);
+			continue;
+		}
+
+		jpeg_decoder->fb_dma_buffers[num_remaining_framebuffers++] = fb_dma_buffer;
+	}
+
+	IMX_VPU_API_DEBUG("keeping %zu of %zu framebuffer(s)", num_remaining_framebuffers, jpeg_decoder->num_framebuffers);
+
+	jpeg_decoder->num_framebuffers = num_remaining_framebuffers;
+	if (num_remaining_framebuffers == 0)
+	{
+		free(jpeg_decoder->fb_dma_buffers);
+		jpeg_decoder->fb_dma_buffers = NULL;
+	}
+}
+
+
+static void imx_vpu_api_jpeg_dec_return_fb_dma_buffer(ImxVpuApiJpegDecoder *jpeg_decoder)
+{
+	if (jpeg_decoder->fb_dma_buffer_to_return == NULL)
+		return;
+
+	imx_vpu_api_dec_return_framebuffer_to_decoder(jpeg_decoder->decoder, jpeg_decoder->fb_dma_buffer_to_return);
+	jpeg_decoder->fb_dma_buffer_to_return = NULL;
+
+	/* If the framebuffer was dropped from the pool while the user held
+	 * it, the decoder removes it once it is returned. It can then be
+	 * deallocated. */
+	imx_vpu_api_jpeg_dec_deallocate_unused_fb_dma_buffers(jpeg_decoder);
+}
+
+
 int imx_vpu_api_jpeg_dec_open(ImxVpuApiJpegDecoder **jpeg_decoder, ImxDmaBufferAllocator *dma_buffer_allocator)
 {
 	int ret = TRUE;
@@ -193,7 +242,10 @@ int imx_vpu_api_jpeg_dec_open(ImxVpuApiJpegDecoder **jpeg_decoder, ImxDmaBufferA
 	open_params = &((*jpeg_decoder)->open_params);
 	memset(open_params, 0, sizeof(ImxVpuApiDecOpenParams));
 	open_params->compression_format = IMX_VPU_API_COMPRESSION_FORMAT_JPEG;
-	open_params->flags = 0;
+	/* Keep framebuffers across JPEG format changes if the decoder supports
+	 * it. Otherwise, every change in size or color format would cause the
+	 * entire pool to be reallocated. */
+	open_params->flags = IMX_VPU_API_DEC_OPEN_PARAMS_FLAG_REUSE_FRAMEBUFFERS;
 
 	if ((dec_ret = imx_vpu_api_dec_open(&((*jpeg_decoder)->decoder), open_params, (*jpeg_decoder)->stream_buffer)) != IMX_VPU_API_DEC_RETURN_CODE_OK)
 	{
@@ -240,11 +292,7 @@ ImxVpuApiJpegDecInfo const * imx_vpu_api_jpeg_dec_decode(ImxVpuApiJpegDecoder *j
 
 	assert(jpeg_decoder != NULL);
 
-	if (jpeg_decoder->fb_dma_buffer_to_return != NULL)
-	{
-		imx_vpu_api_dec_return_framebuffer_to_decoder(jpeg_decoder->decoder, jpeg_decoder->fb_dma_buffer_to_return);
-		jpeg_decoder->fb_dma_buffer_to_return = NULL;
-	}
+	imx_vpu_api_jpeg_dec_return_fb_dma_buffer(jpeg_decoder);
 
 	encoded_frame.data = (uint8_t *)jpeg_data;
 	encoded_frame.data_size = jpeg_data_size;
@@ -278,26 +326,39 @@ ImxVpuApiJpegDecInfo const * imx_vpu_api_jpeg_dec_decode(ImxVpuApiJpegDecoder *j
 			{
 				ImxVpuApiFramebufferMetrics const *fb_metrics = &(jpeg_decoder->stream_info.decoded_frame_framebuffer_metrics);
 				ImxVpuApiDecStreamInfo const *stream_info = imx_vpu_api_dec_get_stream_info(jpeg_decoder->decoder);
+				size_t num_framebuffers_to_add;
 
-				imx_vpu_api_jpeg_dec_deallocate_fb_dma_buffers(jpeg_decoder);
+				imx_vpu_api_jpeg_dec_deallocate_unused_fb_dma_buffers(jpeg_decoder);
 
 				jpeg_decoder->stream_info = *stream_info;
 				jpeg_decoder->jpeg_dec_info.framebuffer_metrics = fb_metrics;
 				jpeg_decoder->jpeg_dec_info.color_format = stream_info->color_format;
 				jpeg_decoder->jpeg_dec_info.total_frame_size = (imx_vpu_api_is_color_format_semi_planar(stream_info->color_format) ? fb_metrics->u_offset : fb_metrics->v_offset) + fb_metrics->uv_size;
 
-				if (!imx_vpu_api_jpeg_dec_add_framebuffers(jpeg_decoder, stream_info->min_num_required_framebuffers))
+				num_framebuffers_to_add = imx_vpu_api_dec_get_num_framebuffers_to_be_added(jpeg_decoder->decoder);
+				if (!imx_vpu_api_jpeg_dec_add_framebuffers(jpeg_decoder, num_framebuffers_to_add))
 				{
-					IMX_VPU_API_ERROR("could not add %zu framebuffer(s) to decoder", stream_info->min_num_required_framebuffers);
+					IMX_VPU_API_ERROR("could not add %zu framebuffer(s) to decoder", num_framebuffers_to_add);
 					goto error;
 				}
 
 				if (!(jpeg_decoder->global_info->flags & IMX_VPU_API_DEC_GLOBAL_INFO_FLAG_DECODED_FRAMES_ARE_FROM_BUFFER_POOL))
 				{
 					int err;
+					size_t alignment = jpeg_decoder->stream_info.output_framebuffer_alignment;
 
+					/* Keep the existing output buffer if it is large
+					 * enough and suitably aligned for the new format. */
 					if (jpeg_decoder->output_dma_buffer != NULL)
 					{
+						if ((imx_dma_buffer_get_size(jpeg_decoder->output_dma_buffer) >= jpeg_decoder->stream_info.min_output_framebuffer_size)
+						 && ((alignment <= 1) || ((imx_dma_buffer_get_physical_address(jpeg_decoder->output_dma_buffer) % alignment) == 0)))
+						{
+							IMX_VPU_API_DEBUG("reusing output DMA buffer");
+							imx_vpu_api_dec_set_output_frame_dma_buffer(jpeg_decoder->decoder, jpeg_decoder->output_dma_buffer, NULL);
+							break;
+						}
+
 						imx_dma_buffer_deallocate(jpeg_decoder->output_dma_buffer);
 						jpeg_decoder->output_dma_buffer = NULL;
 					}
@@ -322,9 +383,11 @@ ImxVpuApiJpegDecInfo const * imx_vpu_api_jpeg_dec_decode(ImxVpuApiJpegDecoder *j
 
 			case IMX_VPU_API_DEC_OUTPUT_CODE_NEED_ADDITIONAL_FRAMEBUFFER:
 			{
-				if (!imx_vpu_api_jpeg_dec_add_framebuffers(jpeg_decoder, 1))
+				size_t num_framebuffers_to_add = imx_vpu_api_dec_get_num_framebuffers_to_be_added(jpeg_decoder->decoder);
+
+				if (!imx_vpu_api_jpeg_dec_add_framebuffers(jpeg_decoder, num_framebuffers_to_add))
 				{
-					IMX_VPU_API_ERROR("could not add framebuffer to decoder");
+					IMX_VPU_API_ERROR("could not add %zu framebuffer(s) to decoder", num_framebuffers_to_add);
 					goto error;
 				}
 
@@ -1,6 +1,16 @@
+/* Needed for clock_gettime(). */
+#define _POSIX_C_SOURCE 199309L
+
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <config.h>
 #include "imxvpuapi2_priv.h"
 
 
@@ -9,6 +19,10 @@ uint8_t const h264_aud[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
 size_t const h264_aud_size = sizeof(h264_aud);
 
 
+/* h.264/h.265 Annex-B start code */
+uint8_t const annexb_start_code[ANNEXB_START_CODE_SIZE] = { 0x00, 0x00, 0x00, 0x01 };
+
+
 /* These quantization tables are from the JPEG specification, section K.1 */
 
 uint8_t const jpeg_quantization_table_luma[64] =
@@ -268,218 +282,1879 @@ void imx_vpu_api_insert_divx3_frame_header(uint8_t *header, unsigned int frame_w
 }
 
 
-int imx_vpu_api_parse_jpeg_header(void *jpeg_data, size_t jpeg_data_size, BOOL semi_planar_output, unsigned int *width, unsigned int *height, ImxVpuApiColorFormat *color_format)
+static size_t read_nal_length(uint8_t const *data, unsigned int nal_length_size)
 {
-	uint8_t *jpeg_data_start = jpeg_data;
-	uint8_t *jpeg_data_end = jpeg_data_start + jpeg_data_size;
-	uint8_t *jpeg_data_cur = jpeg_data_start;
-	int found_info = 0;
+	size_t length = 0;
+	unsigned int i;
 
-#define READ_UINT8(value) do \
-	{ \
-		(value) = *jpeg_data_cur; \
-		++jpeg_data_cur; \
-	} \
-	while (0)
-#define READ_UINT16(value) do \
+	for (i = 0; i < nal_length_size; ++i)
+		length = (length << 8) | data[i];
+
+	return length;
+}
+
+
+static void append_annexb_nal(uint8_t *annexb_data, size_t *annexb_offset, uint8_t const *nal, size_t nal_size)
+{
+	if (annexb_data != NULL)
+	{
+		memcpy(annexb_data + (*annexb_offset), annexb_start_code, ANNEXB_START_CODE_SIZE);
+		memcpy(annexb_data + (*annexb_offset) + ANNEXB_START_CODE_SIZE, nal, nal_size);
+	}
+
+	(*annexb_offset) += ANNEXB_START_CODE_SIZE + nal_size;
+}
+
+
+BOOL imx_vpu_api_convert_nal_config_to_annexb(ImxVpuApiCompressionFormat compression_format, uint8_t const *config_data, size_t config_data_size, uint8_t *annexb_data, size_t *annexb_data_size, unsigned int *nal_length_size)
+{
+	size_t offset, annexb_offset = 0;
+
+	assert(config_data != NULL);
+	assert(annexb_data_size != NULL);
+	assert(nal_length_size != NULL);
+
+#define CHECK_CONFIG_DATA_SIZE(NUM_BYTES) do \
 	{ \
-		uint16_t w = *((uint16_t *)jpeg_data_cur); \
-		jpeg_data_cur += 2; \
-		(value) = ( ((w & 0xff) << 8) | ((w & 0xff00) >> 8) ); \
+		if ((offset + (NUM_BYTES)) > config_data_size) \
+		{ \
+			IMX_VPU_API_ERROR("NAL configuration data is too short; expected at least %zu byte(s), got %zu", offset + (size_t)(NUM_BYTES), config_data_size); \
+			return FALSE; \
+		} \
 	} \
 	while (0)
 
-	while (jpeg_data_cur < jpeg_data_end)
+	switch (compression_format)
 	{
-		uint8_t marker;
+		case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+		{
+			/* avcC layout (ISO/IEC 14496-15 section 5.3.3.1):
+			 *   byte 0: configurationVersion (always 1)
+			 *   bytes 1-3: profile, profile compatibility, level
+			 *   byte 4: 6 reserved bits, 2 bits lengthSizeMinusOne
+			 *   byte 5: 3 reserved bits, 5 bits numOfSequenceParameterSets
+			 *   SPS entries: 16-bit length + SPS NAL
+			 *   1 byte numOfPictureParameterSets
+			 *   PPS entries: 16-bit length + PPS NAL
+			 * Any trailing profile specific extensions are ignored. */
+			unsigned int set_type, num_sets, i;
+
+			offset = 0;
+			CHECK_CONFIG_DATA_SIZE(6);
+
+			if (config_data[0] != 1)
+			{
+				IMX_VPU_API_ERROR("unsupported avcC configuration version %u", (unsigned int)(config_data[0]));
+				return FALSE;
+			}
 
-		/* Marker is preceded by byte 0xFF */
-		if (*(jpeg_data_cur++) != 0xff)
-			break;
+			*nal_length_size = (config_data[4] & 0x03) + 1;
+			num_sets = config_data[5] & 0x1F;
+			offset = 6;
+
+			for (set_type = 0; set_type < 2; ++set_type)
+			{
+				if (set_type == 1)
+				{
+					CHECK_CONFIG_DATA_SIZE(1);
+					num_sets = config_data[offset];
+					offset += 1;
+				}
+
+				for (i = 0; i < num_sets; ++i)
+				{
+					size_t nal_size;
+
+					CHECK_CONFIG_DATA_SIZE(2);
+					nal_size = READ_16BIT_BE(config_data, offset);
+					offset += 2;
+
+					CHECK_CONFIG_DATA_SIZE(nal_size);
+					append_annexb_nal(annexb_data, &annexb_offset, config_data + offset, nal_size);
+					offset += nal_size;
+				}
+			}
 
-		READ_UINT8(marker);
-		if (marker == JPEG_MARKER_SOS)
 			break;
+		}
 
-		switch (marker)
+		case IMX_VPU_API_COMPRESSION_FORMAT_H265:
 		{
-			case JPEG_MARKER_SOI:
-				break;
-			case JPEG_MARKER_DRI:
-				jpeg_data_cur += 4;
-				break;
-
-			case JPEG_MARKER_SOF2:
+			/* hvcC layout (ISO/IEC 14496-15 section 8.3.3.1):
+			 *   bytes 0-20: configurationVersion, profile/tier/level
+			 *               information, chroma format, bit depths etc.
+			 *   byte 21: 2 bits constantFrameRate, 3 bits numTemporalLayers,
+			 *            1 bit temporalIdNested, 2 bits lengthSizeMinusOne
+			 *   byte 22: numOfArrays
+			 *   arrays: 1 byte completeness + NAL unit type, 16-bit
+			 *           numNalus, then numNalus times 16-bit length + NAL */
+			unsigned int num_arrays, num_nalus, i, j;
+
+			offset = 0;
+			CHECK_CONFIG_DATA_SIZE(23);
+
+			if (config_data[0] != 1)
 			{
-				IMX_VPU_API_ERROR("progressive JPEGs are not supported");
-				return 0;
+				IMX_VPU_API_ERROR("unsupported hvcC configuration version %u", (unsigned int)(config_data[0]));
+				return FALSE;
 			}
 
-			case JPEG_MARKER_SOF0:
+			*nal_length_size = (config_data[21] & 0x03) + 1;
+			num_arrays = config_data[22];
+			offset = 23;
+
+			for (i = 0; i < num_arrays; ++i)
 			{
-				uint16_t length;
-				uint8_t num_components;
-				uint8_t block_width[3], block_height[3];
+				CHECK_CONFIG_DATA_SIZE(3);
+				num_nalus = READ_16BIT_BE(config_data, offset + 1);
+				offset += 3;
 
-				READ_UINT16(length);
-				length -= 2;
-				IMX_VPU_API_LOG("marker: %#lx length: %u", (unsigned long)marker, length);
+				for (j = 0; j < num_nalus; ++j)
+				{
+					size_t nal_size;
 
-				jpeg_data_cur++;
-				READ_UINT16(*height);
-				READ_UINT16(*width);
+					CHECK_CONFIG_DATA_SIZE(2);
+					nal_size = READ_16BIT_BE(config_data, offset);
+					offset += 2;
 
-				if ((*width) > 8192)
-				{
-					IMX_VPU_API_ERROR("width of %u pixels exceeds the maximum of 8192", *width);
-					return 0;
+					CHECK_CONFIG_DATA_SIZE(nal_size);
+					append_annexb_nal(annexb_data, &annexb_offset, config_data + offset, nal_size);
+					offset += nal_size;
 				}
+			}
 
-				if ((*height) > 8192)
-				{
-					IMX_VPU_API_ERROR("height of %u pixels exceeds the maximum of 8192", *height);
-					return 0;
-				}
+			break;
+		}
 
-				READ_UINT8(num_components);
+		default:
+			IMX_VPU_API_ERROR("compression format %s does not use length-prefixed NAL units", imx_vpu_api_compression_format_string(compression_format));
+			return FALSE;
+	}
 
-				if (num_components <= 3)
-				{
-					for (int i = 0; i < num_components; ++i)
-					{
-						uint8_t b;
-						++jpeg_data_cur;
-						READ_UINT8(b);
-						block_width[i] = (b & 0xf0) >> 4;
-						block_height[i] = (b & 0x0f);
-						++jpeg_data_cur;
-					}
-				}
+#undef CHECK_CONFIG_DATA_SIZE
 
-				if (num_components > 3)
-				{
-					IMX_VPU_API_ERROR("JPEGs with %d components are not supported", (int)num_components);
-					return 0;
-				}
-				if (num_components == 3)
-				{
-					int temp = (block_width[0] * block_height[0]) / (block_width[1] * block_height[1]);
+	if (*nal_length_size == 3)
+	{
+		IMX_VPU_API_ERROR("NAL length size 3 is not allowed");
+		return FALSE;
+	}
 
-					if ((temp == 4) && (block_height[0] == 2))
-						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT;
-					else if ((temp == 2) && (block_height[0] == 1))
-						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_HORIZONTAL_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_HORIZONTAL_8BIT;
-					else if ((temp == 2) && (block_height[0] == 2))
-						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_VERTICAL_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_VERTICAL_8BIT;
-					else if ((temp == 1) && (block_height[0] == 1))
-						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV444_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV444_8BIT;
-					else
-						*color_format = IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT;
-				}
-				else
-					*color_format = IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT;
+	*annexb_data_size = annexb_offset;
 
-				IMX_VPU_API_LOG("width: %u  height: %u  number of components: %d", *width, *height, (int)num_components);
+	return TRUE;
+}
 
-				found_info = 1;
 
-				break;
-			}
+BOOL imx_vpu_api_get_annexb_size_of_length_prefixed_data(uint8_t const *data, size_t data_size, unsigned int nal_length_size, size_t *annexb_data_size)
+{
+	size_t offset = 0, annexb_size = 0;
 
-			default:
-			{
-				uint16_t length;
-				READ_UINT16(length);
-				length -= 2;
-				IMX_VPU_API_LOG("marker: %#lx length: %u", (unsigned long)marker, length);
-				jpeg_data_cur += length;
-			}
+	assert(data != NULL);
+	assert(annexb_data_size != NULL);
+
+	/* Only the length fields are read here, so this is
+	 * much cheaper than a pass over the entire data. */
+	while (offset < data_size)
+	{
+		size_t nal_size;
+
+		if ((offset + nal_length_size) > data_size)
+		{
+			IMX_VPU_API_ERROR("length-prefixed data is truncated; NAL length field at offset %zu exceeds data size %zu", offset, data_size);
+			return FALSE;
+		}
+
+		nal_size = read_nal_length(data + offset, nal_length_size);
+		offset += nal_length_size;
+
+		if (nal_size > (data_size - offset))
+		{
+			IMX_VPU_API_ERROR("length-prefixed data is truncated; NAL at offset %zu has size %zu, but only %zu byte(s) are left", offset, nal_size, data_size - offset);
+			return FALSE;
 		}
+
+		offset += nal_size;
+		annexb_size += ANNEXB_START_CODE_SIZE + nal_size;
 	}
 
-	return found_info;
+	*annexb_data_size = annexb_size;
+
+	return TRUE;
+}
+
+
+size_t imx_vpu_api_get_next_length_prefixed_nal(uint8_t const *data, size_t data_size, unsigned int nal_length_size, uint8_t const **nal, size_t *nal_size)
+{
+	assert(data != NULL);
+	assert(data_size >= nal_length_size);
+	assert(nal != NULL);
+	assert(nal_size != NULL);
+
+	*nal_size = read_nal_length(data, nal_length_size);
+	*nal = data + nal_length_size;
+
+	assert(*nal_size <= (data_size - nal_length_size));
+
+	return nal_length_size + (*nal_size);
 }
 
 
+
+/* Minimal MSB-first bit reader for parsing the first few fields of picture
+ * and slice headers. If skip_emulation_prevention_bytes is set, h.264/h.265
+ * emulation prevention bytes (the 0x03 in 0x00 0x00 0x03) are skipped.
+ * Reading past the end of the data yields zero bits and sets overrun. */
 typedef struct
 {
-	ImxVpuApiH264Level level;
-	int max_macroblocks_per_second;
-	int max_num_macroblocks_per_frame;
-	/* bitrates are given in kbps */
-	int max_bitrate_for_baseline_extended_main;
-	int max_bitrate_for_high;
-	int max_bitrate_for_high10;
+	uint8_t const *data;
+	size_t data_size;
+	size_t byte_offset;
+	unsigned int bit_offset;
+	unsigned int num_zero_bytes;
+	BOOL skip_emulation_prevention_bytes;
+	BOOL overrun;
 }
-H264LevelTableItem;
+BitReader;
 
-/* The items in this table are found in the spec ISO/IEC 14496-10 Table A-1 */
-static H264LevelTableItem const h264_level_table[] = {
-	{ IMX_VPU_API_H264_LEVEL_1,   1485,     99,     64,     80,     192    },
-	{ IMX_VPU_API_H264_LEVEL_1B,  1485,     99,     128,    160,    384    },
-	{ IMX_VPU_API_H264_LEVEL_1_1, 3000,     396,    192,    240,    576    },
-	{ IMX_VPU_API_H264_LEVEL_1_2, 6000,     396,    384,    480,    1152   },
-	{ IMX_VPU_API_H264_LEVEL_1_3, 11880,    396,    768,    960,    2304   },
-	{ IMX_VPU_API_H264_LEVEL_2,   11880,    396,    2000,   2500,   6000   },
-	{ IMX_VPU_API_H264_LEVEL_2_1, 19800,    792,    4000,   5000,   12000  },
-	{ IMX_VPU_API_H264_LEVEL_2_2, 20250,    1620,   4000,   5000,   12000  },
-	{ IMX_VPU_API_H264_LEVEL_3,   40500,    1620,   10000,  12500,  30000  },
-	{ IMX_VPU_API_H264_LEVEL_3_1, 108000,   3600,   14000,  17500,  42000  },
-	{ IMX_VPU_API_H264_LEVEL_3_2, 216000,   5120,   20000,  25000,  60000  },
-	{ IMX_VPU_API_H264_LEVEL_4,   245760,   8192,   20000,  25000,  60000  },
-	{ IMX_VPU_API_H264_LEVEL_4_1, 245760,   8192,   50000,  50000,  150000 },
-	{ IMX_VPU_API_H264_LEVEL_4_2, 522240,   8704,   50000,  50000,  150000 },
-	{ IMX_VPU_API_H264_LEVEL_5,   589824,   22080,  135000, 168750, 405000 },
-	{ IMX_VPU_API_H264_LEVEL_5_1, 983040,   36864,  240000, 300000, 720000 },
-	{ IMX_VPU_API_H264_LEVEL_6,   4177920,  139264, 240000, 240000, 240000 },
-	{ IMX_VPU_API_H264_LEVEL_6_1, 8355840,  139264, 480000, 480000, 480000 },
-	{ IMX_VPU_API_H264_LEVEL_6_2, 16711680, 139264, 800000, 800000, 800000 },
-};
-static int const h264_level_table_size = sizeof(h264_level_table) / sizeof(H264LevelTableItem);
 
+static void init_bit_reader(BitReader *reader, uint8_t const *data, size_t data_size, BOOL skip_emulation_prevention_bytes)
+{
+	memset(reader, 0, sizeof(BitReader));
+	reader->data = data;
+	reader->data_size = data_size;
+	reader->skip_emulation_prevention_bytes = skip_emulation_prevention_bytes;
+}
 
-ImxVpuApiH264Level imx_vpu_api_estimate_max_h264_level(int width, int height, int bitrate, int fps_num, int fps_denom, ImxVpuApiH264Profile profile)
+
+static uint32_t read_bits(BitReader *reader, unsigned int num_bits)
 {
-	int num_mb_per_frame, num_mb_per_second;
+	uint32_t value = 0;
 
-	/* One macroblock consists of 16 x 16 pixels */
-	num_mb_per_frame = (width * height) / (16 * 16);
-	num_mb_per_second = num_mb_per_frame * fps_num / fps_denom;
+	assert(num_bits <= 32);
 
-	for (int i = 0; i < h264_level_table_size; ++i)
+	while (num_bits > 0)
 	{
-		H264LevelTableItem const *item = &(h264_level_table[i]);
-		int max_bitrate = 0;
+		if (reader->byte_offset >= reader->data_size)
+		{
+			reader->overrun = TRUE;
+			return 0;
+		}
 
-		switch (profile)
+		value = (value << 1) | ((reader->data[reader->byte_offset] >> (7 - reader->bit_offset)) & 1);
+		num_bits--;
+
+		reader->bit_offset++;
+		if (reader->bit_offset == 8)
 		{
-			case IMX_VPU_API_H264_PROFILE_CONSTRAINED_BASELINE:
-			case IMX_VPU_API_H264_PROFILE_BASELINE:
-			case IMX_VPU_API_H264_PROFILE_MAIN:
-				max_bitrate = item->max_bitrate_for_baseline_extended_main;
-				break;
-			case IMX_VPU_API_H264_PROFILE_HIGH:
-				max_bitrate = item->max_bitrate_for_high;
-				break;
-			case IMX_VPU_API_H264_PROFILE_HIGH10:
-				max_bitrate = item->max_bitrate_for_high10;
-				break;
-			default:
-				/* we should never reach this */
-				assert(FALSE);
+			reader->num_zero_bytes = (reader->data[reader->byte_offset] == 0x00) ? (reader->num_zero_bytes + 1) : 0;
+			reader->byte_offset++;
+			reader->bit_offset = 0;
+
+			if (reader->skip_emulation_prevention_bytes
+			 && (reader->num_zero_bytes >= 2)
+			 && (reader->byte_offset < reader->data_size)
+			 && (reader->data[reader->byte_offset] == 0x03))
+			{
+				reader->byte_offset++;
+				reader->num_zero_bytes = 0;
+			}
 		}
+	}
 
-		if ((num_mb_per_frame <= item->max_num_macroblocks_per_frame) &&
-		    (num_mb_per_second <= item->max_macroblocks_per_second) &&
-		    (bitrate <= max_bitrate))
-			return item->level;
+	return value;
+}
+
+
+static uint32_t read_exp_golomb(BitReader *reader)
+{
+	unsigned int num_leading_zero_bits = 0;
+
+	while ((read_bits(reader, 1) == 0) && !(reader->overrun))
+	{
+		num_leading_zero_bits++;
+		if (num_leading_zero_bits > 31)
+		{
+			reader->overrun = TRUE;
+			return 0;
+		}
 	}
 
-	return IMX_VPU_API_H264_LEVEL_UNDEFINED;
+	return ((((uint32_t)1) << num_leading_zero_bits) - 1) + read_bits(reader, num_leading_zero_bits);
 }
 
 
-ImxVpuApiH265Level imx_vpu_api_estimate_max_h265_level(int width, int height, int bitrate, int fps_num, int fps_denom, ImxVpuApiH265Profile profile)
+/* Finds the next 0x00 0x00 0x01 start code, beginning at *offset. Returns
+ * a pointer to the first byte after the start code, or NULL if none was
+ * found. In the former case, *offset is set to the offset of that byte. */
+static uint8_t const * find_next_start_code(uint8_t const *data, size_t data_size, size_t *offset)
 {
-	// TODO
+	size_t i;
+
+	for (i = *offset; (i + 3) <= data_size; ++i)
+	{
+		if ((data[i + 0] == 0x00) && (data[i + 1] == 0x00) && (data[i + 2] == 0x01))
+		{
+			*offset = i + 3;
+			return data + i + 3;
+		}
+	}
+
+	return NULL;
+}
+
+
+/* Gets the next h.264/h.265 NAL unit, beginning at *offset, and advances
+ * *offset. With Annex-B data (nal_length_size 0), the end of the NAL unit
+ * is not searched for, since only the headers are of interest, so nal_size
+ * is set to the size of all of the remaining data. */
+static BOOL get_next_nal(uint8_t const *data, size_t data_size, unsigned int nal_length_size, size_t *offset, uint8_t const **nal, size_t *nal_size)
+{
+	if (nal_length_size == 0)
+	{
+		*nal = find_next_start_code(data, data_size, offset);
+		if (*nal == NULL)
+			return FALSE;
+
+		*nal_size = data_size - (*offset);
+	}
+	else
+	{
+		if ((data_size - (*offset)) < nal_length_size)
+			return FALSE;
+
+		*offset += imx_vpu_api_get_next_length_prefixed_nal(data + (*offset), data_size - (*offset), nal_length_size, nal, nal_size);
+	}
+
+	return TRUE;
+}
+
+
+static BOOL parse_h264_frame_properties(uint8_t const *data, size_t data_size, unsigned int nal_length_size, uint32_t *properties)
+{
+	size_t offset = 0;
+	uint8_t const *nal;
+	size_t nal_size;
+
+	while (get_next_nal(data, data_size, nal_length_size, &offset, &nal, &nal_size))
+	{
+		unsigned int nal_unit_type, nal_ref_idc, slice_type;
+		BitReader reader;
+
+		if (nal_size < 2)
+			continue;
+
+		nal_unit_type = nal[0] & 0x1F;
+		nal_ref_idc = (nal[0] >> 5) & 0x03;
+
+		switch (nal_unit_type)
+		{
+			case 5: /* coded slice of an IDR picture */
+				*properties = IMX_VPU_API_FRAME_PROPERTY_INTRA | IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT;
+				return TRUE;
+
+			case 1: /* coded slice of a non-IDR picture */
+				init_bit_reader(&reader, nal + 1, nal_size - 1, TRUE);
+				read_exp_golomb(&reader); /* first_mb_in_slice */
+				slice_type = read_exp_golomb(&reader) % 5;
+				if (reader.overrun)
+					return FALSE;
+
+				*properties = 0;
+				/* I and SI slices */
+				if ((slice_type == 2) || (slice_type == 4))
+					*properties |= IMX_VPU_API_FRAME_PROPERTY_INTRA;
+				if (nal_ref_idc == 0)
+					*properties |= IMX_VPU_API_FRAME_PROPERTY_NON_REFERENCE;
+				return TRUE;
+
+			default:
+				break;
+		}
+	}
+
+	return FALSE;
+}
+
+
+static BOOL parse_h265_frame_properties(uint8_t const *data, size_t data_size, unsigned int nal_length_size, uint32_t *properties)
+{
+	size_t offset = 0;
+	uint8_t const *nal;
+	size_t nal_size;
+
+	while (get_next_nal(data, data_size, nal_length_size, &offset, &nal, &nal_size))
+	{
+		unsigned int nal_unit_type;
+
+		if (nal_size < 3)
+			continue;
+
+		nal_unit_type = (nal[0] >> 1) & 0x3F;
+
+		/* Only VCL NAL units are of interest. */
+		if (nal_unit_type > 31)
+			continue;
+
+		/* Whether or not a non-IRAP picture only contains I slices cannot
+		 * be determined without parsing the PPS, since the slice type comes
+		 * after a PPS dependent number of extra slice header bits. So, only
+		 * IRAP pictures (BLA, IDR, CRA) are considered intra pictures here. */
+		if ((nal_unit_type >= 16) && (nal_unit_type <= 23))
+			*properties = IMX_VPU_API_FRAME_PROPERTY_INTRA | IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT;
+		else if ((nal_unit_type <= 14) && ((nal_unit_type % 2) == 0))
+			/* TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N and the reserved
+			 * RSV_VCL_N types are sub-layer non-reference pictures. */
+			*properties = IMX_VPU_API_FRAME_PROPERTY_NON_REFERENCE;
+		else
+			*properties = 0;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+static BOOL get_h265_temporal_id(uint8_t const *data, size_t data_size, unsigned int nal_length_size, unsigned int *temporal_id)
+{
+	size_t offset = 0;
+	uint8_t const *nal;
+	size_t nal_size;
+
+	/* All VCL NAL units of an access unit have the same TemporalId,
+	 * so the first one is sufficient. */
+	while (get_next_nal(data, data_size, nal_length_size, &offset, &nal, &nal_size))
+	{
+		unsigned int nuh_temporal_id_plus1;
+
+		if (nal_size < 3)
+			continue;
+
+		if (((nal[0] >> 1) & 0x3F) > 31)
+			continue;
+
+		nuh_temporal_id_plus1 = nal[1] & 0x07;
+		if (nuh_temporal_id_plus1 == 0)
+			return FALSE;
+
+		*temporal_id = nuh_temporal_id_plus1 - 1;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+static BOOL parse_vp9_frame_properties(uint8_t const *data, size_t data_size, uint32_t *properties)
+{
+	BitReader reader;
+	unsigned int profile;
+
+	/* Parse the beginning of the uncompressed header. */
+
+	init_bit_reader(&reader, data, data_size, FALSE);
+
+	/* frame_marker */
+	if (read_bits(&reader, 2) != 2)
+		return FALSE;
+
+	profile = read_bits(&reader, 1);
+	profile |= read_bits(&reader, 1) << 1;
+	if (profile == 3)
+		read_bits(&reader, 1); /* reserved_zero */
+
+	/* show_existing_frame; such frames contain no data to decode. */
+	if (read_bits(&reader, 1) == 1)
+		return FALSE;
+
+	/* frame_type; 0 = KEY_FRAME */
+	if (read_bits(&reader, 1) == 0)
+	{
+		*properties = IMX_VPU_API_FRAME_PROPERTY_INTRA | IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT;
+	}
+	else
+	{
+		unsigned int show_frame = read_bits(&reader, 1);
+		read_bits(&reader, 1); /* error_resilient_mode */
+		*properties = ((show_frame == 0) && (read_bits(&reader, 1) == 1)) ? IMX_VPU_API_FRAME_PROPERTY_INTRA : 0;
+	}
+
+	return !(reader.overrun);
+}
+
+
+BOOL imx_vpu_api_parse_frame_properties(ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, uint32_t *properties)
+{
+	size_t offset = 0;
+	uint8_t const *header;
+
+	assert(data != NULL);
+	assert(properties != NULL);
+
+	switch (compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_JPEG:
+		case IMX_VPU_API_COMPRESSION_FORMAT_WEBP:
+			*properties = IMX_VPU_API_FRAME_PROPERTY_INTRA | IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT;
+			return TRUE;
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+			return parse_h264_frame_properties(data, data_size, nal_length_size, properties);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_H265:
+			return parse_h265_frame_properties(data, data_size, nal_length_size, properties);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG2:
+		{
+			/* Look for the picture header (start code value 0x00). */
+			while ((header = find_next_start_code(data, data_size, &offset)) != NULL)
+			{
+				unsigned int picture_coding_type;
+
+				if ((data_size - offset) < 3)
+					return FALSE;
+				if (header[0] != 0x00)
+					continue;
+
+				/* The 10 bits of temporal_reference come first. */
+				picture_coding_type = (header[2] >> 3) & 0x07;
+				switch (picture_coding_type)
+				{
+					case 1: *properties = IMX_VPU_API_FRAME_PROPERTY_INTRA | IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT; return TRUE;
+					case 2: *properties = 0; return TRUE;
+					case 3: *properties = IMX_VPU_API_FRAME_PROPERTY_NON_REFERENCE; return TRUE;
+					default: return FALSE;
+				}
+			}
+
+			return FALSE;
+		}
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG4:
+		{
+			/* Look for the VOP header (start code value 0xB6). */
+			while ((header = find_next_start_code(data, data_size, &offset)) != NULL)
+			{
+				if ((data_size - offset) < 2)
+					return FALSE;
+				if (header[0] != 0xB6)
+					continue;
+
+				switch (header[1] >> 6)
+				{
+					case 0: *properties = IMX_VPU_API_FRAME_PROPERTY_INTRA | IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT; return TRUE;
+					case 2: *properties = IMX_VPU_API_FRAME_PROPERTY_NON_REFERENCE; return TRUE;
+					default: *properties = 0; return TRUE;
+				}
+			}
+
+			return FALSE;
+		}
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP8:
+			if (data_size < 3)
+				return FALSE;
+			/* Bit #0 of the frame tag is 0 for key frames. */
+			*properties = ((data[0] & 0x01) == 0) ? (IMX_VPU_API_FRAME_PROPERTY_INTRA | IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT) : 0;
+			return TRUE;
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP9:
+			return parse_vp9_frame_properties(data, data_size, properties);
+
+		default:
+			return FALSE;
+	}
+}
+
+
+void imx_vpu_api_update_h265_highest_temporal_id(uint8_t const *data, size_t data_size, unsigned int nal_length_size, int *highest_temporal_id)
+{
+	size_t offset = 0;
+	uint8_t const *nal;
+	size_t nal_size;
+
+	assert(data != NULL);
+	assert(highest_temporal_id != NULL);
+
+	while (get_next_nal(data, data_size, nal_length_size, &offset, &nal, &nal_size))
+	{
+		unsigned int nal_unit_type;
+		int sps_max_sub_layers_minus1;
+
+		if (nal_size < 3)
+			continue;
+
+		nal_unit_type = (nal[0] >> 1) & 0x3F;
+
+		/* Parameter sets precede the VCL NAL units. */
+		if (nal_unit_type <= 31)
+			break;
+
+		/* The SPS begins with sps_video_parameter_set_id (4 bits),
+		 * followed by sps_max_sub_layers_minus1 (3 bits). */
+		if (nal_unit_type != 33)
+			continue;
+
+		sps_max_sub_layers_minus1 = (nal[2] >> 1) & 0x07;
+		if (sps_max_sub_layers_minus1 > (*highest_temporal_id))
+			*highest_temporal_id = sps_max_sub_layers_minus1;
+	}
+}
+
+
+BOOL imx_vpu_api_dec_is_frame_excluded_by_skip_mode(ImxVpuApiDecSkipMode skip_mode, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, int h265_highest_temporal_id)
+{
+	uint32_t properties;
+
+	if (skip_mode == IMX_VPU_API_DEC_SKIP_MODE_NONE)
+		return FALSE;
+
+	/* Frames whose properties are unknown are always decoded. */
+	if (!imx_vpu_api_parse_frame_properties(compression_format, data, data_size, nal_length_size, &properties))
+		return FALSE;
+
+	switch (skip_mode)
+	{
+		case IMX_VPU_API_DEC_SKIP_MODE_NON_REFERENCE_FRAMES:
+			if (!(properties & IMX_VPU_API_FRAME_PROPERTY_NON_REFERENCE))
+				return FALSE;
+
+			/* h.265 sub-layer non-reference pictures are only not referred
+			 * to by pictures of the same sub-layer. Pictures of higher
+			 * sub-layers may still refer to them, so only those in the
+			 * highest sub-layer can be dropped. If that sub-layer is not
+			 * known, no pictures are dropped. */
+			if (compression_format == IMX_VPU_API_COMPRESSION_FORMAT_H265)
+			{
+				unsigned int temporal_id;
+
+				if ((h265_highest_temporal_id < 0) || !get_h265_temporal_id(data, data_size, nal_length_size, &temporal_id))
+					return FALSE;
+
+				return temporal_id >= (unsigned int)h265_highest_temporal_id;
+			}
+
+			return TRUE;
+
+		case IMX_VPU_API_DEC_SKIP_MODE_NON_INTRA_FRAMES:
+			return (properties & IMX_VPU_API_FRAME_PROPERTY_INTRA) == 0;
+
+		default:
+			return FALSE;
+	}
+}
+
+
+static ImxVpuApiStreamHeaderCacheEntry * find_stream_header_cache_entry(ImxVpuApiStreamHeaderCache *cache, unsigned int type_order, unsigned int id)
+{
+	size_t i;
+
+	for (i = 0; i < cache->num_entries; ++i)
+	{
+		ImxVpuApiStreamHeaderCacheEntry *entry = &(cache->entries[i]);
+		if ((entry->type_order == type_order) && (entry->id == id))
+			return entry;
+	}
+
+	return NULL;
+}
+
+
+static void remove_stream_header_cache_entry(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiStreamHeaderCacheEntry *entry)
+{
+	size_t index = entry - cache->entries;
+
+	free(entry->data);
+	cache->num_entries--;
+	memmove(entry, entry + 1, sizeof(ImxVpuApiStreamHeaderCacheEntry) * (cache->num_entries - index));
+}
+
+
+/* Replaces the contents of the entry with the given type order and ID,
+ * adding the entry if necessary. Entries are kept sorted by type order
+ * and ID, which is the order in which they are reinserted. The header
+ * is stored with a 4-byte start code in front of it if start_code is set.
+ * Returns FALSE if memory could not be allocated. The cache does not
+ * contain the entry then, so an outdated header is never reinserted. */
+static BOOL set_stream_header_cache_entry(ImxVpuApiStreamHeaderCache *cache, unsigned int type_order, unsigned int id, BOOL start_code, uint8_t const *data, size_t data_size)
+{
+	ImxVpuApiStreamHeaderCacheEntry *entry = find_stream_header_cache_entry(cache, type_order, id);
+	size_t total_size = data_size + (start_code ? ANNEXB_START_CODE_SIZE : 0);
+
+	if (entry == NULL)
+	{
+		size_t index;
+
+		if (cache->num_entries == cache->entries_capacity)
+		{
+			size_t new_capacity = (cache->entries_capacity > 0) ? (cache->entries_capacity * 2) : 4;
+			ImxVpuApiStreamHeaderCacheEntry *new_entries = realloc(cache->entries, sizeof(ImxVpuApiStreamHeaderCacheEntry) * new_capacity);
+			if (new_entries == NULL)
+			{
+				IMX_VPU_API_ERROR("could not allocate memory for stream header cache entry");
+				return FALSE;
+			}
+
+			cache->entries = new_entries;
+			cache->entries_capacity = new_capacity;
+		}
+
+		for (index = 0; index < cache->num_entries; ++index)
+		{
+			ImxVpuApiStreamHeaderCacheEntry *existing_entry = &(cache->entries[index]);
+			if ((existing_entry->type_order > type_order) || ((existing_entry->type_order == type_order) && (existing_entry->id > id)))
+				break;
+		}
+
+		entry = &(cache->entries[index]);
+		memmove(entry + 1, entry, sizeof(ImxVpuApiStreamHeaderCacheEntry) * (cache->num_entries - index));
+		memset(entry, 0, sizeof(ImxVpuApiStreamHeaderCacheEntry));
+		entry->type_order = type_order;
+		entry->id = id;
+		cache->num_entries++;
+	}
+
+	if (total_size > entry->capacity)
+	{
+		uint8_t *new_data = realloc(entry->data, total_size);
+		if (new_data == NULL)
+		{
+			IMX_VPU_API_ERROR("could not allocate %zu byte(s) for stream header cache entry", total_size);
+			remove_stream_header_cache_entry(cache, entry);
+			return FALSE;
+		}
+
+		entry->data = new_data;
+		entry->capacity = total_size;
+	}
+
+	if (start_code)
+		memcpy(entry->data, annexb_start_code, ANNEXB_START_CODE_SIZE);
+	memcpy(entry->data + (start_code ? ANNEXB_START_CODE_SIZE : 0), data, data_size);
+	entry->size = total_size;
+	entry->updated = TRUE;
+
+	return TRUE;
+}
+
+
+static void skip_bits(BitReader *reader, unsigned int num_bits)
+{
+	while (num_bits > 0)
+	{
+		unsigned int num_bits_to_read = (num_bits > 32) ? 32 : num_bits;
+		read_bits(reader, num_bits_to_read);
+		num_bits -= num_bits_to_read;
+	}
+}
+
+
+/* Gets the order in which the parameter set has to appear in the stream,
+ * and its ID. Returns FALSE if the NAL unit is not a parameter set, or
+ * if its ID cannot be parsed. */
+static BOOL get_h26x_parameter_set_id(ImxVpuApiCompressionFormat compression_format, uint8_t const *nal, size_t nal_size, unsigned int *type_order, unsigned int *id)
+{
+	BitReader reader;
+	unsigned int max_id;
+
+	if (compression_format == IMX_VPU_API_COMPRESSION_FORMAT_H264)
+	{
+		init_bit_reader(&reader, nal + 1, nal_size - 1, TRUE);
+
+		switch (nal[0] & 0x1F)
+		{
+			case 7: /* SPS */
+				*type_order = 0;
+				max_id = 31;
+				/* profile_idc, constraint flags, level_idc */
+				skip_bits(&reader, 24);
+				break;
+
+			case 8: /* PPS */
+				*type_order = 1;
+				max_id = 255;
+				break;
+
+			default:
+				return FALSE;
+		}
+
+		*id = read_exp_golomb(&reader);
+	}
+	else
+	{
+		if (nal_size < 3)
+			return FALSE;
+
+		init_bit_reader(&reader, nal + 2, nal_size - 2, TRUE);
+
+		switch ((nal[0] >> 1) & 0x3F)
+		{
+			case 32: /* VPS */
+				*type_order = 0;
+				max_id = 15;
+				*id = read_bits(&reader, 4);
+				break;
+
+			case 33: /* SPS */
+			{
+				unsigned int i, max_sub_layers_minus1;
+				BOOL sub_layer_profile_present[7], sub_layer_level_present[7];
+
+				*type_order = 1;
+				max_id = 15;
+
+				read_bits(&reader, 4); /* sps_video_parameter_set_id */
+				max_sub_layers_minus1 = read_bits(&reader, 3);
+				read_bits(&reader, 1); /* sps_temporal_id_nesting_flag */
+
+				/* profile_tier_level(): the general profile, tier and
+				 * level take up 96 bits, followed by the sub-layer flags
+				 * (padded to 8 entries) and the sub-layer information. */
+				skip_bits(&reader, 96);
+				for (i = 0; i < max_sub_layers_minus1; ++i)
+				{
+					sub_layer_profile_present[i] = read_bits(&reader, 1);
+					sub_layer_level_present[i] = read_bits(&reader, 1);
+				}
+				if (max_sub_layers_minus1 > 0)
+					skip_bits(&reader, (8 - max_sub_layers_minus1) * 2);
+				for (i = 0; i < max_sub_layers_minus1; ++i)
+				{
+					if (sub_layer_profile_present[i])
+						skip_bits(&reader, 88);
+					if (sub_layer_level_present[i])
+						skip_bits(&reader, 8);
+				}
+
+				*id = read_exp_golomb(&reader);
+				break;
+			}
+
+			case 34: /* PPS */
+				*type_order = 2;
+				max_id = 63;
+				*id = read_exp_golomb(&reader);
+				break;
+
+			default:
+				return FALSE;
+		}
+	}
+
+	/* Out-of-range IDs indicate corrupted data. Not caching
+	 * these keeps such data from filling up the cache. */
+	return !(reader.overrun) && (*id <= max_id);
+}
+
+
+static BOOL update_h26x_stream_header_cache(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, BOOL *headers_found)
+{
+	size_t offset = 0;
+	uint8_t const *nal;
+	size_t nal_size;
+	BOOL ret = TRUE;
+
+	while (get_next_nal(data, data_size, nal_length_size, &offset, &nal, &nal_size))
+	{
+		unsigned int nal_unit_type, type_order, id;
+
+		if (nal_size < 2)
+			continue;
+
+		if (compression_format == IMX_VPU_API_COMPRESSION_FORMAT_H264)
+		{
+			nal_unit_type = nal[0] & 0x1F;
+			/* Parameter sets always precede the slices of an access
+			 * unit, so there is no need to look any further. */
+			if ((nal_unit_type >= 1) && (nal_unit_type <= 5))
+				break;
+		}
+		else
+		{
+			nal_unit_type = (nal[0] >> 1) & 0x3F;
+			if (nal_unit_type <= 31)
+				break;
+		}
+
+		/* get_next_nal() does not search for the end of Annex-B
+		 * NAL units, so find it here by looking for the next
+		 * start code. Any trailing zero byte that belongs to a
+		 * 4-byte start code is kept; it is valid padding. */
+		if (nal_length_size == 0)
+		{
+			size_t end_offset = offset;
+			if (find_next_start_code(data, data_size, &end_offset) != NULL)
+				nal_size = end_offset - offset - 3;
+		}
+
+		/* Parameter sets are cached per ID, since a stream can use
+		 * several of them, for example one PPS per slice type. */
+		if (!get_h26x_parameter_set_id(compression_format, nal, nal_size, &type_order, &id))
+			continue;
+
+		if (!set_stream_header_cache_entry(cache, type_order, id, TRUE, nal, nal_size))
+			ret = FALSE;
+
+		*headers_found = TRUE;
+	}
+
+	return ret;
+}
+
+
+static BOOL is_first_stream_header_start_code(ImxVpuApiCompressionFormat compression_format, uint8_t start_code)
+{
+	switch (compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG2:
+			/* Sequence header */
+			return (start_code == 0xB3);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG4:
+			/* Visual object sequence, video object, video object layer */
+			return (start_code == 0xB0) || (start_code <= 0x2F);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_WVC1:
+			/* Sequence header */
+			return (start_code == 0x0F);
+
+		default:
+			return FALSE;
+	}
+}
+
+
+static BOOL is_stream_header_start_code(ImxVpuApiCompressionFormat compression_format, uint8_t start_code)
+{
+	switch (compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG2:
+			/* Sequence header, extension, user data */
+			return (start_code == 0xB3) || (start_code == 0xB5) || (start_code == 0xB2);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG4:
+			/* Visual object sequence, visual object, user data,
+			 * video object, video object layer */
+			return (start_code == 0xB0) || (start_code == 0xB5) || (start_code == 0xB2) || (start_code <= 0x2F);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_WVC1:
+			/* Sequence header, entry-point header, and their user data */
+			return (start_code == 0x0F) || (start_code == 0x0E) || (start_code == 0x1F) || (start_code == 0x1E);
+
+		default:
+			return FALSE;
+	}
+}
+
+
+static BOOL update_start_code_stream_header_cache(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, BOOL *headers_found)
+{
+	size_t headers_start, headers_end, offset;
+
+	/* Sequence headers are always at the very beginning of a frame. Checking
+	 * for that first avoids scanning through frames that have no start
+	 * codes at all, like VC-1 frames without a frame start code. */
+	for (headers_start = 0; (headers_start < data_size) && (data[headers_start] == 0x00); ++headers_start);
+	if ((headers_start < 2) || ((headers_start + 1) >= data_size) || (data[headers_start] != 0x01))
+		return TRUE;
+	if (!is_first_stream_header_start_code(compression_format, data[headers_start + 1]))
+		return TRUE;
+
+	/* Continue after the start code value, and let headers_start
+	 * point to the start code instead of its 0x01 byte. */
+	offset = headers_start + 2;
+	headers_start -= 2;
+	headers_end = data_size;
+
+	/* The headers end at the first start code that is
+	 * not part of them, like a picture start code. */
+	while (find_next_start_code(data, data_size, &offset) != NULL)
+	{
+		if (offset >= data_size)
+			break;
+
+		if (!is_stream_header_start_code(compression_format, data[offset]))
+		{
+			headers_end = offset - 3;
+			break;
+		}
+	}
+
+	*headers_found = TRUE;
+
+	/* These formats have no parameter set IDs; the
+	 * headers are always stored as one entry. */
+	return set_stream_header_cache_entry(cache, 0, 0, FALSE, data + headers_start, headers_end - headers_start);
+}
+
+
+void imx_vpu_api_stream_header_cache_cleanup(ImxVpuApiStreamHeaderCache *cache)
+{
+	size_t i;
+
+	assert(cache != NULL);
+
+	for (i = 0; i < cache->num_entries; ++i)
+		free(cache->entries[i].data);
+	free(cache->entries);
+
+	memset(cache, 0, sizeof(ImxVpuApiStreamHeaderCache));
+}
+
+
+void imx_vpu_api_stream_header_cache_schedule_reinsertion(ImxVpuApiStreamHeaderCache *cache)
+{
+	assert(cache != NULL);
+
+	/* The reinsertion also covers headers from skipped frames. */
+	cache->reinsertion_pending = (cache->num_entries > 0);
+	cache->skipped_headers_pending = FALSE;
+}
+
+
+static BOOL update_stream_header_cache(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, BOOL *headers_found)
+{
+	size_t i;
+
+	*headers_found = FALSE;
+
+	for (i = 0; i < cache->num_entries; ++i)
+		cache->entries[i].updated = FALSE;
+
+	switch (compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+		case IMX_VPU_API_COMPRESSION_FORMAT_H265:
+			return update_h26x_stream_header_cache(cache, compression_format, data, data_size, nal_length_size, headers_found);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG2:
+		case IMX_VPU_API_COMPRESSION_FORMAT_MPEG4:
+		case IMX_VPU_API_COMPRESSION_FORMAT_WVC1:
+			return update_start_code_stream_header_cache(cache, compression_format, data, data_size, headers_found);
+
+		/* No headers are cached for other formats. In particular, VP8
+		 * and VP9 have no headers that are sent separately from the
+		 * frames. Decoding after a flush starts at a keyframe, which
+		 * resets all of the state that earlier frames set up. */
+		default:
+			return TRUE;
+	}
+}
+
+
+BOOL imx_vpu_api_stream_header_cache_process_frame(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, BOOL *reinsert_headers)
+{
+	BOOL ret;
+	BOOL headers_found;
+	uint32_t properties;
+
+	assert(cache != NULL);
+	assert(reinsert_headers != NULL);
+
+	*reinsert_headers = FALSE;
+
+	ret = update_stream_header_cache(cache, compression_format, data, data_size, nal_length_size, &headers_found);
+
+	if (!(cache->reinsertion_pending) && !(cache->skipped_headers_pending))
+		return ret;
+
+	/* A frame that carries its own headers does not need the cached ones.
+	 * (If it only carries some of them, like an h.264 PPS without an SPS,
+	 * the decoder still has to get the others.) */
+	if (headers_found)
+	{
+		size_t i;
+		BOOL all_entries_updated = TRUE;
+
+		for (i = 0; i < cache->num_entries; ++i)
+		{
+			if (!(cache->entries[i].updated))
+				all_entries_updated = FALSE;
+		}
+
+		if (all_entries_updated)
+		{
+			cache->reinsertion_pending = FALSE;
+			cache->skipped_headers_pending = FALSE;
+			return ret;
+		}
+	}
+
+	/* Frames in front of which decoding cannot start would not be
+	 * decoded properly anyway, so only insert the headers in front of
+	 * a random access point. Frames whose properties are unknown
+	 * are treated as random access points. The exception are headers
+	 * from skipped frames, since the decoder never saw these, and
+	 * the frame may depend on them. */
+	if (!(cache->skipped_headers_pending) && imx_vpu_api_parse_frame_properties(compression_format, data, data_size, nal_length_size, &properties) && !(properties & IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT))
+		return ret;
+
+	cache->reinsertion_pending = FALSE;
+	cache->skipped_headers_pending = FALSE;
+	*reinsert_headers = (cache->num_entries > 0);
+
+	return ret;
+}
+
+
+BOOL imx_vpu_api_stream_header_cache_process_skipped_frame(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size)
+{
+	BOOL ret;
+	BOOL headers_found;
+
+	assert(cache != NULL);
+
+	ret = update_stream_header_cache(cache, compression_format, data, data_size, nal_length_size, &headers_found);
+	if (headers_found)
+		cache->skipped_headers_pending = TRUE;
+
+	return ret;
+}
+
+
+int imx_vpu_api_parse_jpeg_header(void *jpeg_data, size_t jpeg_data_size, BOOL semi_planar_output, unsigned int *width, unsigned int *height, ImxVpuApiColorFormat *color_format)
+{
+	uint8_t *jpeg_data_start = jpeg_data;
+	uint8_t *jpeg_data_end = jpeg_data_start + jpeg_data_size;
+	uint8_t *jpeg_data_cur = jpeg_data_start;
+	int found_info = 0;
+
+#define READ_UINT8(value) do \
+	{ \
+		(value) = *jpeg_data_cur; \
+		++jpeg_data_cur; \
+	} \
+	while (0)
+#define READ_UINT16(value) do \
+	{ \
+		uint16_t w = *((uint16_t *)jpeg_data_cur); \
+		jpeg_data_cur += 2; \
+		(value) = ( ((w & 0xff) << 8) | ((w & 0xff00) >> 8) ); \
+	} \
+	while (0)
+
+	while (jpeg_data_cur < jpeg_data_end)
+	{
+		uint8_t marker;
+
+		/* Marker is preceded by byte 0xFF */
+		if (*(jpeg_data_cur++) != 0xff)
+			break;
+
+		READ_UINT8(marker);
+		if (marker == JPEG_MARKER_SOS)
+			break;
+
+		switch (marker)
+		{
+			case JPEG_MARKER_SOI:
+				break;
+			case JPEG_MARKER_DRI:
+				jpeg_data_cur += 4;
+				break;
+
+			case JPEG_MARKER_SOF2:
+			{
+				IMX_VPU_API_ERROR("progressive JPEGs are not supported");
+				return 0;
+			}
+
+			case JPEG_MARKER_SOF0:
+			{
+				uint16_t length;
+				uint8_t num_components;
+				uint8_t block_width[3], block_height[3];
+
+				READ_UINT16(length);
+				length -= 2;
+				IMX_VPU_API_LOG("marker: %#lx length: %u", (unsigned long)marker, length);
+
+				jpeg_data_cur++;
+				READ_UINT16(*height);
+				READ_UINT16(*width);
+
+				if ((*width) > 8192)
+				{
+					IMX_VPU_API_ERROR("width of %u pixels exceeds the maximum of 8192", *width);
+					return 0;
+				}
+
+				if ((*height) > 8192)
+				{
+					IMX_VPU_API_ERROR("height of %u pixels exceeds the maximum of 8192", *height);
+					return 0;
+				}
+
+				READ_UINT8(num_components);
+
+				if (num_components <= 3)
+				{
+					for (int i = 0; i < num_components; ++i)
+					{
+						uint8_t b;
+						++jpeg_data_cur;
+						READ_UINT8(b);
+						block_width[i] = (b & 0xf0) >> 4;
+						block_height[i] = (b & 0x0f);
+						++jpeg_data_cur;
+					}
+				}
+
+				if (num_components > 3)
+				{
+					IMX_VPU_API_ERROR("JPEGs with %d components are not supported", (int)num_components);
+					return 0;
+				}
+				if (num_components == 3)
+				{
+					int temp = (block_width[0] * block_height[0]) / (block_width[1] * block_height[1]);
+
+					if ((temp == 4) && (block_height[0] == 2))
+						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT;
+					else if ((temp == 2) && (block_height[0] == 1))
+						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_HORIZONTAL_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_HORIZONTAL_8BIT;
+					else if ((temp == 2) && (block_height[0] == 2))
+						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV422_VERTICAL_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV422_VERTICAL_8BIT;
+					else if ((temp == 1) && (block_height[0] == 1))
+						*color_format = semi_planar_output ? IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV444_8BIT : IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV444_8BIT;
+					else
+						*color_format = IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT;
+				}
+				else
+					*color_format = IMX_VPU_API_COLOR_FORMAT_YUV400_8BIT;
+
+				IMX_VPU_API_LOG("width: %u  height: %u  number of components: %d", *width, *height, (int)num_components);
+
+				found_info = 1;
+
+				break;
+			}
+
+			default:
+			{
+				uint16_t length;
+				READ_UINT16(length);
+				length -= 2;
+				IMX_VPU_API_LOG("marker: %#lx length: %u", (unsigned long)marker, length);
+				jpeg_data_cur += length;
+			}
+		}
+	}
+
+	return found_info;
+}
+
+
+uint64_t imx_vpu_api_get_monotonic_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)(ts.tv_sec) * 1000000000ull + (uint64_t)(ts.tv_nsec);
+}
+
+
+typedef struct
+{
+	ImxVpuApiH264Level level;
+	int max_macroblocks_per_second;
+	int max_num_macroblocks_per_frame;
+	/* bitrates are given in kbps */
+	int max_bitrate_for_baseline_extended_main;
+	int max_bitrate_for_high;
+	int max_bitrate_for_high10;
+}
+H264LevelTableItem;
+
+/* The items in this table are found in the spec ISO/IEC 14496-10 Table A-1 */
+static H264LevelTableItem const h264_level_table[] = {
+	{ IMX_VPU_API_H264_LEVEL_1,   1485,     99,     64,     80,     192    },
+	{ IMX_VPU_API_H264_LEVEL_1B,  1485,     99,     128,    160,    384    },
+	{ IMX_VPU_API_H264_LEVEL_1_1, 3000,     396,    192,    240,    576    },
+	{ IMX_VPU_API_H264_LEVEL_1_2, 6000,     396,    384,    480,    1152   },
+	{ IMX_VPU_API_H264_LEVEL_1_3, 11880,    396,    768,    960,    2304   },
+	{ IMX_VPU_API_H264_LEVEL_2,   11880,    396,    2000,   2500,   6000   },
+	{ IMX_VPU_API_H264_LEVEL_2_1, 19800,    792,    4000,   5000,   12000  },
+	{ IMX_VPU_API_H264_LEVEL_2_2, 20250,    1620,   4000,   5000,   12000  },
+	{ IMX_VPU_API_H264_LEVEL_3,   40500,    1620,   10000,  12500,  30000  },
+	{ IMX_VPU_API_H264_LEVEL_3_1, 108000,   3600,   14000,  17500,  42000  },
+	{ IMX_VPU_API_H264_LEVEL_3_2, 216000,   5120,   20000,  25000,  60000  },
+	{ IMX_VPU_API_H264_LEVEL_4,   245760,   8192,   20000,  25000,  60000  },
+	{ IMX_VPU_API_H264_LEVEL_4_1, 245760,   8192,   50000,  50000,  150000 },
+	{ IMX_VPU_API_H264_LEVEL_4_2, 522240,   8704,   50000,  50000,  150000 },
+	{ IMX_VPU_API_H264_LEVEL_5,   589824,   22080,  135000, 168750, 405000 },
+	{ IMX_VPU_API_H264_LEVEL_5_1, 983040,   36864,  240000, 300000, 720000 },
+	{ IMX_VPU_API_H264_LEVEL_6,   4177920,  139264, 240000, 240000, 240000 },
+	{ IMX_VPU_API_H264_LEVEL_6_1, 8355840,  139264, 480000, 480000, 480000 },
+	{ IMX_VPU_API_H264_LEVEL_6_2, 16711680, 139264, 800000, 800000, 800000 },
+};
+static int const h264_level_table_size = sizeof(h264_level_table) / sizeof(H264LevelTableItem);
+
+
+ImxVpuApiH264Level imx_vpu_api_estimate_max_h264_level(int width, int height, int bitrate, int fps_num, int fps_denom, ImxVpuApiH264Profile profile)
+{
+	int num_mb_per_frame, num_mb_per_second;
+
+	/* One macroblock consists of 16 x 16 pixels */
+	num_mb_per_frame = (width * height) / (16 * 16);
+	num_mb_per_second = num_mb_per_frame * fps_num / fps_denom;
+
+	for (int i = 0; i < h264_level_table_size; ++i)
+	{
+		H264LevelTableItem const *item = &(h264_level_table[i]);
+		int max_bitrate = 0;
+
+		switch (profile)
+		{
+			case IMX_VPU_API_H264_PROFILE_CONSTRAINED_BASELINE:
+			case IMX_VPU_API_H264_PROFILE_BASELINE:
+			case IMX_VPU_API_H264_PROFILE_MAIN:
+				max_bitrate = item->max_bitrate_for_baseline_extended_main;
+				break;
+			case IMX_VPU_API_H264_PROFILE_HIGH:
+				max_bitrate = item->max_bitrate_for_high;
+				break;
+			case IMX_VPU_API_H264_PROFILE_HIGH10:
+				max_bitrate = item->max_bitrate_for_high10;
+				break;
+			default:
+				/* we should never reach this */
+				assert(FALSE);
+		}
+
+		if ((num_mb_per_frame <= item->max_num_macroblocks_per_frame) &&
+		    (num_mb_per_second <= item->max_macroblocks_per_second) &&
+		    (bitrate <= max_bitrate))
+			return item->level;
+	}
+
+	return IMX_VPU_API_H264_LEVEL_UNDEFINED;
+}
+
+
+ImxVpuApiH265Level imx_vpu_api_estimate_max_h265_level(int width, int height, int bitrate, int fps_num, int fps_denom, ImxVpuApiH265Profile profile)
+{
+	// TODO
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_dma_buffer_by_copy(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame, ImxDmaBuffer *encoded_dma_buffer, size_t offset, ImxVpuApiDecEncodedDmaBufferReleaseCallback release_callback, void *release_callback_user_data)
+{
+	int err;
+	uint8_t *virtual_address;
+	ImxVpuApiEncodedFrame mapped_encoded_frame;
+	ImxVpuApiDecReturnCodes ret;
+
+	assert(decoder != NULL);
+	assert(encoded_frame != NULL);
+	assert(encoded_dma_buffer != NULL);
+
+	if ((offset + encoded_frame->data_size) > imx_dma_buffer_get_size(encoded_dma_buffer))
+	{
+		IMX_VPU_API_ERROR("encoded data with offset %zu and size %zu does not fit in DMA buffer of size %zu", offset, encoded_frame->data_size, imx_dma_buffer_get_size(encoded_dma_buffer));
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+	virtual_address = imx_dma_buffer_map(encoded_dma_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_READ, &err);
+	if (virtual_address == NULL)
+	{
+		IMX_VPU_API_ERROR("mapping encoded DMA buffer to virtual address space failed: %s (%d)", strerror(err), err);
+		return IMX_VPU_API_DEC_RETURN_CODE_DMA_MEMORY_ACCESS_ERROR;
+	}
+
+	mapped_encoded_frame = *encoded_frame;
+	mapped_encoded_frame.data = virtual_address + offset;
+
+	ret = imx_vpu_api_dec_push_encoded_frame(decoder, &mapped_encoded_frame);
+
+	imx_dma_buffer_unmap(encoded_dma_buffer);
+
+	/* The data was copied into the stream buffer,
+	 * so the DMA buffer can be released right away. */
+	if ((ret == IMX_VPU_API_DEC_RETURN_CODE_OK) && (release_callback != NULL))
+		release_callback(decoder, encoded_dma_buffer, release_callback_user_data);
+
+	return ret;
+}
+
+
+
+/* The worker threads are shared by all instances. The number of threads
+ * is platform specific. On the i.MX8M, there is one thread per core (G1,
+ * G2, and the encoder), and each thread only runs the jobs of its core
+ * (see ImxVpuApiAsyncJob's core field). That way, jobs for one core do
+ * not have to wait for jobs running on another one. On the i.MX6, the
+ * CODA960 can only process one frame at a time, so additional threads
+ * would only block inside the VPU library, bypassing the scheduling.
+ * Jobs for the same instance never run concurrently, since at most one
+ * run of a job can be in progress at any time. */
+#ifdef IMXVPUAPI2_NUM_ASYNC_WORKER_THREADS
+#define IMX_VPU_API_ASYNC_NUM_WORKER_THREADS IMXVPUAPI2_NUM_ASYNC_WORKER_THREADS
+#else
+#define IMX_VPU_API_ASYNC_NUM_WORKER_THREADS IMX_VPU_API_ASYNC_NUM_CORES
+#endif
+
+/* Serializes starting and stopping the worker threads. This is separate
+ * from async_worker_mutex, since stopping means joining the threads, and
+ * these need async_worker_mutex to be able to exit. */
+static pthread_mutex_t async_worker_lifecycle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int async_worker_num_users = 0;
+static pthread_t async_worker_threads[IMX_VPU_API_ASYNC_NUM_WORKER_THREADS];
+static unsigned int async_worker_num_threads = 0;
+
+/* Protects the job queue, the shutdown flag, and the scheduling
+ * parameters and virtual runtimes of the jobs. Jobs are appended to
+ * the queue, so jobs that are otherwise equal are run in FIFO order.
+ * async_min_virtual_runtime is the virtual runtime of the job that was
+ * last picked. Jobs that are queued with a lower virtual runtime, for
+ * example because their instance was idle for a while, are moved up to
+ * this value. Otherwise, such jobs could monopolize the worker threads
+ * until they catch up with the others. */
+static pthread_mutex_t async_worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_worker_cond = PTHREAD_COND_INITIALIZER;
+static ImxVpuApiAsyncJob *async_job_queue_head = NULL;
+static ImxVpuApiAsyncJob *async_job_queue_tail = NULL;
+static uint64_t async_min_virtual_runtime = 0;
+static BOOL async_worker_shutdown = FALSE;
+/* Number of queued jobs per worker thread. Each
+ * thread waits until this is nonzero for it. */
+static unsigned int async_num_queued_jobs[IMX_VPU_API_ASYNC_NUM_WORKER_THREADS];
+
+
+static unsigned int get_async_worker_thread_index(ImxVpuApiAsyncJob const *job);
+static int64_t get_effective_async_job_priority(ImxVpuApiAsyncJob const *job);
+static ImxVpuApiAsyncJob* pick_next_async_job(unsigned int thread_index);
+static void* async_worker_thread_func(void *arg);
+static void stop_async_worker_threads(void);
+
+
+static unsigned int get_async_worker_thread_index(ImxVpuApiAsyncJob const *job)
+{
+	return ((unsigned int)(job->core)) % IMX_VPU_API_ASYNC_NUM_WORKER_THREADS;
+}
+
+
+/* Must be called with async_worker_mutex locked. 64-bit
+ * arithmetic is used so that aging cannot overflow. */
+static int64_t get_effective_async_job_priority(ImxVpuApiAsyncJob const *job)
+{
+	return (int64_t)(job->priority) + job->num_times_skipped / IMX_VPU_API_ASYNC_JOB_AGING_INTERVAL;
+}
+
+
+/* Must be called with async_worker_mutex locked. */
+static ImxVpuApiAsyncJob* pick_next_async_job(unsigned int thread_index)
+{
+	ImxVpuApiAsyncJob *job, *prev_job;
+	ImxVpuApiAsyncJob *best_job = NULL, *prev_best_job = NULL;
+	int64_t priority, best_priority = 0;
+
+	for (prev_job = NULL, job = async_job_queue_head; job != NULL; prev_job = job, job = job->next)
+	{
+		if (get_async_worker_thread_index(job) != thread_index)
+			continue;
+
+		priority = get_effective_async_job_priority(job);
+
+		if ((best_job == NULL)
+		 || (priority > best_priority)
+		 || ((priority == best_priority) && (job->virtual_runtime < best_job->virtual_runtime)))
+		{
+			best_job = job;
+			prev_best_job = prev_job;
+			best_priority = priority;
+		}
+	}
+
+	if (best_job == NULL)
+		return NULL;
+
+	/* Age the jobs that were passed over because of their lower priority.
+	 * Jobs with the same priority are not aged, since the virtual runtime
+	 * already takes care of fairness among them. */
+	for (job = async_job_queue_head; job != NULL; job = job->next)
+	{
+		if ((get_async_worker_thread_index(job) == thread_index) && (get_effective_async_job_priority(job) < best_priority))
+			job->num_times_skipped++;
+	}
+	best_job->num_times_skipped = 0;
+
+	if (prev_best_job != NULL)
+		prev_best_job->next = best_job->next;
+	else
+		async_job_queue_head = best_job->next;
+	if (async_job_queue_tail == best_job)
+		async_job_queue_tail = prev_best_job;
+	best_job->next = NULL;
+
+	assert(async_num_queued_jobs[thread_index] > 0);
+	async_num_queued_jobs[thread_index]--;
+
+	if (best_job->virtual_runtime > async_min_virtual_runtime)
+		async_min_virtual_runtime = best_job->virtual_runtime;
+
+	return best_job;
+}
+
+
+static void* async_worker_thread_func(void *arg)
+{
+	unsigned int thread_index = (unsigned int)(uintptr_t)arg;
+
+	pthread_mutex_lock(&async_worker_mutex);
+
+	while (TRUE)
+	{
+		ImxVpuApiAsyncJob *job;
+		uint64_t event_value = 1;
+		uint64_t start_time, runtime;
+		unsigned int weight;
+
+		while (!async_worker_shutdown && (async_num_queued_jobs[thread_index] == 0))
+			pthread_cond_wait(&async_worker_cond, &async_worker_mutex);
+
+		/* The threads are only stopped once no job is set up
+		 * anymore, so the queue is always empty at that point. */
+		job = pick_next_async_job(thread_index);
+		if (job == NULL)
+			break;
+
+		pthread_mutex_unlock(&async_worker_mutex);
+
+		start_time = imx_vpu_api_get_monotonic_time();
+		job->func(job->user_data);
+		runtime = imx_vpu_api_get_monotonic_time() - start_time;
+
+		/* Charge the job for the time it took. This has to be done before
+		 * the eventfd is written to, since the job's owner may start the
+		 * job again right after that. */
+		pthread_mutex_lock(&async_worker_mutex);
+		weight = (job->weight != 0) ? job->weight : IMX_VPU_API_ASYNC_JOB_DEFAULT_WEIGHT;
+		job->virtual_runtime += runtime * IMX_VPU_API_ASYNC_JOB_DEFAULT_WEIGHT / weight;
+		pthread_mutex_unlock(&async_worker_mutex);
+
+		/* Make the eventfd readable to signal that the job is finished.
+		 * The write() call also acts as a memory barrier, so the job's
+		 * results are visible to the thread that then reads the eventfd. */
+		while (write(job->event_fd, &event_value, sizeof(event_value)) < 0)
+		{
+			if (errno != EINTR)
+			{
+				IMX_VPU_API_ERROR("could not signal finished job: %s (%d)", strerror(errno), errno);
+				break;
+			}
+		}
+
+		pthread_mutex_lock(&async_worker_mutex);
+	}
+
+	pthread_mutex_unlock(&async_worker_mutex);
+
+	return NULL;
+}
+
+
+static void stop_async_worker_threads(void)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&async_worker_mutex);
+	async_worker_shutdown = TRUE;
+	pthread_cond_broadcast(&async_worker_cond);
+	pthread_mutex_unlock(&async_worker_mutex);
+
+	for (i = 0; i < async_worker_num_threads; ++i)
+		pthread_join(async_worker_threads[i], NULL);
+	async_worker_num_threads = 0;
+}
+
+
+BOOL imx_vpu_api_async_job_setup(ImxVpuApiAsyncJob *job, ImxVpuApiAsyncJobFunc func, void *user_data)
+{
+	int err;
+	BOOL ret = TRUE;
+
+	assert(job != NULL);
+	assert(func != NULL);
+
+	if (job->is_set_up)
+		return TRUE;
+
+	job->event_fd = eventfd(0, EFD_CLOEXEC);
+	if (job->event_fd < 0)
+	{
+		IMX_VPU_API_ERROR("could not create eventfd: %s (%d)", strerror(errno), errno);
+		return FALSE;
+	}
+
+	pthread_mutex_lock(&async_worker_lifecycle_mutex);
+
+	if (async_worker_num_users == 0)
+	{
+		async_worker_shutdown = FALSE;
+
+		for (async_worker_num_threads = 0; async_worker_num_threads < IMX_VPU_API_ASYNC_NUM_WORKER_THREADS; ++async_worker_num_threads)
+		{
+			err = pthread_create(&(async_worker_threads[async_worker_num_threads]), NULL, async_worker_thread_func, (void *)(uintptr_t)async_worker_num_threads);
+			if (err != 0)
+			{
+				IMX_VPU_API_ERROR("could not start worker thread: %s (%d)", strerror(err), err);
+				stop_async_worker_threads();
+				ret = FALSE;
+				break;
+			}
+		}
+	}
+
+	if (ret)
+		async_worker_num_users++;
+
+	pthread_mutex_unlock(&async_worker_lifecycle_mutex);
+
+	if (!ret)
+	{
+		close(job->event_fd);
+		job->event_fd = -1;
+		return FALSE;
+	}
+
+	job->func = func;
+	job->user_data = user_data;
+	job->in_progress = FALSE;
+	job->next = NULL;
+	job->is_set_up = TRUE;
+
+	return TRUE;
+}
+
+
+void imx_vpu_api_async_job_cleanup(ImxVpuApiAsyncJob *job)
+{
+	assert(job != NULL);
+
+	if (!job->is_set_up)
+		return;
+
+	if (job->in_progress)
+		imx_vpu_api_async_job_wait(job);
+
+	close(job->event_fd);
+	job->event_fd = -1;
+	job->is_set_up = FALSE;
+
+	pthread_mutex_lock(&async_worker_lifecycle_mutex);
+
+	assert(async_worker_num_users > 0);
+	async_worker_num_users--;
+	if (async_worker_num_users == 0)
+		stop_async_worker_threads();
+
+	pthread_mutex_unlock(&async_worker_lifecycle_mutex);
+}
+
+
+BOOL imx_vpu_api_async_job_start(ImxVpuApiAsyncJob *job)
+{
+	assert(job != NULL);
+	assert(job->is_set_up);
+
+	if (job->in_progress)
+		return FALSE;
+
+	job->in_progress = TRUE;
+
+	pthread_mutex_lock(&async_worker_mutex);
+
+	if (job->virtual_runtime < async_min_virtual_runtime)
+		job->virtual_runtime = async_min_virtual_runtime;
+
+	job->num_times_skipped = 0;
+	job->next = NULL;
+	if (async_job_queue_tail != NULL)
+		async_job_queue_tail->next = job;
+	else
+		async_job_queue_head = job;
+	async_job_queue_tail = job;
+
+	async_num_queued_jobs[get_async_worker_thread_index(job)]++;
+
+	/* All threads wait on the same condition variable, and only
+	 * the one for the job's core can pick it, so wake up all. */
+	pthread_cond_broadcast(&async_worker_cond);
+
+	pthread_mutex_unlock(&async_worker_mutex);
+
+	return TRUE;
+}
+
+
+BOOL imx_vpu_api_async_job_wait(ImxVpuApiAsyncJob *job)
+{
+	uint64_t event_value;
+
+	assert(job != NULL);
+
+	if (!job->in_progress)
+		return FALSE;
+
+	/* The eventfd is in blocking mode, so this waits until the worker
+	 * thread signals that the job is finished. Reading also resets the
+	 * eventfd's counter, making it non-readable again. */
+	while (read(job->event_fd, &event_value, sizeof(event_value)) < 0)
+	{
+		if (errno != EINTR)
+		{
+			IMX_VPU_API_ERROR("could not wait for job to finish: %s (%d)", strerror(errno), errno);
+			break;
+		}
+	}
+
+	job->in_progress = FALSE;
+
+	return TRUE;
+}
+
+
+void imx_vpu_api_async_job_set_scheduling_params(ImxVpuApiAsyncJob *job, int priority, unsigned int weight)
+{
+	assert(job != NULL);
+
+	pthread_mutex_lock(&async_worker_mutex);
+	job->priority = priority;
+	job->weight = weight;
+	pthread_mutex_unlock(&async_worker_mutex);
+}
+
+
+void imx_vpu_api_async_job_set_core(ImxVpuApiAsyncJob *job, ImxVpuApiAsyncCore core)
+{
+	assert(job != NULL);
+	assert(!(job->in_progress));
+	assert(core < IMX_VPU_API_ASYNC_NUM_CORES);
+
+	job->core = core;
+}
+
+
+static void dec_async_job_func(void *user_data)
+{
+	ImxVpuApiDecAsyncState *async_state = (ImxVpuApiDecAsyncState *)user_data;
+	async_state->return_code = imx_vpu_api_dec_decode(async_state->decoder, &(async_state->output_code));
+}
+
+
+int imx_vpu_api_dec_async_get_event_fd(ImxVpuApiDecAsyncState *async_state, ImxVpuApiDecoder *decoder)
+{
+	assert(async_state != NULL);
+	assert(decoder != NULL);
+
+	async_state->decoder = decoder;
+	if (!imx_vpu_api_async_job_setup(&(async_state->job), dec_async_job_func, async_state))
+		return -1;
+
+	return async_state->job.event_fd;
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_async_start_decode(ImxVpuApiDecAsyncState *async_state, ImxVpuApiDecoder *decoder)
+{
+	assert(async_state != NULL);
+	assert(decoder != NULL);
+
+	if (imx_vpu_api_dec_async_get_event_fd(async_state, decoder) < 0)
+		return IMX_VPU_API_DEC_RETURN_CODE_ERROR;
+
+	if (!imx_vpu_api_async_job_start(&(async_state->job)))
+	{
+		IMX_VPU_API_ERROR("a decoding step is already in progress");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+	}
+
+	return IMX_VPU_API_DEC_RETURN_CODE_OK;
+}
+
+
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_async_finish_decode(ImxVpuApiDecAsyncState *async_state, ImxVpuApiDecOutputCodes *output_code)
+{
+	assert(async_state != NULL);
+	assert(output_code != NULL);
+
+	if (!async_state->job.is_set_up || !imx_vpu_api_async_job_wait(&(async_state->job)))
+	{
+		IMX_VPU_API_ERROR("no decoding step is in progress");
+		return IMX_VPU_API_DEC_RETURN_CODE_INVALID_CALL;
+	}
+
+	*output_code = async_state->output_code;
+	return async_state->return_code;
+}
+
+
+void imx_vpu_api_dec_async_cleanup(ImxVpuApiDecAsyncState *async_state)
+{
+	assert(async_state != NULL);
+	imx_vpu_api_async_job_cleanup(&(async_state->job));
+}
+
+
+static void enc_async_job_func(void *user_data)
+{
+	ImxVpuApiEncAsyncState *async_state = (ImxVpuApiEncAsyncState *)user_data;
+	async_state->return_code = imx_vpu_api_enc_encode(async_state->encoder, &(async_state->encoded_frame_size), &(async_state->output_code));
+}
+
+
+int imx_vpu_api_enc_async_get_event_fd(ImxVpuApiEncAsyncState *async_state, ImxVpuApiEncoder *encoder)
+{
+	assert(async_state != NULL);
+	assert(encoder != NULL);
+
+	async_state->encoder = encoder;
+	if (!imx_vpu_api_async_job_setup(&(async_state->job), enc_async_job_func, async_state))
+		return -1;
+
+	return async_state->job.event_fd;
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_async_start_encode(ImxVpuApiEncAsyncState *async_state, ImxVpuApiEncoder *encoder)
+{
+	assert(async_state != NULL);
+	assert(encoder != NULL);
+
+	if (imx_vpu_api_enc_async_get_event_fd(async_state, encoder) < 0)
+		return IMX_VPU_API_ENC_RETURN_CODE_ERROR;
+
+	if (!imx_vpu_api_async_job_start(&(async_state->job)))
+	{
+		IMX_VPU_API_ERROR("an encoding step is already in progress");
+		return IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL;
+	}
+
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_async_finish_encode(ImxVpuApiEncAsyncState *async_state, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code)
+{
+	assert(async_state != NULL);
+	assert(encoded_frame_size != NULL);
+	assert(output_code != NULL);
+
+	if (!async_state->job.is_set_up || !imx_vpu_api_async_job_wait(&(async_state->job)))
+	{
+		IMX_VPU_API_ERROR("no encoding step is in progress");
+		return IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL;
+	}
+
+	*encoded_frame_size = async_state->encoded_frame_size;
+	*output_code = async_state->output_code;
+	return async_state->return_code;
+}
+
+
+void imx_vpu_api_enc_async_cleanup(ImxVpuApiEncAsyncState *async_state)
+{
+	assert(async_state != NULL);
+	imx_vpu_api_async_job_cleanup(&(async_state->job));
 }
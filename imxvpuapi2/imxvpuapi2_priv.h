@@ -71,6 +71,11 @@ extern uint8_t const h264_aud[];
 extern size_t const h264_aud_size;
 
 
+#define ANNEXB_START_CODE_SIZE  4
+
+extern uint8_t const annexb_start_code[ANNEXB_START_CODE_SIZE];
+
+
 extern uint8_t const jpeg_quantization_table_luma[64];
 extern uint8_t const jpeg_quantization_table_chroma[64];
 extern uint8_t const jpeg_zigzag_pattern[64];
@@ -153,11 +158,277 @@ void imx_vpu_api_insert_vc1_frame_layer_header(uint8_t *header, uint8_t *main_da
 
 void imx_vpu_api_insert_divx3_frame_header(uint8_t *header, unsigned int frame_width, unsigned int frame_height);
 
+/* Converts the parameter sets in an avcC (h.264) or hvcC (h.265) NAL
+ * configuration record into Annex-B NAL units, each with a 4-byte start
+ * code. If annexb_data is NULL, only the size of the Annex-B data is
+ * computed. This makes it possible to call this function once to get the
+ * size, allocate a buffer, and call it again to fill that buffer. Also
+ * retrieves the size of the NAL length fields used in the main data. */
+BOOL imx_vpu_api_convert_nal_config_to_annexb(ImxVpuApiCompressionFormat compression_format, uint8_t const *config_data, size_t config_data_size, uint8_t *annexb_data, size_t *annexb_data_size, unsigned int *nal_length_size);
+/* Validates length-prefixed NAL data and computes its size once the
+ * length fields are replaced by 4-byte start codes. Returns FALSE if
+ * the data is malformed. */
+BOOL imx_vpu_api_get_annexb_size_of_length_prefixed_data(uint8_t const *data, size_t data_size, unsigned int nal_length_size, size_t *annexb_data_size);
+/* Gets the NAL unit at the beginning of length-prefixed data. The data
+ * must have been validated with imx_vpu_api_get_annexb_size_of_length_prefixed_data().
+ * Returns the number of bytes (length field plus NAL unit) that were read. */
+size_t imx_vpu_api_get_next_length_prefixed_nal(uint8_t const *data, size_t data_size, unsigned int nal_length_size, uint8_t const **nal, size_t *nal_size);
+
+/* Properties of an encoded frame, as determined by
+ * imx_vpu_api_parse_frame_properties(). */
+/* The frame does not refer to any other frame. */
+#define IMX_VPU_API_FRAME_PROPERTY_INTRA                (1 << 0)
+/* Decoding can start at this frame (IDR, IRAP, keyframe). */
+#define IMX_VPU_API_FRAME_PROPERTY_RANDOM_ACCESS_POINT  (1 << 1)
+/* No other frame refers to this frame, so it can be dropped. */
+#define IMX_VPU_API_FRAME_PROPERTY_NON_REFERENCE        (1 << 2)
+
+/* Determines the properties of an encoded frame by parsing its first
+ * picture/slice header with the CPU. h.264/h.265 data can be in Annex-B
+ * format (nal_length_size 0) or length-prefixed; in the latter case, it
+ * must have been validated with imx_vpu_api_get_annexb_size_of_length_prefixed_data().
+ * Returns FALSE if the properties cannot be determined, for example
+ * because the format is not supported by this parser. */
+BOOL imx_vpu_api_parse_frame_properties(ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, uint32_t *properties);
+/* Looks for h.265 SPS NAL units in the given data (which can be in the same
+ * formats as with imx_vpu_api_parse_frame_properties()), and raises
+ * *highest_temporal_id to the highest TemporalId they allow for. Initialize
+ * *highest_temporal_id to -1 (= unknown) before passing in the first data. */
+void imx_vpu_api_update_h265_highest_temporal_id(uint8_t const *data, size_t data_size, unsigned int nal_length_size, int *highest_temporal_id);
+/* Checks if the given frame shall not be decoded because of the skip mode.
+ * Frames whose properties cannot be determined are never excluded. With
+ * h.265, h265_highest_temporal_id must be the value that was determined
+ * with imx_vpu_api_update_h265_highest_temporal_id(); it is ignored with
+ * other formats. */
+BOOL imx_vpu_api_dec_is_frame_excluded_by_skip_mode(ImxVpuApiDecSkipMode skip_mode, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, int h265_highest_temporal_id);
+
+/* Cache for the stream headers that are found in pushed frames: h.264
+ * SPS/PPS, h.265 VPS/SPS/PPS, MPEG-2 and MPEG-4 sequence headers, and VC-1
+ * sequence and entry-point headers. Decoders whose flush discards the parsed
+ * headers use it to reinsert them after a flush, so callers do not have to
+ * resend them. VP8 and VP9 need no cache, since their keyframes carry all
+ * of the header information. A zero-initialized cache is valid and empty.
+ *
+ * h.264/h.265 parameter sets are cached per type and parameter set ID, so
+ * for example a PPS with ID 1 does not replace the one with ID 0. A new
+ * parameter set replaces the cached one with the same type and ID. The
+ * headers of the other formats have no IDs, and are cached as one entry
+ * that is replaced by the headers of the next frame that has any. The
+ * entries are stored with start codes, and are ordered the way they have
+ * to appear in the stream (first by type, then by ID). */
+typedef struct
+{
+	/* Position of the header type in the stream. With h.265 for
+	 * example, this is 0 for the VPS, 1 for the SPS, 2 for the PPS. */
+	unsigned int type_order;
+	/* Parameter set ID. Always 0 with formats other than h.264/h.265. */
+	unsigned int id;
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	/* TRUE if the last processed frame contained this header. */
+	BOOL updated;
+}
+ImxVpuApiStreamHeaderCacheEntry;
+
+typedef struct
+{
+	ImxVpuApiStreamHeaderCacheEntry *entries;
+	size_t num_entries;
+	size_t entries_capacity;
+	BOOL reinsertion_pending;
+	/* TRUE if a skipped frame contained headers. The cached
+	 * headers are then inserted in front of the next frame. */
+	BOOL skipped_headers_pending;
+}
+ImxVpuApiStreamHeaderCache;
+
+/* Frees the cache entries and empties the cache. */
+void imx_vpu_api_stream_header_cache_cleanup(ImxVpuApiStreamHeaderCache *cache);
+/* Marks the cached headers for reinsertion ahead of the next frame that
+ * is a random access point. Call this when the decoder is flushed. */
+void imx_vpu_api_stream_header_cache_schedule_reinsertion(ImxVpuApiStreamHeaderCache *cache);
+/* Updates the cache with the headers in the given frame. The frame has to
+ * begin at a frame boundary; h.264/h.265 data can be length-prefixed like
+ * with imx_vpu_api_parse_frame_properties(). Sets *reinsert_headers to TRUE
+ * if a reinsertion is pending and the frame is a random access point (or
+ * its properties are unknown) that does not carry its own headers. In that
+ * case, the caller must insert all cache entries in front of the frame.
+ * Returns FALSE if memory for a header could not be allocated. That header
+ * is then not in the cache, but *reinsert_headers is still valid. */
+BOOL imx_vpu_api_stream_header_cache_process_frame(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size, BOOL *reinsert_headers);
+/* Updates the cache with the headers in a frame that is not passed to the
+ * decoder, like a frame that is excluded by the skip mode. Headers in such
+ * a frame still have to reach the decoder, so if there are any, the next
+ * imx_vpu_api_stream_header_cache_process_frame() call requests the
+ * insertion of the cached headers, even if its frame is not a random
+ * access point. Returns FALSE in the same cases as
+ * imx_vpu_api_stream_header_cache_process_frame(). */
+BOOL imx_vpu_api_stream_header_cache_process_skipped_frame(ImxVpuApiStreamHeaderCache *cache, ImxVpuApiCompressionFormat compression_format, uint8_t const *data, size_t data_size, unsigned int nal_length_size);
+
 int imx_vpu_api_parse_jpeg_header(void *jpeg_data, size_t jpeg_data_size, BOOL semi_planar_output, unsigned int *width, unsigned int *height, ImxVpuApiColorFormat *color_format);
 
+/* Returns the current time of the monotonic clock, in nanoseconds.
+ * Used for measuring the latencies of decoded frames. */
+uint64_t imx_vpu_api_get_monotonic_time(void);
+
 ImxVpuApiH264Level imx_vpu_api_estimate_max_h264_level(int width, int height, int bitrate, int fps_num, int fps_denom, ImxVpuApiH264Profile profile);
 ImxVpuApiH265Level imx_vpu_api_estimate_max_h265_level(int width, int height, int bitrate, int fps_num, int fps_denom, ImxVpuApiH265Profile profile);
 
+/* Generic imx_vpu_api_dec_push_encoded_dma_buffer() implementation for
+ * backends that cannot read encoded data directly from the DMA buffer.
+ * Maps the DMA buffer, pushes its data with imx_vpu_api_dec_push_encoded_frame(),
+ * and then immediately invokes the release callback. */
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_push_encoded_dma_buffer_by_copy(ImxVpuApiDecoder *decoder, ImxVpuApiEncodedFrame *encoded_frame, ImxDmaBuffer *encoded_dma_buffer, size_t offset, ImxVpuApiDecEncodedDmaBufferReleaseCallback release_callback, void *release_callback_user_data);
+
+
+
+/* Asynchronous jobs
+ *
+ * The VPU libraries only offer blocking calls for waiting until the hardware
+ * finishes a frame, and there is no file descriptor that could be polled for
+ * that. To still be able to drive many instances from one event loop, the
+ * blocking calls are run as jobs in worker threads that are shared by all
+ * instances in the process. Each job has an eventfd that becomes readable
+ * once the job is finished.
+ *
+ * At most one run of a given job can be in progress at any time.
+ * The structure must be zero-initialized before its first use. The eventfd
+ * and the reference to the shared worker threads are set up lazily by
+ * imx_vpu_api_async_job_setup(), so instances that never use asynchronous
+ * operation do not cause any worker threads to be started.
+ *
+ * Queued jobs are not run in FIFO order. Instead, the worker threads pick
+ * the job with the highest priority. Among jobs with equal priority, the
+ * one with the lowest virtual runtime is picked. The virtual runtime is the
+ * time the job spent running so far, scaled by the inverse of its weight.
+ * Jobs with a higher weight therefore get a proportionally bigger share of
+ * the worker threads' time. This is the same scheme as the one used by the
+ * Linux CFS scheduler.
+ *
+ * To keep a continuous stream of high priority jobs from starving lower
+ * priority ones, queued jobs age: every time a job is passed over in favor
+ * of a higher priority job for the same worker thread, it counts as
+ * skipped, and every IMX_VPU_API_ASYNC_JOB_AGING_INTERVAL skips raise its
+ * effective priority by one. The count is reset once the job is picked.
+ *
+ * Each job is routed to the hardware core it runs on. Every worker thread
+ * only picks jobs for one core, so jobs for one core never have to wait
+ * for jobs that are running on another core. If there are fewer worker
+ * threads than cores (see IMXVPUAPI2_NUM_ASYNC_WORKER_THREADS), then
+ * cores share threads. */
+
+/* Weight that is used if none was set explicitly. */
+#define IMX_VPU_API_ASYNC_JOB_DEFAULT_WEIGHT 100
+/* Number of times a queued job has to be passed over
+ * until its effective priority is raised by one. */
+#define IMX_VPU_API_ASYNC_JOB_AGING_INTERVAL 4
+
+typedef enum
+{
+	/* The decoder core. On the i.MX8M, this is the Hantro G1 core. */
+	IMX_VPU_API_ASYNC_CORE_DECODER = 0,
+	/* The Hantro G2 core (h.265 and VP9) on the i.MX8M. */
+	IMX_VPU_API_ASYNC_CORE_SECONDARY_DECODER,
+	/* The encoder core (Hantro H1 or VC8000E) on the i.MX8M. */
+	IMX_VPU_API_ASYNC_CORE_ENCODER,
+
+	IMX_VPU_API_ASYNC_NUM_CORES
+}
+ImxVpuApiAsyncCore;
+
+typedef void (*ImxVpuApiAsyncJobFunc)(void *user_data);
+
+typedef struct _ImxVpuApiAsyncJob ImxVpuApiAsyncJob;
+
+struct _ImxVpuApiAsyncJob
+{
+	ImxVpuApiAsyncJobFunc func;
+	void *user_data;
+
+	BOOL is_set_up;
+	int event_fd;
+	BOOL in_progress;
+
+	/* Scheduling parameters. A weight of 0 is treated as
+	 * IMX_VPU_API_ASYNC_JOB_DEFAULT_WEIGHT, so zero-initialized
+	 * jobs get the default parameters. */
+	int priority;
+	unsigned int weight;
+	/* Accumulated weighted runtime, in nanoseconds. */
+	uint64_t virtual_runtime;
+	/* How often the job was passed over in favor of a
+	 * higher priority job since it was queued. */
+	unsigned int num_times_skipped;
+	/* Core the job runs on. Zero-initialized jobs
+	 * run on IMX_VPU_API_ASYNC_CORE_DECODER. */
+	ImxVpuApiAsyncCore core;
+
+	/* Used by the worker threads for their queue. */
+	ImxVpuApiAsyncJob *next;
+};
+
+/* Creates the job's eventfd and starts the shared worker threads if they
+ * are not running already. Does nothing if the job is already set up. */
+BOOL imx_vpu_api_async_job_setup(ImxVpuApiAsyncJob *job, ImxVpuApiAsyncJobFunc func, void *user_data);
+/* Waits for the job to finish if it is in progress, closes the eventfd, and
+ * stops the worker threads if no other job is set up anymore. Does nothing
+ * if the job was never set up. */
+void imx_vpu_api_async_job_cleanup(ImxVpuApiAsyncJob *job);
+/* Queues the job for execution in one of the worker threads. Returns FALSE
+ * if the job is already in progress. */
+BOOL imx_vpu_api_async_job_start(ImxVpuApiAsyncJob *job);
+/* Blocks until the job is finished, and resets the eventfd so it is no
+ * longer readable. Returns FALSE if the job is not in progress. */
+BOOL imx_vpu_api_async_job_wait(ImxVpuApiAsyncJob *job);
+/* Sets the job's priority and weight. Can be called at any time, including
+ * before the job is set up and while it is queued. */
+void imx_vpu_api_async_job_set_scheduling_params(ImxVpuApiAsyncJob *job, int priority, unsigned int weight);
+/* Sets the core the job runs on. Must not be called while the job is in
+ * progress. Backends call this when the instance is opened. */
+void imx_vpu_api_async_job_set_core(ImxVpuApiAsyncJob *job, ImxVpuApiAsyncCore core);
+
+
+/* Generic implementation of the asynchronous decoding functions
+ * imx_vpu_api_dec_get_event_fd(), imx_vpu_api_dec_start_decode() and
+ * imx_vpu_api_dec_finish_decode(). Backends embed this structure in their
+ * decoder structure (zero-initialized), call these functions from the
+ * public ones, and call imx_vpu_api_dec_async_cleanup() first thing in
+ * imx_vpu_api_dec_close(). The job simply runs imx_vpu_api_dec_decode(). */
+
+typedef struct
+{
+	ImxVpuApiAsyncJob job;
+	ImxVpuApiDecoder *decoder;
+	ImxVpuApiDecReturnCodes return_code;
+	ImxVpuApiDecOutputCodes output_code;
+}
+ImxVpuApiDecAsyncState;
+
+int imx_vpu_api_dec_async_get_event_fd(ImxVpuApiDecAsyncState *async_state, ImxVpuApiDecoder *decoder);
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_async_start_decode(ImxVpuApiDecAsyncState *async_state, ImxVpuApiDecoder *decoder);
+ImxVpuApiDecReturnCodes imx_vpu_api_dec_async_finish_decode(ImxVpuApiDecAsyncState *async_state, ImxVpuApiDecOutputCodes *output_code);
+void imx_vpu_api_dec_async_cleanup(ImxVpuApiDecAsyncState *async_state);
+
+
+/* Encoder counterpart of ImxVpuApiDecAsyncState, used for implementing
+ * imx_vpu_api_enc_get_event_fd(), imx_vpu_api_enc_start_encode() and
+ * imx_vpu_api_enc_finish_encode(). The job runs imx_vpu_api_enc_encode(). */
+
+typedef struct
+{
+	ImxVpuApiAsyncJob job;
+	ImxVpuApiEncoder *encoder;
+	ImxVpuApiEncReturnCodes return_code;
+	size_t encoded_frame_size;
+	ImxVpuApiEncOutputCodes output_code;
+}
+ImxVpuApiEncAsyncState;
+
+int imx_vpu_api_enc_async_get_event_fd(ImxVpuApiEncAsyncState *async_state, ImxVpuApiEncoder *encoder);
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_async_start_encode(ImxVpuApiEncAsyncState *async_state, ImxVpuApiEncoder *encoder);
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_async_finish_encode(ImxVpuApiEncAsyncState *async_state, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code);
+void imx_vpu_api_enc_async_cleanup(ImxVpuApiEncAsyncState *async_state);
 
 #ifdef __cplusplus
 }
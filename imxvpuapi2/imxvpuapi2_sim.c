@@ -0,0 +1,896 @@
+/* Needed for MAP_ANONYMOUS, which is used by the DMA buffer allocator. */
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <config.h>
+
+#include <imxdmabuffer/imxdmabuffer.h>
+#include "imxvpuapi2.h"
+#include "imxvpuapi2_priv.h"
+#include "imxvpuapi2_sim.h"
+
+
+
+
+/******************************************************/
+/******* MISCELLANEOUS STRUCTURES AND FUNCTIONS *******/
+/******************************************************/
+
+
+/* Define the stream buffer size to be large enough to hold at least one
+ * uncompressed 4:2:0 frame of the maximum supported size, since that is
+ * what the passthrough codec produces. */
+#define VPU_ENC_MIN_REQUIRED_STREAM_BUFFER_SIZE  (1920*1088*3 + 262144)
+#define STREAM_BUFFER_PHYSADDR_ALIGNMENT         (0x10)
+#define STREAM_BUFFER_SIZE_ALIGNMENT             (1024)
+#define FRAME_WIDTH_ALIGNMENT                    (16)
+#define FRAME_HEIGHT_ALIGNMENT                   (16)
+#define FRAMEBUFFER_ALIGNMENT                    (16)
+
+/* Pointers and strides of the planes of a 8-bit 4:2:0 frame. Used for
+ * copying frames between the tightly packed sim payload and framebuffers.
+ * If semi_planar is TRUE, u points to the interleaved UV plane, and v is
+ * not used. */
+typedef struct
+{
+	uint8_t *y, *u, *v;
+	size_t y_stride, uv_stride;
+	BOOL semi_planar;
+}
+SimFrameLayout;
+
+
+static BOOL sim_is_supported_color_format(ImxVpuApiColorFormat color_format)
+{
+	switch (color_format)
+	{
+		case IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT:
+		case IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+
+static size_t sim_calculate_payload_size(size_t width, size_t height)
+{
+	size_t chroma_width = (width + 1) / 2;
+	size_t chroma_height = (height + 1) / 2;
+	return width * height + chroma_width * chroma_height * 2;
+}
+
+
+static void sim_calculate_framebuffer_metrics(ImxVpuApiFramebufferMetrics *fb_metrics, size_t width, size_t height, BOOL semi_planar)
+{
+	fb_metrics->actual_frame_width = width;
+	fb_metrics->actual_frame_height = height;
+	fb_metrics->aligned_frame_width = IMX_VPU_API_ALIGN_VAL_TO(width, FRAME_WIDTH_ALIGNMENT);
+	fb_metrics->aligned_frame_height = IMX_VPU_API_ALIGN_VAL_TO(height, FRAME_HEIGHT_ALIGNMENT);
+
+	fb_metrics->y_stride = fb_metrics->aligned_frame_width;
+	fb_metrics->y_size = fb_metrics->y_stride * fb_metrics->aligned_frame_height;
+	fb_metrics->uv_stride = fb_metrics->y_stride / 2;
+	fb_metrics->uv_size = fb_metrics->y_size / 4;
+
+	if (semi_planar)
+	{
+		fb_metrics->uv_stride *= 2;
+		fb_metrics->uv_size *= 2;
+	}
+
+	fb_metrics->y_offset = 0;
+	fb_metrics->u_offset = fb_metrics->y_size;
+	fb_metrics->v_offset = fb_metrics->u_offset + fb_metrics->uv_size;
+}
+
+
+static void sim_layout_from_framebuffer(SimFrameLayout *layout, uint8_t *base, ImxVpuApiFramebufferMetrics const *fb_metrics, BOOL semi_planar)
+{
+	layout->y = base + fb_metrics->y_offset;
+	layout->u = base + fb_metrics->u_offset;
+	layout->v = semi_planar ? NULL : (base + fb_metrics->v_offset);
+	layout->y_stride = fb_metrics->y_stride;
+	layout->uv_stride = fb_metrics->uv_stride;
+	layout->semi_planar = semi_planar;
+}
+
+
+static void sim_layout_from_payload(SimFrameLayout *layout, uint8_t *payload, size_t width, size_t height, BOOL semi_planar)
+{
+	size_t chroma_width = (width + 1) / 2;
+	size_t chroma_height = (height + 1) / 2;
+
+	layout->y = payload;
+	layout->u = payload + width * height;
+	layout->v = semi_planar ? NULL : (layout->u + chroma_width * chroma_height);
+	layout->y_stride = width;
+	layout->uv_stride = semi_planar ? (chroma_width * 2) : chroma_width;
+	layout->semi_planar = semi_planar;
+}
+
+
+/* Copies the pixels of a frame, converting between
+ * semi-planar and fully planar chroma if necessary. */
+static void sim_copy_frame(SimFrameLayout const *dest, SimFrameLayout const *src, size_t width, size_t height)
+{
+	size_t x, y;
+	size_t chroma_width = (width + 1) / 2;
+	size_t chroma_height = (height + 1) / 2;
+
+	for (y = 0; y < height; ++y)
+		memcpy(dest->y + y * dest->y_stride, src->y + y * src->y_stride, width);
+
+	for (y = 0; y < chroma_height; ++y)
+	{
+		uint8_t *dest_u_row = dest->u + y * dest->uv_stride;
+		uint8_t const *src_u_row = src->u + y * src->uv_stride;
+
+		if (dest->semi_planar && src->semi_planar)
+		{
+			memcpy(dest_u_row, src_u_row, chroma_width * 2);
+		}
+		else if (!(dest->semi_planar) && !(src->semi_planar))
+		{
+			memcpy(dest_u_row, src_u_row, chroma_width);
+			memcpy(dest->v + y * dest->uv_stride, src->v + y * src->uv_stride, chroma_width);
+		}
+		else if (dest->semi_planar)
+		{
+			uint8_t const *src_v_row = src->v + y * src->uv_stride;
+			for (x = 0; x < chroma_width; ++x)
+			{
+				dest_u_row[x * 2 + 0] = src_u_row[x];
+				dest_u_row[x * 2 + 1] = src_v_row[x];
+			}
+		}
+		else
+		{
+			uint8_t *dest_v_row = dest->v + y * dest->uv_stride;
+			for (x = 0; x < chroma_width; ++x)
+			{
+				dest_u_row[x] = src_u_row[x * 2 + 0];
+				dest_v_row[x] = src_u_row[x * 2 + 1];
+			}
+		}
+	}
+}
+
+
+
+
+/******************************************************************/
+/******* MMAP DMA BUFFER ALLOCATOR STRUCTURES AND FUNCTIONS *******/
+/******************************************************************/
+
+
+typedef struct
+{
+	ImxDmaBuffer parent;
+
+	/* Pages returned by mmap(). These are page aligned,
+	 * so no extra alignment handling is needed. */
+	uint8_t *memory;
+	size_t mapped_size;
+	size_t size;
+}
+SimDmaBuffer;
+
+
+static void sim_allocator_destroy(ImxDmaBufferAllocator *allocator);
+static ImxDmaBuffer* sim_allocator_allocate(ImxDmaBufferAllocator *allocator, size_t size, size_t alignment, int *error);
+static void sim_allocator_deallocate(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer);
+static uint8_t* sim_allocator_map(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer, unsigned int flags, int *error);
+static void sim_allocator_unmap(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer);
+static imx_physical_address_t sim_allocator_get_physical_address(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer);
+static int sim_allocator_get_fd(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer);
+static size_t sim_allocator_get_size(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer);
+static void sim_allocator_start_sync_session(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer);
+static void sim_allocator_stop_sync_session(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer);
+
+
+static void sim_allocator_destroy(ImxDmaBufferAllocator *allocator)
+{
+	free(allocator);
+}
+
+
+static ImxDmaBuffer* sim_allocator_allocate(ImxDmaBufferAllocator *allocator, size_t size, size_t alignment, int *error)
+{
+	SimDmaBuffer *sim_buffer;
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	assert(size > 0);
+	assert(page_size > 0);
+
+	/* Pages are the largest alignment that can be provided. */
+	if (alignment > (size_t)page_size)
+	{
+		if (error != NULL)
+			*error = EINVAL;
+		return NULL;
+	}
+
+	sim_buffer = malloc(sizeof(SimDmaBuffer));
+	if (sim_buffer == NULL)
+	{
+		if (error != NULL)
+			*error = ENOMEM;
+		return NULL;
+	}
+
+	/* The memory is allocated as a shared mapping, and not with malloc(),
+	 * since DMA buffer mappings are always shared. The Hantro decoder
+	 * backend relies on this when it maps the stream buffer a second
+	 * time for its ring buffer mode. */
+	sim_buffer->mapped_size = IMX_VPU_API_ALIGN_VAL_TO(size, (size_t)page_size);
+	sim_buffer->memory = mmap(NULL, sim_buffer->mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sim_buffer->memory == MAP_FAILED)
+	{
+		if (error != NULL)
+			*error = errno;
+		free(sim_buffer);
+		return NULL;
+	}
+
+	sim_buffer->parent.allocator = allocator;
+	sim_buffer->size = size;
+
+	return (ImxDmaBuffer *)sim_buffer;
+}
+
+
+static void sim_allocator_deallocate(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer)
+{
+	SimDmaBuffer *sim_buffer = (SimDmaBuffer *)buffer;
+
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+
+	munmap(sim_buffer->memory, sim_buffer->mapped_size);
+	free(sim_buffer);
+}
+
+
+static uint8_t* sim_allocator_map(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer, unsigned int flags, int *error)
+{
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+	IMX_VPU_API_UNUSED_PARAM(flags);
+	IMX_VPU_API_UNUSED_PARAM(error);
+
+	/* The memory is always accessible, so mapping is a no-op. */
+	return ((SimDmaBuffer *)buffer)->memory;
+}
+
+
+static void sim_allocator_unmap(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+	IMX_VPU_API_UNUSED_PARAM(buffer);
+}
+
+
+static imx_physical_address_t sim_allocator_get_physical_address(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+
+	/* There is no physical address, but the rest of the library
+	 * uses physical addresses as unique buffer IDs, so use the
+	 * virtual address instead. */
+	return (imx_physical_address_t)((uintptr_t)(((SimDmaBuffer *)buffer)->memory));
+}
+
+
+static int sim_allocator_get_fd(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+	IMX_VPU_API_UNUSED_PARAM(buffer);
+	return -1;
+}
+
+
+static size_t sim_allocator_get_size(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+	return ((SimDmaBuffer *)buffer)->size;
+}
+
+
+static void sim_allocator_start_sync_session(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+	IMX_VPU_API_UNUSED_PARAM(buffer);
+}
+
+
+static void sim_allocator_stop_sync_session(ImxDmaBufferAllocator *allocator, ImxDmaBuffer *buffer)
+{
+	IMX_VPU_API_UNUSED_PARAM(allocator);
+	IMX_VPU_API_UNUSED_PARAM(buffer);
+}
+
+
+ImxDmaBufferAllocator* imx_vpu_api_sim_dma_buffer_allocator_new(int *error)
+{
+	ImxDmaBufferAllocator *allocator = malloc(sizeof(ImxDmaBufferAllocator));
+	if (allocator == NULL)
+	{
+		if (error != NULL)
+			*error = ENOMEM;
+		return NULL;
+	}
+
+	memset(allocator, 0, sizeof(ImxDmaBufferAllocator));
+
+	allocator->destroy = sim_allocator_destroy;
+	allocator->allocate = sim_allocator_allocate;
+	allocator->deallocate = sim_allocator_deallocate;
+	allocator->map = sim_allocator_map;
+	allocator->unmap = sim_allocator_unmap;
+	allocator->get_physical_address = sim_allocator_get_physical_address;
+	allocator->get_fd = sim_allocator_get_fd;
+	allocator->get_size = sim_allocator_get_size;
+	allocator->start_sync_session = sim_allocator_start_sync_session;
+	allocator->stop_sync_session = sim_allocator_stop_sync_session;
+
+	return allocator;
+}
+
+
+
+
+/************************************************/
+/******* ENCODER STRUCTURES AND FUNCTIONS *******/
+/************************************************/
+
+
+struct _ImxVpuApiEncoder
+{
+	/* Stream buffer. The passthrough codec writes the encoded frame
+	 * into it, just like a hardware encoder would. It is mapped for
+	 * as long as the encoder is open. */
+	ImxDmaBuffer *stream_buffer;
+	uint8_t *stream_buffer_virtual_address;
+	size_t stream_buffer_size;
+
+	/* Copy of the open_params passed to imx_vpu_api_enc_open(). */
+	ImxVpuApiEncOpenParams open_params;
+
+	/* Stream information that is generated by imx_vpu_api_enc_open(). */
+	ImxVpuApiEncStreamInfo stream_info;
+
+	/* DEPRECATED. This is kept here for backwards compatibility. */
+	BOOL drain_mode_enabled;
+
+	/* The raw frame that is staged for encoding.
+	 * (Staging is done by imx_vpu_api_enc_push_raw_frame().) */
+	ImxVpuApiRawFrame staged_raw_frame;
+	BOOL staged_raw_frame_set;
+
+	/* TRUE is an encoded frame is available, FALSE otherwise.
+	 * If set to FALSE, then the fields below about the encoded frame
+	 * are invalid. */
+	BOOL encoded_frame_available;
+
+	void *encoded_frame_context;
+	uint64_t encoded_frame_pts, encoded_frame_dts;
+	ImxVpuApiFrameType encoded_frame_type;
+	size_t encoded_frame_data_size;
+
+	/* State for imx_vpu_api_enc_start_encode() / imx_vpu_api_enc_finish_encode(). */
+	ImxVpuApiEncAsyncState async_state;
+};
+
+
+static ImxVpuApiColorFormat const enc_supported_color_formats[] =
+{
+	IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT,
+	IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT
+};
+
+static ImxVpuApiCompressionFormat const enc_supported_compression_formats[] =
+{
+	IMX_VPU_API_COMPRESSION_FORMAT_VP8,
+	IMX_VPU_API_COMPRESSION_FORMAT_H264
+};
+
+static ImxVpuApiEncGlobalInfo const enc_global_info = {
+	.flags = IMX_VPU_API_ENC_GLOBAL_INFO_FLAG_HAS_ENCODER | IMX_VPU_API_ENC_GLOBAL_INFO_FLAG_SEMI_PLANAR_FRAMES_SUPPORTED | IMX_VPU_API_ENC_GLOBAL_INFO_FLAG_FULLY_PLANAR_FRAMES_SUPPORTED,
+	.hardware_type = IMX_VPU_API_HARDWARE_TYPE_SIM,
+	.min_required_stream_buffer_size = VPU_ENC_MIN_REQUIRED_STREAM_BUFFER_SIZE,
+	.required_stream_buffer_physaddr_alignment = STREAM_BUFFER_PHYSADDR_ALIGNMENT,
+	.required_stream_buffer_size_alignment = STREAM_BUFFER_SIZE_ALIGNMENT,
+	.supported_compression_formats = enc_supported_compression_formats,
+	.num_supported_compression_formats = sizeof(enc_supported_compression_formats) / sizeof(ImxVpuApiCompressionFormat)
+};
+
+ImxVpuApiEncGlobalInfo const * imx_vpu_api_enc_get_global_info(void)
+{
+	return &enc_global_info;
+}
+
+
+static ImxVpuApiVP8SupportDetails const enc_vp8_support_details = {
+	.parent = {
+		.min_width = 8, .max_width = 1920,
+		.min_height = 8, .max_height = 1088,
+		.supported_color_formats = enc_supported_color_formats,
+		.num_supported_color_formats = sizeof(enc_supported_color_formats) / sizeof(ImxVpuApiColorFormat),
+		.min_quantization = 0, .max_quantization = 127
+	},
+
+	.supported_profiles = (1 << IMX_VPU_API_VP8_PROFILE_0)
+};
+
+static ImxVpuApiH264SupportDetails const enc_h264_support_details = {
+	.parent = {
+		.min_width = 8, .max_width = 1920,
+		.min_height = 8, .max_height = 1088,
+		.supported_color_formats = enc_supported_color_formats,
+		.num_supported_color_formats = sizeof(enc_supported_color_formats) / sizeof(ImxVpuApiColorFormat),
+		.min_quantization = 1, .max_quantization = 51
+	},
+
+	.max_constrained_baseline_profile_level = IMX_VPU_API_H264_LEVEL_5_1,
+	.max_baseline_profile_level = IMX_VPU_API_H264_LEVEL_UNDEFINED,
+	.max_main_profile_level = IMX_VPU_API_H264_LEVEL_UNDEFINED,
+	.max_high_profile_level = IMX_VPU_API_H264_LEVEL_UNDEFINED,
+	.max_high10_profile_level = IMX_VPU_API_H264_LEVEL_UNDEFINED,
+
+	.flags = 0
+};
+
+
+ImxVpuApiCompressionFormatSupportDetails const * imx_vpu_api_enc_get_compression_format_support_details(ImxVpuApiCompressionFormat compression_format)
+{
+	switch (compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP8:
+			return (ImxVpuApiCompressionFormatSupportDetails const *)(&enc_vp8_support_details);
+
+		case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+			return (ImxVpuApiCompressionFormatSupportDetails const *)(&enc_h264_support_details);
+
+		default:
+			return NULL;
+	}
+
+	return NULL;
+}
+
+
+void imx_vpu_api_enc_set_default_open_params(ImxVpuApiCompressionFormat compression_format, ImxVpuApiColorFormat color_format, size_t frame_width, size_t frame_height, ImxVpuApiEncOpenParams *open_params)
+{
+	assert(open_params != NULL);
+
+	memset(open_params, 0, sizeof(ImxVpuApiEncOpenParams));
+
+	open_params->frame_width = frame_width;
+	open_params->frame_height = frame_height;
+	open_params->compression_format = compression_format;
+	open_params->color_format = color_format;
+	open_params->bitrate = 256;
+	open_params->quantization = 0;
+	open_params->gop_size = 16;
+	open_params->frame_rate_numerator = 25;
+	open_params->frame_rate_denominator = 1;
+
+	switch (compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+			open_params->format_specific_open_params.h264_open_params.profile = IMX_VPU_API_H264_PROFILE_CONSTRAINED_BASELINE;
+			open_params->format_specific_open_params.h264_open_params.level = IMX_VPU_API_H264_LEVEL_UNDEFINED;
+			open_params->format_specific_open_params.h264_open_params.enable_access_unit_delimiters = 0;
+			break;
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP8:
+			open_params->format_specific_open_params.vp8_open_params.profile = IMX_VPU_API_VP8_PROFILE_0;
+			open_params->format_specific_open_params.vp8_open_params.partition_count = IMX_VPU_API_ENC_VP8_PARTITION_COUNT_1;
+			open_params->format_specific_open_params.vp8_open_params.error_resilient_mode = FALSE;
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_open(ImxVpuApiEncoder **encoder, ImxVpuApiEncOpenParams *open_params, ImxDmaBuffer *stream_buffer)
+{
+	int err;
+	ImxVpuApiEncReturnCodes ret = IMX_VPU_API_ENC_RETURN_CODE_OK;
+	ImxVpuApiFramebufferMetrics *fb_metrics;
+	BOOL semi_planar;
+	size_t stream_buffer_size;
+
+	assert(encoder != NULL);
+	assert(open_params != NULL);
+	assert(stream_buffer != NULL);
+
+
+	/* Check that the allocated stream buffer is big enough */
+	stream_buffer_size = imx_dma_buffer_get_size(stream_buffer);
+	if (stream_buffer_size < VPU_ENC_MIN_REQUIRED_STREAM_BUFFER_SIZE)
+	{
+		IMX_VPU_API_ERROR("stream buffer size is %zu bytes; need at least %zu bytes", stream_buffer_size, (size_t)VPU_ENC_MIN_REQUIRED_STREAM_BUFFER_SIZE);
+		return IMX_VPU_API_ENC_RETURN_CODE_INSUFFICIENT_STREAM_BUFFER_SIZE;
+	}
+
+
+	/* Validate the open params. */
+
+	switch (open_params->compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP8:
+		case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+			break;
+
+		default:
+			IMX_VPU_API_ERROR("unknown/unsupported compression format %s (%d)", imx_vpu_api_compression_format_string(open_params->compression_format), open_params->compression_format);
+			return IMX_VPU_API_ENC_RETURN_CODE_UNSUPPORTED_COMPRESSION_FORMAT;
+	}
+
+	if (!sim_is_supported_color_format(open_params->color_format))
+	{
+		IMX_VPU_API_ERROR("unknown/unsupported color format %s (%d)", imx_vpu_api_color_format_string(open_params->color_format), open_params->color_format);
+		return IMX_VPU_API_ENC_RETURN_CODE_UNSUPPORTED_COLOR_FORMAT;
+	}
+
+	if ((open_params->frame_width < 8) || (open_params->frame_width > 1920) || (open_params->frame_height < 8) || (open_params->frame_height > 1088))
+	{
+		IMX_VPU_API_ERROR("frame size %zux%zu is out of range", open_params->frame_width, open_params->frame_height);
+		return IMX_VPU_API_ENC_RETURN_CODE_INVALID_PARAMS;
+	}
+
+
+	/* Allocate encoder instance. */
+	*encoder = malloc(sizeof(ImxVpuApiEncoder));
+	assert((*encoder) != NULL);
+
+
+	/* Set default encoder values. */
+	memset(*encoder, 0, sizeof(ImxVpuApiEncoder));
+
+
+	(*encoder)->stream_buffer_virtual_address = imx_dma_buffer_map(stream_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_WRITE | IMX_DMA_BUFFER_MAPPING_FLAG_READ | IMX_DMA_BUFFER_MAPPING_FLAG_MANUAL_SYNC, &err);
+	if ((*encoder)->stream_buffer_virtual_address == NULL)
+	{
+		IMX_VPU_API_ERROR("mapping stream buffer to virtual address space failed: %s (%d)", strerror(err), err);
+		ret = IMX_VPU_API_ENC_RETURN_CODE_DMA_MEMORY_ACCESS_ERROR;
+		goto cleanup;
+	}
+
+	(*encoder)->stream_buffer_size = stream_buffer_size;
+	(*encoder)->stream_buffer = stream_buffer;
+
+
+	/* Make a copy of the open_params for later use. */
+	(*encoder)->open_params = *open_params;
+
+
+	fb_metrics = &((*encoder)->stream_info.frame_encoding_framebuffer_metrics);
+	semi_planar = imx_vpu_api_is_color_format_semi_planar(open_params->color_format);
+	sim_calculate_framebuffer_metrics(fb_metrics, open_params->frame_width, open_params->frame_height, semi_planar);
+
+	/* The passthrough codec does not use a framebuffer pool, so set this to 0. */
+	(*encoder)->stream_info.min_num_required_framebuffers = 0;
+	(*encoder)->stream_info.min_framebuffer_size = (semi_planar ? fb_metrics->u_offset : fb_metrics->v_offset) + fb_metrics->uv_size;
+	(*encoder)->stream_info.framebuffer_alignment = FRAMEBUFFER_ALIGNMENT;
+	(*encoder)->stream_info.frame_rate_numerator = open_params->frame_rate_numerator;
+	(*encoder)->stream_info.frame_rate_denominator = open_params->frame_rate_denominator;
+	switch (open_params->compression_format)
+	{
+		case IMX_VPU_API_COMPRESSION_FORMAT_VP8:
+			(*encoder)->stream_info.format_specific_open_params.vp8_open_params = open_params->format_specific_open_params.vp8_open_params;
+			break;
+		case IMX_VPU_API_COMPRESSION_FORMAT_H264:
+			(*encoder)->stream_info.format_specific_open_params.h264_open_params = open_params->format_specific_open_params.h264_open_params;
+			break;
+		default:
+			break;
+	}
+
+
+	/* Finish & cleanup. */
+finish:
+	if (ret == IMX_VPU_API_ENC_RETURN_CODE_OK)
+		IMX_VPU_API_DEBUG("successfully opened encoder");
+
+	return ret;
+
+cleanup:
+	if ((*encoder) != NULL)
+	{
+		imx_vpu_api_enc_close(*encoder);
+		*encoder = NULL;
+	}
+
+	goto finish;
+}
+
+
+void imx_vpu_api_enc_close(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+
+	/* This waits for any encoding step that is still in progress,
+	 * so it must be done before anything else is torn down. */
+	imx_vpu_api_enc_async_cleanup(&(encoder->async_state));
+
+	if (encoder->stream_buffer_virtual_address != NULL)
+		imx_dma_buffer_unmap(encoder->stream_buffer);
+
+	free(encoder);
+}
+
+
+ImxVpuApiEncStreamInfo const * imx_vpu_api_enc_get_stream_info(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return &(encoder->stream_info);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_add_framebuffers_to_pool(ImxVpuApiEncoder *encoder, ImxDmaBuffer **fb_dma_buffers, size_t num_framebuffers)
+{
+	IMX_VPU_API_UNUSED_PARAM(encoder);
+	IMX_VPU_API_UNUSED_PARAM(fb_dma_buffers);
+	IMX_VPU_API_UNUSED_PARAM(num_framebuffers);
+	IMX_VPU_API_ERROR("tried to add framebuffers, but this encoder does not use a framebuffer pool");
+	return IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL;
+}
+
+
+void imx_vpu_api_enc_enable_drain_mode(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	encoder->drain_mode_enabled = TRUE;
+}
+
+
+int imx_vpu_api_enc_is_drain_mode_enabled(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return encoder->drain_mode_enabled;
+}
+
+
+void imx_vpu_api_enc_flush(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+
+	encoder->staged_raw_frame_set = FALSE;
+	encoder->encoded_frame_available = FALSE;
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_set_bitrate(ImxVpuApiEncoder *encoder, unsigned int bitrate)
+{
+	assert(encoder != NULL);
+
+	/* The passthrough codec has no rate control. Just
+	 * store the value so it can be inspected later. */
+	encoder->open_params.bitrate = bitrate;
+
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_set_frame_rate(ImxVpuApiEncoder *encoder, unsigned int frame_rate_numerator, unsigned int frame_rate_denominator)
+{
+	assert(encoder != NULL);
+
+	encoder->open_params.frame_rate_numerator = frame_rate_numerator;
+	encoder->open_params.frame_rate_denominator = frame_rate_denominator;
+	encoder->stream_info.frame_rate_numerator = frame_rate_numerator;
+	encoder->stream_info.frame_rate_denominator = frame_rate_denominator;
+
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_push_raw_frame(ImxVpuApiEncoder *encoder, ImxVpuApiRawFrame const *raw_frame)
+{
+	assert(encoder != NULL);
+	assert(raw_frame != NULL);
+
+	if (encoder->staged_raw_frame_set)
+	{
+		IMX_VPU_API_ERROR("tried to push a raw frame before a previous one was encoded");
+		return IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL;
+	}
+
+	IMX_VPU_API_LOG("staged raw frame");
+
+	encoder->staged_raw_frame = *raw_frame;
+	encoder->staged_raw_frame_set = TRUE;
+
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_encode(ImxVpuApiEncoder *encoder, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code)
+{
+	int err;
+	ImxVpuApiEncReturnCodes ret = IMX_VPU_API_ENC_RETURN_CODE_OK;
+	ImxVpuApiFramebufferMetrics const *fb_metrics;
+	uint8_t *raw_frame_virtual_address;
+	uint8_t *header;
+	size_t width, height, payload_size;
+	SimFrameLayout src_layout, dest_layout;
+
+	assert(encoder != NULL);
+	assert(encoded_frame_size != NULL);
+	assert(output_code != NULL);
+
+	if (encoder->encoded_frame_available)
+	{
+		IMX_VPU_API_ERROR("cannot encode new frame before the old one was retrieved");
+		ret = IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL;
+		goto finish;
+	}
+
+	if (!(encoder->staged_raw_frame_set))
+	{
+		IMX_VPU_API_TRACE("no data left to encode");
+		*output_code = IMX_VPU_API_ENC_OUTPUT_CODE_MORE_INPUT_DATA_NEEDED;
+		ret = IMX_VPU_API_ENC_RETURN_CODE_OK;
+		goto finish;
+	}
+
+	*encoded_frame_size = 0;
+
+	encoder->encoded_frame_context = encoder->staged_raw_frame.context;
+	encoder->encoded_frame_pts = encoder->staged_raw_frame.pts;
+	encoder->encoded_frame_dts = encoder->staged_raw_frame.dts;
+
+	if (encoder->staged_raw_frame.frame_types[0] == IMX_VPU_API_FRAME_TYPE_SKIP)
+	{
+		encoder->encoded_frame_type = IMX_VPU_API_FRAME_TYPE_SKIP;
+		encoder->encoded_frame_data_size = 0;
+		*output_code = IMX_VPU_API_ENC_OUTPUT_CODE_FRAME_SKIPPED;
+		IMX_VPU_API_LOG("encoder skipped this frame");
+		goto finish;
+	}
+
+	fb_metrics = &(encoder->stream_info.frame_encoding_framebuffer_metrics);
+	width = fb_metrics->actual_frame_width;
+	height = fb_metrics->actual_frame_height;
+	payload_size = sim_calculate_payload_size(width, height);
+	assert((payload_size + IMX_VPU_API_SIM_FRAME_HEADER_SIZE) <= encoder->stream_buffer_size);
+
+	raw_frame_virtual_address = imx_dma_buffer_map(encoder->staged_raw_frame.fb_dma_buffer, IMX_DMA_BUFFER_MAPPING_FLAG_READ, &err);
+	if (raw_frame_virtual_address == NULL)
+	{
+		IMX_VPU_API_ERROR("mapping raw frame to virtual address space failed: %s (%d)", strerror(err), err);
+		ret = IMX_VPU_API_ENC_RETURN_CODE_DMA_MEMORY_ACCESS_ERROR;
+		goto finish;
+	}
+
+	imx_dma_buffer_start_sync_session(encoder->stream_buffer);
+
+	header = encoder->stream_buffer_virtual_address;
+	WRITE_32BIT_LE(header, 0, IMX_VPU_API_SIM_FRAME_HEADER_MAGIC);
+	WRITE_16BIT_LE(header, 4, width);
+	WRITE_16BIT_LE(header, 6, height);
+	WRITE_32BIT_LE(header, 8, (uint32_t)(encoder->open_params.color_format));
+	WRITE_32BIT_LE(header, 12, payload_size);
+
+	sim_layout_from_framebuffer(&src_layout, raw_frame_virtual_address, fb_metrics, imx_vpu_api_is_color_format_semi_planar(encoder->open_params.color_format));
+	sim_layout_from_payload(&dest_layout, header + IMX_VPU_API_SIM_FRAME_HEADER_SIZE, width, height, src_layout.semi_planar);
+	sim_copy_frame(&dest_layout, &src_layout, width, height);
+
+	imx_dma_buffer_stop_sync_session(encoder->stream_buffer);
+
+	imx_dma_buffer_unmap(encoder->staged_raw_frame.fb_dma_buffer);
+
+	/* Every sim frame is self-contained, so all of them are IDR frames. */
+	encoder->encoded_frame_type = IMX_VPU_API_FRAME_TYPE_IDR;
+	encoder->encoded_frame_data_size = payload_size + IMX_VPU_API_SIM_FRAME_HEADER_SIZE;
+	encoder->encoded_frame_available = TRUE;
+
+	*encoded_frame_size = encoder->encoded_frame_data_size;
+	*output_code = IMX_VPU_API_ENC_OUTPUT_CODE_ENCODED_FRAME_AVAILABLE;
+
+	IMX_VPU_API_LOG("encoded frame has a size of %zu byte", *encoded_frame_size);
+
+
+finish:
+	encoder->staged_raw_frame_set = FALSE;
+
+	return ret;
+}
+
+
+int imx_vpu_api_enc_get_event_fd(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_get_event_fd(&(encoder->async_state), encoder);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_start_encode(ImxVpuApiEncoder *encoder)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_start_encode(&(encoder->async_state), encoder);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_finish_encode(ImxVpuApiEncoder *encoder, size_t *encoded_frame_size, ImxVpuApiEncOutputCodes *output_code)
+{
+	assert(encoder != NULL);
+	return imx_vpu_api_enc_async_finish_encode(&(encoder->async_state), encoded_frame_size, output_code);
+}
+
+
+void imx_vpu_api_enc_set_scheduling_params(ImxVpuApiEncoder *encoder, int priority, unsigned int weight)
+{
+	assert(encoder != NULL);
+	imx_vpu_api_async_job_set_scheduling_params(&(encoder->async_state.job), priority, weight);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_get_encoded_frame(ImxVpuApiEncoder *encoder, ImxVpuApiEncodedFrame *encoded_frame)
+{
+	return imx_vpu_api_enc_get_encoded_frame_ext(encoder, encoded_frame, NULL);
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_get_encoded_frame_ext(ImxVpuApiEncoder *encoder, ImxVpuApiEncodedFrame *encoded_frame, int *is_sync_point)
+{
+	assert(encoder != NULL);
+	assert(encoded_frame != NULL);
+	assert(encoded_frame->data != NULL);
+
+	if (!(encoder->encoded_frame_available))
+	{
+		IMX_VPU_API_ERROR("cannot retrieve encoded frame since there is none");
+		return IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL;
+	}
+
+	imx_dma_buffer_start_sync_session(encoder->stream_buffer);
+	memcpy(encoded_frame->data, encoder->stream_buffer_virtual_address, encoder->encoded_frame_data_size);
+	imx_dma_buffer_stop_sync_session(encoder->stream_buffer);
+
+	encoded_frame->data_size = encoder->encoded_frame_data_size;
+	encoded_frame->has_header = FALSE;
+	encoded_frame->frame_type = encoder->encoded_frame_type;
+	encoded_frame->context = encoder->encoded_frame_context;
+	encoded_frame->pts = encoder->encoded_frame_pts;
+	encoded_frame->dts = encoder->encoded_frame_dts;
+
+	if (is_sync_point != NULL)
+		*is_sync_point = TRUE;
+
+	encoder->encoded_frame_available = FALSE;
+
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
+
+
+ImxVpuApiEncReturnCodes imx_vpu_api_enc_get_skipped_frame_info(ImxVpuApiEncoder *encoder, void **context, uint64_t *pts, uint64_t *dts)
+{
+	assert(encoder != NULL);
+
+	if (encoder->encoded_frame_type != IMX_VPU_API_FRAME_TYPE_SKIP)
+	{
+		IMX_VPU_API_ERROR("frame was not skipped");
+		return IMX_VPU_API_ENC_RETURN_CODE_INVALID_CALL;
+	}
+
+	if (context != NULL)
+		*context = encoder->encoded_frame_context;
+	if (pts != NULL)
+		*pts = encoder->encoded_frame_pts;
+	if (dts != NULL)
+		*dts = encoder->encoded_frame_dts;
+
+	return IMX_VPU_API_ENC_RETURN_CODE_OK;
+}
@@ -0,0 +1,91 @@
+/* imxvpuapi software simulation backend
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+
+/* The "sim" platform runs the imxvpuapi2.h API on the CPU, without any VPU.
+ * It exists for measuring the library's own per-frame overhead (stream
+ * buffer handling, frame entry bookkeeping, header insertion etc.) on build
+ * hosts that have no i.MX hardware.
+ *
+ * The decoder is the Hantro decoder backend that is also used on the i.MX8M,
+ * so that its code is what gets measured. Only the imx-vpu-hantro codec
+ * library underneath it is replaced by a trivial lossless passthrough codec
+ * (see imxvpuapi2_sim_hantro_codec.c). The codec definitions come from
+ * imxvpuapi2_sim_hantro_codec.h, so building for the sim platform needs
+ * neither the imx-vpu-hantro headers nor its libraries. The encoder is a passthrough encoder of its own.
+ *
+ * The sim encoder produces encoded frames that consist of a small header
+ * (described below) followed by the tightly packed planes of the raw input
+ * frame. The sim decoder reverses this, and always produces semi-planar
+ * frames, like the Hantro G1/G2 decoders do. Any data in front of the header
+ * (for example parameter sets that the decoder inserted) is ignored. Data
+ * that does not contain such a header is treated as a bitstream error.
+ *
+ * Since there is no physically contiguous memory on such hosts, a DMA buffer
+ * allocator is provided as well. It allocates shared anonymous memory
+ * mappings. Their "physical addresses" are just their virtual addresses. */
+
+#ifndef IMXVPUAPI2_SIM_H
+#define IMXVPUAPI2_SIM_H
+
+#include <imxdmabuffer/imxdmabuffer.h>
+#include "imxvpuapi2.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Layout of the header at the beginning of each encoded sim frame.
+ * All integers are stored in little endian byte order.
+ *
+ *   offset  size  contents
+ *   0       4     FourCC 'I','V','S','F'
+ *   4       2     frame width, in pixels
+ *   6       2     frame height, in pixels
+ *   8       4     color format (ImxVpuApiColorFormat)
+ *   12      4     payload size, in bytes (excluding this header)
+ *
+ * The payload contains the Y plane, followed by either the U and V planes
+ * (fully planar) or the interleaved UV plane (semi-planar). The planes are
+ * tightly packed, that is, their strides equal their widths. Only 8-bit
+ * 4:2:0 color formats are supported. */
+#define IMX_VPU_API_SIM_FRAME_HEADER_MAGIC IMX_VPU_API_MAKE_FOURCC_UINT32('I','V','S','F')
+#define IMX_VPU_API_SIM_FRAME_HEADER_SIZE  16
+
+
+/* Creates a DMA buffer allocator that allocates buffers as memory mappings.
+ * Use this instead of imx_dma_buffer_allocator_new() for allocating
+ * stream buffers and framebuffers when the sim platform is in use.
+ *
+ * @param error If this pointer is non-NULL, and if an error occurs, then
+ *        the integer the pointer refers to is set to an error code from
+ *        errno.h. If creating the allocator succeeds, the integer is not
+ *        modified.
+ * @return Pointer to the newly created allocator, or NULL in case of an error.
+ */
+ImxDmaBufferAllocator* imx_vpu_api_sim_dma_buffer_allocator_new(int *error);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* IMXVPUAPI2_SIM_H */
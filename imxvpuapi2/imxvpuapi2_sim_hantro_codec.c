@@ -0,0 +1,767 @@
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <config.h>
+
+#include "imxvpuapi2.h"
+#include "imxvpuapi2_priv.h"
+#include "imxvpuapi2_sim.h"
+
+/* The definitions of the codec interface that is implemented here come
+ * from an in-tree header, so the imx-vpu-hantro headers are not needed. */
+#include "imxvpuapi2_sim_hantro_codec.h"
+
+
+/* Simulated Hantro codec for the sim platform.
+ *
+ * The sim platform's decoder is the regular Hantro decoder backend from
+ * imxvpuapi2_imx8m_hantro_decoder.c. Only the codec underneath it is
+ * replaced: this file implements the DWL and HantroHwDecOmx_decoder_create_*()
+ * functions from imx-vpu-hantro with a passthrough codec that decodes the
+ * frames produced by the sim encoder (see imxvpuapi2_sim.h). That way, the
+ * stream buffer handling, frame entry bookkeeping, header insertion and
+ * framebuffer pool management that run on the i.MX8M are the code that gets
+ * measured, and not a reimplementation of it.
+ *
+ * The state machine follows the one of the imx-vpu-hantro codecs:
+ *
+ * - The first frame produces CODEC_HAS_INFO, after which decode() returns
+ *   CODEC_WAITING_FRAME_BUFFER until enough framebuffers were added with
+ *   setframebuffer().
+ * - Each decoded frame produces CODEC_HAS_FRAME, and is then returned by
+ *   getframe(). Its framebuffer is not used again until it is handed back
+ *   with pictureconsumed(). If no framebuffer is free, decode() returns
+ *   CODEC_NO_DECODING_BUFFER.
+ * - A frame with a different size produces CODEC_PENDING_FLUSH, then
+ *   CODEC_HAS_INFO. At that point, all framebuffers are removed from the
+ *   codec, just like with imx-vpu-hantro.
+ * - Data that does not contain a valid sim frame produces CODEC_ERROR_STREAM.
+ * - After endofstream(), getframe() returns CODEC_END_OF_STREAM once all
+ *   decoded frames were retrieved.
+ *
+ * Decoded frames are always 8-bit semi-planar 4:2:0 frames, since that is
+ * what the G1 and G2 cores produce. */
+
+
+
+
+/******************************************************/
+/******* MISCELLANEOUS STRUCTURES AND FUNCTIONS *******/
+/******************************************************/
+
+
+#define SIM_FRAME_WIDTH_ALIGNMENT   (16)
+#define SIM_FRAME_HEIGHT_ALIGNMENT  (16)
+
+/* The passthrough codec does not need any reference frames, but
+ * the imx-vpu-hantro codecs always request a few framebuffers more
+ * than the DPB size, so do the same here to make sure the pool
+ * handling in the decoder backend gets exercised. */
+#define SIM_MIN_NUM_REQUIRED_FRAMEBUFFERS  (4)
+
+
+/* Framebuffer that was added to the codec with setframebuffer(). */
+typedef struct
+{
+	BUFFER buffer;
+	/* TRUE if the framebuffer holds a decoded frame that was not yet
+	 * returned with pictureconsumed(). Such framebuffers are either
+	 * in the output queue or were already returned by getframe(). */
+	BOOL in_use;
+}
+SimFramebuffer;
+
+
+/* Decoded frame that can be retrieved with getframe(). */
+typedef struct
+{
+	size_t framebuffer_index;
+	OMX_U32 pic_id;
+}
+SimOutputFrame;
+
+
+typedef struct
+{
+	/* Must be the first field, since the CODEC_PROTOTYPE pointers
+	 * that the decoder backend gets are cast to SimCodec pointers. */
+	CODEC_PROTOTYPE base;
+
+	char const *name;
+
+	BOOL has_info;
+	size_t width, height;
+	size_t stride, slice_height;
+	size_t framebuffer_size;
+
+	/* TRUE if CODEC_PENDING_FLUSH was returned because the frame size
+	 * changed. The new stream info is set up by the next decode() call. */
+	BOOL pending_flush;
+
+	SimFramebuffer *framebuffers;
+	size_t num_framebuffers;
+	size_t framebuffers_capacity;
+
+	/* Ring buffer of decoded frames that getframe() has yet to return.
+	 * It has as many slots as there are framebuffers, so it never
+	 * overflows. */
+	SimOutputFrame *output_frames;
+	size_t output_frames_capacity;
+	size_t first_output_frame_index;
+	size_t num_output_frames;
+
+	BOOL end_of_stream;
+}
+SimCodec;
+
+
+/* Locates the sim frame header in the given data. Anything in front
+ * of the header, like parameter sets that the decoder backend inserted,
+ * is passed through as-is. The return value is the offset of the
+ * header, or -1 if there is none. */
+static long sim_codec_find_frame_header(uint8_t const *data, size_t data_size)
+{
+	size_t offset;
+
+	if (data_size < IMX_VPU_API_SIM_FRAME_HEADER_SIZE)
+		return -1;
+
+	for (offset = 0; offset <= (data_size - IMX_VPU_API_SIM_FRAME_HEADER_SIZE); ++offset)
+	{
+		if (READ_32BIT_LE(data, offset) == IMX_VPU_API_SIM_FRAME_HEADER_MAGIC)
+			return (long)offset;
+	}
+
+	return -1;
+}
+
+
+static size_t sim_codec_get_payload_size(size_t width, size_t height)
+{
+	return width * height + ((width + 1) / 2) * ((height + 1) / 2) * 2;
+}
+
+
+static BOOL sim_codec_parse_frame_header(uint8_t const *header, size_t data_size, size_t *width, size_t *height, BOOL *semi_planar)
+{
+	ImxVpuApiColorFormat color_format;
+	size_t payload_size;
+
+	*width = (size_t)(header[4]) | ((size_t)(header[5]) << 8);
+	*height = (size_t)(header[6]) | ((size_t)(header[7]) << 8);
+	color_format = (ImxVpuApiColorFormat)READ_32BIT_LE(header, 8);
+	payload_size = READ_32BIT_LE(header, 12);
+
+	switch (color_format)
+	{
+		case IMX_VPU_API_COLOR_FORMAT_SEMI_PLANAR_YUV420_8BIT:
+			*semi_planar = TRUE;
+			break;
+
+		case IMX_VPU_API_COLOR_FORMAT_FULLY_PLANAR_YUV420_8BIT:
+			*semi_planar = FALSE;
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	return (*width > 0) && (*height > 0)
+	    && (payload_size == sim_codec_get_payload_size(*width, *height))
+	    && ((payload_size + IMX_VPU_API_SIM_FRAME_HEADER_SIZE) <= data_size);
+}
+
+
+/* Copies the tightly packed planes of a sim frame into a
+ * framebuffer, interleaving the chroma planes if necessary. */
+static void sim_codec_copy_payload(SimCodec *sim_codec, uint8_t *dest, uint8_t const *payload, BOOL semi_planar)
+{
+	size_t x, y;
+	size_t width = sim_codec->width;
+	size_t height = sim_codec->height;
+	size_t chroma_width = (width + 1) / 2;
+	size_t chroma_height = (height + 1) / 2;
+	uint8_t *dest_uv = dest + sim_codec->stride * sim_codec->slice_height;
+	uint8_t const *src_u = payload + width * height;
+	uint8_t const *src_v = src_u + chroma_width * chroma_height;
+
+	for (y = 0; y < height; ++y)
+		memcpy(dest + y * sim_codec->stride, payload + y * width, width);
+
+	for (y = 0; y < chroma_height; ++y)
+	{
+		uint8_t *dest_uv_row = dest_uv + y * sim_codec->stride;
+
+		if (semi_planar)
+		{
+			memcpy(dest_uv_row, src_u + y * chroma_width * 2, chroma_width * 2);
+		}
+		else
+		{
+			for (x = 0; x < chroma_width; ++x)
+			{
+				dest_uv_row[x * 2 + 0] = src_u[y * chroma_width + x];
+				dest_uv_row[x * 2 + 1] = src_v[y * chroma_width + x];
+			}
+		}
+	}
+}
+
+
+static size_t sim_codec_find_framebuffer(SimCodec *sim_codec, OSAL_BUS_WIDTH bus_address)
+{
+	size_t i;
+
+	for (i = 0; i < sim_codec->num_framebuffers; ++i)
+	{
+		if (sim_codec->framebuffers[i].buffer.bus_address == bus_address)
+			return i;
+	}
+
+	return SIZE_MAX;
+}
+
+
+static void sim_codec_clear_output_frames(SimCodec *sim_codec)
+{
+	while (sim_codec->num_output_frames > 0)
+	{
+		SimOutputFrame *output_frame = &(sim_codec->output_frames[sim_codec->first_output_frame_index]);
+		sim_codec->framebuffers[output_frame->framebuffer_index].in_use = FALSE;
+		sim_codec->first_output_frame_index = (sim_codec->first_output_frame_index + 1) % sim_codec->output_frames_capacity;
+		sim_codec->num_output_frames--;
+	}
+
+	sim_codec->first_output_frame_index = 0;
+}
+
+
+
+
+/******************************************/
+/******* CODEC PROTOTYPE FUNCTIONS ********/
+/******************************************/
+
+
+static void sim_codec_destroy(CODEC_PROTOTYPE *codec)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+
+	free(sim_codec->framebuffers);
+	free(sim_codec->output_frames);
+	free(sim_codec);
+}
+
+
+static CODEC_STATE sim_codec_decode(CODEC_PROTOTYPE *codec, STREAM_BUFFER *stream_buffer, OMX_U32 *num_used_input_bytes, FRAME *frame)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+	uint8_t const *data = stream_buffer->bus_data;
+	size_t data_size = stream_buffer->streamlen;
+	size_t width, height, i;
+	BOOL semi_planar;
+	long header_offset;
+	SimFramebuffer *framebuffer;
+	SimOutputFrame *output_frame;
+
+	IMX_VPU_API_UNUSED_PARAM(frame);
+
+	*num_used_input_bytes = 0;
+
+	header_offset = sim_codec_find_frame_header(data, data_size);
+	if ((header_offset < 0) || !sim_codec_parse_frame_header(data + header_offset, data_size - header_offset, &width, &height, &semi_planar))
+	{
+		IMX_VPU_API_DEBUG("%s: no valid sim frame found in %zu byte(s) of data", sim_codec->name, data_size);
+		*num_used_input_bytes = data_size;
+		return CODEC_ERROR_STREAM;
+	}
+
+	if (sim_codec->has_info && ((width != sim_codec->width) || (height != sim_codec->height)))
+	{
+		/* Like the imx-vpu-hantro codecs, first let the decoder backend
+		 * retrieve the remaining frames, and only then announce the
+		 * new stream info. */
+		if (!(sim_codec->pending_flush))
+		{
+			IMX_VPU_API_DEBUG("%s: frame size changed from %zux%zu to %zux%zu", sim_codec->name, sim_codec->width, sim_codec->height, width, height);
+			sim_codec->pending_flush = TRUE;
+			return CODEC_PENDING_FLUSH;
+		}
+
+		if (sim_codec->num_output_frames > 0)
+			return CODEC_PENDING_FLUSH;
+
+		sim_codec->has_info = FALSE;
+	}
+
+	if (!(sim_codec->has_info))
+	{
+		sim_codec->width = width;
+		sim_codec->height = height;
+		sim_codec->stride = IMX_VPU_API_ALIGN_VAL_TO(width, SIM_FRAME_WIDTH_ALIGNMENT);
+		sim_codec->slice_height = IMX_VPU_API_ALIGN_VAL_TO(height, SIM_FRAME_HEIGHT_ALIGNMENT);
+		sim_codec->framebuffer_size = sim_codec->stride * sim_codec->slice_height * 3 / 2;
+		sim_codec->has_info = TRUE;
+		sim_codec->pending_flush = FALSE;
+
+		/* The framebuffers for the old stream info are not used
+		 * anymore. The decoder backend has to add new ones. */
+		sim_codec_clear_output_frames(sim_codec);
+		sim_codec->num_framebuffers = 0;
+
+		return CODEC_HAS_INFO;
+	}
+
+	if (sim_codec->num_framebuffers < SIM_MIN_NUM_REQUIRED_FRAMEBUFFERS)
+		return CODEC_WAITING_FRAME_BUFFER;
+
+	framebuffer = NULL;
+	for (i = 0; i < sim_codec->num_framebuffers; ++i)
+	{
+		if (!(sim_codec->framebuffers[i].in_use))
+		{
+			framebuffer = &(sim_codec->framebuffers[i]);
+			break;
+		}
+	}
+
+	if (framebuffer == NULL)
+		return CODEC_NO_DECODING_BUFFER;
+
+	sim_codec_copy_payload(sim_codec, framebuffer->buffer.bus_data, data + header_offset + IMX_VPU_API_SIM_FRAME_HEADER_SIZE, semi_planar);
+	framebuffer->in_use = TRUE;
+
+	assert(sim_codec->num_output_frames < sim_codec->output_frames_capacity);
+	output_frame = &(sim_codec->output_frames[(sim_codec->first_output_frame_index + sim_codec->num_output_frames) % sim_codec->output_frames_capacity]);
+	output_frame->framebuffer_index = i;
+	output_frame->pic_id = stream_buffer->picId;
+	sim_codec->num_output_frames++;
+
+	*num_used_input_bytes = header_offset + IMX_VPU_API_SIM_FRAME_HEADER_SIZE + sim_codec_get_payload_size(width, height);
+
+	return CODEC_HAS_FRAME;
+}
+
+
+static CODEC_STATE sim_codec_getinfo(CODEC_PROTOTYPE *codec, STREAM_INFO *stream_info)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+
+	if (!(sim_codec->has_info))
+		return CODEC_ERROR_NOT_INITIALIZED;
+
+	stream_info->format = OMX_COLOR_FormatYUV420SemiPlanar;
+	stream_info->width = sim_codec->stride;
+	stream_info->height = sim_codec->slice_height;
+	stream_info->stride = sim_codec->stride;
+	stream_info->sliceheight = sim_codec->slice_height;
+	stream_info->framesize = sim_codec->framebuffer_size;
+	stream_info->frame_buffers = SIM_MIN_NUM_REQUIRED_FRAMEBUFFERS;
+	stream_info->bit_depth = 8;
+	stream_info->interlaced = OMX_FALSE;
+	/* Like the imx-vpu-hantro codecs, store the
+	 * unaligned size in the crop rectangle. */
+	stream_info->crop_available = OMX_TRUE;
+	stream_info->crop_left = 0;
+	stream_info->crop_top = 0;
+	stream_info->crop_width = sim_codec->width;
+	stream_info->crop_height = sim_codec->height;
+
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_getframe(CODEC_PROTOTYPE *codec, FRAME *frame, OMX_BOOL eos)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+	SimOutputFrame *output_frame;
+	SimFramebuffer *framebuffer;
+
+	/* Frames are never reordered, so they can
+	 * always be output, even outside of drain mode. */
+	IMX_VPU_API_UNUSED_PARAM(eos);
+
+	if (sim_codec->num_output_frames == 0)
+	{
+		if (sim_codec->end_of_stream)
+		{
+			sim_codec->end_of_stream = FALSE;
+			return CODEC_END_OF_STREAM;
+		}
+
+		return CODEC_OK;
+	}
+
+	output_frame = &(sim_codec->output_frames[sim_codec->first_output_frame_index]);
+	framebuffer = &(sim_codec->framebuffers[output_frame->framebuffer_index]);
+
+	frame->fb_bus_data = framebuffer->buffer.bus_data;
+	frame->fb_bus_address = framebuffer->buffer.bus_address;
+	frame->outBufPrivate.nPicId[0] = output_frame->pic_id;
+	frame->outBufPrivate.nPicId[1] = output_frame->pic_id;
+
+	sim_codec->first_output_frame_index = (sim_codec->first_output_frame_index + 1) % sim_codec->output_frames_capacity;
+	sim_codec->num_output_frames--;
+
+	return CODEC_HAS_FRAME;
+}
+
+
+static OMX_S32 sim_codec_scanframe(CODEC_PROTOTYPE *codec, STREAM_BUFFER *stream_buffer, OMX_U32 *first, OMX_U32 *last)
+{
+	uint8_t const *data = stream_buffer->bus_data;
+	size_t data_size = stream_buffer->streamlen;
+	size_t width, height;
+	BOOL semi_planar;
+	long header_offset;
+
+	IMX_VPU_API_UNUSED_PARAM(codec);
+
+	header_offset = sim_codec_find_frame_header(data, data_size);
+	if (header_offset < 0)
+	{
+		/* Data without any sim frame header can never be decoded.
+		 * Pass all of it on, so decode() reports a stream error. */
+		if (data_size < IMX_VPU_API_SIM_FRAME_HEADER_SIZE)
+			return -1;
+
+		*first = 0;
+		*last = data_size;
+		return 0;
+	}
+
+	/* The frame is incomplete if the header is, or if the data is too
+	 * short for the payload. In the latter case, the header is either
+	 * corrupted, or more data is needed. Both cannot be distinguished,
+	 * so rely on the decoder backend's usual framing and let decode()
+	 * report an error for corrupted headers. */
+	if (!sim_codec_parse_frame_header(data + header_offset, data_size - header_offset, &width, &height, &semi_planar))
+	{
+		if (READ_32BIT_LE(data + header_offset, 12) > (data_size - header_offset - IMX_VPU_API_SIM_FRAME_HEADER_SIZE))
+			return -1;
+
+		*first = 0;
+		*last = data_size;
+		return 0;
+	}
+
+	*first = 0;
+	*last = header_offset + IMX_VPU_API_SIM_FRAME_HEADER_SIZE + sim_codec_get_payload_size(width, height);
+
+	return 0;
+}
+
+
+static CODEC_STATE sim_codec_endofstream(CODEC_PROTOTYPE *codec)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+	sim_codec->end_of_stream = TRUE;
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_pictureconsumed(CODEC_PROTOTYPE *codec, BUFFER *buffer)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+	size_t index = sim_codec_find_framebuffer(sim_codec, buffer->bus_address);
+
+	if (index == SIZE_MAX)
+	{
+		IMX_VPU_API_ERROR("%s: framebuffer with bus address %#lx is not in the codec", sim_codec->name, (unsigned long)(buffer->bus_address));
+		return CODEC_ERROR_INVALID_ARGUMENT;
+	}
+
+	sim_codec->framebuffers[index].in_use = FALSE;
+
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_setframebuffer(CODEC_PROTOTYPE *codec, BUFFER *buffer, OMX_U32 num_buffers)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+	SimFramebuffer *framebuffer;
+
+	IMX_VPU_API_UNUSED_PARAM(num_buffers);
+
+	if (!(sim_codec->has_info))
+		return CODEC_ERROR_NOT_INITIALIZED;
+
+	if (buffer->allocsize < sim_codec->framebuffer_size)
+		return CODEC_ERROR_BUFFER_SIZE;
+
+	if (sim_codec_find_framebuffer(sim_codec, buffer->bus_address) != SIZE_MAX)
+		return CODEC_ERROR_INVALID_ARGUMENT;
+
+	if (sim_codec->num_framebuffers == sim_codec->framebuffers_capacity)
+	{
+		size_t new_capacity = (sim_codec->framebuffers_capacity > 0) ? (sim_codec->framebuffers_capacity * 2) : 8;
+		SimFramebuffer *new_framebuffers;
+		SimOutputFrame *new_output_frames;
+		size_t i;
+
+		new_framebuffers = realloc(sim_codec->framebuffers, sizeof(SimFramebuffer) * new_capacity);
+		if (new_framebuffers == NULL)
+			return CODEC_ERROR_MEMFAIL;
+		sim_codec->framebuffers = new_framebuffers;
+
+		/* Unwrap the output frame ring buffer while growing it. */
+		new_output_frames = malloc(sizeof(SimOutputFrame) * new_capacity);
+		if (new_output_frames == NULL)
+			return CODEC_ERROR_MEMFAIL;
+		for (i = 0; i < sim_codec->num_output_frames; ++i)
+			new_output_frames[i] = sim_codec->output_frames[(sim_codec->first_output_frame_index + i) % sim_codec->output_frames_capacity];
+		free(sim_codec->output_frames);
+		sim_codec->output_frames = new_output_frames;
+		sim_codec->output_frames_capacity = new_capacity;
+		sim_codec->first_output_frame_index = 0;
+
+		sim_codec->framebuffers_capacity = new_capacity;
+	}
+
+	framebuffer = &(sim_codec->framebuffers[sim_codec->num_framebuffers]);
+	framebuffer->buffer = *buffer;
+	framebuffer->in_use = FALSE;
+	sim_codec->num_framebuffers++;
+
+	return (sim_codec->num_framebuffers < SIM_MIN_NUM_REQUIRED_FRAMEBUFFERS) ? CODEC_NEED_MORE : CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_getframebufferinfo(CODEC_PROTOTYPE *codec, FRAME_BUFFER_INFO *fb_info)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+	size_t i, num_free_framebuffers = 0;
+
+	if (!(sim_codec->has_info))
+		return CODEC_ERROR_NOT_INITIALIZED;
+
+	for (i = 0; i < sim_codec->num_framebuffers; ++i)
+	{
+		if (!(sim_codec->framebuffers[i].in_use))
+			num_free_framebuffers++;
+	}
+
+	/* Request one more framebuffer than there are
+	 * if all of them are in use, like the G1/G2
+	 * codecs do when the DPB is full. */
+	fb_info->bufferSize = sim_codec->framebuffer_size;
+	fb_info->numberOfBuffers = sim_codec->num_framebuffers + ((num_free_framebuffers == 0) ? 1 : 0);
+	if (fb_info->numberOfBuffers < SIM_MIN_NUM_REQUIRED_FRAMEBUFFERS)
+		fb_info->numberOfBuffers = SIM_MIN_NUM_REQUIRED_FRAMEBUFFERS;
+
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_abort(CODEC_PROTOTYPE *codec)
+{
+	SimCodec *sim_codec = (SimCodec *)codec;
+
+	/* Frames that were decoded but not yet retrieved are dropped.
+	 * Frames that were retrieved stay in use until they are
+	 * returned with pictureconsumed(). */
+	sim_codec_clear_output_frames(sim_codec);
+	sim_codec->end_of_stream = FALSE;
+
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_abortafter(CODEC_PROTOTYPE *codec)
+{
+	IMX_VPU_API_UNUSED_PARAM(codec);
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_setnoreorder(CODEC_PROTOTYPE *codec, OMX_BOOL no_reorder)
+{
+	IMX_VPU_API_UNUSED_PARAM(codec);
+	IMX_VPU_API_UNUSED_PARAM(no_reorder);
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_setinfo(CODEC_PROTOTYPE *codec, void *info, void *config)
+{
+	IMX_VPU_API_UNUSED_PARAM(codec);
+	IMX_VPU_API_UNUSED_PARAM(info);
+	IMX_VPU_API_UNUSED_PARAM(config);
+	return CODEC_OK;
+}
+
+
+static CODEC_STATE sim_codec_setppargs(CODEC_PROTOTYPE *codec, PP_ARGS *args)
+{
+	PP_ARGS no_pp_args;
+
+	IMX_VPU_API_UNUSED_PARAM(codec);
+
+	/* There is no post-processor. The decoder backend passes
+	 * all-zero arguments if post-processing is not enabled. */
+	memset(&no_pp_args, 0, sizeof(no_pp_args));
+	return (memcmp(args, &no_pp_args, sizeof(PP_ARGS)) == 0) ? CODEC_OK : CODEC_ERROR_INVALID_ARGUMENT;
+}
+
+
+static CODEC_PROTOTYPE * sim_codec_create(char const *name)
+{
+	SimCodec *sim_codec = malloc(sizeof(SimCodec));
+	if (sim_codec == NULL)
+		return NULL;
+
+	memset(sim_codec, 0, sizeof(SimCodec));
+
+	sim_codec->base.destroy = sim_codec_destroy;
+	sim_codec->base.decode = sim_codec_decode;
+	sim_codec->base.getinfo = sim_codec_getinfo;
+	sim_codec->base.getframe = sim_codec_getframe;
+	sim_codec->base.scanframe = sim_codec_scanframe;
+	sim_codec->base.endofstream = sim_codec_endofstream;
+	sim_codec->base.pictureconsumed = sim_codec_pictureconsumed;
+	sim_codec->base.setframebuffer = sim_codec_setframebuffer;
+	sim_codec->base.getframebufferinfo = sim_codec_getframebufferinfo;
+	sim_codec->base.abort = sim_codec_abort;
+	sim_codec->base.abortafter = sim_codec_abortafter;
+	sim_codec->base.setnoreorder = sim_codec_setnoreorder;
+	sim_codec->base.setinfo = sim_codec_setinfo;
+	sim_codec->base.setppargs = sim_codec_setppargs;
+
+	sim_codec->name = name;
+
+	IMX_VPU_API_DEBUG("created simulated %s codec", name);
+
+	return (CODEC_PROTOTYPE *)sim_codec;
+}
+
+
+
+
+/**************************************************/
+/******* IMX-VPU-HANTRO REPLACEMENT FUNCTIONS *****/
+/**************************************************/
+
+
+/* There is no hardware, so the DWL instance is only
+ * a token that is checked for being non-NULL. */
+static int sim_dwl_instance;
+
+
+const void *DWLInit(struct DWLInitParam *param)
+{
+	IMX_VPU_API_UNUSED_PARAM(param);
+	return &sim_dwl_instance;
+}
+
+
+i32 DWLRelease(const void *instance)
+{
+	IMX_VPU_API_UNUSED_PARAM(instance);
+	return 0;
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_avs(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("AVS");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_h264(const void *dwl, OMX_BOOL mvc, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(mvc);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("h.264");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_hevc(const void *dwl, OMX_VIDEO_PARAM_G2CONFIGTYPE *g2)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(g2);
+	return sim_codec_create("h.265");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_jpeg(OMX_BOOL motion_jpeg)
+{
+	IMX_VPU_API_UNUSED_PARAM(motion_jpeg);
+	return sim_codec_create("JPEG");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_mpeg2(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("MPEG-2");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_mpeg4(const void *dwl, OMX_BOOL deblocking, MPEG4_FORMAT format, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(deblocking);
+	IMX_VPU_API_UNUSED_PARAM(format);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("MPEG-4");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_rv(const void *dwl, OMX_BOOL is_rv8, OMX_U32 frame_code_length, OMX_U32 *frame_sizes, OMX_U32 max_width, OMX_U32 max_height, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(is_rv8);
+	IMX_VPU_API_UNUSED_PARAM(frame_code_length);
+	IMX_VPU_API_UNUSED_PARAM(frame_sizes);
+	IMX_VPU_API_UNUSED_PARAM(max_width);
+	IMX_VPU_API_UNUSED_PARAM(max_height);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("RealVideo");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vc1(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("VC-1");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vp6(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("VP6");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vp8(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(g1);
+	return sim_codec_create("VP8");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vp9(const void *dwl, OMX_VIDEO_PARAM_G2CONFIGTYPE *g2)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	IMX_VPU_API_UNUSED_PARAM(g2);
+	return sim_codec_create("VP9");
+}
+
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_webp(const void *dwl)
+{
+	IMX_VPU_API_UNUSED_PARAM(dwl);
+	return sim_codec_create("WebP");
+}
@@ -0,0 +1,309 @@
+/* imxvpuapi software simulation backend - Hantro codec definitions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef IMXVPUAPI2_SIM_HANTRO_CODEC_H
+#define IMXVPUAPI2_SIM_HANTRO_CODEC_H
+
+#include <stdint.h>
+
+
+/* This header replaces the imx-vpu-hantro decoder headers (dwl.h, codec.h,
+ * and the OMX types they pull in) on the sim platform. It only contains the
+ * subset of definitions that the Hantro decoder backend in
+ * imxvpuapi2_imx8m_hantro_decoder.c uses. Both that backend and the
+ * simulated codec in imxvpuapi2_sim_hantro_codec.c are built against this
+ * header on the sim platform, so the enum values and structure layouts only
+ * have to be consistent with each other, and not with imx-vpu-hantro.
+ * This allows for building the sim platform on hosts that do not have the
+ * imx-vpu-hantro headers. On the i.MX8M, the real headers are used. */
+
+
+/* OMX types */
+
+typedef uint32_t OMX_U32;
+typedef int32_t OMX_S32;
+typedef uint8_t OMX_U8;
+
+typedef enum
+{
+	OMX_FALSE = 0,
+	OMX_TRUE = 1
+}
+OMX_BOOL;
+
+typedef uintptr_t OSAL_BUS_WIDTH;
+
+typedef enum
+{
+	OMX_COLOR_FormatL8,
+	OMX_COLOR_FormatYUV411PackedPlanar,
+	OMX_COLOR_FormatYUV411PackedSemiPlanar,
+	OMX_COLOR_FormatYUV411Planar,
+	OMX_COLOR_FormatYUV411SemiPlanar,
+	OMX_COLOR_FormatYUV420PackedPlanar,
+	OMX_COLOR_FormatYUV420PackedSemiPlanar,
+	OMX_COLOR_FormatYUV420Planar,
+	OMX_COLOR_FormatYUV420SemiPlanar,
+	OMX_COLOR_FormatYUV420SemiPlanar4x4Tiled,
+	OMX_COLOR_FormatYUV420SemiPlanar8x4Tiled,
+	OMX_COLOR_FormatYUV420SemiPlanarP010,
+	OMX_COLOR_FormatYUV422PackedPlanar,
+	OMX_COLOR_FormatYUV422PackedSemiPlanar,
+	OMX_COLOR_FormatYUV422Planar,
+	OMX_COLOR_FormatYUV422SemiPlanar,
+	OMX_COLOR_FormatYUV440PackedSemiPlanar,
+	OMX_COLOR_FormatYUV440SemiPlanar,
+	OMX_COLOR_FormatYUV444PackedSemiPlanar,
+	OMX_COLOR_FormatYUV444SemiPlanar,
+	OMX_COLOR_FormatYCbYCr,
+	OMX_COLOR_FormatCbYCrY,
+	OMX_COLOR_Format16bitRGB565,
+	OMX_COLOR_Format16bitBGR565,
+	OMX_COLOR_Format32bitARGB8888
+}
+OMX_COLOR_FORMATTYPE;
+
+typedef enum
+{
+	OMX_VIDEO_G2PixelFormat_Default,
+	OMX_VIDEO_G2PixelFormat_8bit
+}
+OMX_VIDEO_G2PIXELFORMAT;
+
+typedef struct
+{
+	OMX_BOOL bEnableTiled;
+	OMX_BOOL bAllowFieldDBP;
+	OMX_BOOL bEnableRFC;
+	OMX_BOOL bEnableFetchOnePic;
+	OMX_BOOL bEnableAdaptiveBuffers;
+	OMX_BOOL bEnableSecureMode;
+	OMX_BOOL bEnableRingBuffer;
+	OMX_U32 nGuardSize;
+	OMX_VIDEO_G2PIXELFORMAT ePixelFormat;
+}
+OMX_VIDEO_PARAM_G1CONFIGTYPE;
+
+typedef OMX_VIDEO_PARAM_G1CONFIGTYPE OMX_VIDEO_PARAM_G2CONFIGTYPE;
+
+typedef struct
+{
+	OMX_VIDEO_PARAM_G1CONFIGTYPE g1_conf;
+	OMX_VIDEO_PARAM_G2CONFIGTYPE g2_conf;
+}
+OMX_VIDEO_PARAM_CONFIGTYPE;
+
+
+/* DWL (hardware abstraction layer) */
+
+typedef int32_t i32;
+
+enum
+{
+	DWL_CLIENT_TYPE_H264_DEC = 1,
+	DWL_CLIENT_TYPE_HEVC_DEC = 2
+};
+
+struct DWLInitParam
+{
+	unsigned int client_type;
+};
+
+const void *DWLInit(struct DWLInitParam *param);
+i32 DWLRelease(const void *instance);
+
+
+/* Codec interface */
+
+typedef enum
+{
+	CODEC_OK,
+	CODEC_ABORTED,
+	CODEC_BUFFER_EMPTY,
+	CODEC_END_OF_STREAM,
+	CODEC_ERROR_BUFFER_SIZE,
+	CODEC_ERROR_DWL,
+	CODEC_ERROR_FORMAT_NOT_SUPPORTED,
+	CODEC_ERROR_FRAME,
+	CODEC_ERROR_HW_BUS_ERROR,
+	CODEC_ERROR_HW_RESERVED,
+	CODEC_ERROR_HW_TIMEOUT,
+	CODEC_ERROR_INITFAIL,
+	CODEC_ERROR_INVALID_ARGUMENT,
+	CODEC_ERROR_MEMFAIL,
+	CODEC_ERROR_NOT_ENOUGH_FRAME_BUFFERS,
+	CODEC_ERROR_NOT_INITIALIZED,
+	CODEC_ERROR_STREAM,
+	CODEC_ERROR_STREAM_NOT_SUPPORTED,
+	CODEC_ERROR_SYS,
+	CODEC_ERROR_UNSPECIFIED,
+	CODEC_FLUSHED,
+	CODEC_HAS_FRAME,
+	CODEC_HAS_INFO,
+	CODEC_NEED_MORE,
+	CODEC_NO_DECODING_BUFFER,
+	CODEC_PENDING_FLUSH,
+	CODEC_PIC_SKIPPED,
+	CODEC_WAITING_FRAME_BUFFER
+}
+CODEC_STATE;
+
+typedef struct
+{
+	OMX_U8 *bus_data;
+	OSAL_BUS_WIDTH bus_address;
+	OMX_U8 *buf_data;
+	OSAL_BUS_WIDTH buf_address;
+	OMX_U32 streamlen;
+	OMX_U32 allocsize;
+	OMX_U32 sliceInfoNum;
+	OMX_U8 *pSliceInfo;
+	OMX_U32 picId;
+}
+STREAM_BUFFER;
+
+typedef struct
+{
+	OMX_U8 *bus_data;
+	OSAL_BUS_WIDTH bus_address;
+	OMX_U32 allocsize;
+}
+BUFFER;
+
+typedef struct
+{
+	OMX_U32 nPicId[2];
+}
+OUTPUT_BUFFER_PRIVATE;
+
+typedef struct
+{
+	OMX_U8 *fb_bus_data;
+	OSAL_BUS_WIDTH fb_bus_address;
+	OUTPUT_BUFFER_PRIVATE outBufPrivate;
+	OMX_U32 fb_size;
+	OMX_U32 size;
+}
+FRAME;
+
+typedef struct
+{
+	OMX_U32 redPrimary[2];
+	OMX_U32 greenPrimary[2];
+	OMX_U32 bluePrimary[2];
+	OMX_U32 whitePoint[2];
+	OMX_U32 maxMasteringLuminance;
+	OMX_U32 minMasteringLuminance;
+	OMX_U32 maxContentLightLevel;
+	OMX_U32 maxFrameAverageLightLevel;
+}
+HDR10_METADATA;
+
+typedef struct
+{
+	OMX_COLOR_FORMATTYPE format;
+	OMX_U32 width, height;
+	OMX_U32 stride, sliceheight;
+	OMX_U32 framesize;
+	OMX_U32 frame_buffers;
+	OMX_U32 bit_depth;
+	OMX_BOOL crop_available;
+	OMX_BOOL interlaced;
+	OMX_BOOL hdr10_available;
+	OMX_BOOL colour_desc_available;
+	OMX_BOOL chroma_loc_info_available;
+	OMX_U32 crop_left, crop_top, crop_width, crop_height;
+	HDR10_METADATA hdr10_metadata;
+	OMX_U32 colour_primaries;
+	OMX_U32 transfer_characteristics;
+	OMX_U32 matrix_coeffs;
+	OMX_U32 video_full_range_flag;
+	OMX_U32 chroma_sample_loc_type_top_field;
+	OMX_U32 chroma_sample_loc_type_bottom_field;
+}
+STREAM_INFO;
+
+typedef struct
+{
+	struct
+	{
+		OMX_S32 left, top, width, height;
+	}
+	crop;
+	struct
+	{
+		OMX_S32 width, height;
+	}
+	scale;
+	OMX_COLOR_FORMATTYPE format;
+}
+PP_ARGS;
+
+typedef struct FRAME_BUFFER_INFO
+{
+	OMX_U32 bufferSize;
+	OMX_U32 numberOfBuffers;
+	OSAL_BUS_WIDTH fb_bus_address;
+}
+FRAME_BUFFER_INFO;
+
+typedef struct CODEC_PROTOTYPE CODEC_PROTOTYPE;
+
+struct CODEC_PROTOTYPE
+{
+	void (*destroy)(CODEC_PROTOTYPE *);
+	CODEC_STATE (*decode)(CODEC_PROTOTYPE *, STREAM_BUFFER *, OMX_U32 *, FRAME *);
+	CODEC_STATE (*getinfo)(CODEC_PROTOTYPE *, STREAM_INFO *);
+	CODEC_STATE (*getframe)(CODEC_PROTOTYPE *, FRAME *, OMX_BOOL);
+	OMX_S32 (*scanframe)(CODEC_PROTOTYPE *, STREAM_BUFFER *, OMX_U32 *, OMX_U32 *);
+	CODEC_STATE (*endofstream)(CODEC_PROTOTYPE *);
+	CODEC_STATE (*pictureconsumed)(CODEC_PROTOTYPE *, BUFFER *);
+	CODEC_STATE (*setframebuffer)(CODEC_PROTOTYPE *, BUFFER *, OMX_U32);
+	CODEC_STATE (*getframebufferinfo)(CODEC_PROTOTYPE *, FRAME_BUFFER_INFO *);
+	CODEC_STATE (*abort)(CODEC_PROTOTYPE *);
+	CODEC_STATE (*abortafter)(CODEC_PROTOTYPE *);
+	CODEC_STATE (*setnoreorder)(CODEC_PROTOTYPE *, OMX_BOOL);
+	CODEC_STATE (*setinfo)(CODEC_PROTOTYPE *, void *, void *);
+	CODEC_STATE (*setppargs)(CODEC_PROTOTYPE *, PP_ARGS *);
+};
+
+typedef enum
+{
+	MPEG4FORMAT_MPEG4,
+	MPEG4FORMAT_H263,
+	MPEG4FORMAT_SORENSON,
+	MPEG4FORMAT_CUSTOM_1,
+	MPEG4FORMAT_CUSTOM_1_3
+}
+MPEG4_FORMAT;
+
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_avs(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_h264(const void *dwl, OMX_BOOL mvc, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_hevc(const void *dwl, OMX_VIDEO_PARAM_G2CONFIGTYPE *g2);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_jpeg(OMX_BOOL motion_jpeg);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_mpeg2(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_mpeg4(const void *dwl, OMX_BOOL deblocking, MPEG4_FORMAT format, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_rv(const void *dwl, OMX_BOOL bIsRV8, OMX_U32 frame_code_length, OMX_U32 *frame_sizes, OMX_U32 maxwidth, OMX_U32 maxheight, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vc1(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vp6(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vp8(const void *dwl, OMX_VIDEO_PARAM_G1CONFIGTYPE *g1);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_vp9(const void *dwl, OMX_VIDEO_PARAM_G2CONFIGTYPE *g2);
+CODEC_PROTOTYPE *HantroHwDecOmx_decoder_create_webp(const void *dwl);
+
+
+#endif